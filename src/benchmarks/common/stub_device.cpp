@@ -0,0 +1,268 @@
+#include "stub_device.h"
+
+#include "vulkan/swapChain.h"
+#include "vulkan/vkContext.h"
+#include "vulkan/vkUtils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace mg {
+VulkanContext vkContext = {};
+
+int32_t findMemoryTypeIndex(const VkPhysicalDeviceMemoryProperties &memoryProperties,
+                            uint32_t memoryTypeBitsRequirement, VkMemoryPropertyFlags, VkMemoryPropertyFlags) {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if (memoryTypeBitsRequirement & (1u << i))
+      return int32_t(i);
+  }
+  return -1;
+}
+} // namespace mg
+
+namespace stub {
+
+struct _Memory {
+  VkDeviceSize size;
+  void *data;
+};
+
+static DeviceStats _deviceStats = {};
+static uint64_t _nextHandle = 1;
+// host memory is only allocated when a device memory is mapped, so large device only heaps cost nothing
+static std::unordered_map<uint64_t, _Memory> _memories;
+static std::unordered_map<uint64_t, VkDeviceSize> _bufferSizes;
+// fences of submits the queue has not finished yet, fences that are not in here are signaled
+static std::unordered_map<uint64_t, mg::timer::Time> _fenceSignalTimes;
+static uint64_t _gpuTimeOfSubmitsInUs = 0;
+static mg::timer::Time _gpuEndTime;
+static std::mutex _mutex;
+
+static uint64_t createHandle() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _nextHandle++;
+}
+
+void initDevice(uint32_t memoryTypeCount) {
+  mg::vkContext.device = (VkDevice)(uintptr_t(0x1));
+  mg::vkContext.physicalDeviceMemoryProperties.memoryTypeCount = memoryTypeCount;
+  mg::vkContext.physicalDeviceProperties.limits.minUniformBufferOffsetAlignment = 256;
+  mg::vkContext.physicalDeviceProperties.limits.minStorageBufferOffsetAlignment = 256;
+  resetDeviceStats();
+}
+
+void resetDeviceStats() { _deviceStats = {}; }
+
+DeviceStats getDeviceStats() { return _deviceStats; }
+
+void setGpuTimeOfSubmits(uint64_t gpuTimeInUs) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _gpuTimeOfSubmitsInUs = gpuTimeInUs;
+}
+
+mg::timer::Time getGpuEndTime() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _gpuEndTime;
+}
+
+static mg::timer::Time getFenceSignalTime(VkFence fence) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const auto it = _fenceSignalTimes.find(uint64_t(fence));
+  return it != _fenceSignalTimes.end() ? it->second : mg::timer::Time();
+}
+
+} // namespace stub
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo *pAllocateInfo,
+                                                const VkAllocationCallbacks *, VkDeviceMemory *pMemory) {
+  std::lock_guard<std::mutex> lock(stub::_mutex);
+  const auto handle = stub::_nextHandle++;
+  stub::_memories[handle] = {pAllocateInfo->allocationSize, nullptr};
+  *pMemory = (VkDeviceMemory)handle;
+  stub::_deviceStats.nrOfAllocateMemoryCalls++;
+  stub::_deviceStats.totalAllocatedBytes += pAllocateInfo->allocationSize;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks *) {
+  if (memory == VK_NULL_HANDLE)
+    return;
+  std::lock_guard<std::mutex> lock(stub::_mutex);
+  const auto it = stub::_memories.find(uint64_t(memory));
+  if (it != stub::_memories.end()) {
+    free(it->second.data);
+    stub::_memories.erase(it);
+  }
+  stub::_deviceStats.nrOfFreeMemoryCalls++;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize,
+                                           VkMemoryMapFlags, void **ppData) {
+  std::lock_guard<std::mutex> lock(stub::_mutex);
+  auto &deviceMemory = stub::_memories[uint64_t(memory)];
+  if (deviceMemory.data == nullptr)
+    deviceMemory.data = malloc(deviceMemory.size);
+  *ppData = (char *)deviceMemory.data + offset;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice, const VkBufferCreateInfo *pCreateInfo,
+                                              const VkAllocationCallbacks *, VkBuffer *pBuffer) {
+  const auto handle = stub::createHandle();
+  std::lock_guard<std::mutex> lock(stub::_mutex);
+  stub::_bufferSizes[handle] = pCreateInfo->size;
+  *pBuffer = (VkBuffer)handle;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks *) {
+  std::lock_guard<std::mutex> lock(stub::_mutex);
+  stub::_bufferSizes.erase(uint64_t(buffer));
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice, VkBuffer buffer,
+                                                         VkMemoryRequirements *pMemoryRequirements) {
+  std::lock_guard<std::mutex> lock(stub::_mutex);
+  pMemoryRequirements->size = stub::_bufferSizes[uint64_t(buffer)];
+  pMemoryRequirements->alignment = 256;
+  pMemoryRequirements->memoryTypeBits = ~0u;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize) {
+  return VK_SUCCESS;
+}
+
+// descriptor pools, descriptor sets, fences and command buffers are plain handles
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice, const VkDescriptorPoolCreateInfo *,
+                                                      const VkAllocationCallbacks *,
+                                                      VkDescriptorPool *pDescriptorPool) {
+  *pDescriptorPool = (VkDescriptorPool)stub::createHandle();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice, VkDescriptorPool, const VkAllocationCallbacks *) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo *pAllocateInfo,
+                                                        VkDescriptorSet *pDescriptorSets) {
+  for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; i++) {
+    pDescriptorSets[i] = (VkDescriptorSet)stub::createHandle();
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFreeDescriptorSets(VkDevice, VkDescriptorPool, uint32_t, const VkDescriptorSet *) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice, uint32_t, const VkWriteDescriptorSet *, uint32_t,
+                                                  const VkCopyDescriptorSet *) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(VkDevice, const VkFenceCreateInfo *, const VkAllocationCallbacks *,
+                                             VkFence *pFence) {
+  *pFence = (VkFence)stub::createHandle();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFence(VkDevice, VkFence fence, const VkAllocationCallbacks *) {
+  std::lock_guard<std::mutex> lock(stub::_mutex);
+  stub::_fenceSignalTimes.erase(uint64_t(fence));
+}
+
+// only waiting for all fences is supported
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice, uint32_t fenceCount, const VkFence *pFences, VkBool32,
+                                               uint64_t) {
+  for (uint32_t i = 0; i < fenceCount; i++) {
+    std::this_thread::sleep_until(stub::getFenceSignalTime(pFences[i]));
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice, uint32_t fenceCount, const VkFence *pFences) {
+  std::lock_guard<std::mutex> lock(stub::_mutex);
+  for (uint32_t i = 0; i < fenceCount; i++) {
+    stub::_fenceSignalTimes.erase(uint64_t(pFences[i]));
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetFenceStatus(VkDevice, VkFence fence) {
+  return mg::timer::now() >= stub::getFenceSignalTime(fence) ? VK_SUCCESS : VK_NOT_READY;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo *pAllocateInfo,
+                                                        VkCommandBuffer *pCommandBuffers) {
+  for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+    pCommandBuffers[i] = (VkCommandBuffer)stub::createHandle();
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeCommandBuffers(VkDevice, VkCommandPool, uint32_t, const VkCommandBuffer *) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer, const VkCommandBufferBeginInfo *) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer) { return VK_SUCCESS; }
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue, uint32_t, const VkSubmitInfo *, VkFence fence) {
+  std::lock_guard<std::mutex> lock(stub::_mutex);
+  stub::_gpuEndTime = std::max(stub::_gpuEndTime, mg::timer::now()) +
+                      std::chrono::microseconds(stub::_gpuTimeOfSubmitsInUs);
+  if (fence != VK_NULL_HANDLE)
+    stub::_fenceSignalTimes[uint64_t(fence)] = stub::_gpuEndTime;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice, VkPipelineCache, uint32_t createInfoCount,
+                                                         const VkGraphicsPipelineCreateInfo *,
+                                                         const VkAllocationCallbacks *, VkPipeline *pPipelines) {
+  for (uint32_t i = 0; i < createInfoCount; i++) {
+    pPipelines[i] = (VkPipeline)stub::createHandle();
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateComputePipelines(VkDevice, VkPipelineCache, uint32_t createInfoCount,
+                                                        const VkComputePipelineCreateInfo *,
+                                                        const VkAllocationCallbacks *, VkPipeline *pPipelines) {
+  for (uint32_t i = 0; i < createInfoCount; i++) {
+    pPipelines[i] = (VkPipeline)stub::createHandle();
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(VkDevice, VkPipeline, const VkAllocationCallbacks *) {}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint, VkPipeline) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(VkDevice, const VkShaderModuleCreateInfo *,
+                                                    const VkAllocationCallbacks *, VkShaderModule *pShaderModule) {
+  *pShaderModule = (VkShaderModule)stub::createHandle();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyShaderModule(VkDevice, VkShaderModule, const VkAllocationCallbacks *) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo *, const VkAllocationCallbacks *,
+                                                 VkSemaphore *pSemaphore) {
+  *pSemaphore = (VkSemaphore)stub::createHandle();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore, const VkAllocationCallbacks *) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue(VkDevice, VkSemaphore, uint64_t *pValue) {
+  *pValue = UINT64_MAX;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags,
+                                                VkDependencyFlags, uint32_t, const VkMemoryBarrier *, uint32_t,
+                                                const VkBufferMemoryBarrier *, uint32_t,
+                                                const VkImageMemoryBarrier *) {}
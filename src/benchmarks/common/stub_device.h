@@ -0,0 +1,25 @@
+#pragma once
+#include "mg/mgUtils.h"
+#include <cstdint>
+
+// cpu only replacement for the vulkan entry points used by the engine allocators, linear heaps and pipelines,
+// the benchmarks link against this instead of the vulkan loader
+namespace stub {
+
+struct DeviceStats {
+  uint64_t nrOfAllocateMemoryCalls;
+  uint64_t nrOfFreeMemoryCalls;
+  uint64_t totalAllocatedBytes;
+};
+
+void initDevice(uint32_t memoryTypeCount);
+void resetDeviceStats();
+DeviceStats getDeviceStats();
+
+// the queue runs the submits one after the other, a submit takes the gpu time set here, 0 by default. The fence of a
+// submit is signaled when the queue is done with it, vkWaitForFences sleeps until then
+void setGpuTimeOfSubmits(uint64_t gpuTimeInUs);
+// when the queue is done with the last submit
+mg::timer::Time getGpuEndTime();
+
+} // namespace stub
@@ -0,0 +1,187 @@
+#include "common/stub_device.h"
+#include "mg/mgUtils.h"
+#include "vulkan/deviceAllocator.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// replays alloc/free traces against DeviceMemoryAllocator with vkAllocateMemory stubbed out,
+// usage: device-allocator-benchmark [trace file]
+// trace file format, one operation per line: "a <id> <size> <alignment>" or "f <id>"
+
+struct TraceOperation {
+  bool allocate;
+  uint32_t id;
+  uint32_t size;
+  uint32_t alignment;
+};
+
+struct Trace {
+  std::vector<TraceOperation> operations;
+  uint32_t nrOfIds;
+};
+
+static Trace generateTrace(uint32_t nrOfOperations, uint32_t targetNrOfLiveAllocations, uint32_t seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  const uint32_t textureAlignments[] = {256, 1024, 4096, 65536};
+
+  Trace trace = {};
+  std::vector<uint32_t> liveIds;
+  for (uint32_t i = 0; i < nrOfOperations; i++) {
+    const float allocateProbability = liveIds.size() < targetNrOfLiveAllocations ? 0.7f : 0.3f;
+    if (liveIds.empty() || unit(generator) < allocateProbability) {
+      // mostly small mesh buffers, some textures and a few large textures
+      const float kind = unit(generator);
+      float minSize, maxSize;
+      uint32_t alignment;
+      if (kind < 0.85f) {
+        minSize = 256.0f, maxSize = 64.0f * 1024.0f;
+        alignment = 256;
+      } else if (kind < 0.99f) {
+        minSize = 64.0f * 1024.0f, maxSize = 2.0f * 1024.0f * 1024.0f;
+        alignment = textureAlignments[generator() % mg::countof(textureAlignments)];
+      } else {
+        minSize = 2.0f * 1024.0f * 1024.0f, maxSize = 16.0f * 1024.0f * 1024.0f;
+        alignment = 65536;
+      }
+      const float size = minSize * std::pow(maxSize / minSize, unit(generator));
+
+      TraceOperation operation = {};
+      operation.allocate = true;
+      operation.id = trace.nrOfIds++;
+      operation.size = uint32_t(size);
+      operation.alignment = alignment;
+      trace.operations.push_back(operation);
+      liveIds.push_back(operation.id);
+    } else {
+      const uint32_t index = generator() % uint32_t(liveIds.size());
+      trace.operations.push_back({false, liveIds[index], 0, 0});
+      liveIds[index] = liveIds.back();
+      liveIds.pop_back();
+    }
+  }
+  for (auto id : liveIds) {
+    trace.operations.push_back({false, id, 0, 0});
+  }
+  return trace;
+}
+
+static bool loadTrace(const std::string &path, Trace *trace) {
+  std::ifstream file(path);
+  if (!file.is_open())
+    return false;
+
+  *trace = {};
+  std::string type;
+  while (file >> type) {
+    TraceOperation operation = {};
+    operation.allocate = type == "a";
+    file >> operation.id;
+    if (operation.allocate)
+      file >> operation.size >> operation.alignment;
+    trace->nrOfIds = std::max(trace->nrOfIds, operation.id + 1);
+    trace->operations.push_back(operation);
+  }
+  return true;
+}
+
+struct ReplayResult {
+  uint64_t bestTimeInUs;
+  uint32_t nrOfHeaps;
+  uint32_t warmupHostAllocations;
+  uint32_t steadyStateHostAllocations;
+  // sampled halfway through the trace
+  std::vector<mg::DeviceHeapStats> heapStats;
+};
+
+// the first iteration warms up the allocator, the following ones should not touch the host heap
+static ReplayResult replayTrace(const Trace &trace, mg::DeviceAllocationStrategy strategy, uint32_t nrOfIterations) {
+  constexpr uint32_t mgTobytes = 1024 * 1024;
+  constexpr uint32_t heapSize = 256 * mgTobytes;
+
+  auto allocator = std::make_unique<mg::DeviceMemoryAllocator>();
+  mg::CreateDeviceHeapAllocatorInfo createInfo = {};
+  createInfo.heapSizes = {heapSize, heapSize, heapSize, heapSize};
+  createInfo.useDifferentHeapsForSmallAllocations = false;
+  createInfo.allocationStrategy = strategy;
+  allocator->create(createInfo);
+  stub::resetDeviceStats();
+
+  std::vector<mg::DeviceHeapAllocation> allocations(trace.nrOfIds);
+  const auto replayOperations = [&](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+      const auto &operation = trace.operations[i];
+      if (operation.allocate)
+        allocations[operation.id] = allocator->allocateDeviceOnlyMemory(0, operation.size, operation.alignment);
+      else
+        allocator->freeDeviceOnlyMemory(allocations[operation.id]);
+    }
+  };
+  const auto nrOfOperations = uint32_t(trace.operations.size());
+
+  ReplayResult result = {};
+  result.bestTimeInUs = UINT64_MAX;
+  for (uint32_t iteration = 0; iteration < nrOfIterations; iteration++) {
+    const auto start = mg::timer::now();
+    replayOperations(0, nrOfOperations);
+    const auto end = mg::timer::now();
+
+    result.bestTimeInUs = std::min(result.bestTimeInUs, mg::timer::durationInUs(start, end));
+    if (iteration == 0)
+      result.warmupHostAllocations = allocator->getNrOfHostAllocations();
+  }
+  result.steadyStateHostAllocations = allocator->getNrOfHostAllocations() - result.warmupHostAllocations;
+
+  replayOperations(0, nrOfOperations / 2);
+  result.heapStats = allocator->getHeapStats();
+  replayOperations(nrOfOperations / 2, nrOfOperations);
+  result.nrOfHeaps = uint32_t(stub::getDeviceStats().nrOfAllocateMemoryCalls);
+  allocator->destroy();
+  return result;
+}
+
+int main(int argc, char **argv) {
+  stub::initDevice(1);
+
+  Trace trace = {};
+  if (argc > 1) {
+    if (!loadTrace(argv[1], &trace)) {
+      printf("could not open trace file: %s\n", argv[1]);
+      return 1;
+    }
+  } else {
+    trace = generateTrace(1000000, 2000, 1);
+  }
+  printf("replaying %zu operations, %u allocations\n", trace.operations.size(), trace.nrOfIds);
+
+  const struct {
+    const char *name;
+    mg::DeviceAllocationStrategy strategy;
+  } strategies[] = {
+      {"first fit", mg::DeviceAllocationStrategy::FirstFit},
+      {"tlsf", mg::DeviceAllocationStrategy::Tlsf},
+      {"buddy", mg::DeviceAllocationStrategy::Buddy},
+  };
+  for (const auto &strategy : strategies) {
+    const auto result = replayTrace(trace, strategy.strategy, 5);
+    const double nsPerOperation = double(result.bestTimeInUs) * 1000.0 / double(trace.operations.size());
+    printf("%-10s %10llu us %8.1f ns/op, vkAllocateMemory calls: %u, host allocations warmup: %u, steady state: %u\n",
+           strategy.name, (unsigned long long)result.bestTimeInUs, nsPerOperation, result.nrOfHeaps,
+           result.warmupHostAllocations, result.steadyStateHostAllocations);
+    for (const auto &stats : result.heapStats) {
+      const auto paddingSize = stats.totalSize - stats.freeSize - stats.allocatedSize;
+      printf("%-10s heap %u, allocated: %7.2f mb, padding: %7.2f mb, free: %7.2f mb, largest free block: %7.2f mb, "
+             "free blocks: %u, fragmentation: %5.1f%%\n",
+             "", stats.heapIndex, stats.allocatedSize / 1024.0 / 1024.0, paddingSize / 1024.0 / 1024.0,
+             stats.freeSize / 1024.0 / 1024.0, stats.largestFreeBlockSize / 1024.0 / 1024.0, stats.nrOfFreeBlocks,
+             stats.fragmentation * 100.0f);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include "common/stub_device.h"
+#include "mg/mgUtils.h"
+#include "vulkan/deviceAllocator.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// allocation throughput of DeviceMemoryAllocator as the number of threads grows, vkAllocateMemory is stubbed out.
+// every round each thread allocates a batch, then frees half of its own batch and half of the batch of the next
+// thread so the cross thread free path is exercised.
+// usage: device-allocator-threads-benchmark [max nr of threads]
+
+static constexpr uint32_t nrOfRounds = 2000;
+static constexpr uint32_t batchSize = 256;
+
+class SpinBarrier {
+public:
+  explicit SpinBarrier(uint32_t nrOfThreads) : _nrOfThreads(nrOfThreads) {}
+
+  void wait() {
+    const auto generation = _generation.load();
+    if (++_nrOfWaiting == _nrOfThreads) {
+      _nrOfWaiting = 0;
+      _generation++;
+      return;
+    }
+    while (_generation.load() == generation) {
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  const uint32_t _nrOfThreads;
+  std::atomic<uint32_t> _nrOfWaiting = {0};
+  std::atomic<uint32_t> _generation = {0};
+};
+
+struct Request {
+  uint32_t size;
+  uint32_t alignment;
+};
+
+// mostly small mesh buffers and some textures
+static std::vector<Request> generateRequests(uint32_t count, uint32_t seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<Request> requests(count);
+  for (auto &request : requests) {
+    const bool small = unit(generator) < 0.9f;
+    const float minSize = small ? 256.0f : 64.0f * 1024.0f;
+    const float maxSize = small ? 64.0f * 1024.0f : 1024.0f * 1024.0f;
+    request.size = uint32_t(minSize * std::pow(maxSize / minSize, unit(generator)));
+    request.alignment = small ? 256 : 4096;
+  }
+  return requests;
+}
+
+enum class Mode { GlobalMutex, ThreadCaches };
+
+static double runBenchmark(Mode mode, uint32_t nrOfThreads) {
+  constexpr uint32_t mgTobytes = 1024 * 1024;
+  constexpr uint32_t heapSize = 256 * mgTobytes;
+
+  auto allocator = std::make_unique<mg::DeviceMemoryAllocator>();
+  mg::CreateDeviceHeapAllocatorInfo createInfo = {};
+  createInfo.heapSizes = {heapSize, heapSize, heapSize, heapSize};
+  createInfo.useDifferentHeapsForSmallAllocations = false;
+  createInfo.allocationStrategy = mg::DeviceAllocationStrategy::Tlsf;
+  createInfo.threadSafe = mode == Mode::ThreadCaches;
+  allocator->create(createInfo);
+
+  std::mutex mutex;
+  const auto allocate = [&](const Request &request) {
+    if (mode == Mode::GlobalMutex) {
+      std::lock_guard<std::mutex> lock(mutex);
+      return allocator->allocateDeviceOnlyMemory(0, request.size, request.alignment);
+    }
+    return allocator->allocateDeviceOnlyMemory(0, request.size, request.alignment);
+  };
+  const auto free = [&](const mg::DeviceHeapAllocation &allocation) {
+    if (mode == Mode::GlobalMutex) {
+      std::lock_guard<std::mutex> lock(mutex);
+      allocator->freeDeviceOnlyMemory(allocation);
+      return;
+    }
+    allocator->freeDeviceOnlyMemory(allocation);
+  };
+
+  std::vector<std::vector<mg::DeviceHeapAllocation>> batches(nrOfThreads,
+                                                             std::vector<mg::DeviceHeapAllocation>(batchSize));
+  SpinBarrier barrier(nrOfThreads + 1);
+  std::vector<std::thread> threads;
+  for (uint32_t threadIndex = 0; threadIndex < nrOfThreads; threadIndex++) {
+    threads.emplace_back([&, threadIndex]() {
+      const auto requests = generateRequests(batchSize * 16, threadIndex + 1);
+      auto &ownBatch = batches[threadIndex];
+      auto &nextBatch = batches[(threadIndex + 1) % nrOfThreads];
+      barrier.wait();
+      for (uint32_t round = 0; round < nrOfRounds; round++) {
+        for (uint32_t i = 0; i < batchSize; i++) {
+          ownBatch[i] = allocate(requests[(round * batchSize + i) % requests.size()]);
+        }
+        barrier.wait();
+        for (uint32_t i = 0; i < batchSize; i += 2) {
+          free(ownBatch[i]);
+          free(nextBatch[i + 1]);
+        }
+        barrier.wait();
+      }
+    });
+  }
+
+  // the main thread takes part in the barriers so it can time the rounds only
+  barrier.wait();
+  const auto start = mg::timer::now();
+  for (uint32_t round = 0; round < nrOfRounds; round++) {
+    barrier.wait();
+    barrier.wait();
+  }
+  const auto end = mg::timer::now();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  allocator->destroy();
+
+  const double nrOfOperations = 2.0 * double(nrOfRounds) * double(batchSize) * double(nrOfThreads);
+  const double seconds = double(mg::timer::durationInUs(start, end)) / 1000000.0;
+  return nrOfOperations / seconds;
+}
+
+int main(int argc, char **argv) {
+  stub::initDevice(1);
+
+  uint32_t maxNrOfThreads = std::max(1u, std::thread::hardware_concurrency());
+  if (argc > 1)
+    maxNrOfThreads = uint32_t(std::max(1, atoi(argv[1])));
+  maxNrOfThreads = std::min<uint32_t>(maxNrOfThreads, mg::DeviceMemoryAllocator::MAX_NR_OF_THREADS);
+
+  printf("%u rounds of %u allocations and frees per thread\n", nrOfRounds, batchSize);
+  printf("%-8s %20s %20s %10s\n", "threads", "global mutex Mops/s", "thread caches Mops/s", "speedup");
+  for (uint32_t nrOfThreads = 1; nrOfThreads <= maxNrOfThreads; nrOfThreads *= 2) {
+    const auto globalMutex = runBenchmark(Mode::GlobalMutex, nrOfThreads);
+    const auto threadCaches = runBenchmark(Mode::ThreadCaches, nrOfThreads);
+    printf("%-8u %20.2f %20.2f %9.2fx\n", nrOfThreads, globalMutex / 1000000.0, threadCaches / 1000000.0,
+           threadCaches / globalMutex);
+  }
+  return 0;
+}
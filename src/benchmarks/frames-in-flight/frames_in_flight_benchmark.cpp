@@ -0,0 +1,177 @@
+#include "common/stub_device.h"
+#include "mg/mgUtils.h"
+#include "vulkan/linearHeapAllocator.h"
+#include "vulkan/vkContext.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// latency and throughput of the frame loop for different numbers of frames in flight. every frame waits for the fence
+// of the command buffer like beginRendering, allocates the uniforms and vertices of its draws from the linear heap,
+// swaps the linear heap buffers and submits like endRendering. The vulkan calls are stubbed out, the stub queue runs
+// the submits in order and signals a fence when the gpu time of its submit has passed, present is not throttled.
+// cpu and gpu frame times are generated from seeded workloads, the cpu time left after recording is slept.
+// usage: frames-in-flight-benchmark [nr of frames]
+
+static constexpr uint32_t nrOfDrawsPerFrame = 1000;
+
+struct Workload {
+  const char *name;
+  float cpuTimeInMs;
+  float gpuTimeInMs;
+  float jitter;              // relative variation of every frame
+  float spikeProbability;    // probability that a frame is a spike on the gpu
+  float gpuSpikeTimeInMs;
+};
+
+struct FrameTimes {
+  std::vector<float> cpu;
+  std::vector<float> gpu;
+};
+
+struct Report {
+  float fps;
+  float averageLatencyInMs;
+  float p99LatencyInMs;
+  float fenceWaitInMsPerFrame;
+};
+
+static FrameTimes generateFrameTimes(const Workload &workload, uint32_t nrOfFrames, uint32_t seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  FrameTimes frameTimes = {};
+  frameTimes.cpu.resize(nrOfFrames);
+  frameTimes.gpu.resize(nrOfFrames);
+  for (uint32_t i = 0; i < nrOfFrames; i++) {
+    frameTimes.cpu[i] = workload.cpuTimeInMs * (1.0f + workload.jitter * (2.0f * unit(generator) - 1.0f));
+    frameTimes.gpu[i] = workload.gpuTimeInMs * (1.0f + workload.jitter * (2.0f * unit(generator) - 1.0f));
+    if (unit(generator) < workload.spikeProbability)
+      frameTimes.gpu[i] = workload.gpuSpikeTimeInMs;
+  }
+  return frameTimes;
+}
+
+static void waitForSubmittedFrames() {
+  auto &commandBuffers = mg::vkContext.commandBuffers;
+  for (uint32_t i = 0; i < mg::MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
+    if (commandBuffers.submitted[i])
+      vkWaitForFences(mg::vkContext.device, 1, &commandBuffers.fences[i], VK_TRUE, UINT64_MAX);
+    commandBuffers.submitted[i] = false;
+  }
+}
+
+// like setNrOfFramesInFlight, without a swap chain to recreate
+static void setNrOfFramesInFlight(mg::LinearHeapAllocator *allocator, uint32_t nrOfFramesInFlight) {
+  waitForSubmittedFrames();
+  allocator->setNrOfBuffers(nrOfFramesInFlight);
+  mg::vkContext.commandBuffers.nrOfBuffers = nrOfFramesInFlight;
+  mg::vkContext.commandBuffers.currentIndex = 0;
+}
+
+static void recordFrame(mg::LinearHeapAllocator *allocator, uint32_t frame) {
+  VkBuffer buffer;
+  VkDeviceSize vertexOffset;
+  uint32_t uniformOffset;
+  VkDescriptorSet descriptorSet;
+  for (uint32_t i = 0; i < nrOfDrawsPerFrame; i++) {
+    auto *uniform = (uint32_t *)allocator->allocateUniform(256, &buffer, &uniformOffset, &descriptorSet);
+    auto *vertices = (uint32_t *)allocator->allocateBuffer(1024, &buffer, &vertexOffset);
+    *uniform = *vertices = frame;
+  }
+}
+
+static Report runFrameLoop(mg::LinearHeapAllocator *allocator, const FrameTimes &frameTimes,
+                           uint32_t nrOfFramesInFlight) {
+  setNrOfFramesInFlight(allocator, nrOfFramesInFlight);
+  auto &commandBuffers = mg::vkContext.commandBuffers;
+  const auto nrOfFrames = uint32_t(frameTimes.cpu.size());
+  std::vector<float> latencies(nrOfFrames);
+
+  uint64_t totalFenceWaitTimeInUs = 0;
+  const auto start = mg::timer::now();
+  for (uint32_t i = 0; i < nrOfFrames; i++) {
+    const auto index = commandBuffers.currentIndex;
+    const auto fenceWaitStart = mg::timer::now();
+    if (commandBuffers.submitted[index])
+      vkWaitForFences(mg::vkContext.device, 1, &commandBuffers.fences[index], VK_TRUE, UINT64_MAX);
+    const auto frameStart = mg::timer::now();
+    totalFenceWaitTimeInUs += mg::timer::durationInUs(fenceWaitStart, frameStart);
+    vkResetFences(mg::vkContext.device, 1, &commandBuffers.fences[index]);
+
+    recordFrame(allocator, i);
+    std::this_thread::sleep_until(frameStart + std::chrono::microseconds(uint64_t(frameTimes.cpu[i] * 1000.0f)));
+    allocator->swapLinearHeapBuffers();
+
+    stub::setGpuTimeOfSubmits(uint64_t(frameTimes.gpu[i] * 1000.0f));
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffers.buffers[index];
+    vkQueueSubmit(mg::vkContext.queue, 1, &submitInfo, commandBuffers.fences[index]);
+    commandBuffers.submitted[index] = true;
+    commandBuffers.currentIndex = (index + 1) % commandBuffers.nrOfBuffers;
+    // input is read when the cpu starts the frame and is visible when the gpu is done with it
+    latencies[i] = float(mg::timer::durationInUs(frameStart, stub::getGpuEndTime())) / 1000.0f;
+  }
+  waitForSubmittedFrames();
+  const auto end = stub::getGpuEndTime();
+
+  Report report = {};
+  report.fps = float(1000000.0 * nrOfFrames / double(mg::timer::durationInUs(start, end)));
+  double totalLatency = 0.0;
+  for (const auto latency : latencies)
+    totalLatency += latency;
+  report.averageLatencyInMs = float(totalLatency / nrOfFrames);
+  std::sort(latencies.begin(), latencies.end());
+  report.p99LatencyInMs = latencies[std::min(nrOfFrames - 1, nrOfFrames * 99 / 100)];
+  report.fenceWaitInMsPerFrame = float(double(totalFenceWaitTimeInUs) / 1000.0 / nrOfFrames);
+  return report;
+}
+
+int main(int argc, char **argv) {
+  uint32_t nrOfFrames = 200;
+  if (argc > 1)
+    nrOfFrames = uint32_t(std::max(1, atoi(argv[1])));
+
+  stub::initDevice(1);
+  auto &commandBuffers = mg::vkContext.commandBuffers;
+  for (uint32_t i = 0; i < mg::MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
+    VkFenceCreateInfo fenceCreateInfo = {};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    vkCreateFence(mg::vkContext.device, &fenceCreateInfo, nullptr, &commandBuffers.fences[i]);
+  }
+  auto allocator = std::make_unique<mg::LinearHeapAllocator>();
+  allocator->create();
+
+  const Workload workloads[] = {
+      {"gpu bound", 4.0f, 6.0f, 0.1f, 0.0f, 0.0f},
+      {"balanced", 5.0f, 5.0f, 0.3f, 0.0f, 0.0f},
+      {"gpu spikes", 5.0f, 4.0f, 0.1f, 0.05f, 16.0f},
+      {"heavy gpu spikes", 6.0f, 3.0f, 0.1f, 0.1f, 25.0f},
+  };
+
+  printf("%u frames per workload, %u draws per frame\n", nrOfFrames, nrOfDrawsPerFrame);
+  printf("%-18s %8s %10s %16s %16s %20s\n", "workload", "frames", "fps", "avg latency ms", "p99 latency ms",
+         "fence wait ms/frame");
+  for (const auto &workload : workloads) {
+    const auto frameTimes = generateFrameTimes(workload, nrOfFrames, 1);
+    for (uint32_t nrOfFramesInFlight = mg::MIN_NR_OF_FRAMES_IN_FLIGHT;
+         nrOfFramesInFlight <= mg::MAX_NR_OF_FRAMES_IN_FLIGHT; nrOfFramesInFlight++) {
+      const auto report = runFrameLoop(allocator.get(), frameTimes, nrOfFramesInFlight);
+      printf("%-18s %8u %10.1f %16.2f %16.2f %20.3f\n", workload.name, nrOfFramesInFlight, report.fps,
+             report.averageLatencyInMs, report.p99LatencyInMs, report.fenceWaitInMsPerFrame);
+    }
+  }
+
+  allocator->destroy();
+  for (uint32_t i = 0; i < mg::MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
+    vkDestroyFence(mg::vkContext.device, commandBuffers.fences[i], nullptr);
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "mg/jobs.h"
+#include "mg/mgUtils.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// scaling of the job system as the number of threads grows. Face normals of a triangle grid are computed with
+// parallelFor, which is the work the obj loader does, and empty jobs are spawned to measure the overhead of a job.
+// usage: jobs-benchmark [max nr of threads]
+
+static constexpr uint32_t gridSize = 1024;
+static constexpr uint32_t nrOfRuns = 20;
+static constexpr uint32_t normalsGrainSize = 1024;
+static constexpr uint32_t nrOfEmptyJobs = 1u << 20;
+
+static std::vector<glm::vec3> createGrid() {
+  std::vector<glm::vec3> triangles;
+  triangles.reserve(gridSize * gridSize * 6);
+  for (uint32_t y = 0; y < gridSize; y++) {
+    for (uint32_t x = 0; x < gridSize; x++) {
+      const auto height = [](uint32_t x, uint32_t y) { return glm::sin(float(x) * 0.1f) * glm::cos(float(y) * 0.1f); };
+      const glm::vec3 p00 = {float(x), height(x, y), float(y)};
+      const glm::vec3 p10 = {float(x + 1), height(x + 1, y), float(y)};
+      const glm::vec3 p01 = {float(x), height(x, y + 1), float(y + 1)};
+      const glm::vec3 p11 = {float(x + 1), height(x + 1, y + 1), float(y + 1)};
+      triangles.insert(triangles.end(), {p00, p10, p11, p00, p11, p01});
+    }
+  }
+  return triangles;
+}
+
+static double runNormals(const std::vector<glm::vec3> &triangles, std::vector<glm::vec3> *normals) {
+  const auto nrOfTriangles = uint32_t(triangles.size() / 3);
+  const auto start = mg::timer::now();
+  for (uint32_t run = 0; run < nrOfRuns; run++) {
+    mg::jobs::parallelFor(0, nrOfTriangles, normalsGrainSize, [&](uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < end; i++) {
+        const auto &v0 = triangles[i * 3 + 0];
+        const auto &v1 = triangles[i * 3 + 1];
+        const auto &v2 = triangles[i * 3 + 2];
+        (*normals)[i] = glm::normalize(glm::cross(v2 - v0, v1 - v0));
+      }
+    });
+  }
+  const auto end = mg::timer::now();
+  return double(mg::timer::durationInUs(start, end)) / 1000.0 / double(nrOfRuns);
+}
+
+static double runEmptyJobs() {
+  const auto start = mg::timer::now();
+  mg::jobs::parallelFor(0, nrOfEmptyJobs, 1, [](uint32_t, uint32_t) {});
+  const auto end = mg::timer::now();
+  // parallelFor spawns two jobs per split, so about twice as many jobs as leaves
+  const double nrOfJobs = 2.0 * double(nrOfEmptyJobs);
+  return nrOfJobs / (double(mg::timer::durationInUs(start, end)) / 1000000.0);
+}
+
+int main(int argc, char **argv) {
+  uint32_t nrOfThreads = std::max(1u, std::thread::hardware_concurrency());
+  if (argc > 1)
+    nrOfThreads = uint32_t(std::max(1, atoi(argv[1])));
+
+  const auto triangles = createGrid();
+  std::vector<glm::vec3> normals(triangles.size() / 3);
+  std::vector<glm::vec3> expectedNormals(normals.size());
+
+  printf("face normals of %u triangles, grain size %u, and %u empty leaf jobs\n", uint32_t(normals.size()),
+         normalsGrainSize, nrOfEmptyJobs);
+  printf("%-8s %14s %10s %16s\n", "threads", "normals ms", "speedup", "empty Mjobs/s");
+  double singleThreadMs = 0.0;
+  bool normalsDiffer = false;
+  for (uint32_t i = 1; i <= nrOfThreads; i *= 2) {
+    mg::jobs::create(i - 1);
+    const auto normalsMs = runNormals(triangles, i == 1 ? &expectedNormals : &normals);
+    const auto emptyJobs = runEmptyJobs();
+    mg::jobs::destroy();
+
+    if (i == 1)
+      singleThreadMs = normalsMs;
+    else if (normals != expectedNormals) {
+      printf("normals differ from the single thread run\n");
+      normalsDiffer = true;
+    }
+    printf("%-8u %14.2f %9.2fx %16.2f\n", i, normalsMs, singleThreadMs / normalsMs, emptyJobs / 1000000.0);
+  }
+  return normalsDiffer ? 1 : 0;
+}
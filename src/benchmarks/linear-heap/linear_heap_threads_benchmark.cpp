@@ -0,0 +1,122 @@
+#include "common/stub_device.h"
+#include "mg/mgUtils.h"
+#include "vulkan/linearHeapAllocator.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// throughput of the per frame linear heap allocations as the number of recording threads grows, the vulkan calls are
+// stubbed out. every frame each thread records a number of draws with one uniform and one vertex allocation each,
+// either through the shared allocator behind a global mutex or through its own LinearHeapArena.
+// usage: linear-heap-threads-benchmark [max nr of threads]
+
+static constexpr uint32_t nrOfFrames = 500;
+static constexpr uint32_t nrOfDrawsPerFrame = 2000;
+static constexpr uint32_t maxNrOfThreads = 16;
+
+class SpinBarrier {
+public:
+  explicit SpinBarrier(uint32_t nrOfThreads) : _nrOfThreads(nrOfThreads) {}
+
+  void wait() {
+    const auto generation = _generation.load();
+    if (++_nrOfWaiting == _nrOfThreads) {
+      _nrOfWaiting = 0;
+      _generation++;
+      return;
+    }
+    while (_generation.load() == generation) {
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  const uint32_t _nrOfThreads;
+  std::atomic<uint32_t> _nrOfWaiting = {0};
+  std::atomic<uint32_t> _generation = {0};
+};
+
+enum class Mode { GlobalMutex, Arenas };
+
+static double runBenchmark(Mode mode, uint32_t nrOfThreads) {
+  // large enough pages so that the pages per buffer view do not run out with many threads
+  mg::CreateLinearHeapAllocatorInfo createInfo = {};
+  createInfo.uniformPageSizeInBytes = 1u << 24;
+  createInfo.vertexPageSizeInBytes = 1u << 26;
+
+  auto allocator = std::make_unique<mg::LinearHeapAllocator>();
+  allocator->create(createInfo);
+
+  std::mutex mutex;
+  SpinBarrier barrier(nrOfThreads + 1);
+  std::vector<std::thread> threads;
+  for (uint32_t threadIndex = 0; threadIndex < nrOfThreads; threadIndex++) {
+    threads.emplace_back([&]() {
+      mg::LinearHeapArena arena;
+      VkBuffer buffer;
+      VkDeviceSize vertexOffset;
+      uint32_t uniformOffset;
+      VkDescriptorSet descriptorSet;
+      barrier.wait();
+      for (uint32_t frame = 0; frame < nrOfFrames; frame++) {
+        for (uint32_t i = 0; i < nrOfDrawsPerFrame; i++) {
+          if (mode == Mode::GlobalMutex) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto *uniform = (uint32_t *)allocator->allocateUniform(256, &buffer, &uniformOffset, &descriptorSet);
+            auto *vertices = (uint32_t *)allocator->allocateBuffer(1024, &buffer, &vertexOffset);
+            *uniform = *vertices = i;
+          } else {
+            auto *uniform =
+                (uint32_t *)allocator->allocateUniform(&arena, 256, &buffer, &uniformOffset, &descriptorSet);
+            auto *vertices = (uint32_t *)allocator->allocateBuffer(&arena, 1024, &buffer, &vertexOffset);
+            *uniform = *vertices = i;
+          }
+        }
+        barrier.wait();
+        barrier.wait();
+      }
+    });
+  }
+
+  // the main thread swaps the buffers between the frames, like endRendering does
+  barrier.wait();
+  const auto start = mg::timer::now();
+  for (uint32_t frame = 0; frame < nrOfFrames; frame++) {
+    barrier.wait();
+    allocator->swapLinearHeapBuffers();
+    barrier.wait();
+  }
+  const auto end = mg::timer::now();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  allocator->destroy();
+
+  const double nrOfAllocations = 2.0 * double(nrOfFrames) * double(nrOfDrawsPerFrame) * double(nrOfThreads);
+  const double seconds = double(mg::timer::durationInUs(start, end)) / 1000000.0;
+  return nrOfAllocations / seconds;
+}
+
+int main(int argc, char **argv) {
+  stub::initDevice(1);
+
+  uint32_t nrOfThreads = std::max(1u, std::thread::hardware_concurrency());
+  if (argc > 1)
+    nrOfThreads = uint32_t(std::max(1, atoi(argv[1])));
+  nrOfThreads = std::min(nrOfThreads, maxNrOfThreads);
+
+  printf("%u frames of %u draws per thread, one uniform and one vertex allocation per draw\n", nrOfFrames,
+         nrOfDrawsPerFrame);
+  printf("%-8s %20s %20s %10s\n", "threads", "global mutex Mops/s", "arenas Mops/s", "speedup");
+  for (uint32_t i = 1; i <= nrOfThreads; i *= 2) {
+    const auto globalMutex = runBenchmark(Mode::GlobalMutex, i);
+    const auto arenas = runBenchmark(Mode::Arenas, i);
+    printf("%-8u %20.2f %20.2f %9.2fx\n", i, globalMutex / 1000000.0, arenas / 1000000.0, arenas / globalMutex);
+  }
+  return 0;
+}
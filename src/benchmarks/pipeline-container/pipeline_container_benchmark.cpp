@@ -0,0 +1,150 @@
+#include "common/stub_device.h"
+#include "mg/jobs.h"
+#include "mg/mgUtils.h"
+#include "vulkan/pipelineContainer.h"
+#include "vulkan/shaders.h"
+#include "vulkan/vkUtils.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// cpu cost of getting the pipeline for a draw call, the vulkan calls are stubbed out. every draw either fills a
+// pipeline description and calls createPipeline, which copies and hashes the description, as the draw helpers used
+// to do, or gets the pipeline through a handle registered once.
+// usage: pipeline-container-benchmark [nr of draws per frame]
+
+namespace mg {
+void createShaders() {}
+void deleteShaders() {}
+Shader getShader(const std::string &name) {
+  Shader shader = {};
+  shader.name = name;
+  shader.count = 2;
+  shader.stageCreateInfo[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shader.stageCreateInfo[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shader.stageCreateInfo[0].pName = "main";
+  shader.stageCreateInfo[1] = shader.stageCreateInfo[0];
+  shader.stageCreateInfo[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  return shader;
+}
+bool hasShader(const std::string &) { return true; }
+Shader loadShader(const std::string &name) { return getShader(name); }
+Shader replaceShader(const Shader &) { return {}; }
+void destroyShader(const Shader &) {}
+std::vector<std::string> getChangedShaders() { return {}; }
+void waitForDeviceIdle() {}
+namespace nv {
+PFN_vkCreateRayTracingPipelinesNV vkCreateRayTracingPipelinesNV;
+} // namespace nv
+namespace ext {
+PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT;
+PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT;
+PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT;
+PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT;
+PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT;
+PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT;
+} // namespace ext
+} // namespace mg
+
+static constexpr uint32_t nrOfFrames = 10;
+static constexpr uint32_t nrOfMaterials = 8;
+
+static mg::shaders::VertexInputState vertexInputState[] = {
+    {VK_FORMAT_R32G32B32_SFLOAT, 0, 0, 0, 12},
+    {VK_FORMAT_R32G32B32_SFLOAT, 1, 12, 0, 12},
+    {VK_FORMAT_R32G32_SFLOAT, 2, 24, 0, 8},
+};
+
+static const VkRenderPass renderPass = (VkRenderPass)uintptr_t(0x1);
+static const VkPipelineLayout pipelineLayout = (VkPipelineLayout)uintptr_t(0x2);
+
+// the same description the draw helpers fill in before every draw
+static void fillPipelineDesc(uint32_t material, mg::PipelineStateDesc *pipelineStateDesc,
+                             mg::CreatePipelineInfo *createPipelineInfo) {
+  pipelineStateDesc->rasterization.vkRenderPass = renderPass;
+  pipelineStateDesc->rasterization.vkPipelineLayout = pipelineLayout;
+  pipelineStateDesc->rasterization.graphics.subpass = 0;
+  pipelineStateDesc->rasterization.rasterization.cullMode = material % 2 ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+  pipelineStateDesc->rasterization.depth.TestEnable = material % 4 < 2 ? VK_TRUE : VK_FALSE;
+
+  createPipelineInfo->shaderName = "material" + std::to_string(material);
+  createPipelineInfo->vertexInputState = vertexInputState;
+  createPipelineInfo->vertexInputStateCount = mg::countof(vertexInputState);
+}
+
+static uint64_t drawWithCreatePipeline(mg::PipelineContainer *pipelineContainer, uint32_t nrOfDraws) {
+  uint64_t checksum = 0;
+  for (uint32_t i = 0; i < nrOfDraws; i++) {
+    mg::PipelineStateDesc pipelineStateDesc = {};
+    mg::CreatePipelineInfo createPipelineInfo = {};
+    fillPipelineDesc(i % nrOfMaterials, &pipelineStateDesc, &createPipelineInfo);
+    const auto pipeline = pipelineContainer->createPipeline(pipelineStateDesc, createPipelineInfo);
+    checksum += uint64_t(pipeline.pipeline);
+  }
+  return checksum;
+}
+
+static uint64_t drawWithHandles(mg::PipelineContainer *pipelineContainer, mg::PipelineHandle *handles,
+                                uint32_t nrOfDraws) {
+  uint64_t checksum = 0;
+  for (uint32_t i = 0; i < nrOfDraws; i++) {
+    auto &handle = handles[i % nrOfMaterials];
+    if (!pipelineContainer->isValid(handle, renderPass, 0)) {
+      mg::PipelineStateDesc pipelineStateDesc = {};
+      mg::CreatePipelineInfo createPipelineInfo = {};
+      fillPipelineDesc(i % nrOfMaterials, &pipelineStateDesc, &createPipelineInfo);
+      handle = pipelineContainer->registerPipeline(pipelineStateDesc, createPipelineInfo);
+    }
+    const auto pipeline = pipelineContainer->getPipeline(handle);
+    checksum += uint64_t(pipeline.pipeline);
+  }
+  return checksum;
+}
+
+int main(int argc, char **argv) {
+  uint32_t nrOfDraws = 100000;
+  if (argc > 1)
+    nrOfDraws = uint32_t(std::max(1, atoi(argv[1])));
+
+  stub::initDevice(1);
+  // pipelines recorded in the manifest of the last run are pre-warmed by jobs
+  mg::jobs::create();
+  mg::PipelineContainer pipelineContainer;
+  pipelineContainer.createPipelineContainer();
+
+  // creates the pipelines, both paths share them
+  mg::PipelineHandle handles[nrOfMaterials] = {};
+  const auto expectedChecksum = drawWithHandles(&pipelineContainer, handles, nrOfDraws);
+  if (drawWithCreatePipeline(&pipelineContainer, nrOfDraws) != expectedChecksum) {
+    printf("the two paths returned different pipelines\n");
+    return 1;
+  }
+
+  uint64_t createPipelineTimeInUs = 0;
+  uint64_t handleTimeInUs = 0;
+  for (uint32_t frame = 0; frame < nrOfFrames; frame++) {
+    auto start = mg::timer::now();
+    if (drawWithCreatePipeline(&pipelineContainer, nrOfDraws) != expectedChecksum)
+      return 1;
+    createPipelineTimeInUs += mg::timer::durationInUs(start, mg::timer::now());
+
+    start = mg::timer::now();
+    if (drawWithHandles(&pipelineContainer, handles, nrOfDraws) != expectedChecksum)
+      return 1;
+    handleTimeInUs += mg::timer::durationInUs(start, mg::timer::now());
+  }
+
+  const auto printResult = [&](const char *name, uint64_t timeInUs) {
+    printf("%-16s %14.3f %14.1f %10.1fx\n", name, timeInUs / 1000.0 / nrOfFrames,
+           timeInUs * 1000.0 / (double(nrOfFrames) * nrOfDraws), double(createPipelineTimeInUs) / timeInUs);
+  };
+  printf("%u draws per frame, %u pipelines, %u frames\n", nrOfDraws, nrOfMaterials, nrOfFrames);
+  printf("%-16s %14s %14s %11s\n", "path", "ms per frame", "ns per draw", "speedup");
+  printResult("createPipeline", createPipelineTimeInUs);
+  printResult("handle", handleTimeInUs);
+
+  pipelineContainer.destroyPipelineContainer();
+  mg::jobs::destroy();
+  return 0;
+}
@@ -0,0 +1,372 @@
+#include "assetStreamer.h"
+#include "mg/jobs.h"
+#include "mg/logger.h"
+#include "mg/mgAssert.h"
+#include "mg/mgSystem.h"
+#include <algorithm>
+#include <lodepng.h>
+
+namespace mg {
+
+static bool isBefore(StreamingPriority priorityA, uint64_t requestIndexA, StreamingPriority priorityB,
+                     uint64_t requestIndexB) {
+  if (priorityA != priorityB)
+    return priorityA == StreamingPriority::Near;
+  return requestIndexA < requestIndexB;
+}
+
+static std::vector<unsigned char> decodePng(const std::string &filename, uint32_t *width, uint32_t *height) {
+  std::vector<unsigned char> data;
+  const auto error = lodepng::decode(data, *width, *height, filename);
+  mgAssertDesc(error == 0, "decoder error " << error << ": " << lodepng_error_text(error));
+  return data;
+}
+
+void AssetStreamer::create() {
+  _quit = false;
+  _thread = std::thread(&AssetStreamer::streamingThread, this);
+}
+
+void AssetStreamer::destroy() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _quit = true;
+    _requests.clear();
+  }
+  _condition.notify_one();
+  _thread.join();
+
+  _parsedFiles.clear();
+  _streams.clear();
+  _generations.clear();
+  _freeIndices.clear();
+  _creatingStreams.clear();
+}
+
+void AssetStreamer::streamingThread() {
+  // the loaders use the job system, the faces of an obj file are processed in parallel
+  jobs::joinThread();
+  while (true) {
+    _Request request;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _condition.wait(lock, [this]() { return _quit || !_requests.empty(); });
+      if (_quit)
+        break;
+      const auto next = std::min_element(_requests.begin(), _requests.end(), [](const auto &a, const auto &b) {
+        return isBefore(a.priority, a.requestIndex, b.priority, b.requestIndex);
+      });
+      request = std::move(*next);
+      _requests.erase(next);
+    }
+
+    auto parsedFile = std::make_unique<_ParsedFile>();
+    parsedFile->streamId = request.streamId;
+    switch (request.type) {
+    case _StreamType::Obj:
+      parsedFile->objFile = parseObjFile(request.filename);
+      break;
+    case _StreamType::Gltf:
+      parsedFile->gltfMeshes = parseGltf(request.id, request.path, request.name);
+      for (const auto &imageData : parsedFile->gltfMeshes.images) {
+        _Image image = {};
+        image.name = imageData.name;
+        image.data = decodePng(imageData.path + imageData.name, &image.width, &image.height);
+        parsedFile->images.push_back(std::move(image));
+      }
+      break;
+    case _StreamType::Texture: {
+      _Image image = {};
+      image.data = decodePng(request.filename, &image.width, &image.height);
+      parsedFile->images.push_back(std::move(image));
+      break;
+    }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _parsedFiles.push_back(std::move(parsedFile));
+  }
+  jobs::leaveThread();
+}
+
+StreamId AssetStreamer::createStream(_StreamType type, StreamingPriority priority) {
+  uint32_t currentIndex = 0;
+  if (_freeIndices.size()) {
+    currentIndex = _freeIndices.back();
+    _freeIndices.pop_back();
+  } else {
+    currentIndex = uint32_t(_streams.size());
+    _streams.emplace_back();
+    _generations.push_back(0);
+  }
+
+  auto &stream = _streams[currentIndex];
+  stream = {};
+  stream.type = type;
+  stream.state = StreamingState::Loading;
+  stream.priority = priority;
+  stream.requestIndex = _nrOfRequests++;
+
+  StreamId streamId = {};
+  streamId.index = currentIndex;
+  streamId.generation = _generations[currentIndex];
+  return streamId;
+}
+
+void AssetStreamer::request(_Request request) {
+  const auto &stream = getStream(request.streamId);
+  request.type = stream.type;
+  request.priority = stream.priority;
+  request.requestIndex = stream.requestIndex;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _requests.push_back(std::move(request));
+  }
+  _condition.notify_one();
+}
+
+AssetStreamer::_Stream &AssetStreamer::getStream(StreamId streamId) {
+  mgAssert(streamId.index < _streams.size());
+  mgAssert(streamId.generation == _generations[streamId.index]);
+  return _streams[streamId.index];
+}
+
+const AssetStreamer::_Stream &AssetStreamer::getStream(StreamId streamId) const {
+  mgAssert(streamId.index < _streams.size());
+  mgAssert(streamId.generation == _generations[streamId.index]);
+  return _streams[streamId.index];
+}
+
+StreamId AssetStreamer::streamObj(const std::string &filename, StreamingPriority priority) {
+  const auto streamId = createStream(_StreamType::Obj, priority);
+  auto &stream = getStream(streamId);
+  ObjMesh placeholder = {};
+  placeholder.id = mgSystem.meshContainer.reserveMesh();
+  placeholder.materialId = 0;
+  stream.objMeshes.meshes.push_back(placeholder);
+  stream.objMeshes.materials.push_back({glm::vec4(1.0f)});
+
+  _Request request = {};
+  request.streamId = streamId;
+  request.filename = filename;
+  this->request(std::move(request));
+  return streamId;
+}
+
+StreamId AssetStreamer::streamGltf(const std::string &id, const std::string &path, const std::string &name,
+                                   StreamingPriority priority) {
+  const auto streamId = createStream(_StreamType::Gltf, priority);
+  getStream(streamId).gltf.meshId = mgSystem.meshContainer.reserveMesh();
+
+  _Request request = {};
+  request.streamId = streamId;
+  request.id = id;
+  request.path = path;
+  request.name = name;
+  this->request(std::move(request));
+  return streamId;
+}
+
+StreamId AssetStreamer::streamTexture(const std::string &filename, StreamingPriority priority) {
+  const auto streamId = createStream(_StreamType::Texture, priority);
+  getStream(streamId).textureId = mgSystem.textureContainer.reserveTexture(TEXTURE_TYPE::TEXTURE_2D);
+
+  _Request request = {};
+  request.streamId = streamId;
+  request.filename = filename;
+  this->request(std::move(request));
+  return streamId;
+}
+
+void AssetStreamer::removeIds(_Stream *stream) {
+  switch (stream->type) {
+  case _StreamType::Obj:
+    // the first mesh is reserved, the other meshes are created by update while the parsed file is kept
+    for (uint32_t i = 0; i < uint32_t(stream->objMeshes.meshes.size()); i++) {
+      if (i == 0 || stream->parsedFile->objFile.vertices[i].size() > 0)
+        mgSystem.meshContainer.removeMesh(stream->objMeshes.meshes[i].id);
+    }
+    stream->objMeshes = {};
+    break;
+  case _StreamType::Gltf:
+    mgSystem.meshContainer.removeMesh(stream->gltf.meshId);
+    stream->gltf = {};
+    break;
+  case _StreamType::Texture:
+    mgSystem.textureContainer.removeTexture(stream->textureId);
+    stream->textureId = {};
+    break;
+  }
+}
+
+void AssetStreamer::cancel(StreamId streamId) {
+  auto &stream = getStream(streamId);
+  if (stream.state != StreamingState::Loading)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _requests.erase(std::remove_if(_requests.begin(), _requests.end(),
+                                   [streamId](const auto &request) {
+                                     return request.streamId.index == streamId.index &&
+                                            request.streamId.generation == streamId.generation;
+                                   }),
+                    _requests.end());
+  }
+  // the created meshes and textures are retired until the frames in flight are done with them
+  removeIds(&stream);
+  stream.parsedFile = {};
+  stream.state = StreamingState::Cancelled;
+}
+
+void AssetStreamer::setPriority(StreamId streamId, StreamingPriority priority) {
+  auto &stream = getStream(streamId);
+  stream.priority = priority;
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto &request : _requests) {
+    if (request.streamId.index == streamId.index && request.streamId.generation == streamId.generation)
+      request.priority = priority;
+  }
+}
+
+StreamingState AssetStreamer::getState(StreamId streamId) const { return getStream(streamId).state; }
+
+void AssetStreamer::release(StreamId streamId) {
+  auto &stream = getStream(streamId);
+  mgAssertDesc(stream.state != StreamingState::Loading, "a stream that is loading must be cancelled first");
+  stream = {};
+  _generations[streamId.index]++;
+  _freeIndices.push_back(streamId.index);
+}
+
+const ObjMeshes &AssetStreamer::getObjMeshes(StreamId streamId) const {
+  const auto &stream = getStream(streamId);
+  mgAssert(stream.type == _StreamType::Obj);
+  return stream.objMeshes;
+}
+
+const StreamedGltf &AssetStreamer::getGltf(StreamId streamId) const {
+  const auto &stream = getStream(streamId);
+  mgAssert(stream.type == _StreamType::Gltf);
+  return stream.gltf;
+}
+
+TextureId AssetStreamer::getTexture(StreamId streamId) const {
+  const auto &stream = getStream(streamId);
+  mgAssert(stream.type == _StreamType::Texture);
+  return stream.textureId;
+}
+
+static CreateTextureInfo getCreateTextureInfo(const std::string &id, const std::vector<unsigned char> &data,
+                                              uint32_t width, uint32_t height) {
+  CreateTextureInfo createTextureInfo = {};
+  createTextureInfo.id = id;
+  createTextureInfo.type = TEXTURE_TYPE::TEXTURE_2D;
+  createTextureInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  createTextureInfo.size = {width, height, 1};
+  createTextureInfo.sizeInBytes = uint32_t(mg::sizeofContainerInBytes(data));
+  createTextureInfo.data = (void *)data.data();
+  return createTextureInfo;
+}
+
+VkDeviceSize AssetStreamer::createFromParsedFile(_Stream *stream, VkDeviceSize budgetInBytes) {
+  auto &parsedFile = *stream->parsedFile;
+  VkDeviceSize sizeInBytes = 0;
+  switch (stream->type) {
+  case _StreamType::Obj: {
+    // the meshes are created over several calls, at least one per call
+    const auto &objFile = parsedFile.objFile;
+    const auto nrOfMeshes = uint32_t(objFile.vertices.size());
+    if (stream->nrOfCreatedMeshes == 0)
+      stream->objMeshes.materials = objFile.materials;
+    while (stream->nrOfCreatedMeshes < nrOfMeshes && (sizeInBytes < budgetInBytes || sizeInBytes == 0)) {
+      const auto index = stream->nrOfCreatedMeshes++;
+      if (index == 0)
+        stream->objMeshes.meshes[0] = createObjMesh(objFile, 0, &stream->objMeshes.meshes[0].id);
+      else
+        stream->objMeshes.meshes.push_back(createObjMesh(objFile, index));
+      sizeInBytes += mg::sizeofContainerInBytes(objFile.vertices[index]);
+    }
+    if (stream->nrOfCreatedMeshes == nrOfMeshes)
+      stream->state = StreamingState::Loaded;
+    break;
+  }
+  case _StreamType::Gltf: {
+    mgAssertDesc(parsedFile.gltfMeshes.meshes.size(), "gltf file without meshes");
+    const auto &mesh = parsedFile.gltfMeshes.meshes.front();
+    CreateMeshInfo createMeshInfo = {};
+    createMeshInfo.id = parsedFile.gltfMeshes.id;
+    createMeshInfo.vertices = (uint8_t *)mesh.vertices.data();
+    createMeshInfo.verticesSizeInBytes = uint32_t(mg::sizeofContainerInBytes(mesh.vertices));
+    createMeshInfo.nrOfIndices = mesh.count;
+    mgSystem.meshContainer.createReservedMesh(stream->gltf.meshId, createMeshInfo);
+    sizeInBytes += createMeshInfo.verticesSizeInBytes;
+
+    for (const auto &image : parsedFile.images) {
+      const auto createTextureInfo = getCreateTextureInfo(image.name, image.data, image.width, image.height);
+      stream->gltf.nameToTextureId.emplace(image.name, mgSystem.textureContainer.createTexture(createTextureInfo));
+      sizeInBytes += createTextureInfo.sizeInBytes;
+    }
+    stream->state = StreamingState::Loaded;
+    break;
+  }
+  case _StreamType::Texture: {
+    const auto &image = parsedFile.images.front();
+    const auto createTextureInfo = getCreateTextureInfo("stream", image.data, image.width, image.height);
+    mgSystem.textureContainer.createReservedTexture(stream->textureId, createTextureInfo);
+    sizeInBytes += createTextureInfo.sizeInBytes;
+    stream->state = StreamingState::Loaded;
+    break;
+  }
+  }
+  if (stream->state == StreamingState::Loaded)
+    stream->parsedFile = {};
+  return sizeInBytes;
+}
+
+void AssetStreamer::update(VkDeviceSize budgetInBytes) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &parsedFile : _parsedFiles) {
+      const auto streamId = parsedFile->streamId;
+      // the stream was cancelled while the file was parsed
+      if (_generations[streamId.index] != streamId.generation ||
+          _streams[streamId.index].state != StreamingState::Loading)
+        continue;
+      _streams[streamId.index].parsedFile = std::move(parsedFile);
+      _creatingStreams.push_back(streamId);
+    }
+    _parsedFiles.clear();
+  }
+
+  // streams that were cancelled or released while they were created are skipped
+  const auto isCreating = [this](StreamId streamId) {
+    return _generations[streamId.index] == streamId.generation && _streams[streamId.index].parsedFile != nullptr;
+  };
+  _creatingStreams.erase(std::remove_if(_creatingStreams.begin(), _creatingStreams.end(),
+                                        [&isCreating](StreamId streamId) { return !isCreating(streamId); }),
+                         _creatingStreams.end());
+  std::sort(_creatingStreams.begin(), _creatingStreams.end(), [this](StreamId a, StreamId b) {
+    const auto &streamA = _streams[a.index];
+    const auto &streamB = _streams[b.index];
+    return isBefore(streamA.priority, streamA.requestIndex, streamB.priority, streamB.requestIndex);
+  });
+
+  VkDeviceSize sizeInBytes = 0;
+  uint32_t nrOfLoadedStreams = 0;
+  for (const auto streamId : _creatingStreams) {
+    if (sizeInBytes >= budgetInBytes)
+      break;
+    auto &stream = _streams[streamId.index];
+    sizeInBytes += createFromParsedFile(&stream, budgetInBytes - sizeInBytes);
+    if (stream.state == StreamingState::Loaded)
+      nrOfLoadedStreams++;
+  }
+  _creatingStreams.erase(std::remove_if(_creatingStreams.begin(), _creatingStreams.end(),
+                                        [&isCreating](StreamId streamId) { return !isCreating(streamId); }),
+                         _creatingStreams.end());
+
+  if (nrOfLoadedStreams > 0)
+    LOG("streamed " << nrOfLoadedStreams << " files, " << sizeInBytes << " bytes uploaded");
+}
+
+} // namespace mg
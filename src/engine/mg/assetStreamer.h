@@ -0,0 +1,132 @@
+#pragma once
+#include "mg/meshContainer.h"
+#include "mg/meshLoader.h"
+#include "mg/mgUtils.h"
+#include "mg/textureContainer.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mg {
+
+struct StreamId {
+  uint32_t index;
+  uint32_t generation;
+};
+
+// near streams are parsed and created before far streams, streams with the same priority in request order
+enum class StreamingPriority { Near, Far };
+enum class StreamingState { Loading, Loaded, Cancelled };
+
+struct StreamedGltf {
+  MeshId meshId;
+  // empty until the stream is loaded
+  std::unordered_map<std::string, TextureId> nameToTextureId;
+};
+
+// files are parsed on a streaming thread that has joined the job system, the meshes and textures are created by
+// update on the main thread. The ids returned for a stream are reserved when it is requested, they are placeholders
+// until the stream is loaded. A created mesh or texture can be used in the frame that is recorded after update, the
+// upload is submitted before it
+class AssetStreamer : mg::nonCopyable {
+public:
+  void create();
+  // waits for the file that is being parsed
+  void destroy();
+
+  // the first mesh of the obj file is reserved, the other meshes are added when they are created
+  StreamId streamObj(const std::string &filename, StreamingPriority priority);
+  // the mesh is reserved, the textures of the images are created with the mesh
+  StreamId streamGltf(const std::string &id, const std::string &path, const std::string &name,
+                      StreamingPriority priority);
+  // a png file as a 2D rgba texture, the texture is reserved
+  StreamId streamTexture(const std::string &filename, StreamingPriority priority);
+
+  // the reserved and created ids of the stream are removed, a file that is being parsed is discarded when it is done.
+  // A loaded stream is not changed
+  void cancel(StreamId streamId);
+  void setPriority(StreamId streamId, StreamingPriority priority);
+  StreamingState getState(StreamId streamId) const;
+  bool isLoaded(StreamId streamId) const { return getState(streamId) == StreamingState::Loaded; }
+  // forgets a loaded or cancelled stream, the meshes and textures of a loaded stream are kept
+  void release(StreamId streamId);
+
+  // before the obj file is loaded there is one placeholder mesh with a default material
+  const ObjMeshes &getObjMeshes(StreamId streamId) const;
+  const StreamedGltf &getGltf(StreamId streamId) const;
+  TextureId getTexture(StreamId streamId) const;
+
+  // polls the parsed files and creates their meshes and textures, with at most about budgetInBytes uploaded per
+  // call. Called once per frame by beginRendering
+  void update(VkDeviceSize budgetInBytes);
+
+private:
+  enum class _StreamType { Obj, Gltf, Texture };
+
+  struct _Request {
+    StreamId streamId;
+    _StreamType type;
+    StreamingPriority priority;
+    uint64_t requestIndex;
+    std::string filename;
+    // gltf
+    std::string id, path, name;
+  };
+
+  struct _Image {
+    std::string name;
+    std::vector<unsigned char> data;
+    uint32_t width, height;
+  };
+
+  // written by the streaming thread
+  struct _ParsedFile {
+    StreamId streamId;
+    ObjFile objFile;
+    GltfMeshes gltfMeshes;
+    std::vector<_Image> images;
+  };
+
+  struct _Stream {
+    _StreamType type;
+    StreamingState state;
+    StreamingPriority priority;
+    uint64_t requestIndex;
+    ObjMeshes objMeshes;
+    StreamedGltf gltf;
+    TextureId textureId;
+    // the parsed file, set by update
+    std::unique_ptr<_ParsedFile> parsedFile;
+    uint32_t nrOfCreatedMeshes;
+  };
+
+  StreamId createStream(_StreamType type, StreamingPriority priority);
+  void request(_Request request);
+  _Stream &getStream(StreamId streamId);
+  const _Stream &getStream(StreamId streamId) const;
+  void removeIds(_Stream *stream);
+  // returns the number of bytes uploaded
+  VkDeviceSize createFromParsedFile(_Stream *stream, VkDeviceSize budgetInBytes);
+  void streamingThread();
+
+  std::vector<_Stream> _streams;
+  std::vector<uint32_t> _generations;
+  std::vector<uint32_t> _freeIndices;
+  // streams with a parsed file, in creation order
+  std::vector<StreamId> _creatingStreams;
+  uint64_t _nrOfRequests = 0;
+
+  // shared with the streaming thread
+  std::thread _thread;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  bool _quit = false;
+  std::vector<_Request> _requests;
+  std::vector<std::unique_ptr<_ParsedFile>> _parsedFiles;
+};
+
+} // namespace mg
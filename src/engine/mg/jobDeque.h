@@ -0,0 +1,66 @@
+#pragma once
+#include "mg/jobs.h"
+#include "mg/mgAssert.h"
+#include <atomic>
+#include <cstdint>
+
+namespace mg {
+namespace jobs {
+
+// Chase-Lev work stealing deque with the memory orderings of "Correct and Efficient Work-Stealing for Weak Memory
+// Models", Lê et al. Only the owning thread pushes and pops at the bottom, any thread steals from the top. The
+// capacity is fixed, a thread never has more jobs in flight than it can allocate
+class _JobDeque {
+public:
+  void push(Job *job) {
+    const auto bottom = _bottom.load(std::memory_order_relaxed);
+    const auto top = _top.load(std::memory_order_acquire);
+    mgAssertDesc(bottom - top < int64_t(MaxNrOfJobsPerThread), "job deque is full");
+    _jobs[bottom & (MaxNrOfJobsPerThread - 1)].store(job, std::memory_order_relaxed);
+    // publishes the job to the thieves
+    _bottom.store(bottom + 1, std::memory_order_release);
+  }
+
+  Job *pop() {
+    const auto bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top = _top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+      // empty
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    Job *job = _jobs[bottom & (MaxNrOfJobsPerThread - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // the last job, a thief can take it at the same time
+      if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        job = nullptr;
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+  }
+
+  Job *steal() {
+    auto top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const auto bottom = _bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+      return nullptr;
+
+    Job *job = _jobs[top & (MaxNrOfJobsPerThread - 1)].load(std::memory_order_relaxed);
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      return nullptr;
+    return job;
+  }
+
+private:
+  // top and bottom are written by different threads
+  alignas(64) std::atomic<int64_t> _top = {0};
+  alignas(64) std::atomic<int64_t> _bottom = {0};
+  std::atomic<Job *> _jobs[MaxNrOfJobsPerThread] = {};
+};
+
+} // namespace jobs
+} // namespace mg
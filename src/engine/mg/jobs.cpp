@@ -0,0 +1,221 @@
+#include "jobs.h"
+#include "mg/jobDeque.h"
+#include "mg/logger.h"
+#include "mg/mgAssert.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mg {
+namespace jobs {
+
+struct _ThreadData {
+  _JobDeque deque;
+  std::unique_ptr<Job[]> jobs;
+  uint32_t nrOfAllocatedJobs = 0;
+  // random state for picking the deque to steal from
+  uint32_t random;
+  // only for the deques of joined threads
+  bool isJoined = false;
+};
+
+static struct {
+  std::vector<std::unique_ptr<_ThreadData>> threadData;
+  std::vector<std::thread> threads;
+  // the worker threads and the thread that called create, the deques of the joined threads come after
+  uint32_t nrOfThreads = 0;
+  std::atomic<bool> quit = {false};
+
+  // idle worker threads sleep until a job is pushed
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::atomic<uint32_t> nrOfQueuedJobs = {0};
+  std::atomic<uint32_t> nrOfSleepingThreads = {0};
+} _jobSystem;
+
+// index of the thread in the job system, the thread that called create is 0
+thread_local uint32_t _threadIndex = UINT32_MAX;
+
+static _ThreadData &getThreadData() {
+  mgAssertDesc(_threadIndex < _jobSystem.threadData.size(),
+               "jobs can only be used from the threads of the job system");
+  return *_jobSystem.threadData[_threadIndex];
+}
+
+static Job *getJob() {
+  auto &threadData = getThreadData();
+  Job *job = threadData.deque.pop();
+  if (job == nullptr) {
+    // the deques of the joined threads are stolen from as well
+    const auto nrOfDeques = uint32_t(_jobSystem.threadData.size());
+    // xorshift
+    threadData.random ^= threadData.random << 13;
+    threadData.random ^= threadData.random >> 17;
+    threadData.random ^= threadData.random << 5;
+    const auto start = threadData.random % nrOfDeques;
+    for (uint32_t i = 0; i < nrOfDeques && job == nullptr; i++) {
+      const auto index = (start + i) % nrOfDeques;
+      if (index != _threadIndex)
+        job = _jobSystem.threadData[index]->deque.steal();
+    }
+  }
+  if (job != nullptr)
+    _jobSystem.nrOfQueuedJobs.fetch_sub(1);
+  return job;
+}
+
+static void finish(Job *job) {
+  // the job can be reused as soon as it is finished, so the parent is read before
+  Job *parent = job->parent;
+  const auto nrOfUnfinishedJobs = job->nrOfUnfinishedJobs.fetch_sub(1, std::memory_order_acq_rel) - 1;
+  mgAssert(nrOfUnfinishedJobs >= 0);
+  if (nrOfUnfinishedJobs == 0 && parent != nullptr)
+    finish(parent);
+}
+
+static void execute(Job *job) {
+  job->function(job, job->data);
+  finish(job);
+}
+
+static void workerThread(uint32_t threadIndex) {
+  _threadIndex = threadIndex;
+  // spin for a while before sleeping, jobs are often pushed in bursts
+  constexpr uint32_t nrOfSpinsBeforeSleep = 64;
+  uint32_t nrOfSpins = 0;
+  while (!_jobSystem.quit.load()) {
+    if (Job *job = getJob()) {
+      execute(job);
+      nrOfSpins = 0;
+      continue;
+    }
+    if (++nrOfSpins < nrOfSpinsBeforeSleep) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_jobSystem.mutex);
+    _jobSystem.nrOfSleepingThreads++;
+    _jobSystem.condition.wait(
+        lock, []() { return _jobSystem.nrOfQueuedJobs.load() > 0 || _jobSystem.quit.load(); });
+    _jobSystem.nrOfSleepingThreads--;
+    nrOfSpins = 0;
+  }
+  _threadIndex = UINT32_MAX;
+}
+
+void create(uint32_t nrOfWorkerThreads) {
+  mgAssert(_jobSystem.threadData.empty());
+  if (nrOfWorkerThreads == UINT32_MAX)
+    nrOfWorkerThreads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+  nrOfWorkerThreads = std::min(nrOfWorkerThreads, uint32_t(MaxNrOfWorkerThreads));
+
+  _jobSystem.quit = false;
+  _jobSystem.nrOfThreads = nrOfWorkerThreads + 1;
+  for (uint32_t i = 0; i < _jobSystem.nrOfThreads + MaxNrOfJoinedThreads; i++) {
+    auto threadData = std::make_unique<_ThreadData>();
+    threadData->jobs = std::make_unique<Job[]>(MaxNrOfJobsPerThread);
+    threadData->random = 0x9E3779B9u * (i + 1);
+    _jobSystem.threadData.push_back(std::move(threadData));
+  }
+  _threadIndex = 0;
+  for (uint32_t i = 1; i <= nrOfWorkerThreads; i++)
+    _jobSystem.threads.emplace_back(workerThread, i);
+  LOG("job system worker threads: " << nrOfWorkerThreads);
+}
+
+void destroy() {
+  mgAssert(_threadIndex == 0);
+  {
+    std::lock_guard<std::mutex> lock(_jobSystem.mutex);
+    _jobSystem.quit = true;
+  }
+  _jobSystem.condition.notify_all();
+  for (auto &thread : _jobSystem.threads)
+    thread.join();
+  mgAssertDesc(_jobSystem.nrOfQueuedJobs == 0, "jobs were run but never waited on");
+  for (const auto &threadData : _jobSystem.threadData) {
+    mgAssertDesc(!threadData->isJoined, "a joined thread has not left the job system");
+  }
+  _jobSystem.threads.clear();
+  _jobSystem.threadData.clear();
+  _jobSystem.nrOfThreads = 0;
+  _threadIndex = UINT32_MAX;
+}
+
+uint32_t getNrOfThreads() { return _jobSystem.nrOfThreads; }
+
+void joinThread() {
+  mgAssert(_threadIndex == UINT32_MAX);
+  std::lock_guard<std::mutex> lock(_jobSystem.mutex);
+  for (uint32_t i = _jobSystem.nrOfThreads; i < uint32_t(_jobSystem.threadData.size()); i++) {
+    if (!_jobSystem.threadData[i]->isJoined) {
+      _jobSystem.threadData[i]->isJoined = true;
+      _threadIndex = i;
+      return;
+    }
+  }
+  mgAssertDesc(false, "more than " << MaxNrOfJoinedThreads << " threads have joined the job system");
+}
+
+void leaveThread() {
+  mgAssert(_threadIndex >= _jobSystem.nrOfThreads && _threadIndex < _jobSystem.threadData.size());
+  std::lock_guard<std::mutex> lock(_jobSystem.mutex);
+  _jobSystem.threadData[_threadIndex]->isJoined = false;
+  _threadIndex = UINT32_MAX;
+}
+
+Job *createJob(JobFunction function, const void *data, uint32_t sizeInBytes) {
+  auto &threadData = getThreadData();
+  // jobs are mostly finished in the order they are created, the few that are not, like the parents of a fork join,
+  // are skipped
+  Job *job = nullptr;
+  for (uint32_t i = 0; i < MaxNrOfJobsPerThread && job == nullptr; i++) {
+    Job *candidate = &threadData.jobs[threadData.nrOfAllocatedJobs++ & (MaxNrOfJobsPerThread - 1)];
+    if (isFinished(candidate))
+      job = candidate;
+  }
+  mgAssertDesc(job != nullptr, "more than " << MaxNrOfJobsPerThread << " jobs in flight on one thread");
+  mgAssert(sizeInBytes <= sizeof(job->data));
+
+  job->function = function;
+  job->parent = nullptr;
+  job->nrOfUnfinishedJobs.store(1, std::memory_order_relaxed);
+  if (sizeInBytes > 0)
+    memcpy(job->data, data, sizeInBytes);
+  return job;
+}
+
+Job *createChildJob(Job *parent, JobFunction function, const void *data, uint32_t sizeInBytes) {
+  parent->nrOfUnfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+  Job *job = createJob(function, data, sizeInBytes);
+  job->parent = parent;
+  return job;
+}
+
+void run(Job *job) {
+  // counted before the push so the count never drops below zero when the job is stolen right away
+  _jobSystem.nrOfQueuedJobs.fetch_add(1);
+  getThreadData().deque.push(job);
+  if (_jobSystem.nrOfSleepingThreads.load() > 0) {
+    std::lock_guard<std::mutex> lock(_jobSystem.mutex);
+    _jobSystem.condition.notify_one();
+  }
+}
+
+void wait(const Job *job) {
+  while (!isFinished(job)) {
+    if (Job *next = getJob())
+      execute(next);
+    else
+      std::this_thread::yield();
+  }
+}
+
+bool isFinished(const Job *job) { return job->nrOfUnfinishedJobs.load(std::memory_order_acquire) == 0; }
+
+} // namespace jobs
+} // namespace mg
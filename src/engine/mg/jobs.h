@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+// fork join job system. The thread that calls create and the worker threads each have a Chase-Lev deque, jobs are
+// pushed and popped at the bottom of the deque of the thread that runs them, idle threads steal from the top of the
+// other deques. A job is finished when its function has returned and all its child jobs are finished, wait runs other
+// jobs until then. Jobs can only be created, run and waited on from the threads of the job system
+namespace mg {
+namespace jobs {
+
+struct Job;
+typedef void (*JobFunction)(Job *job, const void *data);
+
+enum { MaxNrOfWorkerThreads = 63 };
+// threads that are not workers, like a streaming thread, can join the job system
+enum { MaxNrOfJoinedThreads = 4 };
+// jobs are allocated from a ring buffer per thread, a thread must not have more jobs in flight than this
+enum { MaxNrOfJobsPerThread = 4096 };
+
+struct alignas(64) Job {
+  JobFunction function;
+  Job *parent;
+  // the job itself and its unfinished child jobs
+  std::atomic<int32_t> nrOfUnfinishedJobs;
+  // copy of the data passed to createJob
+  alignas(16) char data[96];
+};
+// two cache lines, so two jobs never share one
+static_assert(sizeof(Job) == 128, "a job must be two cache lines");
+
+// the default is one worker thread per hardware thread besides the calling thread, with 0 the jobs are run by the
+// calling thread when it waits
+void create(uint32_t nrOfWorkerThreads = UINT32_MAX);
+void destroy();
+// the worker threads and the thread that called create
+uint32_t getNrOfThreads();
+// the calling thread gets its own deque and can create, run and wait on jobs until it leaves, its jobs can be stolen
+// by the other threads. It must leave before destroy
+void joinThread();
+void leaveThread();
+
+// sizeInBytes of data is copied into the job
+Job *createJob(JobFunction function, const void *data = nullptr, uint32_t sizeInBytes = 0);
+// the parent is not finished before the child job, the child must be created before the parent is finished
+Job *createChildJob(Job *parent, JobFunction function, const void *data = nullptr, uint32_t sizeInBytes = 0);
+void run(Job *job);
+// runs other jobs until the job and its child jobs are finished
+void wait(const Job *job);
+bool isFinished(const Job *job);
+
+template <typename T> void _runLambda(Job *, const void *data) { (*(const T *)data)(); }
+
+// the lambda is copied into the job, so it must be trivially copyable and small, capture by reference
+template <typename T> Job *createJob(const T &lambda) {
+  static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= sizeof(Job::data) && alignof(T) <= 16,
+                "the lambda can not be copied into a job");
+  return createJob(_runLambda<T>, &lambda, sizeof(T));
+}
+template <typename T> Job *createChildJob(Job *parent, const T &lambda) {
+  static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= sizeof(Job::data) && alignof(T) <= 16,
+                "the lambda can not be copied into a job");
+  return createChildJob(parent, _runLambda<T>, &lambda, sizeof(T));
+}
+
+template <typename T> struct _ParallelForRange {
+  const T *function;
+  uint32_t begin, end;
+  uint32_t grainSize;
+};
+
+// the range is split in halves until it is at most grainSize, the halves are child jobs so idle threads steal the
+// largest ranges first
+template <typename T> void _parallelForJob(Job *job, const void *data) {
+  const auto &range = *(const _ParallelForRange<T> *)data;
+  if (range.end - range.begin <= range.grainSize) {
+    (*range.function)(range.begin, range.end);
+    return;
+  }
+  const uint32_t middle = range.begin + (range.end - range.begin) / 2;
+  const _ParallelForRange<T> left = {range.function, range.begin, middle, range.grainSize};
+  const _ParallelForRange<T> right = {range.function, middle, range.end, range.grainSize};
+  run(createChildJob(job, _parallelForJob<T>, &left, sizeof(left)));
+  run(createChildJob(job, _parallelForJob<T>, &right, sizeof(right)));
+}
+
+// calls function(rangeBegin, rangeEnd) for ranges of at most grainSize that cover [begin, end), returns when all
+// ranges are done
+template <typename T> void parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const T &function) {
+  if (begin >= end)
+    return;
+  const _ParallelForRange<T> range = {&function, begin, end, grainSize > 0 ? grainSize : 1};
+  Job *job = createJob(_parallelForJob<T>, &range, sizeof(range));
+  run(job);
+  wait(job);
+}
+
+} // namespace jobs
+} // namespace mg
@@ -20,20 +20,19 @@ static void stageData(mg::MeshData *meshData, void *data, uint32_t sizeInBytes)
   region.size = sizeInBytes;
   vkCmdCopyBuffer(copyCommandBuffer, stagingBuffer, meshData->mesh.buffer, 1, &region);
 
-  VkMemoryBarrier memoryBarrier = {};
-  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-  memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
-
-  vkCmdPipelineBarrier(copyCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0,
-                       &memoryBarrier, 0, nullptr, 0, nullptr);
+  mg::mgSystem.uploadQueue.releaseBuffer(copyCommandBuffer, meshData->mesh.buffer,
+                                         VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+                                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 }
 
 static void uploadMeshWithoutIndices(const mg::CreateMeshInfo &createMeshInfo, mg::MeshData *meshData) {
   VkBufferCreateInfo vertexBufferInfo = {};
   vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   vertexBufferInfo.size = createMeshInfo.verticesSizeInBytes;
-  vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  vertexBufferInfo.usage =
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  meshData->bufferSizeInBytes = vertexBufferInfo.size;
+  meshData->bufferUsage = vertexBufferInfo.usage;
 
   checkResult(vkCreateBuffer(mg::vkContext.device, &vertexBufferInfo, nullptr, &meshData->mesh.buffer));
 
@@ -58,9 +57,11 @@ static void uploadMeshWithIndices(const mg::CreateMeshInfo &createMeshInfo, mg::
 
   VkBufferCreateInfo vertexBufferInfo = {};
   vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  vertexBufferInfo.usage =
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
   vertexBufferInfo.size = totalSize;
+  meshData->bufferSizeInBytes = vertexBufferInfo.size;
+  meshData->bufferUsage = vertexBufferInfo.usage;
 
   checkResult(vkCreateBuffer(mg::vkContext.device, &vertexBufferInfo, nullptr, &meshData->mesh.buffer));
 
@@ -82,21 +83,42 @@ MeshContainer::~MeshContainer() { mgAssert(_idToMesh.size() == 0); }
 
 void MeshContainer::destroyMeshContainer() {
   for (auto &meshData : _idToMesh) {
-    if (meshData.mesh.indexCount == 0)
+    // removed and reserved meshes have no buffer
+    if (meshData.mesh.buffer == VK_NULL_HANDLE)
       continue;
 
     vkDestroyBuffer(mg::vkContext.device, meshData.mesh.buffer, nullptr);
     mg::mgSystem.meshDeviceMemoryAllocator.freeDeviceOnlyMemory(meshData.heapAllocation);
   }
+  for (const auto &retiredMesh : _retiredMeshes) {
+    vkDestroyBuffer(mg::vkContext.device, retiredMesh.buffer, nullptr);
+    mg::mgSystem.meshDeviceMemoryAllocator.freeDeviceOnlyMemory(retiredMesh.heapAllocation);
+  }
+  _retiredMeshes.clear();
   _idToMesh.clear();
   _freeIndices.clear();
   _generations.clear();
+  _isReserved.clear();
+  _placeholder = {0, UINT32_MAX};
 }
 
-MeshId MeshContainer::createMesh(const CreateMeshInfo &createMeshInfo) {
+static MeshData createMeshData(const CreateMeshInfo &createMeshInfo) {
   mgAssert(createMeshInfo.verticesSizeInBytes > 0);
   mgAssert(createMeshInfo.vertices != nullptr);
 
+  mg::MeshData meshData = {};
+  meshData.mesh.indexCount = createMeshInfo.nrOfIndices;
+  meshData.mesh.indicesOffset = createMeshInfo.verticesSizeInBytes;
+
+  if (createMeshInfo.indices == nullptr)
+    uploadMeshWithoutIndices(createMeshInfo, &meshData);
+  else {
+    uploadMeshWithIndices(createMeshInfo, &meshData);
+  }
+  return meshData;
+}
+
+uint32_t MeshContainer::allocateIndex() {
   uint32_t currentIndex = 0;
   if (_freeIndices.size()) {
     currentIndex = _freeIndices.back();
@@ -105,16 +127,14 @@ MeshId MeshContainer::createMesh(const CreateMeshInfo &createMeshInfo) {
     currentIndex = uint32_t(_idToMesh.size());
     _idToMesh.push_back({});
     _generations.push_back(0);
+    _isReserved.push_back({});
   }
-  mg::MeshData meshData = {};
-  meshData.mesh.indexCount = createMeshInfo.nrOfIndices;
-  meshData.mesh.indicesOffset = createMeshInfo.verticesSizeInBytes;
+  return currentIndex;
+}
 
-  if (createMeshInfo.indices == nullptr)
-    uploadMeshWithoutIndices(createMeshInfo, &meshData);
-  else {
-    uploadMeshWithIndices(createMeshInfo, &meshData);
-  }
+MeshId MeshContainer::createMesh(const CreateMeshInfo &createMeshInfo) {
+  const auto meshData = createMeshData(createMeshInfo);
+  const auto currentIndex = allocateIndex();
   _idToMesh[currentIndex] = meshData;
 
   MeshId meshId = {};
@@ -123,10 +143,41 @@ MeshId MeshContainer::createMesh(const CreateMeshInfo &createMeshInfo) {
   return meshId;
 }
 
+MeshId MeshContainer::reserveMesh() {
+  if (_placeholder.index == UINT32_MAX) {
+    // large enough for three vertices of any vertex layout, the placeholder draws nothing
+    const char empty[256] = {};
+    CreateMeshInfo createMeshInfo = {};
+    createMeshInfo.id = "placeholder";
+    createMeshInfo.vertices = (unsigned char *)empty;
+    createMeshInfo.verticesSizeInBytes = sizeof(empty);
+    createMeshInfo.nrOfIndices = 0;
+    _placeholder = createMesh(createMeshInfo);
+  }
+  const auto currentIndex = allocateIndex();
+  _isReserved[currentIndex] = true;
+
+  MeshId meshId = {};
+  meshId.generation = _generations[currentIndex];
+  meshId.index = currentIndex;
+  return meshId;
+}
+
+void MeshContainer::createReservedMesh(MeshId meshId, const CreateMeshInfo &createMeshInfo) {
+  mgAssert(meshId.index < _idToMesh.size());
+  mgAssert(meshId.generation == _generations[meshId.index]);
+  mgAssert(_isReserved[meshId.index]);
+
+  _idToMesh[meshId.index] = createMeshData(createMeshInfo);
+  _isReserved[meshId.index] = false;
+}
+
 Mesh MeshContainer::getMesh(MeshId meshId) const {
   mgAssert(meshId.index < _idToMesh.size());
   mgAssert(meshId.generation == _generations[meshId.index]);
 
+  if (_isReserved[meshId.index])
+    return _idToMesh[_placeholder.index].mesh;
   return _idToMesh[meshId.index].mesh;
 }
 
@@ -134,11 +185,89 @@ void MeshContainer::removeMesh(MeshId meshId) {
   mgAssert(meshId.index < _idToMesh.size());
   mgAssert(meshId.generation == _generations[meshId.index]);
 
-  mg::mgSystem.meshDeviceMemoryAllocator.freeDeviceOnlyMemory(_idToMesh[meshId.index].heapAllocation);
-  vkDestroyBuffer(mg::vkContext.device, _idToMesh[meshId.index].mesh.buffer, nullptr);
+  // the frames in flight can still read the buffer, it is destroyed with the moved meshes
+  if (!_isReserved[meshId.index]) {
+    const auto &meshData = _idToMesh[meshId.index];
+    _retiredMeshes.push_back(RetiredMesh{meshData.mesh.buffer, meshData.heapAllocation, _frameIndex});
+  }
   _idToMesh[meshId.index] = {};
+  _isReserved[meshId.index] = false;
   _generations[meshId.index]++;
   _freeIndices.push_back(meshId.index);
 }
 
+static bool moveMesh(mg::MeshData *meshData) {
+  auto &allocator = mg::mgSystem.meshDeviceMemoryAllocator;
+
+  VkBufferCreateInfo vkBufferCreateInfo = {};
+  vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  vkBufferCreateInfo.size = meshData->bufferSizeInBytes;
+  vkBufferCreateInfo.usage = meshData->bufferUsage;
+
+  VkBuffer buffer;
+  checkResult(vkCreateBuffer(mg::vkContext.device, &vkBufferCreateInfo, nullptr, &buffer));
+
+  VkMemoryRequirements vkMemoryRequirements = {};
+  vkGetBufferMemoryRequirements(mg::vkContext.device, buffer, &vkMemoryRequirements);
+
+  DeviceHeapAllocation heapAllocation = {};
+  if (!allocator.allocateOutsideDefragmentationHeap(meshData->heapAllocation.memoryTypeIndex,
+                                                    meshData->heapAllocation.size, vkMemoryRequirements.alignment,
+                                                    &heapAllocation)) {
+    vkDestroyBuffer(mg::vkContext.device, buffer, nullptr);
+    return false;
+  }
+  checkResult(vkBindBufferMemory(mg::vkContext.device, buffer, heapAllocation.deviceMemory, heapAllocation.offset));
+
+  // the staging command buffer is submitted before the frame that uses the new buffer
+  VkCommandBuffer commandBuffer = mg::mgSystem.linearHeapAllocator.getStagingCommandBuffer();
+  VkBufferCopy region = {};
+  region.size = meshData->bufferSizeInBytes;
+  vkCmdCopyBuffer(commandBuffer, meshData->mesh.buffer, buffer, 1, &region);
+
+  VkMemoryBarrier memoryBarrier = {};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+
+  meshData->mesh.buffer = buffer;
+  meshData->heapAllocation = heapAllocation;
+  return true;
+}
+
+VkDeviceSize MeshContainer::defragment(VkDeviceSize budgetInBytes) {
+  _frameIndex++;
+
+  // the copy is submitted with the current frame, wait until every frame in flight that could read the old buffer is
+  // done
+  uint32_t nrOfRetiredMeshes = 0;
+  for (const auto &retiredMesh : _retiredMeshes) {
+    if (_frameIndex - retiredMesh.frameIndex < mg::vkContext.commandBuffers.nrOfBuffers) {
+      _retiredMeshes[nrOfRetiredMeshes++] = retiredMesh;
+      continue;
+    }
+    vkDestroyBuffer(mg::vkContext.device, retiredMesh.buffer, nullptr);
+    mg::mgSystem.meshDeviceMemoryAllocator.freeDeviceOnlyMemory(retiredMesh.heapAllocation);
+  }
+  _retiredMeshes.resize(nrOfRetiredMeshes);
+
+  VkDeviceSize movedSizeInBytes = 0;
+  for (auto &meshData : _idToMesh) {
+    if (meshData.mesh.buffer == VK_NULL_HANDLE ||
+        !mg::mgSystem.meshDeviceMemoryAllocator.isInDefragmentationHeap(meshData.heapAllocation))
+      continue;
+    if (movedSizeInBytes + meshData.heapAllocation.size > budgetInBytes && movedSizeInBytes > 0)
+      break;
+
+    const auto retiredMesh = RetiredMesh{meshData.mesh.buffer, meshData.heapAllocation, _frameIndex};
+    if (!moveMesh(&meshData))
+      break;
+    _retiredMeshes.push_back(retiredMesh);
+    movedSizeInBytes += meshData.heapAllocation.size;
+  }
+  return movedSizeInBytes;
+}
+
 } // namespace mg
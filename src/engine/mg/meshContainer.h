@@ -21,6 +21,8 @@ struct Mesh {
 struct MeshData {
   Mesh mesh;
   mg::DeviceHeapAllocation heapAllocation;
+  VkDeviceSize bufferSizeInBytes;
+  VkBufferUsageFlags bufferUsage;
 };
 
 struct CreateMeshInfo {
@@ -34,16 +36,36 @@ class MeshContainer : mg::nonCopyable {
 public:
   void createMeshContainer() {}
   MeshId createMesh(const CreateMeshInfo &createMeshInfo);
+  // a reserved mesh is the placeholder, an empty mesh, until it is created. Used for meshes that are streamed
+  MeshId reserveMesh();
+  void createReservedMesh(MeshId meshId, const CreateMeshInfo &createMeshInfo);
   Mesh getMesh(MeshId meshId) const;
   void removeMesh(MeshId meshId);
 
+  // moves meshes out of the heap being defragmented, returns the number of bytes copied
+  VkDeviceSize defragment(VkDeviceSize budgetInBytes);
+  bool hasRetiredMeshes() const { return _retiredMeshes.size() > 0; }
+
   void destroyMeshContainer();
   ~MeshContainer();
 
 private:
+  uint32_t allocateIndex();
+
   std::vector<MeshData> _idToMesh;
   std::vector<uint32_t> _freeIndices;
   std::vector<uint32_t> _generations;
+  std::vector<bool> _isReserved;
+  MeshId _placeholder = {0, UINT32_MAX};
+
+  // moved and removed meshes, destroyed when the frames that could reference them have finished
+  struct RetiredMesh {
+    VkBuffer buffer;
+    mg::DeviceHeapAllocation heapAllocation;
+    uint64_t frameIndex;
+  };
+  std::vector<RetiredMesh> _retiredMeshes;
+  uint64_t _frameIndex = 0;
 };
 
 } // namespace mg
@@ -46,7 +46,18 @@ struct ObjMeshes {
   std::vector<ObjMesh> meshes;
 };
 
+// the vertices of every shape of an obj file, 3 position, 3 normal and 2 texcoord floats per vertex
+struct ObjFile {
+  std::vector<ObjMaterial> materials;
+  std::vector<uint32_t> materialIds;
+  std::vector<std::vector<float>> vertices;
+};
+
+// the parse functions do not use the device, they can be called from any thread of the job system
 GltfMeshes parseGltf(const std::string &id, const std::string &path, const std::string &name);
+ObjFile parseObjFile(const std::string &filename);
+// creates the mesh of a shape, a shape without vertices has no mesh. With a reserved mesh id the mesh is created in it
+ObjMesh createObjMesh(const ObjFile &objFile, uint32_t index, const MeshId *reservedMeshId = nullptr);
 ObjMeshes loadObjFromFile(const std::string &filename);
 
 } // namespace mg
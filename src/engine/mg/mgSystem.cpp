@@ -1,4 +1,5 @@
 #include "mgSystem.h"
+#include "mg/jobs.h"
 #include "vulkan/linearHeapAllocator.h"
 #include "vulkan/deviceAllocator.h"
 #include "vulkan/pipelineContainer.h"
@@ -16,6 +17,9 @@ static void createAllocators(MgSystem *system) {
     CreateDeviceHeapAllocatorInfo vertexAllocationInfo = {};
     vertexAllocationInfo.heapSizes = { heapSize, heapSize, heapSize, heapSize };
     vertexAllocationInfo.useDifferentHeapsForSmallAllocations = false;
+    vertexAllocationInfo.allocationStrategy = DeviceAllocationStrategy::Tlsf;
+    // meshes are created from the loader and streaming threads
+    vertexAllocationInfo.threadSafe = true;
     system->meshDeviceMemoryAllocator.create(vertexAllocationInfo);
   }
   {
@@ -24,9 +28,15 @@ static void createAllocators(MgSystem *system) {
     CreateDeviceHeapAllocatorInfo textureAllocationInfo = {};
     textureAllocationInfo.heapSizes = { heapSize, heapSize, heapSize, heapSize };
     textureAllocationInfo.useDifferentHeapsForSmallAllocations = false;
+    textureAllocationInfo.allocationStrategy = DeviceAllocationStrategy::Tlsf;
+    textureAllocationInfo.threadSafe = true;
     system->textureDeviceMemoryAllocator.create(textureAllocationInfo);
   }
-  system->linearHeapAllocator.create();
+  system->uploadQueue.create();
+  CreateLinearHeapAllocatorInfo linearHeapAllocatorInfo = {};
+  linearHeapAllocatorInfo.uploadQueue = &system->uploadQueue;
+  system->linearHeapAllocator.create(linearHeapAllocatorInfo);
+  system->memoryBudget.create();
 }
 
 static void destroyAllocators(MgSystem *system) {
@@ -34,6 +44,7 @@ static void destroyAllocators(MgSystem *system) {
   system->textureDeviceMemoryAllocator.destroy();
   system->meshDeviceMemoryAllocator.destroy();
   system->linearHeapAllocator.destroy();
+  system->uploadQueue.destroy();
 }
 
 static void createContainers(MgSystem *system) {
@@ -51,8 +62,11 @@ static void destroyContainers(MgSystem *system) {
 }
 
 void createMgSystem(MgSystem *system) {
+  jobs::create();
   createAllocators(system);
   createContainers(system);
+  system->secondaryCommandBuffers.create();
+  system->assetStreamer.create();
 
   mgSystem.imguiOverlay.CreateContext();
   system->fonts.init();
@@ -60,10 +74,36 @@ void createMgSystem(MgSystem *system) {
 
 void destroyMgSystem(MgSystem *system) {
   waitForDeviceIdle();
+  system->assetStreamer.destroy();
   system->fonts.destroy();
   mgSystem.imguiOverlay.destroy();
+  system->secondaryCommandBuffers.destroy();
   destroyContainers(system);
   destroyAllocators(system);
+  jobs::destroy();
+}
+
+void defragmentDeviceMemory(MgSystem *system, VkDeviceSize budgetInBytes) {
+  {
+    auto &allocator = system->meshDeviceMemoryAllocator;
+    allocator.releaseEmptyHeaps();
+    allocator.selectDefragmentationHeap();
+    // nothing could be moved, e.g. storage buffers, give up on the heap until something is freed from it
+    if (system->meshContainer.defragment(budgetInBytes) == 0 && !system->meshContainer.hasRetiredMeshes())
+      allocator.abortDefragmentation();
+  }
+  {
+    auto &allocator = system->textureDeviceMemoryAllocator;
+    allocator.releaseEmptyHeaps();
+    allocator.selectDefragmentationHeap();
+    if (system->textureContainer.defragment(budgetInBytes) == 0 && !system->textureContainer.hasRetiredTextures())
+      allocator.abortDefragmentation();
+  }
+}
+
+void manageDeviceMemoryBudget(MgSystem *system, VkDeviceSize budgetInBytes) {
+  system->memoryBudget.update();
+  system->textureContainer.updateResidency(system->memoryBudget, budgetInBytes);
 }
 
 } // namespace
@@ -1,15 +1,21 @@
 #pragma once
 #include <string>
 
+#include "mg/assetStreamer.h"
 #include "mg/fonts.h"
 #include "mg/meshContainer.h"
 #include "mg/mgUtils.h"
 #include "mg/storageContainer.h"
 #include "mg/textureContainer.h"
+#include "rendering/renderQueue.h"
+#include "vulkan/commandRecorder.h"
 #include "vulkan/imguiOverlay.h"
 #include "vulkan/linearHeapAllocator.h"
+#include "vulkan/memoryBudget.h"
 #include "vulkan/pipelineContainer.h"
+#include "vulkan/secondaryCommandBuffers.h"
 #include "vulkan/singleRenderpass.h"
+#include "vulkan/uploadQueue.h"
 
 namespace mg {
 
@@ -21,9 +27,15 @@ struct MgSystem : mg::nonCopyable {
   MeshContainer meshContainer;
   StorageContainer storageContainer;
 
+  UploadQueue uploadQueue;
   LinearHeapAllocator linearHeapAllocator;
   DeviceMemoryAllocator meshDeviceMemoryAllocator;
   DeviceMemoryAllocator textureDeviceMemoryAllocator;
+  MemoryBudget memoryBudget;
+  CommandRecorder commandRecorder;
+  SecondaryCommandBuffers secondaryCommandBuffers;
+  RenderQueue renderQueue;
+  AssetStreamer assetStreamer;
 
   Fonts fonts;
   Imgui imguiOverlay;
@@ -31,6 +43,11 @@ struct MgSystem : mg::nonCopyable {
 
 void createMgSystem(MgSystem *system);
 void destroyMgSystem(MgSystem *system);
+// moves at most budgetInBytes of meshes and textures per call out of sparsely used device heaps and releases empty heaps
+void defragmentDeviceMemory(MgSystem *system, VkDeviceSize budgetInBytes);
+// updates the memory budget, evicts textures under high memory pressure and loads them again when there is room,
+// at most budgetInBytes are moved per call
+void manageDeviceMemoryBudget(MgSystem *system, VkDeviceSize budgetInBytes);
 
 extern MgSystem mgSystem;
 
@@ -1,5 +1,6 @@
 #include "mgUtils.h"
 
+#include <filesystem>
 #include <fstream>
 #include <cassert>
 #include <vector>
@@ -12,6 +13,15 @@
 
 #include "mgAssert.h"
 
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <glm/glm.hpp>
 
 namespace mg {
@@ -116,6 +126,99 @@ std::vector<char> readBinaryCharVecFromDisc(const std::string &fileName) {
   return std::vector<char>();
 }
 
+bool writeBinaryToDisc(const std::string &fileName, const std::vector<char> &data) {
+  const auto tempFileName = fileName + ".tmp";
+  std::error_code errorCode;
+  {
+    std::ofstream file(tempFileName, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), std::streamsize(data.size()));
+    // the data is flushed by close, a full disc is only reported here
+    file.close();
+    if (!file) {
+      std::filesystem::remove(tempFileName, errorCode);
+      return false;
+    }
+  }
+  std::filesystem::rename(tempFileName, fileName, errorCode);
+  if (errorCode) {
+    std::filesystem::remove(tempFileName, errorCode);
+    return false;
+  }
+  return true;
+}
+
+bool MappedFile::open(const std::string &fileName) {
+  close();
+#if defined(WIN32)
+  _file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (_file == INVALID_HANDLE_VALUE) {
+    _file = nullptr;
+    return false;
+  }
+  LARGE_INTEGER size = {};
+  if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+    close();
+    return false;
+  }
+  _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!_mapping) {
+    close();
+    return false;
+  }
+  _data = (const char *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!_data) {
+    close();
+    return false;
+  }
+  _size = size_t(size.QuadPart);
+#else
+#if defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK)
+  const std::string macFileName = getMacResourcePath(fileName.c_str());
+  const int file = ::open(macFileName.c_str(), O_RDONLY);
+#else
+  const int file = ::open(fileName.c_str(), O_RDONLY);
+#endif
+  if (file < 0)
+    return false;
+  struct stat fileStat = {};
+  if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+    ::close(file);
+    return false;
+  }
+  void *data = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+  // the mapping keeps the file alive
+  ::close(file);
+  if (data == MAP_FAILED)
+    return false;
+  _data = (const char *)data;
+  _size = size_t(fileStat.st_size);
+#endif
+  return true;
+}
+
+void MappedFile::close() {
+#if defined(WIN32)
+  if (_data)
+    UnmapViewOfFile(_data);
+  if (_mapping)
+    CloseHandle(_mapping);
+  if (_file)
+    CloseHandle(_file);
+  _mapping = nullptr;
+  _file = nullptr;
+#else
+  if (_data)
+    munmap((void *)_data, _size);
+#endif
+  _data = nullptr;
+  _size = 0;
+}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
 std::string readStringFromDisc(const std::string &fileName) {
 #if defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK)
   auto macFileName = getMacResourcePath(fileName.c_str());
@@ -160,4 +263,16 @@ std::string getShaderPath() { return "../../../resources/shaders/build/"; }
 std::string getDataPath() { return "../../../resources/data/"; }
 std::string getTransferFunctionPath() { return "../../../resources/transferFunctions/"; }
 
+std::string getExecutableName() {
+#if defined(WIN32)
+  char path[MAX_PATH] = {};
+  if (GetModuleFileNameA(nullptr, path, MAX_PATH))
+    return std::filesystem::path(path).stem().string();
+#elif defined(__linux__)
+  std::error_code errorCode;
+  return std::filesystem::read_symlink("/proc/self/exe", errorCode).stem().string();
+#endif
+  return "";
+}
+
 } // namespace
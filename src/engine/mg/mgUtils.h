@@ -84,6 +84,27 @@ std::vector<float> sint16ToFloat32(int16_t *data, uint32_t size);
 std::vector<uint8_t> readBinaryFromDisc(const std::string &name);
 std::vector<char> readBinaryCharVecFromDisc(const std::string &name);
 std::string readStringFromDisc(const std::string &fileName);
+// writes a temporary file that replaces the old file, a crash during the write leaves the old file intact
+bool writeBinaryToDisc(const std::string &fileName, const std::vector<char> &data);
+
+// read only view of a file mapped into memory, the pages are read from disc when they are first touched
+class MappedFile : nonCopyable {
+public:
+  bool open(const std::string &fileName);
+  void close();
+  bool isOpen() const { return _data != nullptr; }
+  const char *data() const { return _data; }
+  size_t size() const { return _size; }
+  ~MappedFile();
+
+private:
+  const char *_data = nullptr;
+  size_t _size = 0;
+#if defined(WIN32)
+  void *_file = nullptr;
+  void *_mapping = nullptr;
+#endif
+};
 
 template <typename Iter>
 int32_t indexOf(Iter first, Iter last, const typename std::iterator_traits<Iter>::value_type& x) {
@@ -137,6 +158,7 @@ inline uint32_t alignUpPowerOfTwo(uint32_t n, uint32_t alignment) {
 inline uint64_t alignUpPowerOfTwo(uint64_t n, uint64_t alignment) {
   return (n + (alignment - 1)) & ~(alignment - 1);
 }
+inline bool isPowerOfTwo(uint64_t n) { return n != 0 && (n & (n - 1)) == 0; }
 
 std::string getFontsPath();
 std::string getTextureCursorsPath();
@@ -144,6 +166,8 @@ std::string getTexturePath();
 std::string getShaderPath();
 std::string getDataPath();
 std::string getTransferFunctionPath();
+// file name of the running executable without extension, empty if the platform can not tell
+std::string getExecutableName();
 
 class MakeString {
 public:
@@ -1,4 +1,5 @@
 #include "meshLoader.h"
+#include "mg/jobs.h"
 #include "mg/mgSystem.h"
 #include <glm/glm.hpp>
 #include <unordered_set>
@@ -149,36 +150,31 @@ static void computeSmoothingNormals(const tinyobj::attrib_t &attrib, const tinyo
   }
 }
 
-static ObjMeshes readObjFromBinary(std::ifstream &offsets, const std::string &name) {
-  ObjMeshes objMeshes = {};
+static ObjFile readObjFromBinary(std::ifstream &offsets, const std::string &name) {
   const auto binary = mg::readBinaryFromDisc(name + ".bin");
   const auto materials = mg::readBinaryFromDisc(name + ".mat");
   const auto mesh = mg::readBinaryFromDisc(name + ".mesh");
 
-  objMeshes.materials.resize(materials.size() / sizeof(ObjMaterial));
-  std::memcpy(objMeshes.materials.data(), materials.data(), mg::sizeofContainerInBytes(materials));
+  ObjFile objFile = {};
+  objFile.materials.resize(materials.size() / sizeof(ObjMaterial));
+  std::memcpy(objFile.materials.data(), materials.data(), mg::sizeofContainerInBytes(materials));
 
-  objMeshes.meshes.resize(mesh.size() / sizeof(ObjMesh));
-  std::memcpy(objMeshes.meshes.data(), mesh.data(), mg::sizeofContainerInBytes(mesh));
+  std::vector<ObjMesh> meshes(mesh.size() / sizeof(ObjMesh));
+  std::memcpy(meshes.data(), mesh.data(), mg::sizeofContainerInBytes(mesh));
 
   uint32_t currentOffset = 0;
-  for (uint32_t i = 0; i < objMeshes.meshes.size(); i++) {
+  for (const auto &objMesh : meshes) {
     uint32_t vertexsize;
     char delimiter;
     offsets >> vertexsize >> delimiter;
     mgAssert((currentOffset + vertexsize) <= binary.size());
-    mg::CreateMeshInfo createMeshInfo = {};
-    createMeshInfo.id = "mesh" + std::to_string(i);
-    createMeshInfo.vertices = (unsigned char *)&binary[currentOffset];
-    createMeshInfo.verticesSizeInBytes = vertexsize;
-    createMeshInfo.nrOfIndices = vertexsize / (sizeof(float) * (3 + 3 + 2));
+    const auto *vertices = (const float *)&binary[currentOffset];
+    objFile.vertices.emplace_back(vertices, vertices + vertexsize / sizeof(float));
+    objFile.materialIds.push_back(objMesh.materialId);
 
     currentOffset += vertexsize;
-
-    const auto meshId = mg::mgSystem.meshContainer.createMesh(createMeshInfo);
-    objMeshes.meshes[i].id = meshId;
   }
-  return objMeshes;
+  return objFile;
 }
 
 struct Outputs {
@@ -190,12 +186,13 @@ inline bool exists(const std::string &name) {
   return f.good();
 }
 
-ObjMeshes loadObjFromFile(const std::string &filename) {
+ObjFile parseObjFile(const std::string &filename) {
   if (!exists(filename)) {
     LOG("Could not find .obj file, some obj files may need to be unzipped before use");
     exit(1);
   }
 
+  ObjFile objFile = {};
   ObjMeshes tinyObjMeshes = {};
   Outputs outputs = {};
 
@@ -322,140 +319,148 @@ ObjMeshes loadObjFromFile(const std::string &filename) {
         computeSmoothingNormals(attrib, shapes[s], smoothVertexNormals);
       }
 
-      for (size_t f = 0; f < shapes[s].mesh.indices.size() / 3; f++) {
-        tinyobj::index_t idx0 = shapes[s].mesh.indices[3 * f + 0];
-        tinyobj::index_t idx1 = shapes[s].mesh.indices[3 * f + 1];
-        tinyobj::index_t idx2 = shapes[s].mesh.indices[3 * f + 2];
-
-        int current_material_id = shapes[s].mesh.material_ids[f];
-
-        if ((current_material_id < 0) || (current_material_id >= static_cast<int>(materials.size()))) {
-          // Invaid material ID. Use default material.
-          current_material_id =
-              int32_t(materials.size()) - 1; // Default material is added to the last item in `materials`.
-        }
-        float diffuse[3];
-        for (size_t i = 0; i < 3; i++) {
-          diffuse[i] = materials[current_material_id].diffuse[i];
-        }
-        float tc[3][2];
-        if (attrib.texcoords.size() > 0) {
-          if ((idx0.texcoord_index < 0) || (idx1.texcoord_index < 0) || (idx2.texcoord_index < 0)) {
-            // face does not contain valid uv index.
+      // the faces only read the shared data, so they are processed in parallel, each face writes its three vertices
+      constexpr uint32_t nrOfFloatsPerVertex = 3 + 3 + 2; // 3:vtx, 3:normal, 2:texcoord
+      const auto nrOfFaces = uint32_t(shapes[s].mesh.indices.size() / 3);
+      buffer.resize(size_t(nrOfFaces) * 3 * nrOfFloatsPerVertex);
+      mg::jobs::parallelFor(0, nrOfFaces, 1024, [&](uint32_t facesBegin, uint32_t facesEnd) {
+        for (uint32_t f = facesBegin; f < facesEnd; f++) {
+          tinyobj::index_t idx0 = shapes[s].mesh.indices[3 * f + 0];
+          tinyobj::index_t idx1 = shapes[s].mesh.indices[3 * f + 1];
+          tinyobj::index_t idx2 = shapes[s].mesh.indices[3 * f + 2];
+
+          int current_material_id = shapes[s].mesh.material_ids[f];
+
+          if ((current_material_id < 0) || (current_material_id >= static_cast<int>(materials.size()))) {
+            // Invaid material ID. Use default material.
+            current_material_id =
+                int32_t(materials.size()) - 1; // Default material is added to the last item in `materials`.
+          }
+          float diffuse[3];
+          for (size_t i = 0; i < 3; i++) {
+            diffuse[i] = materials[current_material_id].diffuse[i];
+          }
+          float tc[3][2];
+          if (attrib.texcoords.size() > 0) {
+            if ((idx0.texcoord_index < 0) || (idx1.texcoord_index < 0) || (idx2.texcoord_index < 0)) {
+              // face does not contain valid uv index.
+              tc[0][0] = 0.0f;
+              tc[0][1] = 0.0f;
+              tc[1][0] = 0.0f;
+              tc[1][1] = 0.0f;
+              tc[2][0] = 0.0f;
+              tc[2][1] = 0.0f;
+            } else {
+              assert(attrib.texcoords.size() > size_t(2 * idx0.texcoord_index + 1));
+              assert(attrib.texcoords.size() > size_t(2 * idx1.texcoord_index + 1));
+              assert(attrib.texcoords.size() > size_t(2 * idx2.texcoord_index + 1));
+
+              // Flip Y coord.
+              tc[0][0] = attrib.texcoords[2 * idx0.texcoord_index];
+              tc[0][1] = 1.0f - attrib.texcoords[2 * idx0.texcoord_index + 1];
+              tc[1][0] = attrib.texcoords[2 * idx1.texcoord_index];
+              tc[1][1] = 1.0f - attrib.texcoords[2 * idx1.texcoord_index + 1];
+              tc[2][0] = attrib.texcoords[2 * idx2.texcoord_index];
+              tc[2][1] = 1.0f - attrib.texcoords[2 * idx2.texcoord_index + 1];
+            }
+          } else {
             tc[0][0] = 0.0f;
             tc[0][1] = 0.0f;
             tc[1][0] = 0.0f;
             tc[1][1] = 0.0f;
             tc[2][0] = 0.0f;
             tc[2][1] = 0.0f;
-          } else {
-            assert(attrib.texcoords.size() > size_t(2 * idx0.texcoord_index + 1));
-            assert(attrib.texcoords.size() > size_t(2 * idx1.texcoord_index + 1));
-            assert(attrib.texcoords.size() > size_t(2 * idx2.texcoord_index + 1));
-
-            // Flip Y coord.
-            tc[0][0] = attrib.texcoords[2 * idx0.texcoord_index];
-            tc[0][1] = 1.0f - attrib.texcoords[2 * idx0.texcoord_index + 1];
-            tc[1][0] = attrib.texcoords[2 * idx1.texcoord_index];
-            tc[1][1] = 1.0f - attrib.texcoords[2 * idx1.texcoord_index + 1];
-            tc[2][0] = attrib.texcoords[2 * idx2.texcoord_index];
-            tc[2][1] = 1.0f - attrib.texcoords[2 * idx2.texcoord_index + 1];
           }
-        } else {
-          tc[0][0] = 0.0f;
-          tc[0][1] = 0.0f;
-          tc[1][0] = 0.0f;
-          tc[1][1] = 0.0f;
-          tc[2][0] = 0.0f;
-          tc[2][1] = 0.0f;
-        }
 
-        float v[3][3];
-        for (int k = 0; k < 3; k++) {
-          int f0 = idx0.vertex_index;
-          int f1 = idx1.vertex_index;
-          int f2 = idx2.vertex_index;
-          assert(f0 >= 0);
-          assert(f1 >= 0);
-          assert(f2 >= 0);
-
-          v[0][k] = attrib.vertices[3 * f0 + k];
-          v[1][k] = attrib.vertices[3 * f1 + k];
-          v[2][k] = attrib.vertices[3 * f2 + k];
-        }
+          float v[3][3];
+          for (int k = 0; k < 3; k++) {
+            int f0 = idx0.vertex_index;
+            int f1 = idx1.vertex_index;
+            int f2 = idx2.vertex_index;
+            assert(f0 >= 0);
+            assert(f1 >= 0);
+            assert(f2 >= 0);
 
-        float n[3][3];
-        {
-          bool invalid_normal_index = false;
-          if (attrib.normals.size() > 0) {
-            int nf0 = idx0.normal_index;
-            int nf1 = idx1.normal_index;
-            int nf2 = idx2.normal_index;
+            v[0][k] = attrib.vertices[3 * f0 + k];
+            v[1][k] = attrib.vertices[3 * f1 + k];
+            v[2][k] = attrib.vertices[3 * f2 + k];
+          }
 
-            if ((nf0 < 0) || (nf1 < 0) || (nf2 < 0)) {
-              // normal index is missing from this face.
-              invalid_normal_index = true;
-            } else {
-              for (int k = 0; k < 3; k++) {
-                assert(size_t(3 * nf0 + k) < attrib.normals.size());
-                assert(size_t(3 * nf1 + k) < attrib.normals.size());
-                assert(size_t(3 * nf2 + k) < attrib.normals.size());
-                n[0][k] = attrib.normals[3 * nf0 + k];
-                n[1][k] = attrib.normals[3 * nf1 + k];
-                n[2][k] = attrib.normals[3 * nf2 + k];
+          float n[3][3];
+          {
+            bool invalid_normal_index = false;
+            if (attrib.normals.size() > 0) {
+              int nf0 = idx0.normal_index;
+              int nf1 = idx1.normal_index;
+              int nf2 = idx2.normal_index;
+
+              if ((nf0 < 0) || (nf1 < 0) || (nf2 < 0)) {
+                // normal index is missing from this face.
+                invalid_normal_index = true;
+              } else {
+                for (int k = 0; k < 3; k++) {
+                  assert(size_t(3 * nf0 + k) < attrib.normals.size());
+                  assert(size_t(3 * nf1 + k) < attrib.normals.size());
+                  assert(size_t(3 * nf2 + k) < attrib.normals.size());
+                  n[0][k] = attrib.normals[3 * nf0 + k];
+                  n[1][k] = attrib.normals[3 * nf1 + k];
+                  n[2][k] = attrib.normals[3 * nf2 + k];
+                }
               }
+            } else {
+              invalid_normal_index = true;
             }
-          } else {
-            invalid_normal_index = true;
-          }
 
-          if (invalid_normal_index && !smoothVertexNormals.empty()) {
-            // Use smoothing normals
-            int f0 = idx0.vertex_index;
-            int f1 = idx1.vertex_index;
-            int f2 = idx2.vertex_index;
+            if (invalid_normal_index && !smoothVertexNormals.empty()) {
+              // Use smoothing normals
+              int f0 = idx0.vertex_index;
+              int f1 = idx1.vertex_index;
+              int f2 = idx2.vertex_index;
 
-            if (f0 >= 0 && f1 >= 0 && f2 >= 0) {
-              n[0][0] = smoothVertexNormals[f0][0];
-              n[0][1] = smoothVertexNormals[f0][1];
-              n[0][2] = smoothVertexNormals[f0][2];
+              if (f0 >= 0 && f1 >= 0 && f2 >= 0) {
+                // at, the map is read from several threads
+                n[0][0] = smoothVertexNormals.at(f0)[0];
+                n[0][1] = smoothVertexNormals.at(f0)[1];
+                n[0][2] = smoothVertexNormals.at(f0)[2];
 
-              n[1][0] = smoothVertexNormals[f1][0];
-              n[1][1] = smoothVertexNormals[f1][1];
-              n[1][2] = smoothVertexNormals[f1][2];
+                n[1][0] = smoothVertexNormals.at(f1)[0];
+                n[1][1] = smoothVertexNormals.at(f1)[1];
+                n[1][2] = smoothVertexNormals.at(f1)[2];
 
-              n[2][0] = smoothVertexNormals[f2][0];
-              n[2][1] = smoothVertexNormals[f2][1];
-              n[2][2] = smoothVertexNormals[f2][2];
+                n[2][0] = smoothVertexNormals.at(f2)[0];
+                n[2][1] = smoothVertexNormals.at(f2)[1];
+                n[2][2] = smoothVertexNormals.at(f2)[2];
 
-              invalid_normal_index = false;
+                invalid_normal_index = false;
+              }
             }
-          }
 
-          if (invalid_normal_index) {
-            // compute geometric normal
-            CalcNormal(n[0], v[0], v[1], v[2]);
-            n[1][0] = n[0][0];
-            n[1][1] = n[0][1];
-            n[1][2] = n[0][2];
-            n[2][0] = n[0][0];
-            n[2][1] = n[0][1];
-            n[2][2] = n[0][2];
+            if (invalid_normal_index) {
+              // compute geometric normal
+              CalcNormal(n[0], v[0], v[1], v[2]);
+              n[1][0] = n[0][0];
+              n[1][1] = n[0][1];
+              n[1][2] = n[0][2];
+              n[2][0] = n[0][0];
+              n[2][1] = n[0][1];
+              n[2][2] = n[0][2];
+            }
           }
-        }
-
-        for (int k = 0; k < 3; k++) {
-          buffer.push_back(v[k][0]);
-          buffer.push_back(v[k][1]);
-          buffer.push_back(v[k][2]);
-          buffer.push_back(n[k][0]);
-          buffer.push_back(n[k][1]);
-          buffer.push_back(n[k][2]);
 
-          buffer.push_back(tc[k][0]);
-          buffer.push_back(tc[k][1]);
+          for (int k = 0; k < 3; k++) {
+            float *vertex = &buffer[(size_t(f) * 3 + k) * nrOfFloatsPerVertex];
+            vertex[0] = v[k][0];
+            vertex[1] = v[k][1];
+            vertex[2] = v[k][2];
+            vertex[3] = n[k][0];
+            vertex[4] = n[k][1];
+            vertex[5] = n[k][2];
+
+            vertex[6] = tc[k][0];
+            vertex[7] = tc[k][1];
+          }
         }
-      }
+      });
 
       // OpenGL viewer does not support texturing with per-face material.
       if (shapes[s].mesh.material_ids.size() > 0 && shapes[s].mesh.material_ids.size() > s) {
@@ -468,13 +473,6 @@ ObjMeshes loadObjFromFile(const std::string &filename) {
 
       if (buffer.size() > 0) {
         const auto nrOfIndices = buffer.size() / (3 + 3 + 2); // 3:vtx, 3:normal, 2:texcoord
-
-        mg::CreateMeshInfo createMeshInfo = {};
-        createMeshInfo.vertices = (uint8_t *)buffer.data();
-        createMeshInfo.verticesSizeInBytes = mg::sizeofContainerInBytes(buffer);
-        createMeshInfo.nrOfIndices = uint32_t(nrOfIndices);
-
-        o.id = mg::mgSystem.meshContainer.createMesh(createMeshInfo);
         printf("shape[%d] # of triangles = %d\n", static_cast<int>(s), static_cast<int>(nrOfIndices));
 
         outputs.binary.write((char *)buffer.data(), mg::sizeofContainerInBytes(buffer));
@@ -482,6 +480,8 @@ ObjMeshes loadObjFromFile(const std::string &filename) {
       }
 
       tinyObjMeshes.meshes.push_back(o);
+      objFile.materialIds.push_back(o.materialId);
+      objFile.vertices.push_back(std::move(buffer));
     }
   }
 
@@ -495,7 +495,39 @@ ObjMeshes loadObjFromFile(const std::string &filename) {
   outputs.materials.write((char *)tinyObjMeshes.materials.data(), mg::sizeofContainerInBytes(tinyObjMeshes.materials));
   outputs.mesh.write((char *)tinyObjMeshes.meshes.data(), mg::sizeofContainerInBytes(tinyObjMeshes.meshes));
 
-  return tinyObjMeshes;
+  objFile.materials = std::move(tinyObjMeshes.materials);
+  return objFile;
+}
+
+ObjMesh createObjMesh(const ObjFile &objFile, uint32_t index, const MeshId *reservedMeshId) {
+  ObjMesh objMesh = {};
+  objMesh.materialId = objFile.materialIds[index];
+  if (reservedMeshId != nullptr)
+    objMesh.id = *reservedMeshId;
+  const auto &vertices = objFile.vertices[index];
+  if (vertices.size() > 0) {
+    mg::CreateMeshInfo createMeshInfo = {};
+    createMeshInfo.id = "mesh" + std::to_string(index);
+    createMeshInfo.vertices = (uint8_t *)vertices.data();
+    createMeshInfo.verticesSizeInBytes = mg::sizeofContainerInBytes(vertices);
+    createMeshInfo.nrOfIndices = uint32_t(vertices.size() / (3 + 3 + 2)); // 3:vtx, 3:normal, 2:texcoord
+    if (reservedMeshId != nullptr)
+      mg::mgSystem.meshContainer.createReservedMesh(*reservedMeshId, createMeshInfo);
+    else
+      objMesh.id = mg::mgSystem.meshContainer.createMesh(createMeshInfo);
+  }
+  return objMesh;
+}
+
+ObjMeshes loadObjFromFile(const std::string &filename) {
+  const auto objFile = parseObjFile(filename);
+
+  ObjMeshes objMeshes = {};
+  objMeshes.materials = objFile.materials;
+  for (uint32_t i = 0; i < uint32_t(objFile.vertices.size()); i++) {
+    objMeshes.meshes.push_back(createObjMesh(objFile, i));
+  }
+  return objMeshes;
 }
 
 } // namespace mg
\ No newline at end of file
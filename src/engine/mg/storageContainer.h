@@ -36,6 +36,9 @@ public:
   StorageId createEmptyStorage(uint32_t sizeInBytes);
   StorageId createStorage(void *data, uint32_t sizeInBytes);
   StorageId createImageStorage(const CreateImageStorageInfo &info);
+  // creates count images with their layout transitions recorded in one barrier, the images can be used by command
+  // buffers submitted after the staging memory
+  void createImageStorages(const CreateImageStorageInfo *infos, uint32_t count, StorageId *storageIds);
 
   StorageData getStorage(StorageId storageId) const;
 
@@ -3,6 +3,7 @@
 #include "vulkan/deviceAllocator.h"
 #include "vulkan/linearHeapAllocator.h"
 #include "vulkan/vkUtils.h"
+#include <algorithm>
 #include <unordered_map>
 
 namespace mg {
@@ -21,19 +22,22 @@ static ImageInfo createImageInfoFromType(mg::TEXTURE_TYPE type) {
   case mg::TEXTURE_TYPE::TEXTURE_1D:
     imageInfo.vkImageType = VK_IMAGE_TYPE_1D;
     imageInfo.vkImageViewType = VK_IMAGE_VIEW_TYPE_1D;
-    imageInfo.vkImageUsageFlags = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.vkImageUsageFlags =
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.vkImageLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
     break;
   case mg::TEXTURE_TYPE::TEXTURE_2D:
     imageInfo.vkImageType = VK_IMAGE_TYPE_2D;
     imageInfo.vkImageViewType = VK_IMAGE_VIEW_TYPE_2D;
-    imageInfo.vkImageUsageFlags = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.vkImageUsageFlags =
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.vkImageLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
     break;
   case mg::TEXTURE_TYPE::TEXTURE_3D:
     imageInfo.vkImageType = VK_IMAGE_TYPE_3D;
     imageInfo.vkImageViewType = VK_IMAGE_VIEW_TYPE_3D;
-    imageInfo.vkImageUsageFlags = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.vkImageUsageFlags =
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.vkImageLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
     break;
   case mg::TEXTURE_TYPE::ATTACHMENT:
@@ -99,19 +103,8 @@ static void createDeviceTexture(const mg::CreateTextureInfo &textureInfo, const
                          &vkBufferImageCopy);
 
   // Pipeline barrier before using the image data
-  VkImageMemoryBarrier postCopyMemoryBarrier = {};
-  postCopyMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  postCopyMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  postCopyMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  postCopyMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  postCopyMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  postCopyMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  postCopyMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  postCopyMemoryBarrier.image = texture->image;
-  postCopyMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-
-  vkCmdPipelineBarrier(copyCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
-                       nullptr, 0, nullptr, 1, &postCopyMemoryBarrier);
+  mg::mgSystem.uploadQueue.releaseImage(copyCommandBuffer, texture->image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
   VkImageViewCreateInfo vkImageViewCreateInfo = {};
   vkImageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -165,7 +158,7 @@ static void createDepthTexture(const mg::CreateTextureInfo &textureInfo, mg::_Te
 }
 
 void TextureContainer::createTextureContainer() {
-  {
+  for (uint32_t i = 0; i < MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
     uint32_t counts = MAX_NR_OF_2D_TEXTURES;
     VkDescriptorSetVariableDescriptorCountAllocateInfo set_counts = {};
     set_counts.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
@@ -179,22 +172,40 @@ void TextureContainer::createTextureContainer() {
     descriptorSetAllocateInfo.descriptorSetCount = 1;
     descriptorSetAllocateInfo.pSetLayouts = &mg::vkContext.descriptorSetLayout.textures;
 
-    vkAllocateDescriptorSets(mg::vkContext.device, &descriptorSetAllocateInfo, &_descriptorSet);
+    vkAllocateDescriptorSets(mg::vkContext.device, &descriptorSetAllocateInfo, &_descriptorSets[i]);
   }
-  {
+  for (uint32_t i = 0; i < MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
     VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
     descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     descriptorSetAllocateInfo.descriptorPool = mg::vkContext.descriptorPool;
     descriptorSetAllocateInfo.descriptorSetCount = 1;
     descriptorSetAllocateInfo.pSetLayouts = &mg::vkContext.descriptorSetLayout.textures3D;
 
-    vkAllocateDescriptorSets(mg::vkContext.device, &descriptorSetAllocateInfo, &_descriptorSet3D);
+    vkAllocateDescriptorSets(mg::vkContext.device, &descriptorSetAllocateInfo, &_descriptorSets3D[i]);
+  }
+  // Samplers, they never change
+  for (uint32_t i = 0; i < MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
+    VkDescriptorImageInfo samplerDescriptorImageInfos[2] = {};
+    samplerDescriptorImageInfos[0].sampler = vkContext.sampler.linearBorderSampler;
+    samplerDescriptorImageInfos[1].sampler = vkContext.sampler.linearRepeat;
+
+    VkWriteDescriptorSet writeDescriptorSet = {};
+    writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSet.dstBinding = 0;
+    writeDescriptorSet.dstArrayElement = 0;
+    writeDescriptorSet.descriptorCount = mg::countof(samplerDescriptorImageInfos);
+    writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    writeDescriptorSet.pImageInfo = samplerDescriptorImageInfos;
+    writeDescriptorSet.dstSet = _descriptorSets[i];
+
+    vkUpdateDescriptorSets(mg::vkContext.device, 1, &writeDescriptorSet, 0, nullptr);
   }
 }
 
 TextureContainer::~TextureContainer() { mgAssert(_idToTexture.empty()); }
 
 void TextureContainer::destroyTextureContainer() {
+  collectReadbacks(true);
   for (uint32_t i = 0; i < _idToTexture.size(); i++) {
     if (_isAlive[i]) {
       TextureId id = {i, _generations[i]};
@@ -205,16 +216,33 @@ void TextureContainer::destroyTextureContainer() {
   _freeIndices.clear();
   _generations.clear();
   _isAlive.clear();
-  vkFreeDescriptorSets(vkContext.device, vkContext.descriptorPool, 1, &_descriptorSet);
-  vkFreeDescriptorSets(vkContext.device, vkContext.descriptorPool, 1, &_descriptorSet3D);
+  _lastUsedFrameIndices.clear();
+  _isEvicted.clear();
+  _isReloadRequested.clear();
+  _evictedData.clear();
+  _placeholder2D = {UINT32_MAX, 0};
+  _placeholder3D = {UINT32_MAX, 0};
+  _idToDescriptorIndex2D.clear();
+  _idToDescriptorIndex3D.clear();
+  _descriptorImageViews2D.clear();
+  _freeDescriptorIndices2D.clear();
+  for (uint32_t i = 0; i < MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
+    _changedDescriptorIndices2D[i].reset();
+    _hasChangedDescriptors3D[i] = false;
+  }
+  destroyRetiredTextures(true);
+  vkFreeDescriptorSets(vkContext.device, vkContext.descriptorPool, MAX_NR_OF_FRAMES_IN_FLIGHT, _descriptorSets);
+  vkFreeDescriptorSets(vkContext.device, vkContext.descriptorPool, MAX_NR_OF_FRAMES_IN_FLIGHT, _descriptorSets3D);
 }
 
-TextureId TextureContainer::createTexture(const CreateTextureInfo &textureInfo) {
+static _TextureData createTextureData(const CreateTextureInfo &textureInfo) {
   const auto imageInfo = createImageInfoFromType(textureInfo.type);
 
   mg::_TextureData texture = {};
   texture.type = textureInfo.type;
   texture.format = textureInfo.format;
+  texture.extent = textureInfo.size;
+  texture.sizeInBytes = textureInfo.sizeInBytes;
   VkImageCreateInfo imageCreateInfo = {};
   imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   imageCreateInfo.imageType = imageInfo.vkImageType;
@@ -235,8 +263,17 @@ TextureId TextureContainer::createTexture(const CreateTextureInfo &textureInfo)
       findMemoryTypeIndex(mg::vkContext.physicalDeviceMemoryProperties, vkMemoryRequirements.memoryTypeBits,
                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-  texture.heapAllocation = mg::mgSystem.textureDeviceMemoryAllocator.allocateDeviceOnlyMemory(
-      memoryIndex, vkMemoryRequirements.size, vkMemoryRequirements.alignment);
+  // sampled textures are mostly power of two sized, they fit a buddy heap without alignment gaps
+  const bool isSampledTexture = textureInfo.type == TEXTURE_TYPE::TEXTURE_1D ||
+                                textureInfo.type == TEXTURE_TYPE::TEXTURE_2D ||
+                                textureInfo.type == TEXTURE_TYPE::TEXTURE_3D;
+  if (isSampledTexture && mg::isPowerOfTwo(vkMemoryRequirements.size)) {
+    texture.heapAllocation = mg::mgSystem.textureDeviceMemoryAllocator.allocateDeviceOnlyMemory(
+        memoryIndex, vkMemoryRequirements.size, vkMemoryRequirements.alignment, DeviceAllocationStrategy::Buddy);
+  } else {
+    texture.heapAllocation = mg::mgSystem.textureDeviceMemoryAllocator.allocateDeviceOnlyMemory(
+        memoryIndex, vkMemoryRequirements.size, vkMemoryRequirements.alignment);
+  }
   checkResult(vkBindImageMemory(mg::vkContext.device, texture.image, texture.heapAllocation.deviceMemory,
                                 texture.heapAllocation.offset));
 
@@ -257,7 +294,10 @@ TextureId TextureContainer::createTexture(const CreateTextureInfo &textureInfo)
   default:
     mgAssert(false);
   };
+  return texture;
+}
 
+uint32_t TextureContainer::allocateIndex() {
   uint32_t currentIndex = 0;
   if (_freeIndices.size()) {
     currentIndex = _freeIndices.back();
@@ -267,10 +307,39 @@ TextureId TextureContainer::createTexture(const CreateTextureInfo &textureInfo)
     _idToTexture.push_back({});
     _generations.push_back(0);
     _isAlive.push_back({});
+    _lastUsedFrameIndices.push_back(0);
+    _isEvicted.push_back({});
+    _isReloadRequested.push_back({});
+    _evictedData.push_back({});
+    _idToDescriptorIndex2D.push_back(UINT32_MAX);
+    _idToDescriptorIndex3D.push_back(UINT32_MAX);
   }
+  _isAlive[currentIndex] = true;
+  _lastUsedFrameIndices[currentIndex] = _frameIndex;
+  return currentIndex;
+}
 
+TextureId TextureContainer::createTexture(const CreateTextureInfo &textureInfo) {
+  const auto texture = createTextureData(textureInfo);
+  const auto currentIndex = allocateIndex();
   _idToTexture[currentIndex] = texture;
-  _isAlive[currentIndex] = true;
+  setDescriptor(currentIndex);
+
+  TextureId textureId = {};
+  textureId.generation = _generations[currentIndex];
+  textureId.index = currentIndex;
+  return textureId;
+}
+
+TextureId TextureContainer::reserveTexture(TEXTURE_TYPE type) {
+  mgAssert(type == TEXTURE_TYPE::TEXTURE_2D || type == TEXTURE_TYPE::TEXTURE_3D);
+  getPlaceholder(type);
+  const auto currentIndex = allocateIndex();
+  // evicted without data, it is never loaded again by the residency
+  _idToTexture[currentIndex] = {};
+  _idToTexture[currentIndex].type = type;
+  _isEvicted[currentIndex] = true;
+  _isReloadRequested[currentIndex] = false;
 
   TextureId textureId = {};
   textureId.generation = _generations[currentIndex];
@@ -278,12 +347,28 @@ TextureId TextureContainer::createTexture(const CreateTextureInfo &textureInfo)
   return textureId;
 }
 
+void TextureContainer::createReservedTexture(TextureId textureId, const CreateTextureInfo &textureInfo) {
+  mgAssert(textureId.index < _idToTexture.size());
+  mgAssert(textureId.generation == _generations[textureId.index]);
+  mgAssert(_isAlive[textureId.index]);
+  mgAssert(_isEvicted[textureId.index] && _evictedData[textureId.index].empty());
+  mgAssert(textureInfo.type == _idToTexture[textureId.index].type);
+
+  _idToTexture[textureId.index] = createTextureData(textureInfo);
+  _isEvicted[textureId.index] = false;
+  _isReloadRequested[textureId.index] = false;
+  setDescriptor(textureId.index);
+}
+
 uint32_t TextureContainer::getTexture2DDescriptorIndex(TextureId textureId) {
   mgAssert(textureId.index < _idToTexture.size());
   mgAssert(textureId.generation == _generations[textureId.index]);
   mgAssert(_isAlive[textureId.index]);
   mgAssert(_idToTexture.size() == _idToDescriptorIndex2D.size());
 
+  markAsUsed(textureId.index);
+  if (_isEvicted[textureId.index])
+    return _idToDescriptorIndex2D[_placeholder2D.index];
   return _idToDescriptorIndex2D[textureId.index];
 }
 
@@ -293,6 +378,9 @@ uint32_t TextureContainer::getTexture3DDescriptorIndex(TextureId textureId) {
   mgAssert(_isAlive[textureId.index]);
   mgAssert(_idToTexture.size() == _idToDescriptorIndex3D.size());
 
+  markAsUsed(textureId.index);
+  if (_isEvicted[textureId.index])
+    return _idToDescriptorIndex3D[_placeholder3D.index];
   return _idToDescriptorIndex3D[textureId.index];
 }
 
@@ -301,7 +389,11 @@ Texture TextureContainer::getTexture(TextureId textureId) {
   mgAssert(textureId.generation == _generations[textureId.index]);
   mgAssert(_isAlive[textureId.index]);
 
-  const auto &textureData = _idToTexture[textureId.index];
+  markAsUsed(textureId.index);
+  auto index = textureId.index;
+  if (_isEvicted[index])
+    index = _idToTexture[index].type == TEXTURE_TYPE::TEXTURE_3D ? _placeholder3D.index : _placeholder2D.index;
+  const auto &textureData = _idToTexture[index];
 
   Texture texture = {};
   texture.imageView = textureData.imageView;
@@ -315,67 +407,96 @@ void TextureContainer::removeTexture(TextureId textureId) {
   mgAssert(_isAlive[textureId.index]);
 
   const auto &texture = _idToTexture[textureId.index];
-  vkDestroyImage(mg::vkContext.device, texture.image, nullptr);
-  vkDestroyImageView(mg::vkContext.device, texture.imageView, nullptr);
-  mgSystem.textureDeviceMemoryAllocator.freeDeviceOnlyMemory(texture.heapAllocation);
+  releaseDescriptor(textureId.index);
+  if (_isEvicted[textureId.index]) {
+    _isEvicted[textureId.index] = false;
+    _isReloadRequested[textureId.index] = false;
+    _evictedData[textureId.index] = {};
+  } else {
+    retireTexture(texture);
+  }
   _generations[textureId.index]++;
   _isAlive[textureId.index] = false;
   _freeIndices.push_back(textureId.index);
 }
 
-void TextureContainer::setupDescriptorSets() {
-  mg::waitForDeviceIdle();
-  // Samplers
-  {
-    VkDescriptorImageInfo samplerDescriptorImageInfos[2] = {};
-    samplerDescriptorImageInfos[0].sampler = vkContext.sampler.linearBorderSampler;
-    samplerDescriptorImageInfos[1].sampler = vkContext.sampler.linearRepeat;
+// the descriptor is written to each copy of the descriptor sets when the frame using the copy begins
+void TextureContainer::setDescriptor(uint32_t index) {
+  const auto &texture = _idToTexture[index];
+  if (texture.type == TEXTURE_TYPE::TEXTURE_3D) {
+    for (auto &hasChanged : _hasChangedDescriptors3D)
+      hasChanged = true;
+    return;
+  }
+  if (!(texture.type == TEXTURE_TYPE::TEXTURE_2D || texture.type == TEXTURE_TYPE::ATTACHMENT))
+    return;
+
+  auto &descriptorIndex = _idToDescriptorIndex2D[index];
+  if (descriptorIndex == UINT32_MAX) {
+    if (_freeDescriptorIndices2D.size()) {
+      descriptorIndex = _freeDescriptorIndices2D.back();
+      _freeDescriptorIndices2D.pop_back();
+    } else {
+      descriptorIndex = uint32_t(_descriptorImageViews2D.size());
+      _descriptorImageViews2D.push_back(VK_NULL_HANDLE);
+    }
+    mgAssert(MAX_NR_OF_2D_TEXTURES > descriptorIndex);
+  }
+  _descriptorImageViews2D[descriptorIndex] = texture.imageView;
+  for (auto &changedDescriptorIndices : _changedDescriptorIndices2D)
+    changedDescriptorIndices.set(descriptorIndex);
+}
 
-    VkWriteDescriptorSet writeDescriptorSet[2] = {};
-    writeDescriptorSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescriptorSet[0].dstBinding = 0;
-    writeDescriptorSet[0].dstArrayElement = 0;
-    writeDescriptorSet[0].descriptorCount = mg::countof(samplerDescriptorImageInfos);
-    writeDescriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
-    writeDescriptorSet[0].pImageInfo = samplerDescriptorImageInfos;
-    writeDescriptorSet[0].dstSet = _descriptorSet;
+// the copies still in use keep the old descriptor, the binding is partially bound so it is not read again
+void TextureContainer::releaseDescriptor(uint32_t index) {
+  if (_idToTexture[index].type == TEXTURE_TYPE::TEXTURE_3D) {
+    for (auto &hasChanged : _hasChangedDescriptors3D)
+      hasChanged = true;
+    return;
+  }
+  auto &descriptorIndex = _idToDescriptorIndex2D[index];
+  if (descriptorIndex == UINT32_MAX)
+    return;
+  _descriptorImageViews2D[descriptorIndex] = VK_NULL_HANDLE;
+  _freeDescriptorIndices2D.push_back(descriptorIndex);
+  descriptorIndex = UINT32_MAX;
+}
 
-    // 2D Textures
+void TextureContainer::writeDescriptorSets(uint32_t frameIndex) {
+  // 2D Textures, only the changed descriptors are written
+  {
+    auto &changedDescriptorIndices = _changedDescriptorIndices2D[frameIndex];
     VkDescriptorImageInfo descriptorImageInfos[MAX_NR_OF_2D_TEXTURES] = {};
-    uint32_t currentIndex = 0;
-    _idToDescriptorIndex2D.clear();
-    _idToDescriptorIndex2D.resize(_idToTexture.size());
-    for (uint32_t i = 0; i < uint32_t(_idToTexture.size()); ++i) {
-      if (!_isAlive[i])
-        continue;
-      if (!(_idToTexture[i].type == TEXTURE_TYPE::TEXTURE_2D || _idToTexture[i].type == TEXTURE_TYPE::ATTACHMENT))
+    VkWriteDescriptorSet writeDescriptorSets[MAX_NR_OF_2D_TEXTURES] = {};
+    uint32_t nrOfWrites = 0;
+    for (uint32_t i = 0; i < uint32_t(_descriptorImageViews2D.size()); i++) {
+      if (!changedDescriptorIndices.test(i) || _descriptorImageViews2D[i] == VK_NULL_HANDLE)
         continue;
+      descriptorImageInfos[nrOfWrites].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      descriptorImageInfos[nrOfWrites].imageView = _descriptorImageViews2D[i];
 
-      descriptorImageInfos[currentIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      descriptorImageInfos[currentIndex].imageView = _idToTexture[i].imageView;
-      _idToDescriptorIndex2D[i] = currentIndex;
-      currentIndex++;
+      auto &writeDescriptorSet = writeDescriptorSets[nrOfWrites];
+      writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writeDescriptorSet.dstBinding = 1;
+      writeDescriptorSet.dstArrayElement = i;
+      writeDescriptorSet.descriptorCount = 1;
+      writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+      writeDescriptorSet.pImageInfo = &descriptorImageInfos[nrOfWrites];
+      writeDescriptorSet.dstSet = _descriptorSets[frameIndex];
+      nrOfWrites++;
     }
-
-    writeDescriptorSet[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescriptorSet[1].dstBinding = 1;
-    writeDescriptorSet[1].dstArrayElement = 0;
-    writeDescriptorSet[1].descriptorCount = currentIndex;
-    writeDescriptorSet[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-    writeDescriptorSet[1].pImageInfo = descriptorImageInfos;
-    writeDescriptorSet[1].dstSet = _descriptorSet;
-
-    vkUpdateDescriptorSets(mg::vkContext.device, 2, writeDescriptorSet, 0, nullptr);
-     mgAssert(MAX_NR_OF_2D_TEXTURES > currentIndex);
+    changedDescriptorIndices.reset();
+    if (nrOfWrites > 0)
+      vkUpdateDescriptorSets(mg::vkContext.device, nrOfWrites, writeDescriptorSets, 0, nullptr);
   }
   // 3D Textures
-  {
+  if (_hasChangedDescriptors3D[frameIndex]) {
+    _hasChangedDescriptors3D[frameIndex] = false;
     VkDescriptorImageInfo descriptorImageInfos[MAX_NR_OF_3D_TEXTURES] = {};
     uint32_t currentIndex = 0;
-    _idToDescriptorIndex3D.clear();
-    _idToDescriptorIndex3D.resize(_idToTexture.size());
     for (uint32_t i = 0; i < uint32_t(_idToTexture.size()); ++i) {
-      if (!_isAlive[i])
+      _idToDescriptorIndex3D[i] = UINT32_MAX;
+      if (!_isAlive[i] || _isEvicted[i])
         continue;
       if (_idToTexture[i].type != TEXTURE_TYPE::TEXTURE_3D)
         continue;
@@ -394,14 +515,389 @@ void TextureContainer::setupDescriptorSets() {
       writeDescriptorSet.descriptorCount = currentIndex;
       writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
       writeDescriptorSet.pImageInfo = descriptorImageInfos;
-      writeDescriptorSet.dstSet = _descriptorSet3D;
+      writeDescriptorSet.dstSet = _descriptorSets3D[frameIndex];
 
       vkUpdateDescriptorSets(mg::vkContext.device, 1, &writeDescriptorSet, 0, nullptr);
     }
   }
 }
 
-VkDescriptorSet TextureContainer::getDescriptorSet() { return _descriptorSet; }
-VkDescriptorSet TextureContainer::getDescriptorSet3D() { return _descriptorSet3D; }
+void TextureContainer::setupDescriptorSets() {
+  mg::waitForDeviceIdle();
+  for (uint32_t i = 0; i < MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
+    writeDescriptorSets(i);
+  }
+}
+
+void TextureContainer::updateDescriptorSets() { writeDescriptorSets(mg::vkContext.commandBuffers.currentIndex); }
+
+void TextureContainer::retireTexture(const _TextureData &texture) {
+  _retiredTextures.push_back({texture.image, texture.imageView, texture.heapAllocation, _frameIndex});
+}
+
+void TextureContainer::destroyRetiredTextures(bool force) {
+  uint32_t nrOfRetiredTextures = 0;
+  for (const auto &retiredTexture : _retiredTextures) {
+    if (!force && _frameIndex - retiredTexture.frameIndex < mg::vkContext.commandBuffers.nrOfBuffers) {
+      _retiredTextures[nrOfRetiredTextures++] = retiredTexture;
+      continue;
+    }
+    vkDestroyImage(mg::vkContext.device, retiredTexture.image, nullptr);
+    vkDestroyImageView(mg::vkContext.device, retiredTexture.imageView, nullptr);
+    mgSystem.textureDeviceMemoryAllocator.freeDeviceOnlyMemory(retiredTexture.heapAllocation);
+  }
+  _retiredTextures.resize(nrOfRetiredTextures);
+}
+
+static bool moveTexture(mg::_TextureData *texture) {
+  auto &allocator = mg::mgSystem.textureDeviceMemoryAllocator;
+  const auto imageInfo = createImageInfoFromType(texture->type);
+
+  VkImageCreateInfo imageCreateInfo = {};
+  imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageCreateInfo.imageType = imageInfo.vkImageType;
+  imageCreateInfo.format = texture->format;
+  imageCreateInfo.extent = texture->extent;
+  imageCreateInfo.mipLevels = 1;
+  imageCreateInfo.arrayLayers = 1;
+  imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageCreateInfo.usage = imageInfo.vkImageUsageFlags;
+  imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageCreateInfo.initialLayout = imageInfo.vkImageLayout;
+
+  VkImage image;
+  checkResult(vkCreateImage(mg::vkContext.device, &imageCreateInfo, nullptr, &image));
+
+  VkMemoryRequirements vkMemoryRequirements;
+  vkGetImageMemoryRequirements(mg::vkContext.device, image, &vkMemoryRequirements);
+
+  DeviceHeapAllocation heapAllocation = {};
+  if (!allocator.allocateOutsideDefragmentationHeap(texture->heapAllocation.memoryTypeIndex, vkMemoryRequirements.size,
+                                                    vkMemoryRequirements.alignment, &heapAllocation)) {
+    vkDestroyImage(mg::vkContext.device, image, nullptr);
+    return false;
+  }
+  checkResult(vkBindImageMemory(mg::vkContext.device, image, heapAllocation.deviceMemory, heapAllocation.offset));
+
+  VkCommandBuffer commandBuffer = mg::mgSystem.linearHeapAllocator.getStagingCommandBuffer();
+
+  VkImageMemoryBarrier preCopyMemoryBarriers[2] = {};
+  preCopyMemoryBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  preCopyMemoryBarriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  preCopyMemoryBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  preCopyMemoryBarriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  preCopyMemoryBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  preCopyMemoryBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  preCopyMemoryBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  preCopyMemoryBarriers[0].image = texture->image;
+  preCopyMemoryBarriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+  preCopyMemoryBarriers[1] = preCopyMemoryBarriers[0];
+  preCopyMemoryBarriers[1].srcAccessMask = 0;
+  preCopyMemoryBarriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  preCopyMemoryBarriers[1].oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+  preCopyMemoryBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  preCopyMemoryBarriers[1].image = image;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                       nullptr, 0, nullptr, mg::countof(preCopyMemoryBarriers), preCopyMemoryBarriers);
+
+  VkImageCopy vkImageCopy = {};
+  vkImageCopy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  vkImageCopy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  vkImageCopy.extent = texture->extent;
+  vkCmdCopyImage(commandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &vkImageCopy);
+
+  VkImageMemoryBarrier postCopyMemoryBarrier = {};
+  postCopyMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  postCopyMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  postCopyMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  postCopyMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  postCopyMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  postCopyMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  postCopyMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  postCopyMemoryBarrier.image = image;
+  postCopyMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                       nullptr, 0, nullptr, 1, &postCopyMemoryBarrier);
+
+  VkImageView imageView;
+  VkImageViewCreateInfo vkImageViewCreateInfo = {};
+  vkImageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  vkImageViewCreateInfo.image = image;
+  vkImageViewCreateInfo.viewType = imageInfo.vkImageViewType;
+  vkImageViewCreateInfo.format = texture->format;
+  vkImageViewCreateInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,
+                                      VK_COMPONENT_SWIZZLE_A};
+  vkImageViewCreateInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  checkResult(vkCreateImageView(mg::vkContext.device, &vkImageViewCreateInfo, nullptr, &imageView));
+
+  texture->image = image;
+  texture->imageView = imageView;
+  texture->heapAllocation = heapAllocation;
+  return true;
+}
+
+VkDeviceSize TextureContainer::defragment(VkDeviceSize budgetInBytes) {
+  _frameIndex++;
+  // the copy is submitted with the current frame, the old images are destroyed when every frame in flight that could
+  // sample them is done
+  destroyRetiredTextures(false);
+
+  VkDeviceSize movedSizeInBytes = 0;
+  for (uint32_t i = 0; i < uint32_t(_idToTexture.size()); i++) {
+    auto &texture = _idToTexture[i];
+    // attachments and storage images are owned by the render passes and are recreated on resize
+    if (!_isAlive[i] || _isEvicted[i] ||
+        !(texture.type == TEXTURE_TYPE::TEXTURE_1D || texture.type == TEXTURE_TYPE::TEXTURE_2D ||
+          texture.type == TEXTURE_TYPE::TEXTURE_3D))
+      continue;
+    if (!mgSystem.textureDeviceMemoryAllocator.isInDefragmentationHeap(texture.heapAllocation))
+      continue;
+    if (movedSizeInBytes + texture.heapAllocation.size > budgetInBytes && movedSizeInBytes > 0)
+      break;
+
+    const auto oldTexture = texture;
+    if (!moveTexture(&texture))
+      break;
+    retireTexture(oldTexture);
+    setDescriptor(i);
+    movedSizeInBytes += texture.heapAllocation.size;
+  }
+  return movedSizeInBytes;
+}
+
+// evicted textures are loaded again from host memory, so only textures with their data uploaded at creation qualify
+static bool isEvictable(const _TextureData &texture) {
+  return texture.type == TEXTURE_TYPE::TEXTURE_2D || texture.type == TEXTURE_TYPE::TEXTURE_3D;
+}
+
+// records copies of the textures to a host visible buffer with the staging commands of the current frame, the textures
+// are left in the transfer source layout
+static void recordTextureReadback(const std::vector<const _TextureData *> &textures, VkBuffer *buffer,
+                                  VkDeviceMemory *deviceMemory, std::vector<VkDeviceSize> *offsets) {
+  VkDeviceSize sizeInBytes = 0;
+  for (const auto *texture : textures) {
+    // for VkBufferImageCopy, bufferOffset must be a multiple of 4
+    sizeInBytes = mg::alignUpPowerOfTwo(sizeInBytes, VkDeviceSize(16));
+    offsets->push_back(sizeInBytes);
+    sizeInBytes += texture->sizeInBytes;
+  }
+
+  VkBufferCreateInfo vkBufferCreateInfo = {};
+  vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  vkBufferCreateInfo.size = sizeInBytes;
+  vkBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  vkBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  checkResult(vkCreateBuffer(mg::vkContext.device, &vkBufferCreateInfo, nullptr, buffer));
+
+  VkMemoryRequirements vkMemoryRequirements;
+  vkGetBufferMemoryRequirements(mg::vkContext.device, *buffer, &vkMemoryRequirements);
+  VkMemoryAllocateInfo vkMemoryAllocateInfo = {};
+  vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  vkMemoryAllocateInfo.allocationSize = vkMemoryRequirements.size;
+  vkMemoryAllocateInfo.memoryTypeIndex = findMemoryTypeIndex(
+      mg::vkContext.physicalDeviceMemoryProperties, vkMemoryRequirements.memoryTypeBits,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  checkResult(vkAllocateMemory(mg::vkContext.device, &vkMemoryAllocateInfo, nullptr, deviceMemory));
+  checkResult(vkBindBufferMemory(mg::vkContext.device, *buffer, *deviceMemory, 0));
+
+  VkCommandBuffer commandBuffer = mg::mgSystem.linearHeapAllocator.getStagingCommandBuffer();
+  for (uint32_t i = 0; i < uint32_t(textures.size()); i++) {
+    const auto &texture = *textures[i];
+
+    VkImageMemoryBarrier preCopyMemoryBarrier = {};
+    preCopyMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    preCopyMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    preCopyMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    preCopyMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    preCopyMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    preCopyMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    preCopyMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    preCopyMemoryBarrier.image = texture.image;
+    preCopyMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                         nullptr, 0, nullptr, 1, &preCopyMemoryBarrier);
+
+    VkBufferImageCopy vkBufferImageCopy = {};
+    vkBufferImageCopy.bufferOffset = (*offsets)[i];
+    vkBufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    vkBufferImageCopy.imageSubresource.mipLevel = 0;
+    vkBufferImageCopy.imageSubresource.layerCount = 1;
+    vkBufferImageCopy.imageExtent = texture.extent;
+    vkCmdCopyImageToBuffer(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *buffer, 1,
+                           &vkBufferImageCopy);
+  }
+
+  // the host reads the buffer after the fence of the frame is signaled
+  VkBufferMemoryBarrier hostReadBarrier = {};
+  hostReadBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  hostReadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  hostReadBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  hostReadBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  hostReadBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  hostReadBarrier.buffer = *buffer;
+  hostReadBarrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1,
+                       &hostReadBarrier, 0, nullptr);
+}
+
+// the readbacks recorded by frames that are done are copied to the evicted data of the textures
+void TextureContainer::collectReadbacks(bool force) {
+  uint32_t nrOfReadbacks = 0;
+  for (auto &readback : _readbacks) {
+    if (!force && _frameIndex - readback.frameIndex < mg::vkContext.commandBuffers.nrOfBuffers) {
+      _readbacks[nrOfReadbacks++] = std::move(readback);
+      continue;
+    }
+    char *mappedMemory;
+    checkResult(vkMapMemory(mg::vkContext.device, readback.deviceMemory, 0, VK_WHOLE_SIZE, 0, (void **)&mappedMemory));
+    for (uint32_t i = 0; i < uint32_t(readback.textureIds.size()); i++) {
+      const auto textureId = readback.textureIds[i];
+      // the texture can have been removed while it was read back
+      if (!_isAlive[textureId.index] || _generations[textureId.index] != textureId.generation)
+        continue;
+      const auto *data = mappedMemory + readback.offsets[i];
+      _evictedData[textureId.index].assign(data, data + readback.sizesInBytes[i]);
+    }
+    vkUnmapMemory(mg::vkContext.device, readback.deviceMemory);
+    vkDestroyBuffer(mg::vkContext.device, readback.buffer, nullptr);
+    vkFreeMemory(mg::vkContext.device, readback.deviceMemory, nullptr);
+  }
+  _readbacks.resize(nrOfReadbacks);
+}
+
+void TextureContainer::markAsUsed(uint32_t index) {
+  _lastUsedFrameIndices[index] = _frameIndex;
+  // reserved textures and textures still being read back have no data to load
+  if (_isEvicted[index] && !_evictedData[index].empty())
+    _isReloadRequested[index] = true;
+}
+
+TextureId TextureContainer::getPlaceholder(TEXTURE_TYPE type) {
+  auto &placeholder = type == TEXTURE_TYPE::TEXTURE_3D ? _placeholder3D : _placeholder2D;
+  if (placeholder.index == UINT32_MAX) {
+    const uint32_t empty = 0;
+    CreateTextureInfo createTextureInfo = {};
+    createTextureInfo.id = "placeholder";
+    createTextureInfo.type = type;
+    createTextureInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    createTextureInfo.size = {1, 1, 1};
+    createTextureInfo.sizeInBytes = sizeof(empty);
+    createTextureInfo.data = (void *)&empty;
+    placeholder = createTexture(createTextureInfo);
+  }
+  return placeholder;
+}
+
+VkDeviceSize TextureContainer::evictTextures(const MemoryBudget &memoryBudget, VkDeviceSize budgetInBytes) {
+  // textures used by the last frames would be requested again right away
+  constexpr uint32_t minNrOfUnusedFrames = 120;
+  // the memory of the last evicted textures is released when their readback is done, the budget is not updated before
+  if (_readbacks.size())
+    return 0;
+
+  std::vector<uint32_t> candidates;
+  for (uint32_t i = 0; i < uint32_t(_idToTexture.size()); i++) {
+    if (!_isAlive[i] || _isEvicted[i] || !isEvictable(_idToTexture[i]))
+      continue;
+    if (i == _placeholder2D.index || i == _placeholder3D.index)
+      continue;
+    if (_frameIndex - _lastUsedFrameIndices[i] < minNrOfUnusedFrames)
+      continue;
+    if (memoryBudget.getPressure(_idToTexture[i].heapAllocation.memoryTypeIndex) != MemoryPressure::High)
+      continue;
+    candidates.push_back(i);
+  }
+  if (candidates.empty())
+    return 0;
+
+  // least recently used first
+  std::sort(std::begin(candidates), std::end(candidates),
+            [this](uint32_t a, uint32_t b) { return _lastUsedFrameIndices[a] < _lastUsedFrameIndices[b]; });
+
+  const auto memoryTypeIndex = _idToTexture[candidates.front()].heapAllocation.memoryTypeIndex;
+  const auto sizeToEvict = std::min(budgetInBytes, memoryBudget.getSizeAboveMediumPressure(memoryTypeIndex));
+  VkDeviceSize evictedSizeInBytes = 0;
+  uint32_t nrOfEvictedTextures = 0;
+  for (; nrOfEvictedTextures < uint32_t(candidates.size()) && evictedSizeInBytes < sizeToEvict;
+       nrOfEvictedTextures++) {
+    evictedSizeInBytes += _idToTexture[candidates[nrOfEvictedTextures]].heapAllocation.size;
+  }
+
+  // the placeholders are created first, creating a texture can move the texture data
+  for (uint32_t i = 0; i < nrOfEvictedTextures; i++) {
+    getPlaceholder(_idToTexture[candidates[i]].type);
+  }
+  std::vector<const _TextureData *> evictedTextures;
+  for (uint32_t i = 0; i < nrOfEvictedTextures; i++) {
+    evictedTextures.push_back(&_idToTexture[candidates[i]]);
+  }
+  TextureReadback readback = {};
+  recordTextureReadback(evictedTextures, &readback.buffer, &readback.deviceMemory, &readback.offsets);
+  readback.frameIndex = _frameIndex;
+
+  // the placeholder is used from this frame, the images are destroyed when the readback is done. The texture is not
+  // loaded again before its data has been collected
+  for (uint32_t i = 0; i < nrOfEvictedTextures; i++) {
+    const auto index = candidates[i];
+    auto &texture = _idToTexture[index];
+    readback.textureIds.push_back({index, _generations[index]});
+    readback.sizesInBytes.push_back(texture.sizeInBytes);
+    retireTexture(texture);
+    releaseDescriptor(index);
+    texture.image = VK_NULL_HANDLE;
+    texture.imageView = VK_NULL_HANDLE;
+    texture.heapAllocation = {};
+    _isEvicted[index] = true;
+    _isReloadRequested[index] = false;
+  }
+  _readbacks.push_back(std::move(readback));
+  LOG("evicted " << nrOfEvictedTextures << " textures, " << evictedSizeInBytes << " bytes");
+  return evictedSizeInBytes;
+}
+
+VkDeviceSize TextureContainer::reloadTextures(VkDeviceSize budgetInBytes) {
+  VkDeviceSize reloadedSizeInBytes = 0;
+  for (uint32_t i = 0; i < uint32_t(_idToTexture.size()) && reloadedSizeInBytes < budgetInBytes; i++) {
+    if (!_isAlive[i] || !_isReloadRequested[i])
+      continue;
+    auto &texture = _idToTexture[i];
+
+    CreateTextureInfo createTextureInfo = {};
+    createTextureInfo.type = texture.type;
+    createTextureInfo.format = texture.format;
+    createTextureInfo.size = texture.extent;
+    createTextureInfo.sizeInBytes = texture.sizeInBytes;
+    createTextureInfo.data = _evictedData[i].data();
+    texture = createTextureData(createTextureInfo);
+
+    _isEvicted[i] = false;
+    _isReloadRequested[i] = false;
+    _evictedData[i] = {};
+    setDescriptor(i);
+    reloadedSizeInBytes += texture.heapAllocation.size;
+  }
+  return reloadedSizeInBytes;
+}
+
+VkDeviceSize TextureContainer::updateResidency(const MemoryBudget &memoryBudget, VkDeviceSize budgetInBytes) {
+  collectReadbacks(false);
+  if (memoryBudget.getDeviceLocalPressure() == MemoryPressure::High)
+    return evictTextures(memoryBudget, budgetInBytes);
+  return reloadTextures(budgetInBytes);
+}
+
+VkDescriptorSet TextureContainer::getDescriptorSet() {
+  return _descriptorSets[mg::vkContext.commandBuffers.currentIndex];
+}
+VkDescriptorSet TextureContainer::getDescriptorSet3D() {
+  return _descriptorSets3D[mg::vkContext.commandBuffers.currentIndex];
+}
 
 } // namespace mg
\ No newline at end of file
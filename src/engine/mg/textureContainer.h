@@ -1,7 +1,9 @@
 #pragma once
 #include "mg/mgUtils.h"
 #include "vulkan/deviceAllocator.h"
+#include "vulkan/memoryBudget.h"
 #include "vulkan/vkContext.h"
+#include <bitset>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -20,7 +22,9 @@ struct _TextureData {
   VkImageView imageView;
   mg::DeviceHeapAllocation heapAllocation;
   VkFormat format;
+  VkExtent3D extent;
   TEXTURE_TYPE type;
+  uint32_t sizeInBytes;
 };
 
 struct CreateTextureInfo {
@@ -42,33 +46,98 @@ class TextureContainer : mg::nonCopyable {
 public:
   void createTextureContainer();
   TextureId createTexture(const CreateTextureInfo &textureInfo);
+  // a reserved texture is the empty placeholder until it is created, like an evicted texture. Used for textures that
+  // are streamed, the descriptor of the created texture is written when the next frame begins
+  TextureId reserveTexture(TEXTURE_TYPE type);
+  void createReservedTexture(TextureId textureId, const CreateTextureInfo &textureInfo);
   uint32_t getTexture2DDescriptorIndex(TextureId textureId);
   uint32_t getTexture3DDescriptorIndex(TextureId textureId);
 
 
   Texture getTexture(TextureId textureId);
+  // the image is destroyed when the frames in flight that could sample it are done
   void removeTexture(TextureId textureId);
 
+  // the descriptor sets of the current frame
   VkDescriptorSet getDescriptorSet(); 
   VkDescriptorSet getDescriptorSet3D(); 
 
+  // writes the descriptors of every frame, waits for the device to be idle. Used when a scene is created or resized
   void setupDescriptorSets();
+  // writes the changed descriptors to the descriptor sets of the current frame, called once per frame by
+  // beginRendering after the fence of the frame has been waited on
+  void updateDescriptorSets();
+
+  // moves sampled textures out of the heap being defragmented, returns the number of bytes copied
+  VkDeviceSize defragment(VkDeviceSize budgetInBytes);
+  bool hasRetiredTextures() const { return _retiredTextures.size() > 0; }
+
+  // called once per frame. Under high memory pressure the least recently used 2D and 3D textures are copied to host
+  // memory and released, an evicted texture is replaced by an empty placeholder until it is loaded again. Textures
+  // are loaded again when they have been used and the pressure is down. Returns the number of bytes moved
+  VkDeviceSize updateResidency(const MemoryBudget &memoryBudget, VkDeviceSize budgetInBytes);
 
   void destroyTextureContainer();
 
   ~TextureContainer();
 
 private:
-  VkDescriptorSet _descriptorSet;
-  VkDescriptorSet _descriptorSet3D;
+  void markAsUsed(uint32_t index);
+  TextureId getPlaceholder(TEXTURE_TYPE type);
+  uint32_t allocateIndex();
+  VkDeviceSize evictTextures(const MemoryBudget &memoryBudget, VkDeviceSize budgetInBytes);
+  VkDeviceSize reloadTextures(VkDeviceSize budgetInBytes);
+  void setDescriptor(uint32_t index);
+  void releaseDescriptor(uint32_t index);
+  void writeDescriptorSets(uint32_t frameIndex);
+  void retireTexture(const _TextureData &texture);
+  void destroyRetiredTextures(bool force);
+  void collectReadbacks(bool force);
+
+  // one copy of the descriptor sets per frame in flight, a copy is only written when the frame using it is done
+  VkDescriptorSet _descriptorSets[MAX_NR_OF_FRAMES_IN_FLIGHT];
+  VkDescriptorSet _descriptorSets3D[MAX_NR_OF_FRAMES_IN_FLIGHT];
   
   std::vector<_TextureData> _idToTexture;
   std::vector<uint32_t> _freeIndices;
   std::vector<uint32_t> _generations;
   std::vector<bool> _isAlive;
+  // a 2D descriptor index is kept until the texture is removed or evicted, UINT32_MAX when there is none
   std::vector<uint32_t> _idToDescriptorIndex2D;
   std::vector<uint32_t> _idToDescriptorIndex3D;
-
+  std::vector<VkImageView> _descriptorImageViews2D;
+  std::vector<uint32_t> _freeDescriptorIndices2D;
+  // descriptors written since a copy of the descriptor sets was last updated
+  std::bitset<MAX_NR_OF_2D_TEXTURES> _changedDescriptorIndices2D[MAX_NR_OF_FRAMES_IN_FLIGHT];
+  bool _hasChangedDescriptors3D[MAX_NR_OF_FRAMES_IN_FLIGHT] = {};
+
+  // moved and removed textures, destroyed when the frames that could reference them have finished
+  struct RetiredTexture {
+    VkImage image;
+    VkImageView imageView;
+    mg::DeviceHeapAllocation heapAllocation;
+    uint32_t frameIndex;
+  };
+  std::vector<RetiredTexture> _retiredTextures;
+
+  // residency
+  uint32_t _frameIndex = 0;
+  std::vector<uint32_t> _lastUsedFrameIndices;
+  std::vector<bool> _isEvicted;
+  std::vector<bool> _isReloadRequested;
+  std::vector<std::vector<char>> _evictedData;
+  // copies of evicted textures to host memory, collected when the frame that recorded them is done
+  struct TextureReadback {
+    VkBuffer buffer;
+    VkDeviceMemory deviceMemory;
+    std::vector<TextureId> textureIds;
+    std::vector<VkDeviceSize> offsets;
+    std::vector<uint32_t> sizesInBytes;
+    uint32_t frameIndex;
+  };
+  std::vector<TextureReadback> _readbacks;
+  TextureId _placeholder2D = {UINT32_MAX, 0};
+  TextureId _placeholder3D = {UINT32_MAX, 0};
 
 };
 
@@ -30,7 +30,7 @@ static uint64_t getCurrentTimeUs() {
   return std::chrono::duration_cast<std::chrono::microseconds>(nanosec).count();
 }
 
-void initWindow(uint32_t width, uint32_t height) {
+void initWindow(uint32_t width, uint32_t height, uint32_t nrOfFramesInFlight) {
   mgAssertDesc(glfwInit(), "could not init glfw");
   glfwSetErrorCallback(glfwErrorCallback);
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -43,7 +43,7 @@ void initWindow(uint32_t width, uint32_t height) {
   int32_t w, h;
   glfwGetWindowSize(window, &w, &h);
   LOG("initializing Vulkan");
-  initVulkan(window);
+  initVulkan(window, nrOfFramesInFlight);
   prevXY = cursorPosition(width, height);
 
   mg::createMgSystem(&mgSystem);
@@ -102,6 +102,7 @@ FrameData getFrameData() {
   frameData.keys.r = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
   frameData.keys.n = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS;
   frameData.keys.m = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+  frameData.keys.f = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
 
   frameData.keys.w = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
   frameData.keys.a = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
@@ -14,7 +14,7 @@ struct FrameData {
     bool left, middle, right;
   } mouse;
   struct {
-    bool r, n, m, w, a, s, d;
+    bool r, n, m, f, w, a, s, d;
     bool left, right, up, space;
   } keys;
   mg::Tool tool;
@@ -22,7 +22,8 @@ struct FrameData {
   uint32_t fps;
 };
 
-void initWindow(uint32_t width, uint32_t height);
+// nrOfFramesInFlight is the number of frames the cpu can record ahead of the gpu, 2 to 4
+void initWindow(uint32_t width, uint32_t height, uint32_t nrOfFramesInFlight = 2);
 void destroyWindow();
 
 bool startFrame();
@@ -7,9 +7,15 @@
 
 namespace mg {
 
+static mg::PipelineHandle solidPipelineHandle;
+
 static mg::Pipeline createSolidRendering(const mg::RenderContext &renderContext) {
   using namespace mg::shaders::solid;
 
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (pipelineContainer.isValid(solidPipelineHandle, renderContext.renderPass, renderContext.subpass))
+    return pipelineContainer.getPipeline(solidPipelineHandle);
+
   mg::PipelineStateDesc pipelineStateDesc = {};
   pipelineStateDesc.rasterization.vkRenderPass = renderContext.renderPass;
   pipelineStateDesc.rasterization.vkPipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayout;
@@ -22,8 +28,8 @@ static mg::Pipeline createSolidRendering(const mg::RenderContext &renderContext)
   createPipelineInfo.vertexInputState = InputAssembler::vertexInputState;
   createPipelineInfo.vertexInputStateCount = mg::countof(InputAssembler::vertexInputState);
 
-  const auto pipeline = mg::mgSystem.pipelineContainer.createPipeline(pipelineStateDesc, createPipelineInfo);
-  return pipeline;
+  solidPipelineHandle = pipelineContainer.registerPipeline(pipelineStateDesc, createPipelineInfo);
+  return pipelineContainer.getPipeline(solidPipelineHandle);
 }
 
 void renderSolidBoxes(const mg::RenderContext &renderContext, const float *xPositions, const float *yPositions,
@@ -73,22 +79,29 @@ void renderSolidBoxes(const mg::RenderContext &renderContext, const float *xPosi
   memcpy(vertices, vertexInputData, sizeof(vertexInputData));
 
   DescriptorSets descriptorSets = {};
-  descriptorSets.ubo = uboSet;
+  // the set from the last allocation covers both the uniform and the storage binding
+  descriptorSets.ubo = storageSet;
 
   uint32_t offsets[] = {uniformOffset, storageOffset};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, solidPipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(offsets), offsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(solidPipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(offsets), offsets);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, solidPipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(solidPipeline);
 
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &vertexBuffer, &vertexBufferOffset);
-  vkCmdBindIndexBuffer(mg::vkContext.commandBuffer, indexBuffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &vertexBuffer, &vertexBufferOffset);
+  mg::mgSystem.commandRecorder.bindIndexBuffer(indexBuffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
   vkCmdDrawIndexed(mg::vkContext.commandBuffer, mg::countof(indicesInputData), count, 0, 0, 0);
 } 
 
+static mg::PipelineHandle texturePipelineHandle;
+
 static mg::Pipeline createTextureRenderingPipeline(const mg::RenderContext &renderContext) {
   using namespace mg::shaders::textureRendering;
 
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (pipelineContainer.isValid(texturePipelineHandle, renderContext.renderPass, renderContext.subpass))
+    return pipelineContainer.getPipeline(texturePipelineHandle);
+
   mg::PipelineStateDesc pipelineStateDesc = {};
   pipelineStateDesc.rasterization.vkRenderPass = renderContext.renderPass;
   pipelineStateDesc.rasterization.vkPipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayout;
@@ -100,8 +113,8 @@ static mg::Pipeline createTextureRenderingPipeline(const mg::RenderContext &rend
   createPipelineInfo.vertexInputState = InputAssembler::vertexInputState;
   createPipelineInfo.vertexInputStateCount = mg::countof(InputAssembler::vertexInputState);
 
-  const auto pipeline = mg::mgSystem.pipelineContainer.createPipeline(pipelineStateDesc, createPipelineInfo);
-  return pipeline;
+  texturePipelineHandle = pipelineContainer.registerPipeline(pipelineStateDesc, createPipelineInfo);
+  return pipelineContainer.getPipeline(texturePipelineHandle);
 }
 
 void renderBoxWithTexture(mg::RenderContext &renderContext, const glm::vec4 &position, TextureId textureId) {
@@ -146,19 +159,24 @@ void renderBoxWithTexture(mg::RenderContext &renderContext, const glm::vec4 &pos
   memcpy(indices, indicesInputData, sizeof(indicesInputData));
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, texturePipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, texturePipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(texturePipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(texturePipeline);
 
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &vertexBuffer, &vertexBufferOffset);
-  vkCmdBindIndexBuffer(mg::vkContext.commandBuffer, indexBuffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &vertexBuffer, &vertexBufferOffset);
+  mg::mgSystem.commandRecorder.bindIndexBuffer(indexBuffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
   vkCmdDrawIndexed(mg::vkContext.commandBuffer, mg::countof(indicesInputData), 1, 0, 0, 0);
 }
 
+static mg::PipelineHandle depthTexturePipelineHandle;
+
 static mg::Pipeline createDepthTextureRenderingPipeline(const mg::RenderContext &renderContext) {
   using namespace mg::shaders::depth;
 
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (pipelineContainer.isValid(depthTexturePipelineHandle, renderContext.renderPass, renderContext.subpass))
+    return pipelineContainer.getPipeline(depthTexturePipelineHandle);
+
   mg::PipelineStateDesc pipelineStateDesc = {};
   pipelineStateDesc.rasterization.vkRenderPass = renderContext.renderPass;
   pipelineStateDesc.rasterization.vkPipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayout;
@@ -170,8 +188,8 @@ static mg::Pipeline createDepthTextureRenderingPipeline(const mg::RenderContext
   createPipelineInfo.vertexInputState = InputAssembler::vertexInputState;
   createPipelineInfo.vertexInputStateCount = mg::countof(InputAssembler::vertexInputState);
 
-  const auto pipeline = mg::mgSystem.pipelineContainer.createPipeline(pipelineStateDesc, createPipelineInfo);
-  return pipeline;
+  depthTexturePipelineHandle = pipelineContainer.registerPipeline(pipelineStateDesc, createPipelineInfo);
+  return pipelineContainer.getPipeline(depthTexturePipelineHandle);
 }
 
 void renderBoxWithDepthTexture(mg::RenderContext &renderContext, const glm::vec4 &position, TextureId textureId) {
@@ -217,19 +235,24 @@ void renderBoxWithDepthTexture(mg::RenderContext &renderContext, const glm::vec4
   memcpy(indices, indicesInputData, sizeof(indicesInputData));
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, texturePipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, texturePipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(texturePipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(texturePipeline);
 
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &vertexBuffer, &vertexBufferOffset);
-  vkCmdBindIndexBuffer(mg::vkContext.commandBuffer, indexBuffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &vertexBuffer, &vertexBufferOffset);
+  mg::mgSystem.commandRecorder.bindIndexBuffer(indexBuffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
   vkCmdDrawIndexed(mg::vkContext.commandBuffer, mg::countof(indicesInputData), 1, 0, 0, 0);
 }
 
-void renderMeshWithNormals(const mg::RenderContext &renderContext, mg::MeshId id, glm::mat4 model, glm::vec4 color) {
+static mg::PipelineHandle meshWithNormalsPipelineHandle;
+
+static mg::Pipeline createMeshWithNormalsPipeline(const mg::RenderContext &renderContext) {
   using namespace mg::shaders::meshNormals;
 
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (pipelineContainer.isValid(meshWithNormalsPipelineHandle, renderContext.renderPass, renderContext.subpass))
+    return pipelineContainer.getPipeline(meshWithNormalsPipelineHandle);
+
   mg::PipelineStateDesc pipelineStateDesc = {};
   pipelineStateDesc.rasterization.vkRenderPass = renderContext.renderPass;
   pipelineStateDesc.rasterization.vkPipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayout;
@@ -240,7 +263,13 @@ void renderMeshWithNormals(const mg::RenderContext &renderContext, mg::MeshId id
   createPipelineInfo.vertexInputState = InputAssembler::vertexInputState;
   createPipelineInfo.vertexInputStateCount = mg::countof(InputAssembler::vertexInputState);
 
-  const auto pipeline = mg::mgSystem.pipelineContainer.createPipeline(pipelineStateDesc, createPipelineInfo);
+  meshWithNormalsPipelineHandle = pipelineContainer.registerPipeline(pipelineStateDesc, createPipelineInfo);
+  return pipelineContainer.getPipeline(meshWithNormalsPipelineHandle);
+}
+
+void renderMeshWithNormals(const mg::RenderContext &renderContext, mg::MeshId id, glm::mat4 model, glm::vec4 color) {
+  const auto pipeline = createMeshWithNormalsPipeline(renderContext);
+  using namespace mg::shaders::meshNormals;
 
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
@@ -254,22 +283,27 @@ void renderMeshWithNormals(const mg::RenderContext &renderContext, mg::MeshId id
   DescriptorSets descriptorSets = {.ubo = uboSet};
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(pipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   const auto mesh = mg::getMesh(id);
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(pipeline);
 
   VkDeviceSize offset = 0;
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &mesh.buffer, &offset);
-  vkCmdBindIndexBuffer(mg::vkContext.commandBuffer, mesh.buffer, mesh.indicesOffset, VK_INDEX_TYPE_UINT32);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &mesh.buffer, &offset);
+  mg::mgSystem.commandRecorder.bindIndexBuffer(mesh.buffer, mesh.indicesOffset, VK_INDEX_TYPE_UINT32);
   vkCmdDrawIndexed(mg::vkContext.commandBuffer, mesh.indexCount, 1, 0, 0, 0);
 }
 
-void renderMesh(const mg::RenderContext &renderContext, mg::MeshId id, glm::mat4 model, glm::vec4 color) {
+static mg::PipelineHandle meshPipelineHandle;
+
+static mg::Pipeline createMeshPipeline(const mg::RenderContext &renderContext) {
   using namespace mg::shaders::solidColor;
 
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (pipelineContainer.isValid(meshPipelineHandle, renderContext.renderPass, renderContext.subpass))
+    return pipelineContainer.getPipeline(meshPipelineHandle);
+
   mg::PipelineStateDesc pipelineStateDesc = {};
   pipelineStateDesc.rasterization.vkRenderPass = renderContext.renderPass;
   pipelineStateDesc.rasterization.vkPipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayout;
@@ -280,7 +314,13 @@ void renderMesh(const mg::RenderContext &renderContext, mg::MeshId id, glm::mat4
   createPipelineInfo.vertexInputState = InputAssembler::vertexInputState;
   createPipelineInfo.vertexInputStateCount = mg::countof(InputAssembler::vertexInputState);
 
-  const auto pipeline = mg::mgSystem.pipelineContainer.createPipeline(pipelineStateDesc, createPipelineInfo);
+  meshPipelineHandle = pipelineContainer.registerPipeline(pipelineStateDesc, createPipelineInfo);
+  return pipelineContainer.getPipeline(meshPipelineHandle);
+}
+
+void renderMesh(const mg::RenderContext &renderContext, mg::MeshId id, glm::mat4 model, glm::vec4 color) {
+  const auto pipeline = createMeshPipeline(renderContext);
+  using namespace mg::shaders::solidColor;
 
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
@@ -294,22 +334,27 @@ void renderMesh(const mg::RenderContext &renderContext, mg::MeshId id, glm::mat4
   DescriptorSets descriptorSets = {.ubo = uboSet};
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(pipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   const auto mesh = mg::getMesh(id);
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(pipeline);
 
   VkDeviceSize offset = 0;
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &mesh.buffer, &offset);
-  vkCmdBindIndexBuffer(mg::vkContext.commandBuffer, mesh.buffer, mesh.indicesOffset, VK_INDEX_TYPE_UINT32);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &mesh.buffer, &offset);
+  mg::mgSystem.commandRecorder.bindIndexBuffer(mesh.buffer, mesh.indicesOffset, VK_INDEX_TYPE_UINT32);
   vkCmdDrawIndexed(mg::vkContext.commandBuffer, mesh.indexCount, 1, 0, 0, 0);
 }
 
-void renderFluid(const mg::RenderContext &renderContext, mg::StorageId density) {
+static mg::PipelineHandle fluidPipelineHandle;
+
+static mg::Pipeline createFluidPipeline(const mg::RenderContext &renderContext) {
   using namespace mg::shaders::fluid;
 
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (pipelineContainer.isValid(fluidPipelineHandle, renderContext.renderPass, renderContext.subpass))
+    return pipelineContainer.getPipeline(fluidPipelineHandle);
+
   mg::PipelineStateDesc pipelineStateDesc = {};
   pipelineStateDesc.rasterization.vkRenderPass = renderContext.renderPass;
   pipelineStateDesc.rasterization.vkPipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
@@ -317,7 +362,14 @@ void renderFluid(const mg::RenderContext &renderContext, mg::StorageId density)
 
   mg::CreatePipelineInfo createPipelineInfo = {};
   createPipelineInfo.shaderName = shader;
-  const auto pipeline = mg::mgSystem.pipelineContainer.createPipeline(pipelineStateDesc, createPipelineInfo);
+  fluidPipelineHandle = pipelineContainer.registerPipeline(pipelineStateDesc, createPipelineInfo);
+  return pipelineContainer.getPipeline(fluidPipelineHandle);
+}
+
+void renderFluid(const mg::RenderContext &renderContext, mg::StorageId density) {
+  const auto pipeline = createFluidPipeline(renderContext);
+  using namespace mg::shaders::fluid;
+
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
   VkDescriptorSet uboSet;
@@ -331,11 +383,10 @@ void renderFluid(const mg::RenderContext &renderContext, mg::StorageId density)
   descriptorSets.d = mg::mgSystem.storageContainer.getStorage(density).descriptorSet;
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(pipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(pipeline);
   vkCmdDraw(mg::vkContext.commandBuffer, 3, 1, 0, 0);
 }
 
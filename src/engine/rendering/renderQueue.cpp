@@ -0,0 +1,241 @@
+#include "renderQueue.h"
+#include "mg/mgAssert.h"
+#include "mg/mgSystem.h"
+#include <algorithm>
+#include <cstring>
+
+namespace mg {
+
+// sort key layout from the most significant bit, the fields are clamped so that a frame with more pipelines, descriptor
+// sets or meshes is still recorded correctly, only sorted less well
+enum : uint32_t {
+  PASS_BITS = 8,
+  PIPELINE_BITS = 12,
+  DESCRIPTOR_SETS_BITS = 12,
+  MESH_BITS = 16,
+  DEPTH_BITS = 16,
+};
+enum : uint32_t {
+  DEPTH_SHIFT = 0,
+  MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS,
+  DESCRIPTOR_SETS_SHIFT = MESH_SHIFT + MESH_BITS,
+  PIPELINE_SHIFT = DESCRIPTOR_SETS_SHIFT + DESCRIPTOR_SETS_BITS,
+  PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS,
+};
+static_assert(PASS_SHIFT + PASS_BITS == 64, "the sort key fields must fill 64 bits");
+
+static uint64_t toKeyField(uint32_t value, uint32_t bits, uint32_t shift) {
+  const uint32_t maxValue = (1u << bits) - 1;
+  return uint64_t(std::min(value, maxValue)) << shift;
+}
+
+uint32_t RenderQueue::getPassIndex(const RenderContext &renderContext) {
+  // the two lowest bits are the subpass
+  mgAssert(renderContext.subpass < 4);
+  auto it = std::find(_renderPasses.begin(), _renderPasses.end(), renderContext.renderPass);
+  if (it == _renderPasses.end())
+    it = _renderPasses.insert(_renderPasses.end(), renderContext.renderPass);
+  return uint32_t(it - _renderPasses.begin()) << 2 | renderContext.subpass;
+}
+
+uint32_t RenderQueue::getPipelineIndex(const Pipeline &pipeline) {
+  for (uint32_t i = 0; i < _pipelines.size(); i++) {
+    if (isSamePipeline(_pipelines[i], pipeline))
+      return i;
+  }
+  _pipelines.push_back(pipeline);
+  return uint32_t(_pipelines.size() - 1);
+}
+
+uint32_t RenderQueue::getDescriptorSetsIndex(const DrawCommand &drawCommand) {
+  mgAssert(drawCommand.descriptorSetCount <= mg::countof(drawCommand.descriptorSets));
+  mgAssert(drawCommand.dynamicOffsetCount <= mg::countof(drawCommand.dynamicOffsets));
+  _DescriptorSets descriptorSets = {};
+  descriptorSets.layout = drawCommand.pipeline.layout;
+  descriptorSets.count = drawCommand.descriptorSetCount;
+  descriptorSets.dynamicOffsetCount = drawCommand.dynamicOffsetCount;
+  std::copy(drawCommand.descriptorSets, drawCommand.descriptorSets + drawCommand.descriptorSetCount,
+            descriptorSets.values);
+  std::copy(drawCommand.dynamicOffsets, drawCommand.dynamicOffsets + drawCommand.dynamicOffsetCount,
+            descriptorSets.dynamicOffsets);
+
+  // draws are usually submitted with the descriptor sets of the previous draw, so only the last entry is reused
+  if (!_descriptorSets.empty() && memcmp(&_descriptorSets.back(), &descriptorSets, sizeof(descriptorSets)) == 0)
+    return uint32_t(_descriptorSets.size() - 1);
+  _descriptorSets.push_back(descriptorSets);
+  return uint32_t(_descriptorSets.size() - 1);
+}
+
+uint32_t RenderQueue::getMeshIndex(VkBuffer vertexBuffer) {
+  const auto it = _meshIndices.find(vertexBuffer);
+  if (it != _meshIndices.end())
+    return it->second;
+  const auto index = uint32_t(_meshIndices.size());
+  _meshIndices[vertexBuffer] = index;
+  return index;
+}
+
+void RenderQueue::submit(const RenderContext &renderContext, const DrawCommand &drawCommand) {
+  mgAssert(drawCommand.depth >= 0.0f && drawCommand.depth <= 1.0f);
+
+  _DrawPacket packet = {};
+  packet.pipelineIndex = getPipelineIndex(drawCommand.pipeline);
+  packet.descriptorSetsIndex = getDescriptorSetsIndex(drawCommand);
+  packet.vertexBuffer = drawCommand.vertexBuffer;
+  packet.vertexBufferOffset = drawCommand.vertexBufferOffset;
+  packet.indexBuffer = drawCommand.indexBuffer;
+  packet.indexBufferOffset = drawCommand.indexBufferOffset;
+  packet.count = drawCommand.count;
+  packet.pushConstantOffset = uint32_t(_pushConstants.size());
+  packet.pushConstantSize = drawCommand.pushConstantSize;
+  if (drawCommand.pushConstantSize > 0) {
+    const auto *pushConstants = (const uint8_t *)drawCommand.pushConstants;
+    _pushConstants.insert(_pushConstants.end(), pushConstants, pushConstants + drawCommand.pushConstantSize);
+  }
+
+  const auto depthBucket = uint32_t(drawCommand.depth * float((1u << DEPTH_BITS) - 1));
+  const auto meshIndex = drawCommand.vertexBuffer != VK_NULL_HANDLE ? getMeshIndex(drawCommand.vertexBuffer) : 0;
+  const uint64_t sortKey =
+      toKeyField(getPassIndex(renderContext), PASS_BITS, PASS_SHIFT) |
+      toKeyField(packet.pipelineIndex, PIPELINE_BITS, PIPELINE_SHIFT) |
+      toKeyField(packet.descriptorSetsIndex, DESCRIPTOR_SETS_BITS, DESCRIPTOR_SETS_SHIFT) |
+      toKeyField(meshIndex, MESH_BITS, MESH_SHIFT) | toKeyField(depthBucket, DEPTH_BITS, DEPTH_SHIFT);
+
+  _sortKeys.push_back(sortKey);
+  _sortIndices.push_back(uint32_t(_packets.size()));
+  _packets.push_back(packet);
+}
+
+// least significant digit radix sort on 8 bit digits, digits that are the same for all keys are skipped
+void RenderQueue::sortPackets(const RenderContext &renderContext) {
+  const auto count = _sortKeys.size();
+  _sortKeysScratch.resize(count);
+  _sortIndicesScratch.resize(count);
+
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    uint32_t offsets[256] = {};
+    for (const auto key : _sortKeys) {
+      offsets[(key >> shift) & 0xFF]++;
+    }
+    if (offsets[(_sortKeys[0] >> shift) & 0xFF] == count)
+      continue;
+
+    uint32_t offset = 0;
+    for (auto &digitOffset : offsets) {
+      const auto digitCount = digitOffset;
+      digitOffset = offset;
+      offset += digitCount;
+    }
+    for (size_t i = 0; i < count; i++) {
+      const auto destination = offsets[(_sortKeys[i] >> shift) & 0xFF]++;
+      _sortKeysScratch[destination] = _sortKeys[i];
+      _sortIndicesScratch[destination] = _sortIndices[i];
+    }
+    std::swap(_sortKeys, _sortKeysScratch);
+    std::swap(_sortIndices, _sortIndicesScratch);
+  }
+
+  const uint64_t passField = toKeyField(getPassIndex(renderContext), PASS_BITS, PASS_SHIFT);
+  mgAssertDesc(_sortKeys.front() >> PASS_SHIFT == passField >> PASS_SHIFT &&
+                   _sortKeys.back() >> PASS_SHIFT == passField >> PASS_SHIFT,
+               "all draws in the render queue must belong to the render pass and subpass that is flushed");
+}
+
+uint32_t RenderQueue::recordPackets(VkCommandBuffer commandBuffer, CommandRecorder *commandRecorder, uint32_t begin,
+                                    uint32_t end) const {
+  uint32_t nrOfStateChanges = 0;
+  const _DrawPacket *previous = nullptr;
+  for (uint32_t i = begin; i < end; i++) {
+    const auto &packet = _packets[_sortIndices[i]];
+    const auto &pipeline = _pipelines[packet.pipelineIndex];
+    const auto &descriptorSets = _descriptorSets[packet.descriptorSetsIndex];
+
+    if (previous == nullptr || previous->pipelineIndex != packet.pipelineIndex) {
+      commandRecorder->bindGraphicsPipeline(pipeline);
+      nrOfStateChanges++;
+    }
+    if (previous == nullptr || previous->descriptorSetsIndex != packet.descriptorSetsIndex) {
+      commandRecorder->bindDescriptorSets(descriptorSets.layout, 0, descriptorSets.count, descriptorSets.values,
+                                          descriptorSets.dynamicOffsetCount, descriptorSets.dynamicOffsets);
+      nrOfStateChanges++;
+    }
+    if (packet.vertexBuffer != VK_NULL_HANDLE &&
+        (previous == nullptr || previous->vertexBuffer != packet.vertexBuffer ||
+         previous->vertexBufferOffset != packet.vertexBufferOffset)) {
+      commandRecorder->bindVertexBuffers(0, 1, &packet.vertexBuffer, &packet.vertexBufferOffset);
+      nrOfStateChanges++;
+    }
+    if (packet.indexBuffer != VK_NULL_HANDLE &&
+        (previous == nullptr || previous->indexBuffer != packet.indexBuffer ||
+         previous->indexBufferOffset != packet.indexBufferOffset)) {
+      commandRecorder->bindIndexBuffer(packet.indexBuffer, packet.indexBufferOffset, VK_INDEX_TYPE_UINT32);
+      nrOfStateChanges++;
+    }
+    if (packet.pushConstantSize > 0) {
+      vkCmdPushConstants(commandBuffer, pipeline.layout, VK_SHADER_STAGE_ALL, 0, packet.pushConstantSize,
+                         &_pushConstants[packet.pushConstantOffset]);
+    }
+
+    if (packet.indexBuffer != VK_NULL_HANDLE)
+      vkCmdDrawIndexed(commandBuffer, packet.count, 1, 0, 0, 0);
+    else
+      vkCmdDraw(commandBuffer, packet.count, 1, 0, 0);
+    previous = &packet;
+  }
+  return nrOfStateChanges;
+}
+
+void RenderQueue::flush(const RenderContext &renderContext) {
+  if (_packets.empty())
+    return;
+  sortPackets(renderContext);
+  _stats.nrOfStateChanges += recordPackets(mg::vkContext.commandBuffer, &mg::mgSystem.commandRecorder, 0,
+                                           uint32_t(_sortIndices.size()));
+  _stats.nrOfDrawPackets += uint32_t(_packets.size());
+  clear();
+}
+
+void RenderQueue::flush(const RenderContext &renderContext, uint32_t nrOfCommandBuffers) {
+  if (_packets.empty())
+    return;
+  sortPackets(renderContext);
+
+  // the sorted draws are split in contiguous ranges, so they are executed in sort order. Every command buffer starts
+  // without bound state
+  const auto nrOfPackets = uint32_t(_sortIndices.size());
+  nrOfCommandBuffers = std::min(nrOfCommandBuffers, nrOfPackets);
+  uint32_t nrOfStateChanges[jobs::MaxNrOfWorkerThreads + 1] = {};
+  mg::mgSystem.secondaryCommandBuffers.record(
+      renderContext, nrOfCommandBuffers, [&](VkCommandBuffer commandBuffer, uint32_t index) {
+        const auto begin = uint32_t(uint64_t(nrOfPackets) * index / nrOfCommandBuffers);
+        const auto end = uint32_t(uint64_t(nrOfPackets) * (index + 1) / nrOfCommandBuffers);
+        CommandRecorder commandRecorder;
+        commandRecorder.beginCommandBuffer(commandBuffer);
+        nrOfStateChanges[index] = recordPackets(commandBuffer, &commandRecorder, begin, end);
+        commandRecorder.endCommandBuffer();
+      });
+  for (uint32_t i = 0; i < nrOfCommandBuffers; i++) {
+    _stats.nrOfStateChanges += nrOfStateChanges[i];
+  }
+  _stats.nrOfDrawPackets += nrOfPackets;
+  clear();
+}
+
+void RenderQueue::clear() {
+  _packets.clear();
+  _pipelines.clear();
+  _descriptorSets.clear();
+  _renderPasses.clear();
+  _meshIndices.clear();
+  _pushConstants.clear();
+  _sortKeys.clear();
+  _sortIndices.clear();
+}
+
+void RenderQueue::endFrame() {
+  mgAssertDesc(_packets.empty(), "the render queue has draws that were not flushed");
+  _lastStats = _stats;
+  _stats = {};
+}
+
+} // namespace mg
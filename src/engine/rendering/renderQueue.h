@@ -0,0 +1,98 @@
+#pragma once
+#include "mg/mgUtils.h"
+#include "rendering.h"
+#include "vulkan/pipelineContainer.h"
+#include <unordered_map>
+#include <vector>
+
+namespace mg {
+class CommandRecorder;
+
+// a draw that is recorded when the render queue is flushed, a draw without index buffer uses vkCmdDraw and index
+// buffers hold 32 bit indices
+struct DrawCommand {
+  Pipeline pipeline;
+  // at most 2 descriptor sets and 2 dynamic offsets, matching the DescriptorSets in shaderPipelineInput.h
+  VkDescriptorSet descriptorSets[2];
+  uint32_t descriptorSetCount;
+  uint32_t dynamicOffsets[2];
+  uint32_t dynamicOffsetCount;
+  VkBuffer vertexBuffer;
+  VkDeviceSize vertexBufferOffset;
+  VkBuffer indexBuffer;
+  VkDeviceSize indexBufferOffset;
+  uint32_t count;
+  // copied into the queue, pushed with VK_SHADER_STAGE_ALL at offset 0
+  const void *pushConstants;
+  uint32_t pushConstantSize;
+  // distance to the camera in [0, 1], draws are sorted front to back within the same state
+  float depth;
+};
+
+struct RenderQueueStats {
+  uint32_t nrOfDrawPackets;
+  // pipeline, descriptor set and buffer changes between the sorted draws
+  uint32_t nrOfStateChanges;
+};
+
+// draws are sorted on a 64 bit key, render pass and subpass | pipeline | descriptor sets | mesh | depth bucket, and
+// recorded through the command recorder when the queue is flushed
+class RenderQueue : mg::nonCopyable {
+public:
+  void submit(const RenderContext &renderContext, const DrawCommand &drawCommand);
+  // sorts and records the draws of the render pass and subpass, must be called inside that subpass
+  void flush(const RenderContext &renderContext);
+  // records the sorted draws into at most nrOfCommandBuffers secondary command buffers in parallel, the subpass must be
+  // begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+  void flush(const RenderContext &renderContext, uint32_t nrOfCommandBuffers);
+  void endFrame();
+
+  // the stats of the last frame
+  RenderQueueStats getStats() const { return _lastStats; }
+
+private:
+  struct _DrawPacket {
+    uint32_t pipelineIndex;
+    uint32_t descriptorSetsIndex;
+    VkBuffer vertexBuffer;
+    VkDeviceSize vertexBufferOffset;
+    VkBuffer indexBuffer;
+    VkDeviceSize indexBufferOffset;
+    uint32_t count;
+    uint32_t pushConstantOffset;
+    uint32_t pushConstantSize;
+  };
+  struct _DescriptorSets {
+    VkPipelineLayout layout;
+    VkDescriptorSet values[2];
+    uint32_t count;
+    uint32_t dynamicOffsets[2];
+    uint32_t dynamicOffsetCount;
+  };
+
+  uint32_t getPassIndex(const RenderContext &renderContext);
+  uint32_t getPipelineIndex(const Pipeline &pipeline);
+  uint32_t getDescriptorSetsIndex(const DrawCommand &drawCommand);
+  uint32_t getMeshIndex(VkBuffer vertexBuffer);
+  // sorts the packets and checks that they belong to the render pass and subpass
+  void sortPackets(const RenderContext &renderContext);
+  // records the sorted packets [begin, end), returns the number of state changes
+  uint32_t recordPackets(VkCommandBuffer commandBuffer, CommandRecorder *commandRecorder, uint32_t begin,
+                         uint32_t end) const;
+  void clear();
+
+  std::vector<_DrawPacket> _packets;
+  std::vector<Pipeline> _pipelines;
+  std::vector<_DescriptorSets> _descriptorSets;
+  std::vector<VkRenderPass> _renderPasses;
+  std::unordered_map<VkBuffer, uint32_t> _meshIndices;
+  std::vector<uint8_t> _pushConstants;
+  // sort keys with the packet indices, sorted in place with the scratch arrays
+  std::vector<uint64_t> _sortKeys, _sortKeysScratch;
+  std::vector<uint32_t> _sortIndices, _sortIndicesScratch;
+
+  RenderQueueStats _stats = {};
+  RenderQueueStats _lastStats = {};
+};
+
+} // namespace mg
@@ -8,9 +8,15 @@
 
 namespace mg {
 
+static mg::PipelineHandle fontPipelineHandle;
+
 static mg::Pipeline createFontPipeline(const mg::RenderContext &renderContext) {
   using namespace mg::shaders::fontRendering;
 
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (pipelineContainer.isValid(fontPipelineHandle, renderContext.renderPass, renderContext.subpass))
+    return pipelineContainer.getPipeline(fontPipelineHandle);
+
   mg::PipelineStateDesc pipelineStateDesc = {};
   pipelineStateDesc.rasterization.vkRenderPass = renderContext.renderPass;
   pipelineStateDesc.rasterization.vkPipelineLayout = vkContext.pipelineLayouts.pipelineLayout;
@@ -23,8 +29,8 @@ static mg::Pipeline createFontPipeline(const mg::RenderContext &renderContext) {
   createPipelineInfo.vertexInputState = InputAssembler::vertexInputState;
   createPipelineInfo.vertexInputStateCount = mg::countof(InputAssembler::vertexInputState);
 
-  const auto pipeline = mg::mgSystem.pipelineContainer.createPipeline(pipelineStateDesc, createPipelineInfo);
-  return pipeline;
+  fontPipelineHandle = pipelineContainer.registerPipeline(pipelineStateDesc, createPipelineInfo);
+  return pipelineContainer.getPipeline(fontPipelineHandle);
 }
 
 static std::vector<glm::vec4> getTextsVertexBufferData(mg::FONT_TYPE fontType, const _Text texts[Texts::maxTextPerFont],
@@ -95,16 +101,15 @@ static void renderCharacters(const mg::RenderContext &renderContext, const mg::F
   descriptorSets.textures = mg::getTextureDescriptorSet();  
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(pipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.textureIndex = mg::getTexture2DDescriptorIndex(fonts.getFontGlyphMap(fontType));
   vkCmdPushConstants(mg::vkContext.commandBuffer, pipeline.layout, VK_SHADER_STAGE_ALL, 0, sizeof(TextureIndices),
                      &textureIndices);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(pipeline);
 
   VkBuffer buffer;
   VkDeviceSize buffer_offset;
@@ -114,7 +119,7 @@ static void renderCharacters(const mg::RenderContext &renderContext, const mg::F
       (VertexInputData *)mg::mgSystem.linearHeapAllocator.allocateBuffer(totalSize, &buffer, &buffer_offset);
   memcpy(vertices, charVectorData.data(), totalSize);
 
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &buffer, &buffer_offset);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &buffer, &buffer_offset);
   vkCmdDraw(mg::vkContext.commandBuffer, vertexCount, 1, 0, 0);
 }
 
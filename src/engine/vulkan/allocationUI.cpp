@@ -23,10 +23,10 @@ static void drawAllocation(const GuiAllocation guiElement, const char *title, TY
     if (type == TYPE::FIRST_FIT) {
       ImGui::Text(title);
       ImGui::Text("Memory type index: %d, array Index: %d, total size: %.3f mb, used: %0.3f mb, not used: %.3f mb, "
-                  "total allocations: %d, allocations in use: %d",
+                  "total allocations: %d, allocations in use: %d, fragmentation: %.1f%%",
                   guiElement.memoryTypeIndex, guiElement.heapIndex, guiElement.totalSize / 1024.0f / 1024.0f,
                   (guiElement.totalSize - sizeNotUsed) / 1024.0f / 1024.0f, sizeNotUsed / 1024.0f / 1024.0f,
-                  guiElement.totalNrOfAllocation, guiElement.allocationNotFreed);
+                  guiElement.totalNrOfAllocation, guiElement.allocationNotFreed, guiElement.fragmentation * 100.0f);
     } else {
       ImGui::Text(title);
       ImGui::Text("Memory type index: %d, total size: %.3f mb, used: %0.3f mb, not used: %.3f mb",
@@ -64,7 +64,20 @@ static void drawAllocation(const GuiAllocation guiElement, const char *title, TY
 
 static void drawAllocations() {
   ImGui::Separator();
-  ImGui::Text("Device only first fit allocations:");
+  const auto commandRecorderStats = mg::mgSystem.commandRecorder.getStats();
+  ImGui::Text("Command buffer binds: %d, elided binds: %d", commandRecorderStats.nrOfBinds,
+              commandRecorderStats.nrOfElidedBinds);
+  const auto renderQueueStats = mg::mgSystem.renderQueue.getStats();
+  ImGui::Text("Render queue draws: %d, state changes: %d", renderQueueStats.nrOfDrawPackets,
+              renderQueueStats.nrOfStateChanges);
+  const auto secondaryCommandBuffersStats = mg::mgSystem.secondaryCommandBuffers.getStats();
+  ImGui::Text("Secondary command buffers: %d, recording: %.2f ms", secondaryCommandBuffersStats.nrOfCommandBuffers,
+              double(secondaryCommandBuffersStats.recordingTimeInUs) / 1000.0);
+  ImGui::Separator();
+  ImGui::Text("Device only allocations:");
+  ImGui::Text("Allocator host allocations, meshes: %d, textures: %d",
+              mg::mgSystem.meshDeviceMemoryAllocator.getNrOfHostAllocations(),
+              mg::mgSystem.textureDeviceMemoryAllocator.getNrOfHostAllocations());
   ImGui::Separator();
   {
     // mesh
@@ -150,6 +163,34 @@ static void drawAllocations() {
   ImGui::Separator();
 }
 
+static const char *strategyName(DeviceAllocationStrategy strategy) {
+  switch (strategy) {
+  case DeviceAllocationStrategy::FirstFit:
+    return "first fit";
+  case DeviceAllocationStrategy::Tlsf:
+    return "tlsf";
+  case DeviceAllocationStrategy::Buddy:
+    return "buddy";
+  }
+  return "";
+}
+
+static void logHeapStats(const char *name, const DeviceMemoryAllocator &allocator) {
+  for (const auto &stats : allocator.getHeapStats()) {
+    const auto paddingSize = stats.totalSize - stats.freeSize - stats.allocatedSize;
+    LOG(name << " heap, memory type index: " << stats.memoryTypeIndex << ", array index: " << stats.heapIndex
+              << ", strategy: " << strategyName(stats.strategy) << ", total size: " << stats.totalSize
+              << ", allocated: " << stats.allocatedSize << ", padding: " << paddingSize << ", free: " << stats.freeSize
+              << ", largest free block: " << stats.largestFreeBlockSize << ", free blocks: " << stats.nrOfFreeBlocks
+              << ", fragmentation: " << stats.fragmentation * 100.0f << "%");
+  }
+}
+
+void logAllocationStats() {
+  logHeapStats("mesh", mg::mgSystem.meshDeviceMemoryAllocator);
+  logHeapStats("texture", mg::mgSystem.textureDeviceMemoryAllocator);
+}
+
 void drawAllocations(const mg::FrameData &frameData, void *) {
   ImGuiIO &io = ImGui::GetIO();
 
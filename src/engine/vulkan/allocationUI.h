@@ -3,4 +3,6 @@
 
 namespace mg {
 void drawAllocations(const mg::FrameData &frameData, void *);
+// same numbers as the gui, written to the log
+void logAllocationStats();
 }
\ No newline at end of file
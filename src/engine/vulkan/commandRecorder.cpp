@@ -0,0 +1,101 @@
+#include "commandRecorder.h"
+#include "mg/mgAssert.h"
+#include <algorithm>
+
+namespace mg {
+
+void CommandRecorder::beginCommandBuffer(VkCommandBuffer commandBuffer) {
+  _commandBuffer = commandBuffer;
+  _stats = {};
+  invalidate();
+}
+
+void CommandRecorder::endCommandBuffer() {
+  _lastStats = _stats;
+  _commandBuffer = VK_NULL_HANDLE;
+}
+
+void CommandRecorder::invalidate() {
+  _pipeline = {};
+  _descriptorSets = {};
+  for (auto &vertexBuffer : _vertexBuffers) {
+    vertexBuffer = {};
+  }
+  _indexBuffer = {};
+}
+
+void CommandRecorder::bindGraphicsPipeline(const Pipeline &pipeline) {
+  mgAssert(_commandBuffer != VK_NULL_HANDLE);
+  if (isSamePipeline(pipeline, _pipeline)) {
+    _stats.nrOfElidedBinds++;
+    return;
+  }
+  mg::bindGraphicsPipeline(_commandBuffer, pipeline);
+  _pipeline = pipeline;
+  _stats.nrOfBinds++;
+}
+
+void CommandRecorder::bindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount,
+                                         const VkDescriptorSet *descriptorSets, uint32_t dynamicOffsetCount,
+                                         const uint32_t *dynamicOffsets) {
+  mgAssert(_commandBuffer != VK_NULL_HANDLE);
+  auto &bound = _descriptorSets;
+  const bool isTracked = descriptorSetCount <= MAX_DESCRIPTOR_SETS && dynamicOffsetCount <= MAX_DYNAMIC_OFFSETS;
+  if (isTracked && bound.layout == layout && bound.firstSet == firstSet &&
+      bound.descriptorSetCount == descriptorSetCount && bound.dynamicOffsetCount == dynamicOffsetCount &&
+      std::equal(descriptorSets, descriptorSets + descriptorSetCount, bound.descriptorSets) &&
+      std::equal(dynamicOffsets, dynamicOffsets + dynamicOffsetCount, bound.dynamicOffsets)) {
+    _stats.nrOfElidedBinds++;
+    return;
+  }
+  vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, firstSet, descriptorSetCount,
+                          descriptorSets, dynamicOffsetCount, dynamicOffsets);
+  _stats.nrOfBinds++;
+
+  bound = {};
+  if (!isTracked)
+    return;
+  bound.layout = layout;
+  bound.firstSet = firstSet;
+  bound.descriptorSetCount = descriptorSetCount;
+  bound.dynamicOffsetCount = dynamicOffsetCount;
+  std::copy(descriptorSets, descriptorSets + descriptorSetCount, bound.descriptorSets);
+  std::copy(dynamicOffsets, dynamicOffsets + dynamicOffsetCount, bound.dynamicOffsets);
+}
+
+void CommandRecorder::bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer *buffers,
+                                        const VkDeviceSize *offsets) {
+  mgAssert(_commandBuffer != VK_NULL_HANDLE);
+  const bool isTracked = firstBinding + bindingCount <= MAX_VERTEX_BINDINGS;
+  bool isBound = isTracked;
+  for (uint32_t i = 0; isBound && i < bindingCount; i++) {
+    const auto &bound = _vertexBuffers[firstBinding + i];
+    isBound = bound.buffer == buffers[i] && bound.offset == offsets[i];
+  }
+  if (isBound) {
+    _stats.nrOfElidedBinds++;
+    return;
+  }
+  vkCmdBindVertexBuffers(_commandBuffer, firstBinding, bindingCount, buffers, offsets);
+  _stats.nrOfBinds++;
+
+  for (uint32_t i = 0; i < bindingCount && firstBinding + i < MAX_VERTEX_BINDINGS; i++) {
+    _vertexBuffers[firstBinding + i].buffer = buffers[i];
+    _vertexBuffers[firstBinding + i].offset = offsets[i];
+  }
+}
+
+void CommandRecorder::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+  mgAssert(_commandBuffer != VK_NULL_HANDLE);
+  if (_indexBuffer.buffer == buffer && _indexBuffer.offset == offset && _indexBuffer.indexType == indexType) {
+    _stats.nrOfElidedBinds++;
+    return;
+  }
+  vkCmdBindIndexBuffer(_commandBuffer, buffer, offset, indexType);
+  _stats.nrOfBinds++;
+  _indexBuffer.buffer = buffer;
+  _indexBuffer.offset = offset;
+  _indexBuffer.indexType = indexType;
+}
+
+} // namespace mg
@@ -0,0 +1,66 @@
+#pragma once
+#include "mg/mgUtils.h"
+#include "pipelineContainer.h"
+#include "vkContext.h"
+
+namespace mg {
+
+struct CommandRecorderStats {
+  // binds recorded into the command buffer
+  uint32_t nrOfBinds;
+  // binds that were skipped because the same state was already bound
+  uint32_t nrOfElidedBinds;
+};
+
+// graphics binds on the frame command buffer, binds of the state that is already bound are skipped. All graphics
+// binds on vkContext.commandBuffer have to go through the recorder, or be followed by invalidate
+class CommandRecorder : mg::nonCopyable {
+public:
+  // the tracked state is reset for every command buffer
+  void beginCommandBuffer(VkCommandBuffer commandBuffer);
+  void endCommandBuffer();
+
+  void bindGraphicsPipeline(const Pipeline &pipeline);
+  void bindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount,
+                          const VkDescriptorSet *descriptorSets, uint32_t dynamicOffsetCount,
+                          const uint32_t *dynamicOffsets);
+  void bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer *buffers,
+                         const VkDeviceSize *offsets);
+  void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+  // forgets the bound state, the next binds are recorded
+  void invalidate();
+
+  // the stats of the last recorded command buffer
+  CommandRecorderStats getStats() const { return _lastStats; }
+
+private:
+  enum { MAX_DESCRIPTOR_SETS = 8 };
+  enum { MAX_DYNAMIC_OFFSETS = 8 };
+  enum { MAX_VERTEX_BINDINGS = 4 };
+
+  VkCommandBuffer _commandBuffer = VK_NULL_HANDLE;
+  Pipeline _pipeline;
+  // the arguments of the last descriptor set bind
+  struct {
+    VkPipelineLayout layout;
+    uint32_t firstSet;
+    uint32_t descriptorSetCount;
+    uint32_t dynamicOffsetCount;
+    VkDescriptorSet descriptorSets[MAX_DESCRIPTOR_SETS];
+    uint32_t dynamicOffsets[MAX_DYNAMIC_OFFSETS];
+  } _descriptorSets;
+  struct {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+  } _vertexBuffers[MAX_VERTEX_BINDINGS];
+  struct {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkIndexType indexType;
+  } _indexBuffer;
+
+  CommandRecorderStats _stats = {};
+  CommandRecorderStats _lastStats = {};
+};
+
+} // namespace mg
@@ -0,0 +1,187 @@
+#include "computeAutotuner.h"
+
+#include "mg/logger.h"
+#include "mg/mgUtils.h"
+#include "shaders.h"
+#include "vkUtils.h"
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+namespace mg {
+
+// tuned workgroup size of every shader, loaded from disc on first use
+static std::unordered_map<std::string, uint32_t> _workgroupSizes;
+static bool _isLoaded = false;
+
+// the scenes share the bin directory, every executable has its own file like the pipeline cache
+static std::string getWorkgroupSizesFileName() {
+  const auto executableName = mg::getExecutableName();
+  return executableName.empty() ? "workgroupSizes.txt" : "workgroupSizes_" + executableName + ".txt";
+}
+
+// the first line of the file, sizes tuned on another device or driver are not used
+static std::string getDeviceLine() {
+  const auto &properties = mg::vkContext.physicalDeviceProperties;
+  std::ostringstream line;
+  line << properties.vendorID << " " << properties.deviceID << " " << properties.driverVersion;
+  return line.str();
+}
+
+static void loadWorkgroupSizes() {
+  _isLoaded = true;
+  std::ifstream file(getWorkgroupSizesFileName());
+  std::string line;
+  if (!std::getline(file, line) || line != getDeviceLine())
+    return;
+
+  std::string shaderName;
+  uint32_t workgroupSize = 0;
+  while (file >> shaderName >> workgroupSize) {
+    _workgroupSizes[shaderName] = workgroupSize;
+  }
+}
+
+static void saveWorkgroupSizes() {
+  std::ostringstream text;
+  text << getDeviceLine() << "\n";
+  for (const auto &workgroupSize : _workgroupSizes) {
+    text << workgroupSize.first << " " << workgroupSize.second << "\n";
+  }
+  const auto string = text.str();
+  const auto fileName = getWorkgroupSizesFileName();
+  if (!mg::writeBinaryToDisc(fileName, std::vector<char>(std::begin(string), std::end(string))))
+    LOG("could not write workgroup sizes " << fileName);
+}
+
+static Pipeline createCandidatePipeline(const AutotuneWorkgroupSizeInfo &info, uint32_t workgroupSize) {
+  const auto shader = mg::getShader(info.shaderName);
+  mgAssert(shader.count == 1);
+
+  VkSpecializationMapEntry mapEntry = {};
+  mapEntry.constantID = info.constantId;
+  mapEntry.offset = 0;
+  mapEntry.size = sizeof(uint32_t);
+  VkSpecializationInfo specializationInfo = {};
+  specializationInfo.mapEntryCount = 1;
+  specializationInfo.pMapEntries = &mapEntry;
+  specializationInfo.dataSize = sizeof(uint32_t);
+  specializationInfo.pData = &workgroupSize;
+
+  VkComputePipelineCreateInfo pipelineCreateInfo = {};
+  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineCreateInfo.stage = shader.stageCreateInfo[0];
+  pipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+  pipelineCreateInfo.layout = info.pipelineLayout;
+
+  Pipeline pipeline = {};
+  pipeline.layout = info.pipelineLayout;
+  checkResult(vkCreateComputePipelines(mg::vkContext.device, mg::vkContext.pipelineCache, 1, &pipelineCreateInfo,
+                                       nullptr, &pipeline.pipeline));
+  return pipeline;
+}
+
+// time of one run in ms, measured with timestamps when the queue supports them and on the cpu otherwise
+static double timeRun(const AutotuneWorkgroupSizeInfo &info, const Pipeline &pipeline, uint32_t workgroupSize,
+                      VkQueryPool queryPool) {
+  VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+  commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  commandBufferAllocateInfo.commandPool = mg::vkContext.commandPool;
+  commandBufferAllocateInfo.commandBufferCount = 1;
+  commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+  VkCommandBuffer commandBuffer;
+  checkResult(vkAllocateCommandBuffers(mg::vkContext.device, &commandBufferAllocateInfo, &commandBuffer));
+
+  VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+  commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  checkResult(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+
+  if (queryPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+  }
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+  info.recordDispatch(commandBuffer, pipeline, workgroupSize);
+  if (queryPool != VK_NULL_HANDLE)
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+  checkResult(vkEndCommandBuffer(commandBuffer));
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence;
+  checkResult(vkCreateFence(mg::vkContext.device, &fenceInfo, nullptr, &fence));
+
+  const auto start = mg::timer::now();
+  checkResult(vkQueueSubmit(mg::vkContext.queue, 1, &submitInfo, fence));
+  checkResult(vkWaitForFences(mg::vkContext.device, 1, &fence, VK_TRUE, UINT64_MAX));
+  double timeInMs = mg::timer::durationInUs(start, mg::timer::now()) / 1000.0;
+
+  vkDestroyFence(mg::vkContext.device, fence, nullptr);
+  vkFreeCommandBuffers(mg::vkContext.device, mg::vkContext.commandPool, 1, &commandBuffer);
+
+  if (queryPool != VK_NULL_HANDLE) {
+    uint64_t timestamps[2] = {};
+    checkResult(vkGetQueryPoolResults(mg::vkContext.device, queryPool, 0, 2, sizeof(timestamps), timestamps,
+                                      sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+    timeInMs = double(timestamps[1] - timestamps[0]) *
+               mg::vkContext.physicalDeviceProperties.limits.timestampPeriod / 1000000.0;
+  }
+  return timeInMs;
+}
+
+uint32_t autotuneWorkgroupSize(const AutotuneWorkgroupSizeInfo &info) {
+  if (!_isLoaded)
+    loadWorkgroupSizes();
+  const auto it = _workgroupSizes.find(info.shaderName);
+  if (it != std::end(_workgroupSizes))
+    return it->second;
+
+  const auto &limits = mg::vkContext.physicalDeviceProperties.limits;
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  if (limits.timestampComputeAndGraphics) {
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = 2;
+    checkResult(vkCreateQueryPool(mg::vkContext.device, &queryPoolCreateInfo, nullptr, &queryPool));
+  }
+
+  // the first run of a pipeline includes driver warm up, the fastest run is kept
+  constexpr uint32_t nrOfRuns = 3;
+  const uint32_t maxWorkgroupSize = std::min(limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations);
+  uint32_t bestWorkgroupSize = 0;
+  double bestTimeInMs = 0.0;
+  std::ostringstream times;
+  for (uint32_t workgroupSize = 32; workgroupSize <= maxWorkgroupSize; workgroupSize *= 2) {
+    const auto pipeline = createCandidatePipeline(info, workgroupSize);
+    double timeInMs = 0.0;
+    for (uint32_t run = 0; run < nrOfRuns; run++) {
+      const auto runTimeInMs = timeRun(info, pipeline, workgroupSize, queryPool);
+      timeInMs = run == 0 ? runTimeInMs : std::min(timeInMs, runTimeInMs);
+    }
+    vkDestroyPipeline(mg::vkContext.device, pipeline.pipeline, nullptr);
+
+    times << " " << workgroupSize << ": " << timeInMs << " ms";
+    if (bestWorkgroupSize == 0 || timeInMs < bestTimeInMs) {
+      bestWorkgroupSize = workgroupSize;
+      bestTimeInMs = timeInMs;
+    }
+  }
+  if (queryPool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(mg::vkContext.device, queryPool, nullptr);
+
+  mgAssert(bestWorkgroupSize > 0);
+  LOG("tuned workgroup size of " << info.shaderName << ": " << bestWorkgroupSize << "," << times.str());
+  _workgroupSizes[info.shaderName] = bestWorkgroupSize;
+  saveWorkgroupSizes();
+  return bestWorkgroupSize;
+}
+
+} // namespace mg
@@ -0,0 +1,22 @@
+#pragma once
+#include "pipelineContainer.h"
+#include "vkContext.h"
+#include <functional>
+#include <string>
+
+namespace mg {
+
+struct AutotuneWorkgroupSizeInfo {
+  std::string shaderName;
+  VkPipelineLayout pipelineLayout;
+  // id of the specialization constant that sets the workgroup size through local_size_x_id
+  uint32_t constantId;
+  // binds the descriptor sets and records the dispatches of one run, the pipeline is already bound
+  std::function<void(VkCommandBuffer commandBuffer, const Pipeline &pipeline, uint32_t workgroupSize)> recordDispatch;
+};
+
+// times the compute shader with workgroup sizes from 32 up to the device limit and returns the fastest. The winner
+// is stored next to the pipeline cache and returned without timing in later runs on the same device and driver
+uint32_t autotuneWorkgroupSize(const AutotuneWorkgroupSizeInfo &info);
+
+} // namespace mg
@@ -4,13 +4,59 @@
 #include "vkContext.h"
 #include "vkUtils.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 using namespace std;
 
 namespace mg {
 
+static constexpr uint32_t INVALID_NODE_INDEX = UINT32_MAX;
+
+static uint32_t findFirstSetBit(uint32_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, value);
+  return uint32_t(index);
+#else
+  return uint32_t(__builtin_ctz(value));
+#endif
+}
+
+static uint32_t findLastSetBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return uint32_t(index);
+#else
+  return uint32_t(63 - __builtin_clzll(value));
+#endif
+}
+
+// sizes below SL_INDEX_COUNT are mapped linearly into the first level zero
+static void tlsfMappingInsert(VkDeviceSize size, uint32_t *fl, uint32_t *sl) {
+  if (size < _TlsfHeap::SL_INDEX_COUNT) {
+    *fl = 0;
+    *sl = uint32_t(size);
+  } else {
+    const uint32_t lastBit = findLastSetBit(size);
+    *fl = lastBit - (_TlsfHeap::SL_INDEX_COUNT_LOG2 - 1);
+    *sl = uint32_t(size >> (lastBit - _TlsfHeap::SL_INDEX_COUNT_LOG2)) ^ _TlsfHeap::SL_INDEX_COUNT;
+  }
+}
+
+// round up to the next size class so every block in the found list is large enough
+static void tlsfMappingSearch(VkDeviceSize size, uint32_t *fl, uint32_t *sl) {
+  if (size >= _TlsfHeap::SL_INDEX_COUNT)
+    size += (VkDeviceSize(1) << (findLastSetBit(size) - _TlsfHeap::SL_INDEX_COUNT_LOG2)) - 1;
+  tlsfMappingInsert(size, fl, sl);
+}
+
 DeviceMemoryAllocator::~DeviceMemoryAllocator() { mgAssert(_hasBeenDelete == true); }
 
 void DeviceMemoryAllocator::create(const CreateDeviceHeapAllocatorInfo &createDeviceHeapAllocationInfo) {
+  _allocationStrategy = createDeviceHeapAllocationInfo.allocationStrategy;
   _smallSizeAllocationThreshold = createDeviceHeapAllocationInfo.smallSizeAllocationThreshold;
   _nrOfHeapTypes = mg::vkContext.physicalDeviceMemoryProperties.memoryTypeCount;
   mgAssert(createDeviceHeapAllocationInfo.heapSizes.size() <= NR_OF_HEAPS);
@@ -19,25 +65,33 @@ void DeviceMemoryAllocator::create(const CreateDeviceHeapAllocatorInfo &createDe
     _maxHeapSize = std::max(_maxHeapSize, _heapSizes[i]);
   }
   _useDifferentHeapsForSmallAllocations = createDeviceHeapAllocationInfo.useDifferentHeapsForSmallAllocations;
+  for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < VK_MAX_MEMORY_TYPES; memoryTypeIndex++) {
+    for (uint32_t heapIndex = 0; heapIndex < NR_OF_HEAPS; heapIndex++) {
+      _firstFreeNodes[memoryTypeIndex][heapIndex] = INVALID_NODE_INDEX;
+      _defragmentation.abortedAllocationCount[memoryTypeIndex][heapIndex] = 0;
+    }
+  }
+  _defragmentation.memoryTypeIndex = -1;
+  _threadSafe = createDeviceHeapAllocationInfo.threadSafe;
+  for (uint32_t i = 0; i < MAX_NR_OF_THREADS; i++) {
+    _threadCaches[i] = nullptr;
+  }
+  _nrOfThreadCacheHostAllocations = 0;
 }
 
 void DeviceMemoryAllocator::destroy() {
+  destroyThreadCaches();
   for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < _nrOfHeapTypes; memoryTypeIndex++) {
     for (uint32_t heapIndex = 0; heapIndex < NR_OF_HEAPS; heapIndex++) {
       mgAssert(_allocationInfos[memoryTypeIndex][heapIndex].allocationNotFreed == 0);
       mgAssert(_allocationInfos[memoryTypeIndex][heapIndex].currentSize == 0);
-      _Node baseNode = _memoryPools[memoryTypeIndex][heapIndex];
-      if (baseNode.next != nullptr) {
-        mgAssert(baseNode.next->size == _allocationInfos[memoryTypeIndex][heapIndex].totalSize);
-        mgAssert(baseNode.next->next == nullptr);
-        delete baseNode.next;
-        baseNode.next = nullptr;
-        mgAssert(_deviceMemories[memoryTypeIndex][heapIndex] != nullptr);
-        vkFreeMemory(mg::vkContext.device, _deviceMemories[memoryTypeIndex][heapIndex], nullptr);
-        _deviceMemories[memoryTypeIndex][heapIndex] = nullptr;
-      }
+      if (_allocationInfos[memoryTypeIndex][heapIndex].totalSize != 0)
+        destroyHeap(memoryTypeIndex, heapIndex);
     }
   }
+  _nodes.clear();
+  _tlsfBlocks.clear();
+  _defragmentation.memoryTypeIndex = -1;
   _hasBeenDelete = true;
 }
 
@@ -45,18 +99,8 @@ DeviceHeapAllocation DeviceMemoryAllocator::allocateLargeDeviceOnlyMemory(uint32
                                                                           VkDeviceSize sizeInBytes,
                                                                           VkDeviceSize alignment) {
   const auto size = mg::alignUpPowerOfTwo(sizeInBytes, alignment);
-  int32_t index = -1;
-  for (int32_t i = 0; i < int32_t(_largeSizeAllocations.size()); i++) {
-    if (_largeSizeAllocations[i].deviceMemory == 0) {
-      index = i;
-      break;
-    }
-  }
-  if (index == -1) {
-    _largeSizeAllocations.push_back({});
-    _largeSizeAllocations.back().generationIndex = _largSizeGenerationIndex++;
-    index = int32_t(_largeSizeAllocations.size() - 1);
-  }
+  const auto index = _largeSizeAllocations.create();
+  _largeSizeAllocations[index].generationIndex = _largSizeGenerationIndex++;
 
   VkMemoryAllocateInfo vkMemoryAllocateInfo = {};
   vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -70,7 +114,7 @@ DeviceHeapAllocation DeviceMemoryAllocator::allocateLargeDeviceOnlyMemory(uint32
   deviceHeapAllocation.deviceMemory = _largeSizeAllocations[index].deviceMemory;
   deviceHeapAllocation.largeSizeGenerationIndex = _largeSizeAllocations[index].generationIndex;
 
-  deviceHeapAllocation.largeSizeAllocationIndex = index;
+  deviceHeapAllocation.largeSizeAllocationIndex = int32_t(index);
   deviceHeapAllocation.offset = 0;
 
   _largeSizeAllocations[index].size = size;
@@ -82,11 +126,134 @@ DeviceHeapAllocation DeviceMemoryAllocator::allocateLargeDeviceOnlyMemory(uint32
 void DeviceMemoryAllocator::freeLargeDeviceOnlyMemory(const DeviceHeapAllocation &allocation) {
   mgAssert(allocation.largeSizeAllocationIndex >= 0);
   vkFreeMemory(mg::vkContext.device, _largeSizeAllocations[allocation.largeSizeAllocationIndex].deviceMemory, nullptr);
-  _largeSizeAllocations[allocation.largeSizeAllocationIndex] = {};
+  _largeSizeAllocations.release(allocation.largeSizeAllocationIndex);
+}
+
+void DeviceMemoryAllocator::createHeap(uint32_t memoryTypeIndex, uint32_t heapIndex,
+                                       DeviceAllocationStrategy strategy) {
+  VkMemoryAllocateInfo vkMemoryAllocateInfo = {};
+  vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  vkMemoryAllocateInfo.allocationSize = _heapSizes[heapIndex];
+  vkMemoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+  checkResult(vkAllocateMemory(mg::vkContext.device, &vkMemoryAllocateInfo, nullptr,
+                               &_deviceMemories[memoryTypeIndex][heapIndex]));
+  _allocationInfos[memoryTypeIndex][heapIndex].totalSize = _heapSizes[heapIndex];
+  _heapStrategies[memoryTypeIndex][heapIndex] = strategy;
+
+  if (strategy == DeviceAllocationStrategy::Buddy) {
+    mgAssertDesc(mg::isPowerOfTwo(_heapSizes[heapIndex]) &&
+                     _heapSizes[heapIndex] >= (1u << _BuddyHeap::MIN_BLOCK_SIZE_LOG2),
+                 "buddy heaps must be a power of two");
+    _BuddyHeap *heap = &_buddyHeaps[memoryTypeIndex][heapIndex];
+    const uint32_t nrOfLeaves = _heapSizes[heapIndex] >> _BuddyHeap::MIN_BLOCK_SIZE_LOG2;
+    // the block storage is kept when the heap is released, it is only allocated the first time
+    if (heap->blocks.capacity() < nrOfLeaves)
+      _nrOfBuddyHostAllocations++;
+    heap->blocks.assign(nrOfLeaves, {});
+    heap->nrOfOrders = findLastSetBit(nrOfLeaves) + 1;
+    heap->orderBitmap = 0;
+    for (uint32_t order = 0; order < _BuddyHeap::MAX_ORDER_COUNT; order++) {
+      heap->freeLists[order] = INVALID_NODE_INDEX;
+    }
+    heap->blocks[0].order = uint8_t(heap->nrOfOrders - 1);
+    insertFreeBuddyBlock(heap, 0);
+  } else if (strategy == DeviceAllocationStrategy::Tlsf) {
+    _TlsfHeap *heap = &_tlsfHeaps[memoryTypeIndex][heapIndex];
+    heap->flBitmap = 0;
+    for (uint32_t fl = 0; fl < _TlsfHeap::FL_INDEX_COUNT; fl++) {
+      heap->slBitmaps[fl] = 0;
+      for (uint32_t sl = 0; sl < _TlsfHeap::SL_INDEX_COUNT; sl++) {
+        heap->freeLists[fl][sl] = INVALID_NODE_INDEX;
+      }
+    }
+    const auto blockIndex = createTlsfBlock();
+    _tlsfBlocks[blockIndex].size = _heapSizes[heapIndex];
+    heap->firstBlock = blockIndex;
+    insertFreeTlsfBlock(heap, blockIndex);
+  } else {
+    const auto nodeIndex = _nodes.create();
+    _nodes[nodeIndex].next = INVALID_NODE_INDEX;
+    _nodes[nodeIndex].size = _heapSizes[heapIndex];
+    _firstFreeNodes[memoryTypeIndex][heapIndex] = nodeIndex;
+  }
+}
+
+void DeviceMemoryAllocator::destroyHeap(uint32_t memoryTypeIndex, uint32_t heapIndex) {
+  mgAssert(_allocationInfos[memoryTypeIndex][heapIndex].allocationNotFreed == 0);
+  const auto strategy = _heapStrategies[memoryTypeIndex][heapIndex];
+  if (strategy == DeviceAllocationStrategy::Buddy) {
+    _BuddyHeap *heap = &_buddyHeaps[memoryTypeIndex][heapIndex];
+    mgAssert(heap->orderBitmap == (1u << (heap->nrOfOrders - 1)));
+    mgAssert(heap->freeLists[heap->nrOfOrders - 1] == 0);
+    removeFreeBuddyBlock(heap, 0);
+  } else if (strategy == DeviceAllocationStrategy::Tlsf) {
+    const auto firstBlock = _tlsfHeaps[memoryTypeIndex][heapIndex].firstBlock;
+    mgAssert(_tlsfBlocks[firstBlock].isFree);
+    mgAssert(_tlsfBlocks[firstBlock].size == _allocationInfos[memoryTypeIndex][heapIndex].totalSize);
+    mgAssert(_tlsfBlocks[firstBlock].nextPhysical == INVALID_NODE_INDEX);
+    removeFreeTlsfBlock(&_tlsfHeaps[memoryTypeIndex][heapIndex], firstBlock);
+    _tlsfBlocks.release(firstBlock);
+  } else {
+    const auto firstNode = _firstFreeNodes[memoryTypeIndex][heapIndex];
+    mgAssert(_nodes[firstNode].size == _allocationInfos[memoryTypeIndex][heapIndex].totalSize);
+    mgAssert(_nodes[firstNode].next == INVALID_NODE_INDEX);
+    _nodes.release(firstNode);
+    _firstFreeNodes[memoryTypeIndex][heapIndex] = INVALID_NODE_INDEX;
+  }
+  mgAssert(_deviceMemories[memoryTypeIndex][heapIndex] != nullptr);
+  vkFreeMemory(mg::vkContext.device, _deviceMemories[memoryTypeIndex][heapIndex], nullptr);
+  _deviceMemories[memoryTypeIndex][heapIndex] = nullptr;
+  _allocationInfos[memoryTypeIndex][heapIndex] = {};
+}
+
+bool DeviceMemoryAllocator::allocateFromHeap(uint32_t memoryTypeIndex, uint32_t heapIndex, VkDeviceSize sizeInBytes,
+                                             VkDeviceSize alignment, DeviceAllocationStrategy strategy,
+                                             DeviceHeapAllocation *allocation) {
+  if (_allocationInfos[memoryTypeIndex][heapIndex].totalSize == 0)
+    createHeap(memoryTypeIndex, heapIndex, strategy);
+  else if (_heapStrategies[memoryTypeIndex][heapIndex] != strategy)
+    return false;
+
+  bool allocated = false;
+  switch (strategy) {
+  case DeviceAllocationStrategy::FirstFit:
+    allocated = allocateFromFirstFitHeap(memoryTypeIndex, heapIndex, sizeInBytes, alignment, allocation);
+    break;
+  case DeviceAllocationStrategy::Tlsf:
+    allocated = allocateFromTlsfHeap(memoryTypeIndex, heapIndex, sizeInBytes, alignment, allocation);
+    break;
+  case DeviceAllocationStrategy::Buddy:
+    allocated = allocateFromBuddyHeap(memoryTypeIndex, heapIndex, sizeInBytes, alignment, allocation);
+    break;
+  }
+  if (allocated) {
+    _allocationInfos[memoryTypeIndex][heapIndex].currentSize += sizeInBytes;
+    _allocationInfos[memoryTypeIndex][heapIndex].totalNrOfAllocations++;
+    _allocationInfos[memoryTypeIndex][heapIndex].allocationNotFreed++;
+  }
+  return allocated;
 }
 
 DeviceHeapAllocation DeviceMemoryAllocator::allocateDeviceOnlyMemory(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes,
                                                                      VkDeviceSize alignment) {
+  return allocateDeviceOnlyMemory(memoryTypeIndex, sizeInBytes, alignment, _allocationStrategy);
+}
+
+DeviceHeapAllocation DeviceMemoryAllocator::allocateDeviceOnlyMemory(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes,
+                                                                     VkDeviceSize alignment,
+                                                                     DeviceAllocationStrategy strategy) {
+  if (_threadSafe && strategy == _allocationStrategy &&
+      std::max(sizeInBytes, alignment) <= (VkDeviceSize(1) << _ThreadCache::MAX_SIZE_CLASS_LOG2))
+    return allocateFromThreadCache(memoryTypeIndex, sizeInBytes, alignment);
+
+  const auto lock = lockHeaps();
+  return allocateFromHeaps(memoryTypeIndex, sizeInBytes, alignment, strategy);
+}
+
+DeviceHeapAllocation DeviceMemoryAllocator::allocateFromHeaps(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes,
+                                                              VkDeviceSize alignment,
+                                                              DeviceAllocationStrategy strategy) {
   mgAssert(memoryTypeIndex < _nrOfHeapTypes);
   mgAssert(NR_OF_HEAPS > 1);
 
@@ -97,74 +264,162 @@ DeviceHeapAllocation DeviceMemoryAllocator::allocateDeviceOnlyMemory(uint32_t me
   if (_useDifferentHeapsForSmallAllocations && sizeInBytes > _smallSizeAllocationThreshold)
     heapIndex++;
 
-  for (; heapIndex < NR_OF_HEAPS; heapIndex++) {
-    mg::_Node *baseNode = &_memoryPools[memoryTypeIndex][heapIndex];
-    if (baseNode->next == nullptr && _allocationInfos[memoryTypeIndex][heapIndex].totalSize == 0) {
-      VkMemoryAllocateInfo vkMemoryAllocateInfo = {};
-      vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      vkMemoryAllocateInfo.allocationSize = _heapSizes[heapIndex];
-      vkMemoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+  // the heap being defragmented is only used when nothing else fits
+  const bool isDefragmenting = _defragmentation.memoryTypeIndex == int32_t(memoryTypeIndex);
+  DeviceHeapAllocation allocation = {};
+  for (uint32_t i = heapIndex; i < NR_OF_HEAPS; i++) {
+    if (isDefragmenting && i == _defragmentation.heapIndex)
+      continue;
+    if (allocateFromHeap(memoryTypeIndex, i, sizeInBytes, alignment, strategy, &allocation))
+      return allocation;
+  }
+  if (isDefragmenting && _defragmentation.heapIndex >= heapIndex &&
+      allocateFromHeap(memoryTypeIndex, _defragmentation.heapIndex, sizeInBytes, alignment, strategy, &allocation))
+    return allocation;
+  // every heap is used by another strategy, e.g. a buddy request after the default strategy claimed all heaps
+  if (strategy != _allocationStrategy)
+    return allocateFromHeaps(memoryTypeIndex, sizeInBytes, alignment, _allocationStrategy);
 
-      checkResult(vkAllocateMemory(mg::vkContext.device, &vkMemoryAllocateInfo, nullptr,
-                                   &_deviceMemories[memoryTypeIndex][heapIndex]));
-      _allocationInfos[memoryTypeIndex][heapIndex].totalSize = _heapSizes[heapIndex];
+  mgAssertDesc(false, "could not allocate device memory from heap");
+  return {};
+}
 
-      baseNode->next = new mg::_Node{};
-      baseNode->next->size = _heapSizes[heapIndex];
-    }
+bool DeviceMemoryAllocator::allocateFromFirstFitHeap(uint32_t memoryTypeIndex, uint32_t heapIndex,
+                                                     VkDeviceSize sizeInBytes, VkDeviceSize alignment,
+                                                     DeviceHeapAllocation *allocation) {
+  uint32_t *firstNode = &_firstFreeNodes[memoryTypeIndex][heapIndex];
+  for (uint32_t prevNode = INVALID_NODE_INDEX, currentNode = *firstNode; currentNode != INVALID_NODE_INDEX;
+       prevNode = currentNode, currentNode = _nodes[currentNode].next) {
+    const auto currentNodeOffset = _nodes[currentNode].offset;
+    const auto currentNodeSize = _nodes[currentNode].size;
+    const auto currentNodeAlignedOffset = mg::alignUpPowerOfTwo(currentNodeOffset, alignment);
+    if (currentNodeAlignedOffset - currentNodeOffset >= currentNodeSize)
+      continue;
+    const auto currentNodeFreeSpace = currentNodeSize - (currentNodeAlignedOffset - currentNodeOffset);
 
-    for (mg::_Node *prevNode = baseNode, *currentNode = baseNode->next; currentNode != nullptr;
-         prevNode = currentNode, currentNode = currentNode->next) {
-      const auto currentNodeAlignedOffset = mg::alignUpPowerOfTwo(currentNode->offset, alignment);
-      const auto currentNodeFreeSpace = currentNode->size - (currentNodeAlignedOffset - currentNode->offset);
-
-      if (sizeInBytes <= currentNodeFreeSpace) {
-        DeviceHeapAllocation allocation = {};
-        allocation.memoryTypeIndex = memoryTypeIndex;
-        allocation.deviceMemory = _deviceMemories[memoryTypeIndex][heapIndex];
-        allocation.size = sizeInBytes;
-        allocation.offset = currentNodeAlignedOffset;
-
-        // same offset
-        if (currentNode->offset == currentNodeAlignedOffset) {
-          // perfect fit
-          if (sizeInBytes == currentNodeFreeSpace) {
-            prevNode->next = currentNode->next;
-            delete currentNode;
-          } else {
-            currentNode->size = currentNode->size - sizeInBytes;
-            currentNode->offset += sizeInBytes;
-          }
-        } else { // different offset
-          currentNode->size = currentNodeAlignedOffset - currentNode->offset;
-          if (currentNodeFreeSpace != sizeInBytes) {
-            if (currentNode->next == nullptr) {
-              currentNode->next = new mg::_Node();
-            }
-            currentNode->next->size += currentNodeFreeSpace - sizeInBytes;
-            currentNode->next->offset = currentNodeAlignedOffset + sizeInBytes;
-          }
-        }
-        _allocationInfos[memoryTypeIndex][heapIndex].currentSize += sizeInBytes;
-        _allocationInfos[memoryTypeIndex][heapIndex].totalNrOfAllocations++;
-        _allocationInfos[memoryTypeIndex][heapIndex].allocationNotFreed++;
+    if (sizeInBytes <= currentNodeFreeSpace) {
+      allocation->memoryTypeIndex = memoryTypeIndex;
+      allocation->deviceMemory = _deviceMemories[memoryTypeIndex][heapIndex];
+      allocation->size = sizeInBytes;
+      allocation->offset = currentNodeAlignedOffset;
 
-        return allocation;
+      // same offset
+      if (currentNodeOffset == currentNodeAlignedOffset) {
+        // perfect fit
+        if (sizeInBytes == currentNodeFreeSpace) {
+          if (prevNode == INVALID_NODE_INDEX)
+            *firstNode = _nodes[currentNode].next;
+          else
+            _nodes[prevNode].next = _nodes[currentNode].next;
+          _nodes.release(currentNode);
+        } else {
+          _nodes[currentNode].size = currentNodeSize - sizeInBytes;
+          _nodes[currentNode].offset += sizeInBytes;
+        }
+      } else { // different offset
+        _nodes[currentNode].size = currentNodeAlignedOffset - currentNodeOffset;
+        if (currentNodeFreeSpace != sizeInBytes) {
+          const auto remainderNode = _nodes.create();
+          _nodes[remainderNode].offset = currentNodeAlignedOffset + sizeInBytes;
+          _nodes[remainderNode].size = currentNodeFreeSpace - sizeInBytes;
+          _nodes[remainderNode].next = _nodes[currentNode].next;
+          _nodes[currentNode].next = remainderNode;
+        }
       }
+      return true;
     }
   }
-  mgAssertDesc(false, "could not allocate device memory from heap");
-  return {};
+  return false;
+}
+
+bool DeviceMemoryAllocator::allocateFromTlsfHeap(uint32_t memoryTypeIndex, uint32_t heapIndex,
+                                                 VkDeviceSize sizeInBytes, VkDeviceSize alignment,
+                                                 DeviceHeapAllocation *allocation) {
+  _TlsfHeap *heap = &_tlsfHeaps[memoryTypeIndex][heapIndex];
+
+  // search for the worst case padding so the first block in the list always fits
+  uint32_t fl, sl;
+  tlsfMappingSearch(sizeInBytes + (alignment > 1 ? alignment - 1 : 0), &fl, &sl);
+  if (fl >= _TlsfHeap::FL_INDEX_COUNT)
+    return false;
+
+  uint32_t slMap = heap->slBitmaps[fl] & (~0u << sl);
+  if (slMap == 0) {
+    const uint32_t flMap = fl + 1 < _TlsfHeap::FL_INDEX_COUNT ? heap->flBitmap & (~0u << (fl + 1)) : 0;
+    if (flMap == 0)
+      return false;
+    fl = findFirstSetBit(flMap);
+    slMap = heap->slBitmaps[fl];
+  }
+  sl = findFirstSetBit(slMap);
+
+  const auto blockIndex = heap->freeLists[fl][sl];
+  removeFreeTlsfBlock(heap, blockIndex);
+
+  const auto alignedOffset = mg::alignUpPowerOfTwo(_tlsfBlocks[blockIndex].offset, alignment);
+  mgAssert(alignedOffset + sizeInBytes <= _tlsfBlocks[blockIndex].offset + _tlsfBlocks[blockIndex].size);
+
+  // split off the alignment padding in front, the previous block is never free
+  if (alignedOffset != _tlsfBlocks[blockIndex].offset) {
+    const auto paddingIndex = createTlsfBlock();
+    _TlsfBlock &padding = _tlsfBlocks[paddingIndex];
+    _TlsfBlock &block = _tlsfBlocks[blockIndex];
+    padding.offset = block.offset;
+    padding.size = alignedOffset - block.offset;
+    padding.prevPhysical = block.prevPhysical;
+    padding.nextPhysical = blockIndex;
+    if (block.prevPhysical != INVALID_NODE_INDEX)
+      _tlsfBlocks[block.prevPhysical].nextPhysical = paddingIndex;
+    else
+      heap->firstBlock = paddingIndex;
+    block.prevPhysical = paddingIndex;
+    block.offset = alignedOffset;
+    block.size -= padding.size;
+    insertFreeTlsfBlock(heap, paddingIndex);
+  }
+
+  // return the remainder
+  if (_tlsfBlocks[blockIndex].size != sizeInBytes) {
+    const auto remainderIndex = createTlsfBlock();
+    _TlsfBlock &remainder = _tlsfBlocks[remainderIndex];
+    _TlsfBlock &block = _tlsfBlocks[blockIndex];
+    remainder.offset = block.offset + sizeInBytes;
+    remainder.size = block.size - sizeInBytes;
+    remainder.prevPhysical = blockIndex;
+    remainder.nextPhysical = block.nextPhysical;
+    if (block.nextPhysical != INVALID_NODE_INDEX)
+      _tlsfBlocks[block.nextPhysical].prevPhysical = remainderIndex;
+    block.nextPhysical = remainderIndex;
+    block.size = sizeInBytes;
+    insertFreeTlsfBlock(heap, remainderIndex);
+  }
+  _tlsfBlocks[blockIndex].isFree = false;
+
+  allocation->memoryTypeIndex = memoryTypeIndex;
+  allocation->deviceMemory = _deviceMemories[memoryTypeIndex][heapIndex];
+  allocation->size = sizeInBytes;
+  allocation->offset = alignedOffset;
+  allocation->heapBlockIndex = blockIndex;
+  return true;
 }
 
 void DeviceMemoryAllocator::freeDeviceOnlyMemory(const DeviceHeapAllocation &allocation) {
+  if (allocation.threadCacheIndex != UINT32_MAX) {
+    freeToThreadCache(allocation);
+    return;
+  }
+  const auto lock = lockHeaps();
+  freeToHeaps(allocation);
+}
+
+void DeviceMemoryAllocator::freeToHeaps(const DeviceHeapAllocation &allocation) {
   // larger allocation, does not belong to a heap
   if (allocation.largeSizeAllocationIndex != -1) {
     const auto index = allocation.largeSizeAllocationIndex;
     mgAssert(allocation.deviceMemory == _largeSizeAllocations[index].deviceMemory);
     mgAssert(_largeSizeAllocations[index].generationIndex == allocation.largeSizeGenerationIndex);
     vkFreeMemory(mg::vkContext.device, allocation.deviceMemory, nullptr);
-    _largeSizeAllocations[allocation.largeSizeAllocationIndex] = {};
+    _largeSizeAllocations.release(allocation.largeSizeAllocationIndex);
     return;
   }
 
@@ -183,42 +438,331 @@ void DeviceMemoryAllocator::freeDeviceOnlyMemory(const DeviceHeapAllocation &all
   mgAssert(_allocationInfos[memoryTypeIndex][heapIndex].currentSize >= 0);
   mgAssert(_allocationInfos[memoryTypeIndex][heapIndex].allocationNotFreed >= 0);
 
-  mg::_Node *baseNode = &_memoryPools[memoryTypeIndex][heapIndex];
-  mg::_Node *prevNode = baseNode;
-  mg::_Node *currentNode = baseNode->next;
-  for (; currentNode != nullptr; prevNode = currentNode, currentNode = currentNode->next) {
-    mgAssert(allocation.offset != currentNode->offset);
-    if (allocation.offset < currentNode->offset) {
-      if (allocation.offset + allocation.size == currentNode->offset) {
-        currentNode->offset = allocation.offset;
-        currentNode->size += allocation.size;
+  switch (_heapStrategies[memoryTypeIndex][heapIndex]) {
+  case DeviceAllocationStrategy::FirstFit:
+    freeToFirstFitHeap(memoryTypeIndex, heapIndex, allocation);
+    break;
+  case DeviceAllocationStrategy::Tlsf:
+    freeToTlsfHeap(memoryTypeIndex, heapIndex, allocation);
+    break;
+  case DeviceAllocationStrategy::Buddy:
+    freeToBuddyHeap(memoryTypeIndex, heapIndex, allocation);
+    break;
+  }
+}
+
+void DeviceMemoryAllocator::freeToFirstFitHeap(uint32_t memoryTypeIndex, uint32_t heapIndex,
+                                               const DeviceHeapAllocation &allocation) {
+  uint32_t *firstNode = &_firstFreeNodes[memoryTypeIndex][heapIndex];
+  uint32_t prevNode = INVALID_NODE_INDEX;
+  uint32_t currentNode = *firstNode;
+  for (; currentNode != INVALID_NODE_INDEX; prevNode = currentNode, currentNode = _nodes[currentNode].next) {
+    mgAssert(allocation.offset != _nodes[currentNode].offset);
+    if (allocation.offset < _nodes[currentNode].offset) {
+      if (allocation.offset + allocation.size == _nodes[currentNode].offset) {
+        _nodes[currentNode].offset = allocation.offset;
+        _nodes[currentNode].size += allocation.size;
       } else {
-        currentNode = nullptr;
+        currentNode = INVALID_NODE_INDEX;
       }
       break;
     }
   }
-  if (currentNode == nullptr) {
-    currentNode = new _Node{};
-    currentNode->offset = allocation.offset;
-    currentNode->size = allocation.size;
-    currentNode->next = prevNode->next;
-    prevNode->next = currentNode;
+  if (currentNode == INVALID_NODE_INDEX) {
+    currentNode = _nodes.create();
+    _nodes[currentNode].offset = allocation.offset;
+    _nodes[currentNode].size = allocation.size;
+    if (prevNode == INVALID_NODE_INDEX) {
+      _nodes[currentNode].next = *firstNode;
+      *firstNode = currentNode;
+    } else {
+      _nodes[currentNode].next = _nodes[prevNode].next;
+      _nodes[prevNode].next = currentNode;
+    }
+  }
+  if (prevNode != INVALID_NODE_INDEX && _nodes[prevNode].offset + _nodes[prevNode].size == _nodes[currentNode].offset) {
+    _nodes[prevNode].size += _nodes[currentNode].size;
+    _nodes[prevNode].next = _nodes[currentNode].next;
+    _nodes.release(currentNode);
+  }
+}
+
+void DeviceMemoryAllocator::freeToTlsfHeap(uint32_t memoryTypeIndex, uint32_t heapIndex,
+                                           const DeviceHeapAllocation &allocation) {
+  _TlsfHeap *heap = &_tlsfHeaps[memoryTypeIndex][heapIndex];
+  auto blockIndex = allocation.heapBlockIndex;
+  mgAssert(blockIndex < _tlsfBlocks.size());
+  mgAssert(!_tlsfBlocks[blockIndex].isFree);
+  mgAssert(_tlsfBlocks[blockIndex].offset == allocation.offset);
+  _tlsfBlocks[blockIndex].isFree = true;
+
+  // merge with the physical neighbours
+  const auto prevIndex = _tlsfBlocks[blockIndex].prevPhysical;
+  if (prevIndex != INVALID_NODE_INDEX && _tlsfBlocks[prevIndex].isFree) {
+    removeFreeTlsfBlock(heap, prevIndex);
+    _TlsfBlock &prev = _tlsfBlocks[prevIndex];
+    const _TlsfBlock &block = _tlsfBlocks[blockIndex];
+    prev.size += block.size;
+    prev.nextPhysical = block.nextPhysical;
+    if (block.nextPhysical != INVALID_NODE_INDEX)
+      _tlsfBlocks[block.nextPhysical].prevPhysical = prevIndex;
+    _tlsfBlocks.release(blockIndex);
+    blockIndex = prevIndex;
+  }
+  const auto nextIndex = _tlsfBlocks[blockIndex].nextPhysical;
+  if (nextIndex != INVALID_NODE_INDEX && _tlsfBlocks[nextIndex].isFree) {
+    removeFreeTlsfBlock(heap, nextIndex);
+    _TlsfBlock &block = _tlsfBlocks[blockIndex];
+    const _TlsfBlock &next = _tlsfBlocks[nextIndex];
+    block.size += next.size;
+    block.nextPhysical = next.nextPhysical;
+    if (next.nextPhysical != INVALID_NODE_INDEX)
+      _tlsfBlocks[next.nextPhysical].prevPhysical = blockIndex;
+    _tlsfBlocks.release(nextIndex);
+  }
+  insertFreeTlsfBlock(heap, blockIndex);
+}
+
+uint32_t DeviceMemoryAllocator::createTlsfBlock() {
+  const auto blockIndex = _tlsfBlocks.create();
+  _TlsfBlock &block = _tlsfBlocks[blockIndex];
+  block.prevPhysical = block.nextPhysical = INVALID_NODE_INDEX;
+  block.prevFree = block.nextFree = INVALID_NODE_INDEX;
+  return blockIndex;
+}
+
+void DeviceMemoryAllocator::insertFreeTlsfBlock(_TlsfHeap *heap, uint32_t blockIndex) {
+  _TlsfBlock &block = _tlsfBlocks[blockIndex];
+  uint32_t fl, sl;
+  tlsfMappingInsert(block.size, &fl, &sl);
+
+  block.isFree = true;
+  block.prevFree = INVALID_NODE_INDEX;
+  block.nextFree = heap->freeLists[fl][sl];
+  if (block.nextFree != INVALID_NODE_INDEX)
+    _tlsfBlocks[block.nextFree].prevFree = blockIndex;
+  heap->freeLists[fl][sl] = blockIndex;
+  heap->flBitmap |= 1u << fl;
+  heap->slBitmaps[fl] |= 1u << sl;
+}
+
+void DeviceMemoryAllocator::removeFreeTlsfBlock(_TlsfHeap *heap, uint32_t blockIndex) {
+  _TlsfBlock &block = _tlsfBlocks[blockIndex];
+  uint32_t fl, sl;
+  tlsfMappingInsert(block.size, &fl, &sl);
+
+  if (block.prevFree != INVALID_NODE_INDEX)
+    _tlsfBlocks[block.prevFree].nextFree = block.nextFree;
+  if (block.nextFree != INVALID_NODE_INDEX)
+    _tlsfBlocks[block.nextFree].prevFree = block.prevFree;
+
+  if (heap->freeLists[fl][sl] == blockIndex) {
+    heap->freeLists[fl][sl] = block.nextFree;
+    if (block.nextFree == INVALID_NODE_INDEX) {
+      heap->slBitmaps[fl] &= ~(1u << sl);
+      if (heap->slBitmaps[fl] == 0)
+        heap->flBitmap &= ~(1u << fl);
+    }
+  }
+  block.prevFree = block.nextFree = INVALID_NODE_INDEX;
+  block.isFree = false;
+}
+
+bool DeviceMemoryAllocator::allocateFromBuddyHeap(uint32_t memoryTypeIndex, uint32_t heapIndex,
+                                                  VkDeviceSize sizeInBytes, VkDeviceSize alignment,
+                                                  DeviceHeapAllocation *allocation) {
+  _BuddyHeap *heap = &_buddyHeaps[memoryTypeIndex][heapIndex];
+
+  // blocks are aligned to their size, so the alignment only has to be covered by the block size
+  const VkDeviceSize blockSize =
+      std::max({sizeInBytes, alignment, VkDeviceSize(1) << _BuddyHeap::MIN_BLOCK_SIZE_LOG2});
+  const uint32_t order = findLastSetBit(blockSize - 1) + 1 - _BuddyHeap::MIN_BLOCK_SIZE_LOG2;
+  if (order >= heap->nrOfOrders)
+    return false;
+
+  const uint32_t orderMap = heap->orderBitmap & (~0u << order);
+  if (orderMap == 0)
+    return false;
+  uint32_t currentOrder = findFirstSetBit(orderMap);
+  const uint32_t leafIndex = heap->freeLists[currentOrder];
+  removeFreeBuddyBlock(heap, leafIndex);
+
+  // split until the block has the requested size, the upper halves are returned to the free lists
+  while (currentOrder > order) {
+    currentOrder--;
+    const uint32_t buddyIndex = leafIndex + (1u << currentOrder);
+    heap->blocks[buddyIndex].order = uint8_t(currentOrder);
+    insertFreeBuddyBlock(heap, buddyIndex);
+  }
+  heap->blocks[leafIndex].order = uint8_t(order);
+
+  allocation->memoryTypeIndex = memoryTypeIndex;
+  allocation->deviceMemory = _deviceMemories[memoryTypeIndex][heapIndex];
+  allocation->size = sizeInBytes;
+  allocation->offset = VkDeviceSize(leafIndex) << _BuddyHeap::MIN_BLOCK_SIZE_LOG2;
+  allocation->heapBlockIndex = leafIndex;
+  return true;
+}
+
+void DeviceMemoryAllocator::freeToBuddyHeap(uint32_t memoryTypeIndex, uint32_t heapIndex,
+                                            const DeviceHeapAllocation &allocation) {
+  _BuddyHeap *heap = &_buddyHeaps[memoryTypeIndex][heapIndex];
+  auto leafIndex = allocation.heapBlockIndex;
+  mgAssert(leafIndex < heap->blocks.size());
+  mgAssert(!heap->blocks[leafIndex].isFree);
+  mgAssert((VkDeviceSize(leafIndex) << _BuddyHeap::MIN_BLOCK_SIZE_LOG2) == allocation.offset);
+
+  // merge with the buddy as long as it is a free block of the same order
+  uint32_t order = heap->blocks[leafIndex].order;
+  while (order + 1 < heap->nrOfOrders) {
+    const uint32_t buddyIndex = leafIndex ^ (1u << order);
+    if (!heap->blocks[buddyIndex].isFree || heap->blocks[buddyIndex].order != order)
+      break;
+    removeFreeBuddyBlock(heap, buddyIndex);
+    leafIndex = std::min(leafIndex, buddyIndex);
+    order++;
+  }
+  heap->blocks[leafIndex].order = uint8_t(order);
+  insertFreeBuddyBlock(heap, leafIndex);
+}
+
+void DeviceMemoryAllocator::insertFreeBuddyBlock(_BuddyHeap *heap, uint32_t leafIndex) {
+  _BuddyBlock &block = heap->blocks[leafIndex];
+  const uint32_t order = block.order;
+
+  block.isFree = true;
+  block.prevFree = INVALID_NODE_INDEX;
+  block.nextFree = heap->freeLists[order];
+  if (block.nextFree != INVALID_NODE_INDEX)
+    heap->blocks[block.nextFree].prevFree = leafIndex;
+  heap->freeLists[order] = leafIndex;
+  heap->orderBitmap |= 1u << order;
+}
+
+void DeviceMemoryAllocator::removeFreeBuddyBlock(_BuddyHeap *heap, uint32_t leafIndex) {
+  _BuddyBlock &block = heap->blocks[leafIndex];
+  const uint32_t order = block.order;
+
+  if (block.prevFree != INVALID_NODE_INDEX)
+    heap->blocks[block.prevFree].nextFree = block.nextFree;
+  if (block.nextFree != INVALID_NODE_INDEX)
+    heap->blocks[block.nextFree].prevFree = block.prevFree;
+
+  if (heap->freeLists[order] == leafIndex) {
+    heap->freeLists[order] = block.nextFree;
+    if (block.nextFree == INVALID_NODE_INDEX)
+      heap->orderBitmap &= ~(1u << order);
+  }
+  block.prevFree = block.nextFree = INVALID_NODE_INDEX;
+  block.isFree = false;
+}
+
+void DeviceMemoryAllocator::selectDefragmentationHeap() {
+  const auto lock = lockHeaps();
+  if (_defragmentation.memoryTypeIndex != -1)
+    return;
+
+  // pick the least used heap that comfortably fits in the free space of the other heaps of the same memory type and
+  // allocation strategy
+  VkDeviceSize minSize = UINT64_MAX;
+  for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < _nrOfHeapTypes; memoryTypeIndex++) {
+    for (uint32_t heapIndex = 0; heapIndex < NR_OF_HEAPS; heapIndex++) {
+      const auto &info = _allocationInfos[memoryTypeIndex][heapIndex];
+      auto &abortedAllocationCount = _defragmentation.abortedAllocationCount[memoryTypeIndex][heapIndex];
+      if (info.allocationNotFreed == 0)
+        continue;
+      if (abortedAllocationCount > 0 && info.allocationNotFreed >= abortedAllocationCount)
+        continue;
+      abortedAllocationCount = 0;
+
+      VkDeviceSize freeSizeInOtherHeaps = 0;
+      for (uint32_t i = 0; i < NR_OF_HEAPS; i++) {
+        const auto &otherInfo = _allocationInfos[memoryTypeIndex][i];
+        if (i != heapIndex && otherInfo.totalSize != 0 &&
+            _heapStrategies[memoryTypeIndex][i] == _heapStrategies[memoryTypeIndex][heapIndex])
+          freeSizeInOtherHeaps += otherInfo.totalSize - otherInfo.currentSize;
+      }
+      if (info.currentSize * 2 > info.totalSize || info.currentSize * 2 > freeSizeInOtherHeaps)
+        continue;
+      if (info.currentSize < minSize) {
+        minSize = info.currentSize;
+        _defragmentation.memoryTypeIndex = int32_t(memoryTypeIndex);
+        _defragmentation.heapIndex = heapIndex;
+      }
+    }
+  }
+}
+
+bool DeviceMemoryAllocator::isInDefragmentationHeap(const DeviceHeapAllocation &allocation) const {
+  // a thread cache slot can not be moved out of the heap, its chunk stays allocated until the cache is destroyed
+  if (allocation.threadCacheIndex != UINT32_MAX)
+    return false;
+  const auto lock = lockHeaps();
+  if (_defragmentation.memoryTypeIndex != int32_t(allocation.memoryTypeIndex) ||
+      allocation.largeSizeAllocationIndex != -1)
+    return false;
+  return _deviceMemories[allocation.memoryTypeIndex][_defragmentation.heapIndex] == allocation.deviceMemory;
+}
+
+bool DeviceMemoryAllocator::allocateOutsideDefragmentationHeap(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes,
+                                                               VkDeviceSize alignment,
+                                                               DeviceHeapAllocation *allocation) {
+  const auto lock = lockHeaps();
+  mgAssert(_defragmentation.memoryTypeIndex == int32_t(memoryTypeIndex));
+  const auto strategy = _heapStrategies[memoryTypeIndex][_defragmentation.heapIndex];
+  for (uint32_t heapIndex = 0; heapIndex < NR_OF_HEAPS; heapIndex++) {
+    if (heapIndex == _defragmentation.heapIndex || _allocationInfos[memoryTypeIndex][heapIndex].totalSize == 0)
+      continue;
+    *allocation = {};
+    if (allocateFromHeap(memoryTypeIndex, heapIndex, sizeInBytes, alignment, strategy, allocation))
+      return true;
   }
-  if (prevNode != baseNode && prevNode->offset + prevNode->size == currentNode->offset) {
-    prevNode->size += currentNode->size;
-    prevNode->next = currentNode->next;
-    delete currentNode;
+  return false;
+}
+
+void DeviceMemoryAllocator::abortDefragmentation() {
+  const auto lock = lockHeaps();
+  if (_defragmentation.memoryTypeIndex == -1)
+    return;
+  const auto memoryTypeIndex = _defragmentation.memoryTypeIndex;
+  const auto heapIndex = _defragmentation.heapIndex;
+  _defragmentation.abortedAllocationCount[memoryTypeIndex][heapIndex] =
+      _allocationInfos[memoryTypeIndex][heapIndex].allocationNotFreed;
+  _defragmentation.memoryTypeIndex = -1;
+}
+
+uint32_t DeviceMemoryAllocator::releaseEmptyHeaps() {
+  const auto lock = lockHeaps();
+  if (_defragmentation.memoryTypeIndex != -1 &&
+      _allocationInfos[_defragmentation.memoryTypeIndex][_defragmentation.heapIndex].allocationNotFreed == 0)
+    _defragmentation.memoryTypeIndex = -1;
+
+  uint32_t nrOfReleasedHeaps = 0;
+  for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < _nrOfHeapTypes; memoryTypeIndex++) {
+    uint32_t nrOfHeaps = 0;
+    for (uint32_t heapIndex = 0; heapIndex < NR_OF_HEAPS; heapIndex++) {
+      nrOfHeaps += _allocationInfos[memoryTypeIndex][heapIndex].totalSize != 0;
+    }
+    // keep the last heap around so loading and unloading a single asset does not reallocate device memory
+    for (uint32_t heapIndex = 0; heapIndex < NR_OF_HEAPS && nrOfHeaps > 1; heapIndex++) {
+      const auto &info = _allocationInfos[memoryTypeIndex][heapIndex];
+      if (info.totalSize == 0 || info.allocationNotFreed != 0)
+        continue;
+      destroyHeap(memoryTypeIndex, heapIndex);
+      nrOfHeaps--;
+      nrOfReleasedHeaps++;
+    }
   }
+  return nrOfReleasedHeaps;
 }
 
 std::vector<GuiAllocation> DeviceMemoryAllocator::getAllocationForGUI() {
+  const auto lock = lockHeaps();
   std::vector<GuiAllocation> guiAllocations;
   for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < _nrOfHeapTypes; memoryTypeIndex++) {
     for (uint32_t heapIndex = 0; heapIndex < NR_OF_HEAPS; heapIndex++) {
-      mg::_Node *baseNode = &_memoryPools[memoryTypeIndex][heapIndex];
-      _Node *prevNode = baseNode;
-      if (_allocationInfos[memoryTypeIndex][heapIndex].totalSize == 0 && baseNode->next == nullptr)
+      if (_allocationInfos[memoryTypeIndex][heapIndex].totalSize == 0 &&
+          _firstFreeNodes[memoryTypeIndex][heapIndex] == INVALID_NODE_INDEX)
         continue;
 
       GuiAllocation guiAllocation = {};
@@ -227,25 +771,55 @@ std::vector<GuiAllocation> DeviceMemoryAllocator::getAllocationForGUI() {
       guiAllocation.totalSize = uint32_t(_allocationInfos[memoryTypeIndex][heapIndex].totalSize);
       guiAllocation.totalNrOfAllocation = uint32_t(_allocationInfos[memoryTypeIndex][heapIndex].totalNrOfAllocations);
       guiAllocation.allocationNotFreed = uint32_t(_allocationInfos[memoryTypeIndex][heapIndex].allocationNotFreed);
+      guiAllocation.fragmentation = getHeapStats(memoryTypeIndex, heapIndex).fragmentation;
 
-      for (_Node *currentNode = baseNode->next; currentNode != nullptr;
-           prevNode = currentNode, currentNode = currentNode->next) {
+      if (_heapStrategies[memoryTypeIndex][heapIndex] == DeviceAllocationStrategy::Buddy) {
+        const _BuddyHeap &heap = _buddyHeaps[memoryTypeIndex][heapIndex];
+        for (uint32_t leafIndex = 0; leafIndex < uint32_t(heap.blocks.size());) {
+          const uint32_t nrOfLeaves = 1u << heap.blocks[leafIndex].order;
+          SubAllocationGui subAllocationGui = {};
+          subAllocationGui.free = heap.blocks[leafIndex].isFree;
+          subAllocationGui.offset = leafIndex << _BuddyHeap::MIN_BLOCK_SIZE_LOG2;
+          subAllocationGui.size = nrOfLeaves << _BuddyHeap::MIN_BLOCK_SIZE_LOG2;
+          guiAllocation.elements.push_back(subAllocationGui);
+          leafIndex += nrOfLeaves;
+        }
+        guiAllocations.push_back(guiAllocation);
+        continue;
+      }
+      if (_heapStrategies[memoryTypeIndex][heapIndex] == DeviceAllocationStrategy::Tlsf) {
+        for (uint32_t blockIndex = _tlsfHeaps[memoryTypeIndex][heapIndex].firstBlock;
+             blockIndex != INVALID_NODE_INDEX; blockIndex = _tlsfBlocks[blockIndex].nextPhysical) {
+          SubAllocationGui subAllocationGui = {};
+          subAllocationGui.free = _tlsfBlocks[blockIndex].isFree;
+          subAllocationGui.offset = uint32_t(_tlsfBlocks[blockIndex].offset);
+          subAllocationGui.size = uint32_t(_tlsfBlocks[blockIndex].size);
+          guiAllocation.elements.push_back(subAllocationGui);
+        }
+        guiAllocations.push_back(guiAllocation);
+        continue;
+      }
+
+      VkDeviceSize prevNodeEnd = 0;
+      for (uint32_t currentNode = _firstFreeNodes[memoryTypeIndex][heapIndex]; currentNode != INVALID_NODE_INDEX;
+           currentNode = _nodes[currentNode].next) {
         VkDeviceSize space = 0;
-        space = currentNode->offset - (prevNode->offset + prevNode->size);
+        space = _nodes[currentNode].offset - prevNodeEnd;
         if (space) {
           SubAllocationGui subAllocationGui = {};
           subAllocationGui.free = false;
-          subAllocationGui.offset = uint32_t(currentNode->offset - space);
+          subAllocationGui.offset = uint32_t(_nodes[currentNode].offset - space);
           subAllocationGui.size = uint32_t(space);
           guiAllocation.elements.push_back(subAllocationGui);
         }
         SubAllocationGui subAllocationGui = {};
         subAllocationGui.free = true;
-        subAllocationGui.offset = uint32_t(currentNode->offset);
-        subAllocationGui.size = uint32_t(currentNode->size);
+        subAllocationGui.offset = uint32_t(_nodes[currentNode].offset);
+        subAllocationGui.size = uint32_t(_nodes[currentNode].size);
         guiAllocation.elements.push_back(subAllocationGui);
+        prevNodeEnd = _nodes[currentNode].offset + _nodes[currentNode].size;
       }
-      auto space = _allocationInfos[memoryTypeIndex][heapIndex].totalSize - (prevNode->offset + prevNode->size);
+      auto space = _allocationInfos[memoryTypeIndex][heapIndex].totalSize - prevNodeEnd;
       if (space) {
         SubAllocationGui subAllocationGui = {};
         subAllocationGui.free = false;
@@ -276,4 +850,237 @@ std::vector<GuiAllocation> DeviceMemoryAllocator::getAllocationForGUI() {
   return guiAllocations;
 }
 
+DeviceHeapStats DeviceMemoryAllocator::getHeapStats(uint32_t memoryTypeIndex, uint32_t heapIndex) const {
+  DeviceHeapStats stats = {};
+  stats.memoryTypeIndex = memoryTypeIndex;
+  stats.heapIndex = heapIndex;
+  stats.strategy = _heapStrategies[memoryTypeIndex][heapIndex];
+  stats.totalSize = _allocationInfos[memoryTypeIndex][heapIndex].totalSize;
+  stats.allocatedSize = _allocationInfos[memoryTypeIndex][heapIndex].currentSize;
+
+  const auto addFreeBlock = [&stats](VkDeviceSize size) {
+    stats.freeSize += size;
+    stats.largestFreeBlockSize = std::max(stats.largestFreeBlockSize, size);
+    stats.nrOfFreeBlocks++;
+  };
+  switch (stats.strategy) {
+  case DeviceAllocationStrategy::FirstFit:
+    for (uint32_t currentNode = _firstFreeNodes[memoryTypeIndex][heapIndex]; currentNode != INVALID_NODE_INDEX;
+         currentNode = _nodes[currentNode].next) {
+      addFreeBlock(_nodes[currentNode].size);
+    }
+    break;
+  case DeviceAllocationStrategy::Tlsf:
+    for (uint32_t blockIndex = _tlsfHeaps[memoryTypeIndex][heapIndex].firstBlock; blockIndex != INVALID_NODE_INDEX;
+         blockIndex = _tlsfBlocks[blockIndex].nextPhysical) {
+      if (_tlsfBlocks[blockIndex].isFree)
+        addFreeBlock(_tlsfBlocks[blockIndex].size);
+    }
+    break;
+  case DeviceAllocationStrategy::Buddy: {
+    const _BuddyHeap &heap = _buddyHeaps[memoryTypeIndex][heapIndex];
+    for (uint32_t order = 0; order < heap.nrOfOrders; order++) {
+      for (uint32_t leafIndex = heap.freeLists[order]; leafIndex != INVALID_NODE_INDEX;
+           leafIndex = heap.blocks[leafIndex].nextFree) {
+        addFreeBlock(VkDeviceSize(1) << (order + _BuddyHeap::MIN_BLOCK_SIZE_LOG2));
+      }
+    }
+    break;
+  }
+  }
+  if (stats.freeSize > 0)
+    stats.fragmentation = 1.0f - float(double(stats.largestFreeBlockSize) / double(stats.freeSize));
+  return stats;
+}
+
+std::vector<DeviceHeapStats> DeviceMemoryAllocator::getHeapStats() const {
+  const auto lock = lockHeaps();
+  std::vector<DeviceHeapStats> heapStats;
+  for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < _nrOfHeapTypes; memoryTypeIndex++) {
+    for (uint32_t heapIndex = 0; heapIndex < NR_OF_HEAPS; heapIndex++) {
+      if (_allocationInfos[memoryTypeIndex][heapIndex].totalSize != 0)
+        heapStats.push_back(getHeapStats(memoryTypeIndex, heapIndex));
+    }
+  }
+  return heapStats;
+}
+
+VkDeviceSize DeviceMemoryAllocator::getDeviceMemorySize(uint32_t memoryTypeIndex) const {
+  const auto lock = lockHeaps();
+  VkDeviceSize sizeInBytes = 0;
+  if (memoryTypeIndex < _nrOfHeapTypes) {
+    for (uint32_t heapIndex = 0; heapIndex < NR_OF_HEAPS; heapIndex++) {
+      sizeInBytes += _allocationInfos[memoryTypeIndex][heapIndex].totalSize;
+    }
+  }
+  for (uint32_t i = 0; i < _largeSizeAllocations.size(); i++) {
+    const auto &largeAllocation = _largeSizeAllocations[i];
+    if (largeAllocation.deviceMemory != VK_NULL_HANDLE && largeAllocation.memoryIndex == memoryTypeIndex)
+      sizeInBytes += largeAllocation.size;
+  }
+  return sizeInBytes;
+}
+
+uint32_t DeviceMemoryAllocator::getNrOfHostAllocations() const {
+  const auto lock = lockHeaps();
+  return _nodes.getNrOfHostAllocations() + _tlsfBlocks.getNrOfHostAllocations() +
+         _largeSizeAllocations.getNrOfHostAllocations() + _nrOfBuddyHostAllocations + _nrOfThreadCacheHostAllocations;
+}
+
+std::unique_lock<std::mutex> DeviceMemoryAllocator::lockHeaps() const {
+  std::unique_lock<std::mutex> lock(_heapMutex, std::defer_lock);
+  if (_threadSafe)
+    lock.lock();
+  return lock;
+}
+
+// thread indices are reused when a thread exits, the next thread with the index takes over its thread caches
+static std::mutex _threadIndexMutex;
+static std::vector<uint32_t> _freeThreadIndices;
+static uint32_t _nrOfThreadIndices = 0;
+
+struct ThreadIndex {
+  uint32_t index;
+  ThreadIndex() {
+    std::lock_guard<std::mutex> lock(_threadIndexMutex);
+    if (_freeThreadIndices.size()) {
+      index = _freeThreadIndices.back();
+      _freeThreadIndices.pop_back();
+    } else {
+      index = _nrOfThreadIndices++;
+    }
+  }
+  ~ThreadIndex() {
+    std::lock_guard<std::mutex> lock(_threadIndexMutex);
+    _freeThreadIndices.push_back(index);
+  }
+};
+
+static uint32_t getThreadIndex() {
+  thread_local ThreadIndex threadIndex;
+  return threadIndex.index;
+}
+
+static uint32_t getSlotIndex(uint32_t slot) { return slot & ((1u << _ThreadCache::SLOT_INDEX_BITS) - 1); }
+static uint32_t getChunkIndex(uint32_t slot) { return slot >> _ThreadCache::SLOT_INDEX_BITS; }
+
+DeviceHeapAllocation DeviceMemoryAllocator::allocateFromThreadCache(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes,
+                                                                    VkDeviceSize alignment) {
+  mgAssert(memoryTypeIndex < _nrOfHeapTypes);
+  const auto threadIndex = getThreadIndex();
+  mgAssertDesc(threadIndex < MAX_NR_OF_THREADS, "too many threads allocating device memory at the same time");
+
+  // only the owning thread creates its cache, other threads only see it through its allocations
+  _ThreadCache *cache = _threadCaches[threadIndex].load(std::memory_order_acquire);
+  if (cache == nullptr) {
+    cache = new _ThreadCache();
+    cache->returnedSlots = INVALID_NODE_INDEX;
+    _nrOfThreadCacheHostAllocations++;
+    _threadCaches[threadIndex].store(cache, std::memory_order_release);
+  }
+
+  const VkDeviceSize slotSize =
+      std::max({sizeInBytes, alignment, VkDeviceSize(1) << _ThreadCache::MIN_SIZE_CLASS_LOG2});
+  const uint32_t sizeClass = findLastSetBit(slotSize - 1) + 1 - _ThreadCache::MIN_SIZE_CLASS_LOG2;
+  auto &freeSlots = cache->freeSlots[memoryTypeIndex][sizeClass];
+  if (freeSlots.empty())
+    collectReturnedSlots(cache);
+  if (freeSlots.empty())
+    addThreadCacheChunk(cache, memoryTypeIndex, sizeClass);
+
+  const auto slot = freeSlots.back();
+  freeSlots.pop_back();
+  const _ThreadCacheChunk &chunk = *cache->chunks[getChunkIndex(slot)];
+
+  DeviceHeapAllocation allocation = {};
+  allocation.memoryTypeIndex = memoryTypeIndex;
+  allocation.deviceMemory = chunk.allocation.deviceMemory;
+  allocation.size = sizeInBytes;
+  allocation.offset =
+      chunk.allocation.offset + (VkDeviceSize(getSlotIndex(slot)) << (sizeClass + _ThreadCache::MIN_SIZE_CLASS_LOG2));
+  allocation.heapBlockIndex = slot;
+  allocation.threadCacheIndex = threadIndex;
+  return allocation;
+}
+
+void DeviceMemoryAllocator::freeToThreadCache(const DeviceHeapAllocation &allocation) {
+  mgAssert(allocation.threadCacheIndex < MAX_NR_OF_THREADS);
+  _ThreadCache *cache = _threadCaches[allocation.threadCacheIndex].load(std::memory_order_acquire);
+  mgAssert(cache != nullptr);
+  const auto slot = allocation.heapBlockIndex;
+  const _ThreadCacheChunk &chunk = *cache->chunks[getChunkIndex(slot)];
+  mgAssert(getSlotIndex(slot) < chunk.nrOfSlots);
+
+  if (allocation.threadCacheIndex == getThreadIndex()) {
+    cache->freeSlots[chunk.allocation.memoryTypeIndex][chunk.sizeClass].push_back(slot);
+    return;
+  }
+  // the owner takes the whole stack at once, so pushing can not suffer from ABA
+  auto head = cache->returnedSlots.load(std::memory_order_relaxed);
+  do {
+    chunk.nextReturnedSlots[getSlotIndex(slot)].store(head, std::memory_order_relaxed);
+  } while (!cache->returnedSlots.compare_exchange_weak(head, slot, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+}
+
+void DeviceMemoryAllocator::collectReturnedSlots(_ThreadCache *cache) {
+  auto slot = cache->returnedSlots.exchange(INVALID_NODE_INDEX, std::memory_order_acquire);
+  while (slot != INVALID_NODE_INDEX) {
+    const _ThreadCacheChunk &chunk = *cache->chunks[getChunkIndex(slot)];
+    cache->freeSlots[chunk.allocation.memoryTypeIndex][chunk.sizeClass].push_back(slot);
+    slot = chunk.nextReturnedSlots[getSlotIndex(slot)].load(std::memory_order_relaxed);
+  }
+}
+
+void DeviceMemoryAllocator::addThreadCacheChunk(_ThreadCache *cache, uint32_t memoryTypeIndex, uint32_t sizeClass) {
+  mgAssertDesc(cache->nrOfChunks < _ThreadCache::MAX_NR_OF_CHUNKS, "out of thread cache chunks");
+  const uint32_t slotSizeLog2 = sizeClass + _ThreadCache::MIN_SIZE_CLASS_LOG2;
+
+  auto chunk = std::make_unique<_ThreadCacheChunk>();
+  {
+    const auto lock = lockHeaps();
+    chunk->allocation = allocateFromHeaps(memoryTypeIndex, VkDeviceSize(1) << _ThreadCache::CHUNK_SIZE_LOG2,
+                                          VkDeviceSize(1) << slotSizeLog2, _allocationStrategy);
+  }
+  chunk->sizeClass = sizeClass;
+  chunk->nrOfSlots = 1u << (_ThreadCache::CHUNK_SIZE_LOG2 - slotSizeLog2);
+  chunk->nextReturnedSlots = std::make_unique<std::atomic<uint32_t>[]>(chunk->nrOfSlots);
+
+  // reserve for every slot of the class so frees never allocate
+  auto &freeSlots = cache->freeSlots[memoryTypeIndex][sizeClass];
+  freeSlots.reserve(freeSlots.size() + chunk->nrOfSlots);
+  const uint32_t chunkIndex = cache->nrOfChunks++;
+  for (uint32_t i = chunk->nrOfSlots; i-- > 0;) {
+    freeSlots.push_back((chunkIndex << _ThreadCache::SLOT_INDEX_BITS) | i);
+  }
+  cache->chunks[chunkIndex] = std::move(chunk);
+  _nrOfThreadCacheHostAllocations += 3;
+}
+
+// every thread must be done with the allocator
+void DeviceMemoryAllocator::destroyThreadCaches() {
+  for (uint32_t threadIndex = 0; threadIndex < MAX_NR_OF_THREADS; threadIndex++) {
+    _ThreadCache *cache = _threadCaches[threadIndex].exchange(nullptr);
+    if (cache == nullptr)
+      continue;
+    collectReturnedSlots(cache);
+    for (uint32_t chunkIndex = 0; chunkIndex < cache->nrOfChunks; chunkIndex++) {
+      freeToHeaps(cache->chunks[chunkIndex]->allocation);
+    }
+    for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < VK_MAX_MEMORY_TYPES; memoryTypeIndex++) {
+      for (uint32_t sizeClass = 0; sizeClass < _ThreadCache::NR_OF_SIZE_CLASSES; sizeClass++) {
+        uint32_t nrOfSlots = 0;
+        for (uint32_t chunkIndex = 0; chunkIndex < cache->nrOfChunks; chunkIndex++) {
+          const auto &chunk = *cache->chunks[chunkIndex];
+          if (chunk.allocation.memoryTypeIndex == memoryTypeIndex && chunk.sizeClass == sizeClass)
+            nrOfSlots += chunk.nrOfSlots;
+        }
+        mgAssertDesc(cache->freeSlots[memoryTypeIndex][sizeClass].size() == nrOfSlots,
+                     "thread cache allocations have not been freed");
+      }
+    }
+    delete cache;
+  }
+}
+
 } // namespace mg
\ No newline at end of file
@@ -2,7 +2,13 @@
 #include "vkContext.h"
 #include "mg/mgUtils.h"
 #include "vulkan/vkUtils.h"
+#include "mg/mgAssert.h"
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace mg {
 
@@ -13,12 +19,135 @@ struct DeviceHeapAllocation {
   uint32_t memoryTypeIndex;
   int32_t largeSizeAllocationIndex = -1;
   uint64_t largeSizeGenerationIndex;
+  uint32_t heapBlockIndex = UINT32_MAX;
+  uint32_t threadCacheIndex = UINT32_MAX;
+};
+
+// contiguous storage for allocator bookkeeping, nodes are linked by index and released
+// indices are reused so no host allocations happen once the pool has grown to the working set
+template <class T> class NodePool {
+public:
+  static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+  uint32_t create() {
+    uint32_t index;
+    if (_freeIndices.size()) {
+      index = _freeIndices.back();
+      _freeIndices.pop_back();
+    } else {
+      if (_nodes.size() == _nodes.capacity()) {
+        const auto capacity = std::max<size_t>(64, _nodes.capacity() * 2);
+        _nodes.reserve(capacity);
+        _freeIndices.reserve(capacity);
+        _nrOfHostAllocations += 2;
+      }
+      index = uint32_t(_nodes.size());
+      _nodes.push_back({});
+    }
+    return index;
+  }
+  void release(uint32_t index) {
+    mgAssert(index < _nodes.size());
+    _nodes[index] = {};
+    _freeIndices.push_back(index);
+  }
+  void clear() {
+    _nodes.clear();
+    _freeIndices.clear();
+  }
+
+  T &operator[](uint32_t index) { return _nodes[index]; }
+  const T &operator[](uint32_t index) const { return _nodes[index]; }
+  uint32_t size() const { return uint32_t(_nodes.size()); }
+  uint32_t getNrOfHostAllocations() const { return _nrOfHostAllocations; }
+
+private:
+  std::vector<T> _nodes;
+  std::vector<uint32_t> _freeIndices;
+  uint32_t _nrOfHostAllocations = 0;
 };
 
 struct _Node {
-  _Node *next;
+  uint32_t next;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+};
+
+// two-level segregated fit, blocks are linked by index into the block pool
+struct _TlsfBlock {
   VkDeviceSize offset;
   VkDeviceSize size;
+  uint32_t prevPhysical, nextPhysical;
+  uint32_t prevFree, nextFree;
+  bool isFree;
+};
+
+struct _TlsfHeap {
+  enum { SL_INDEX_COUNT_LOG2 = 5 };
+  enum { SL_INDEX_COUNT = 1 << SL_INDEX_COUNT_LOG2 };
+  enum { FL_INDEX_COUNT = 32 };
+
+  uint32_t flBitmap;
+  uint32_t slBitmaps[FL_INDEX_COUNT];
+  uint32_t freeLists[FL_INDEX_COUNT][SL_INDEX_COUNT];
+  uint32_t firstBlock;
+};
+
+// binary buddy system, blocks are power of two sized and aligned to their size. The bookkeeping is indexed by the
+// first leaf of a block, a leaf is the smallest block size
+struct _BuddyBlock {
+  uint32_t prevFree, nextFree;
+  uint8_t order;
+  bool isFree;
+};
+
+struct _BuddyHeap {
+  enum { MIN_BLOCK_SIZE_LOG2 = 12 };
+  enum { MAX_ORDER_COUNT = 32 };
+
+  uint32_t nrOfOrders;
+  uint32_t orderBitmap;
+  uint32_t freeLists[MAX_ORDER_COUNT];
+  std::vector<_BuddyBlock> blocks;
+};
+
+enum class DeviceAllocationStrategy { FirstFit, Tlsf, Buddy };
+
+// concurrent mode, every thread has its own cache of small allocations. Slots of a power of two size class are carved
+// from chunks allocated from the shared heaps, slots freed by other threads are pushed on a lock free stack and
+// collected by the owning thread
+struct _ThreadCacheChunk {
+  DeviceHeapAllocation allocation;
+  uint32_t sizeClass;
+  uint32_t nrOfSlots;
+  std::unique_ptr<std::atomic<uint32_t>[]> nextReturnedSlots;
+};
+
+struct _ThreadCache {
+  enum { MIN_SIZE_CLASS_LOG2 = 8 };
+  enum { MAX_SIZE_CLASS_LOG2 = 16 };
+  enum { NR_OF_SIZE_CLASSES = MAX_SIZE_CLASS_LOG2 - MIN_SIZE_CLASS_LOG2 + 1 };
+  enum { CHUNK_SIZE_LOG2 = 20 };
+  enum { MAX_NR_OF_CHUNKS = 1024 };
+  // a slot is identified by its chunk index and the slot index in the chunk
+  enum { SLOT_INDEX_BITS = 16 };
+
+  std::atomic<uint32_t> returnedSlots;
+  uint32_t nrOfChunks;
+  std::unique_ptr<_ThreadCacheChunk> chunks[MAX_NR_OF_CHUNKS];
+  std::vector<uint32_t> freeSlots[VK_MAX_MEMORY_TYPES][NR_OF_SIZE_CLASSES];
+};
+
+struct DeviceHeapStats {
+  uint32_t memoryTypeIndex, heapIndex;
+  DeviceAllocationStrategy strategy;
+  VkDeviceSize totalSize;
+  VkDeviceSize allocatedSize;
+  VkDeviceSize freeSize;
+  VkDeviceSize largestFreeBlockSize;
+  uint32_t nrOfFreeBlocks;
+  // 1 - largest free block / free size, 0 when all free memory is contiguous
+  float fragmentation;
 };
 
 struct AllocationInfo {
@@ -35,19 +164,75 @@ public:
   void create(const CreateDeviceHeapAllocatorInfo &createDeviceHeapAllocationInfo);
   void destroy();
   DeviceHeapAllocation allocateDeviceOnlyMemory(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes, VkDeviceSize alignment);
+  // heaps are created with the strategy of the first allocation, and only serve allocations with the same strategy
+  DeviceHeapAllocation allocateDeviceOnlyMemory(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes,
+                                                VkDeviceSize alignment, DeviceAllocationStrategy strategy);
   void freeDeviceOnlyMemory(const DeviceHeapAllocation &allocation);
 
+  // defragmentation, live allocations are moved out of a sparsely used heap until it is empty and can be released
+  void selectDefragmentationHeap();
+  bool isInDefragmentationHeap(const DeviceHeapAllocation &allocation) const;
+  bool allocateOutsideDefragmentationHeap(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes, VkDeviceSize alignment,
+                                          DeviceHeapAllocation *allocation);
+  void abortDefragmentation();
+  uint32_t releaseEmptyHeaps();
+
   std::vector<GuiAllocation> getAllocationForGUI();
+  std::vector<DeviceHeapStats> getHeapStats() const;
+  // device memory allocated from vulkan for a memory type, heaps and large allocations
+  VkDeviceSize getDeviceMemorySize(uint32_t memoryTypeIndex) const;
+  uint32_t getNrOfHostAllocations() const;
   ~DeviceMemoryAllocator();
 
   enum { NR_OF_HEAPS = 4 };
+  enum { MAX_NR_OF_THREADS = 64 };
 
 private:
+  DeviceHeapAllocation allocateFromHeaps(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes, VkDeviceSize alignment,
+                                         DeviceAllocationStrategy strategy);
+  void freeToHeaps(const DeviceHeapAllocation &allocation);
+  std::unique_lock<std::mutex> lockHeaps() const;
+
+  DeviceHeapAllocation allocateFromThreadCache(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes,
+                                               VkDeviceSize alignment);
+  void freeToThreadCache(const DeviceHeapAllocation &allocation);
+  void addThreadCacheChunk(_ThreadCache *cache, uint32_t memoryTypeIndex, uint32_t sizeClass);
+  void collectReturnedSlots(_ThreadCache *cache);
+  void destroyThreadCaches();
+
   DeviceHeapAllocation allocateLargeDeviceOnlyMemory(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes, VkDeviceSize alignment);
   void freeLargeDeviceOnlyMemory(const DeviceHeapAllocation &allocation);
 
+  void createHeap(uint32_t memoryTypeIndex, uint32_t heapIndex, DeviceAllocationStrategy strategy);
+  void destroyHeap(uint32_t memoryTypeIndex, uint32_t heapIndex);
+  bool allocateFromHeap(uint32_t memoryTypeIndex, uint32_t heapIndex, VkDeviceSize sizeInBytes,
+                        VkDeviceSize alignment, DeviceAllocationStrategy strategy, DeviceHeapAllocation *allocation);
+  DeviceHeapStats getHeapStats(uint32_t memoryTypeIndex, uint32_t heapIndex) const;
+  bool allocateFromFirstFitHeap(uint32_t memoryTypeIndex, uint32_t heapIndex, VkDeviceSize sizeInBytes,
+                                VkDeviceSize alignment, DeviceHeapAllocation *allocation);
+  void freeToFirstFitHeap(uint32_t memoryTypeIndex, uint32_t heapIndex, const DeviceHeapAllocation &allocation);
+  bool allocateFromTlsfHeap(uint32_t memoryTypeIndex, uint32_t heapIndex, VkDeviceSize sizeInBytes,
+                            VkDeviceSize alignment, DeviceHeapAllocation *allocation);
+  void freeToTlsfHeap(uint32_t memoryTypeIndex, uint32_t heapIndex, const DeviceHeapAllocation &allocation);
+  bool allocateFromBuddyHeap(uint32_t memoryTypeIndex, uint32_t heapIndex, VkDeviceSize sizeInBytes,
+                             VkDeviceSize alignment, DeviceHeapAllocation *allocation);
+  void freeToBuddyHeap(uint32_t memoryTypeIndex, uint32_t heapIndex, const DeviceHeapAllocation &allocation);
+
+  uint32_t createTlsfBlock();
+  void insertFreeTlsfBlock(_TlsfHeap *heap, uint32_t blockIndex);
+  void removeFreeTlsfBlock(_TlsfHeap *heap, uint32_t blockIndex);
+  void insertFreeBuddyBlock(_BuddyHeap *heap, uint32_t leafIndex);
+  void removeFreeBuddyBlock(_BuddyHeap *heap, uint32_t leafIndex);
+
   VkDeviceMemory _deviceMemories[VK_MAX_MEMORY_TYPES][NR_OF_HEAPS];
-  _Node _memoryPools[VK_MAX_MEMORY_TYPES][NR_OF_HEAPS];
+  uint32_t _firstFreeNodes[VK_MAX_MEMORY_TYPES][NR_OF_HEAPS];
+  NodePool<_Node> _nodes;
+  _TlsfHeap _tlsfHeaps[VK_MAX_MEMORY_TYPES][NR_OF_HEAPS];
+  NodePool<_TlsfBlock> _tlsfBlocks;
+  _BuddyHeap _buddyHeaps[VK_MAX_MEMORY_TYPES][NR_OF_HEAPS];
+  uint32_t _nrOfBuddyHostAllocations = 0;
+  DeviceAllocationStrategy _allocationStrategy;
+  DeviceAllocationStrategy _heapStrategies[VK_MAX_MEMORY_TYPES][NR_OF_HEAPS];
   AllocationInfo _allocationInfos[VK_MAX_MEMORY_TYPES][NR_OF_HEAPS];
   uint32_t _heapSizes[NR_OF_HEAPS];
   uint32_t _maxHeapSize;
@@ -57,6 +242,13 @@ private:
   bool _hasBeenDelete = true;
   uint64_t _largSizeGenerationIndex = 0;
 
+  struct {
+    int32_t memoryTypeIndex = -1;
+    uint32_t heapIndex;
+    // heaps with allocations that could not be moved are skipped until something is freed from them
+    int32_t abortedAllocationCount[VK_MAX_MEMORY_TYPES][NR_OF_HEAPS];
+  } _defragmentation;
+
   // allocations larger than the biggest heap
   struct LargeAllocation {
     VkDeviceMemory deviceMemory;
@@ -64,10 +256,19 @@ private:
     uint32_t memoryIndex;
     uint64_t generationIndex;
   };
-  std::vector<LargeAllocation> _largeSizeAllocations;
+  NodePool<LargeAllocation> _largeSizeAllocations;
+
+  // only used in concurrent mode, the shared heaps are guarded by the mutex
+  bool _threadSafe = false;
+  mutable std::mutex _heapMutex;
+  std::atomic<_ThreadCache *> _threadCaches[MAX_NR_OF_THREADS];
+  std::atomic<uint32_t> _nrOfThreadCacheHostAllocations;
 };
 
 struct CreateDeviceHeapAllocatorInfo {
+  DeviceAllocationStrategy allocationStrategy = DeviceAllocationStrategy::FirstFit;
+  // allocations and frees can be made from any thread, small allocations go through per thread caches
+  bool threadSafe = false;
   bool useDifferentHeapsForSmallAllocations;
   uint32_t smallSizeAllocationThreshold;
   std::array<uint32_t, DeviceMemoryAllocator::NR_OF_HEAPS> heapSizes;
@@ -95,19 +95,17 @@ static void renderCommandList(const ImguiBuffer &imguiBuffer, const mg::Pipeline
   dynamic->uTranslate = glm::vec2{translate[0] = -1.0f - imDrawData->DisplayPos.x * scale[0],
                                   translate[1] = -1.0f - imDrawData->DisplayPos.y * scale[1]};
 
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &imguiBuffer.buffer, &imguiBuffer.bufferOffset);
-  vkCmdBindIndexBuffer(mg::vkContext.commandBuffer, imguiBuffer.buffer, imguiBuffer.indicesOffset,
-                       VK_INDEX_TYPE_UINT16);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &imguiBuffer.buffer, &imguiBuffer.bufferOffset);
+  mg::mgSystem.commandRecorder.bindIndexBuffer(imguiBuffer.buffer, imguiBuffer.indicesOffset, VK_INDEX_TYPE_UINT16);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(pipeline);
   DescriptorSets descriptorSets = {};
   descriptorSets.ubo = uboSet;
   descriptorSets.textures = mg::getTextureDescriptorSet();
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(pipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.textureIndex = mg::getTexture2DDescriptorIndex(fontTextureId);
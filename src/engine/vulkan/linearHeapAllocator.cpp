@@ -10,148 +10,323 @@
 // the range member of each element of pBufferInfo, or the effective range if range is VK_WHOLE_SIZE, must be less than
 // or equal to VkPhysicalDeviceLimits::maxUniformBufferRange'
 // https://www.khronos.org/registry/vulkan/specs/1.0/html/vkspec.html#VUID-VkWriteDescriptorSet-descriptorType-00332
-static constexpr uint32_t uniformBufferSizeInBytes = 1u << 16; // 64 kb
-static constexpr uint32_t storageBufferSizeInBytes = 1u << 25; // 2 meg
-static constexpr uint32_t vertexBufferSizeInBytes = 1u << 25;  // 32 meg
 static constexpr uint32_t stagingBufferSizeInBytes = 1u << 25; // 128 meg
 static constexpr uint32_t MAX_ALLOC = 2048;
+static constexpr uint32_t nrOfDescriptorSetsPerPool = 64;
 
 static constexpr struct {
   VkMemoryPropertyFlags requiredProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
   VkBufferUsageFlags vertexBufferUsageFlags =
       VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_NV;
+  VkBufferUsageFlags storageBufferUsageFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
 } usageFlags;
 
 namespace mg {
 
-static mg::_Buffer _createLinearBuffer(uint32_t bufferSizeInBytes, VkBufferUsageFlags vkBufferUsageFlags,
-                                       VkMemoryPropertyFlags requiredProperties,
-                                       VkMemoryPropertyFlags preferredProperties) {
-  mg::_Buffer buffer = {};
+static _LinearPage createLinearPage(VkDeviceSize sizeInBytes, VkBufferUsageFlags vkBufferUsageFlags,
+                                    uint32_t *memoryTypeIndex) {
+  _LinearPage page = {};
+  page.size = sizeInBytes;
+
   VkBufferCreateInfo vkBufferCreateInfo = {};
   vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  vkBufferCreateInfo.size = bufferSizeInBytes;
+  vkBufferCreateInfo.size = sizeInBytes;
   vkBufferCreateInfo.usage = vkBufferUsageFlags;
   vkBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // buffer is exclusive to a single queue family at a time.
 
-  for (uint32_t i = 0; i < NrOfBuffers; i++) {
-    checkResult(vkCreateBuffer(mg::vkContext.device, &vkBufferCreateInfo, nullptr, &buffer.bufferViews[i].vkBuffer));
-  }
+  checkResult(vkCreateBuffer(mg::vkContext.device, &vkBufferCreateInfo, nullptr, &page.vkBuffer));
 
-  // validation gives a warning if vkGetBufferMemoryRequirements has not been called on all buffers
   VkMemoryRequirements vkMemoryRequirements = {};
-  for (uint32_t i = 0; i < NrOfBuffers; i++)
-    vkGetBufferMemoryRequirements(mg::vkContext.device, buffer.bufferViews[i].vkBuffer, &vkMemoryRequirements);
+  vkGetBufferMemoryRequirements(mg::vkContext.device, page.vkBuffer, &vkMemoryRequirements);
 
   // VK_MEMORY_PROPERTY_HOST_COHERENT_BIT is not cached and does not need be flushed
-  const auto memoryTypeIndex =
-      findMemoryTypeIndex(mg::vkContext.physicalDeviceMemoryProperties, vkMemoryRequirements.memoryTypeBits,
-                          requiredProperties, preferredProperties);
-  const auto alignedSize = vkMemoryRequirements.size;
-  buffer.alignedSize = alignedSize;
+  *memoryTypeIndex = findMemoryTypeIndex(mg::vkContext.physicalDeviceMemoryProperties,
+                                         vkMemoryRequirements.memoryTypeBits, usageFlags.requiredProperties);
 
   VkMemoryAllocateInfo vkMemoryAllocateInfo = {};
   vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  vkMemoryAllocateInfo.allocationSize = alignedSize * NrOfBuffers;
-  vkMemoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+  vkMemoryAllocateInfo.allocationSize = vkMemoryRequirements.size;
+  vkMemoryAllocateInfo.memoryTypeIndex = *memoryTypeIndex;
 
-  checkResult(vkAllocateMemory(mg::vkContext.device, &vkMemoryAllocateInfo, nullptr, &buffer.deviceMemory));
-
-  for (uint32_t i = 0; i < NrOfBuffers; i++)
-    checkResult(
-        vkBindBufferMemory(mg::vkContext.device, buffer.bufferViews[i].vkBuffer, buffer.deviceMemory, alignedSize * i));
+  checkResult(vkAllocateMemory(mg::vkContext.device, &vkMemoryAllocateInfo, nullptr, &page.deviceMemory));
+  checkResult(vkBindBufferMemory(mg::vkContext.device, page.vkBuffer, page.deviceMemory, 0));
 
   void *data = nullptr;
-  checkResult(vkMapMemory(mg::vkContext.device, buffer.deviceMemory, 0, VK_WHOLE_SIZE, 0, &data));
+  checkResult(vkMapMemory(mg::vkContext.device, page.deviceMemory, 0, VK_WHOLE_SIZE, 0, &data));
+  page.data = (char *)data;
+
+  return page;
+}
+
+static void destroyLinearPage(_LinearPage *page) {
+  vkUnmapMemory(mg::vkContext.device, page->deviceMemory);
+  vkDestroyBuffer(mg::vkContext.device, page->vkBuffer, nullptr);
+  vkFreeMemory(mg::vkContext.device, page->deviceMemory, nullptr);
+  page->vkBuffer = VK_NULL_HANDLE;
+  page->deviceMemory = VK_NULL_HANDLE;
+}
+
+static constexpr uint32_t pageIndexShift = 48;
+
+static uint64_t packPageIndexAndOffset(uint32_t pageIndex, VkDeviceSize offset) {
+  return (uint64_t(pageIndex) << pageIndexShift) | offset;
+}
+static uint32_t getPageIndex(uint64_t pageIndexAndOffset) { return uint32_t(pageIndexAndOffset >> pageIndexShift); }
+static VkDeviceSize getOffset(uint64_t pageIndexAndOffset) {
+  return pageIndexAndOffset & ((uint64_t(1) << pageIndexShift) - 1);
+}
+
+// every buffer view starts with one page
+static void createLinearBufferView(mg::_Buffer *buffer, uint32_t bufferIndex) {
+  auto &bufferView = buffer->bufferViews[bufferIndex];
+  bufferView.pages.reserve(MaxNrOfLinearPages);
+  bufferView.pages.push_back(createLinearPage(buffer->pageSize, buffer->usage, &buffer->memoryTypeIndex));
+  bufferView.pageIndexAndOffset = 0;
+  bufferView.nrOfQuietFrames = 0;
+  bufferView.maxNrOfPagesUsed = 0;
+}
+
+static void destroyLinearBufferView(mg::_Buffer *buffer, uint32_t bufferIndex) {
+  auto &bufferView = buffer->bufferViews[bufferIndex];
+  for (auto &page : bufferView.pages) {
+    destroyLinearPage(&page);
+  }
+  bufferView.pages.clear();
+  bufferView.pageIndexAndOffset = 0;
+}
+
+static void createLinearBuffer(mg::_Buffer *buffer, VkDeviceSize pageSizeInBytes, VkDeviceSize chunkSizeInBytes,
+                               VkBufferUsageFlags vkBufferUsageFlags, uint32_t nrOfBuffers) {
+  buffer->pageSize = pageSizeInBytes;
+  buffer->chunkSize = chunkSizeInBytes;
+  buffer->usage = vkBufferUsageFlags;
 
-  for (uint32_t i = 0; i < NrOfBuffers; i++) {
-    buffer.bufferViews[i].data = (char *)data + alignedSize * i;
-    buffer.bufferViews[i].offset = 0;
+  for (uint32_t i = 0; i < nrOfBuffers; i++) {
+    createLinearBufferView(buffer, i);
   }
-  return buffer;
+}
+
+// pages past the first half of the chain double in size, device memory runs out long before the reserved pages do
+static VkDeviceSize getNewPageSize(const mg::_Buffer &dynamicBuffer, uint32_t nrOfPages, VkDeviceSize requiredSize) {
+  VkDeviceSize pageSize = dynamicBuffer.pageSize;
+  if (nrOfPages >= MaxNrOfLinearPages / 2)
+    pageSize <<= nrOfPages - MaxNrOfLinearPages / 2 + 1;
+  // the offset into a page must fit next to the page index
+  pageSize = std::min(pageSize, VkDeviceSize(1) << (pageIndexShift - 2));
+  return std::max(pageSize, requiredSize);
 }
 
 static void destroyLinearBuffer(mg::_Buffer *dynamicBuffer) {
-  vkUnmapMemory(mg::vkContext.device, dynamicBuffer->deviceMemory);
-  for (uint32_t i = 0; i < NrOfBuffers; i++) {
-    vkDestroyBuffer(mg::vkContext.device, dynamicBuffer->bufferViews[i].vkBuffer, nullptr);
-    dynamicBuffer->bufferViews[i].vkBuffer = VK_NULL_HANDLE;
-  }
-  vkFreeMemory
-  (mg::vkContext.device, dynamicBuffer->deviceMemory, nullptr);
-  dynamicBuffer->deviceMemory = VK_NULL_HANDLE;
-}
-
-static _UniformBuffer createUniformBuffer(VkDeviceSize bufferSizeInBytes, VkMemoryPropertyFlags requiredProperties,
-                                          VkMemoryPropertyFlags preferredProperties,
-                                          VkDescriptorSet vkDescriptorSet[NrOfBuffers]) {
-  _UniformBuffer dynamicUniformBuffer = {};
-  dynamicUniformBuffer.buffer = _createLinearBuffer(uniformBufferSizeInBytes, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                    requiredProperties, preferredProperties);
-
-  for (uint32_t i = 0; i < NrOfBuffers; i++) {
-    VkDescriptorBufferInfo vkDescriptorBufferInfo = {};
-    vkDescriptorBufferInfo.buffer = dynamicUniformBuffer.buffer.bufferViews[i].vkBuffer;
-    vkDescriptorBufferInfo.range = MAX_ALLOC;
-
-    VkWriteDescriptorSet vkWriteDescriptorSet = {};
-    vkWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    vkWriteDescriptorSet.dstBinding = 0;
-    vkWriteDescriptorSet.descriptorCount = 1;
-    vkWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    vkWriteDescriptorSet.pBufferInfo = &vkDescriptorBufferInfo;
-    vkWriteDescriptorSet.dstSet = vkDescriptorSet[i];
-
-    vkUpdateDescriptorSets(mg::vkContext.device, 1, &vkWriteDescriptorSet, 0, nullptr);
-  }
-  return dynamicUniformBuffer;
-}
-
-static _StorageBuffer createStorageBuffers(VkDeviceSize bufferSizeInBytes, VkMemoryPropertyFlags requiredProperties,
-                                           VkMemoryPropertyFlags preferredProperties,
-                                           VkDescriptorSet vkDescriptorSets[NrOfBuffers]) {
-  _StorageBuffer dynamicStorageBuffer = {};
-  dynamicStorageBuffer.buffer = _createLinearBuffer(
-      storageBufferSizeInBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
-                                                    requiredProperties, preferredProperties);
-
-  for (uint32_t i = 0; i < NrOfBuffers; i++) {
-    VkDescriptorBufferInfo vkDescriptorBufferInfo = {};
-    vkDescriptorBufferInfo.buffer = dynamicStorageBuffer.buffer.bufferViews[i].vkBuffer;
-    vkDescriptorBufferInfo.range = VK_WHOLE_SIZE;
-
-    VkWriteDescriptorSet vkWriteDescriptorSet = {};
-    vkWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    vkWriteDescriptorSet.dstSet = vkDescriptorSets[i];
-    vkWriteDescriptorSet.dstBinding = 1;
-    vkWriteDescriptorSet.descriptorCount = 1;
-    vkWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
-    vkWriteDescriptorSet.pBufferInfo = &vkDescriptorBufferInfo;
-
-    vkUpdateDescriptorSets(mg::vkContext.device, 1, &vkWriteDescriptorSet, 0, nullptr);
-  }
-  return dynamicStorageBuffer;
-}
-
-static void *allocateDynamicBuffer(mg::_Buffer *dynamicBuffer, uint32_t currentBufferIndex, VkDeviceSize sizeInBytes,
-                                   VkBuffer *buffer, VkDeviceSize *offset) {
-  mgAssertDesc((dynamicBuffer->bufferViews[currentBufferIndex].offset + sizeInBytes) <= dynamicBuffer->alignedSize,
-               "Out of dynamic vertex buffer space");
-  *buffer = dynamicBuffer->bufferViews[currentBufferIndex].vkBuffer;
-  *offset = dynamicBuffer->bufferViews[currentBufferIndex].offset;
-
-  char *data =
-      dynamicBuffer->bufferViews[currentBufferIndex].data + dynamicBuffer->bufferViews[currentBufferIndex].offset;
-  dynamicBuffer->bufferViews[currentBufferIndex].offset += sizeInBytes;
+  for (uint32_t i = 0; i < MaxNrOfBuffers; i++) {
+    destroyLinearBufferView(dynamicBuffer, i);
+  }
+}
 
-  return (void *)data;
+static VkDeviceSize getUsedSize(const mg::_Buffer &dynamicBuffer, uint32_t bufferIndex) {
+  const auto &bufferView = dynamicBuffer.bufferViews[bufferIndex];
+  const auto pageIndexAndOffset = bufferView.pageIndexAndOffset.load();
+  const auto pageIndex = getPageIndex(pageIndexAndOffset);
+  // the offset can be past the end of the page when an allocation did not fit
+  VkDeviceSize usedSize = std::min(getOffset(pageIndexAndOffset), bufferView.pages[pageIndex].size);
+  for (uint32_t i = 0; i < pageIndex; i++) {
+    usedSize += bufferView.pages[i].size;
+  }
+  return usedSize;
+}
+
+static VkDeviceSize getTotalSize(const mg::_Buffer &dynamicBuffer, uint32_t bufferIndex) {
+  VkDeviceSize totalSize = 0;
+  for (const auto &page : dynamicBuffer.bufferViews[bufferIndex].pages) {
+    totalSize += page.size;
+  }
+  return totalSize;
+}
+
+static void writeLinearDescriptorSet(const _LinearDescriptorSet &descriptorSet) {
+  VkDescriptorBufferInfo uniformBufferInfo = {};
+  uniformBufferInfo.buffer = descriptorSet.uniformBuffer;
+  uniformBufferInfo.range = MAX_ALLOC;
+
+  VkDescriptorBufferInfo storageBufferInfo = {};
+  storageBufferInfo.buffer = descriptorSet.storageBuffer;
+  storageBufferInfo.range = VK_WHOLE_SIZE;
+
+  VkWriteDescriptorSet vkWriteDescriptorSets[2] = {};
+  vkWriteDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  vkWriteDescriptorSets[0].dstSet = descriptorSet.vkDescriptorSet;
+  vkWriteDescriptorSets[0].dstBinding = 0;
+  vkWriteDescriptorSets[0].descriptorCount = 1;
+  vkWriteDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  vkWriteDescriptorSets[0].pBufferInfo = &uniformBufferInfo;
+
+  vkWriteDescriptorSets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  vkWriteDescriptorSets[1].dstSet = descriptorSet.vkDescriptorSet;
+  vkWriteDescriptorSets[1].dstBinding = 1;
+  vkWriteDescriptorSets[1].descriptorCount = 1;
+  vkWriteDescriptorSets[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  vkWriteDescriptorSets[1].pBufferInfo = &storageBufferInfo;
+
+  vkUpdateDescriptorSets(mg::vkContext.device, mg::countof(vkWriteDescriptorSets), vkWriteDescriptorSets, 0, nullptr);
+}
+
+static VkDescriptorPool createLinearDescriptorPool() {
+  VkDescriptorPoolSize descriptorPoolSizes[2] = {};
+  descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  descriptorPoolSizes[0].descriptorCount = nrOfDescriptorSetsPerPool;
+  descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  descriptorPoolSizes[1].descriptorCount = nrOfDescriptorSetsPerPool;
+
+  VkDescriptorPoolCreateInfo createInfo = {};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  createInfo.poolSizeCount = mg::countof(descriptorPoolSizes);
+  createInfo.pPoolSizes = descriptorPoolSizes;
+  createInfo.maxSets = nrOfDescriptorSetsPerPool;
+  createInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+  VkDescriptorPool vkDescriptorPool;
+  checkResult(vkCreateDescriptorPool(mg::vkContext.device, &createInfo, nullptr, &vkDescriptorPool));
+  return vkDescriptorPool;
 }
 
 LinearHeapAllocator::~LinearHeapAllocator() { /*mgAssert(_hasBeenDelete == true);*/ }
 
+// rangeInBytes is the part of the page that must be addressable from the returned offset, for uniform buffers it is
+// the range written in the descriptor set
+const _LinearPage &LinearHeapAllocator::reserveDynamicBuffer(_Buffer *dynamicBuffer, VkDeviceSize sizeInBytes,
+                                                             VkDeviceSize rangeInBytes, VkDeviceSize *offset) {
+  auto &bufferView = dynamicBuffer->bufferViews[_currentBufferIndex];
+  const auto requiredSize = std::max(sizeInBytes, rangeInBytes);
+
+  while (true) {
+    const auto pageIndexAndOffset = bufferView.pageIndexAndOffset.fetch_add(sizeInBytes);
+    const auto pageIndex = getPageIndex(pageIndexAndOffset);
+    const auto &currentPage = bufferView.pages[pageIndex];
+    *offset = getOffset(pageIndexAndOffset);
+    if (*offset + requiredSize <= currentPage.size)
+      return currentPage;
+
+    // the page is full, the first thread that gets the lock moves the buffer view to the next page
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (getPageIndex(bufferView.pageIndexAndOffset.load()) != pageIndex)
+      continue;
+
+    // continue in the first unused page that is large enough, grow the chain if there is none. the page is moved
+    // next to the used pages so that the pages used in a frame are always at the front of the chain
+    auto &pages = bufferView.pages;
+    const auto nextPageIndex = pageIndex + 1;
+    auto page = std::find_if(pages.begin() + nextPageIndex, pages.end(),
+                             [requiredSize](const _LinearPage &page) { return page.size >= requiredSize; });
+    if (page == pages.end()) {
+      const auto pageSize = getNewPageSize(*dynamicBuffer, uint32_t(pages.size()), requiredSize);
+      const auto newPage = createLinearPage(pageSize, dynamicBuffer->usage, &dynamicBuffer->memoryTypeIndex);
+      page = pages.insert(pages.end(), newPage);
+    }
+    std::swap(pages[nextPageIndex], *page);
+    bufferView.pageIndexAndOffset = packPageIndexAndOffset(nextPageIndex, 0);
+  }
+}
+
+void *LinearHeapAllocator::allocateDynamicBuffer(_Buffer *dynamicBuffer, VkDeviceSize sizeInBytes,
+                                                 VkDeviceSize rangeInBytes, VkBuffer *buffer, VkDeviceSize *offset) {
+  const auto &page = reserveDynamicBuffer(dynamicBuffer, sizeInBytes, rangeInBytes, offset);
+  *buffer = page.vkBuffer;
+  return (void *)(page.data + *offset);
+}
+
+void *LinearHeapAllocator::allocateFromArena(LinearHeapArena *arena, _LinearChunk *chunk, _Buffer *dynamicBuffer,
+                                             VkDeviceSize sizeInBytes, VkDeviceSize rangeInBytes, VkBuffer *buffer,
+                                             VkDeviceSize *offset) {
+  if (arena->frameIndex != _frameIndex) {
+    arena->vertex = {};
+    arena->uniform = {};
+    arena->storage = {};
+    arena->descriptorSet = {};
+    arena->frameIndex = _frameIndex;
+  }
+
+  if (chunk->vkBuffer == VK_NULL_HANDLE || chunk->offset + sizeInBytes > chunk->end ||
+      chunk->offset + rangeInBytes > chunk->pageSize) {
+    const auto chunkSize = std::max(dynamicBuffer->chunkSize, sizeInBytes);
+    VkDeviceSize chunkOffset;
+    const auto &page = reserveDynamicBuffer(dynamicBuffer, chunkSize, rangeInBytes, &chunkOffset);
+    chunk->vkBuffer = page.vkBuffer;
+    chunk->data = page.data;
+    chunk->offset = chunkOffset;
+    chunk->end = chunkOffset + chunkSize;
+    chunk->pageSize = page.size;
+  }
+  *buffer = chunk->vkBuffer;
+  *offset = chunk->offset;
+
+  char *data = chunk->data + chunk->offset;
+  chunk->offset += sizeInBytes;
+  return (void *)data;
+}
+
 void *LinearHeapAllocator::allocateBuffer(VkDeviceSize sizeInBytes, VkBuffer *buffer, VkDeviceSize *offset) {
-  VkDeviceSize alignedSize = mg::alignUpPowerOfTwo(sizeInBytes, 256); 
-  return allocateDynamicBuffer(&_vertexBuffer, _currentBufferIndex, alignedSize, buffer, offset);
+  VkDeviceSize alignedSize = mg::alignUpPowerOfTwo(sizeInBytes, 256);
+  return allocateDynamicBuffer(&_vertexBuffer, alignedSize, 0, buffer, offset);
+}
+
+VkDescriptorSet LinearHeapAllocator::getDescriptorSet(VkBuffer uniformBuffer, VkBuffer storageBuffer,
+                                                      _LinearDescriptorSet *lastDescriptorSet) {
+  // the first page of a buffer view is bound when nothing has been allocated from it
+  if (uniformBuffer == VK_NULL_HANDLE)
+    uniformBuffer = _uniformBuffer.buffer.bufferViews[_currentBufferIndex].pages[0].vkBuffer;
+  if (storageBuffer == VK_NULL_HANDLE)
+    storageBuffer = _storageBuffer.buffer.bufferViews[_currentBufferIndex].pages[0].vkBuffer;
+
+  if (lastDescriptorSet->vkDescriptorSet != VK_NULL_HANDLE && lastDescriptorSet->uniformBuffer == uniformBuffer &&
+      lastDescriptorSet->storageBuffer == storageBuffer)
+    return lastDescriptorSet->vkDescriptorSet;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (const auto &cachedDescriptorSet : _descriptorSets[_currentBufferIndex]) {
+    if (cachedDescriptorSet.uniformBuffer == uniformBuffer && cachedDescriptorSet.storageBuffer == storageBuffer) {
+      *lastDescriptorSet = cachedDescriptorSet;
+      return cachedDescriptorSet.vkDescriptorSet;
+    }
+  }
+
+  _LinearDescriptorSet descriptorSet = {};
+  descriptorSet.uniformBuffer = uniformBuffer;
+  descriptorSet.storageBuffer = storageBuffer;
+  allocateDescriptorSet(&descriptorSet);
+  writeLinearDescriptorSet(descriptorSet);
+  _descriptorSets[_currentBufferIndex].push_back(descriptorSet);
+  *lastDescriptorSet = descriptorSet;
+  return descriptorSet.vkDescriptorSet;
+}
+
+// all sets have the same layout, so a pool with free sets can not fail because of fragmentation
+void LinearHeapAllocator::allocateDescriptorSet(_LinearDescriptorSet *descriptorSet) {
+  auto descriptorPool = std::find_if(_descriptorPools.begin(), _descriptorPools.end(),
+                                     [](const _LinearDescriptorPool &pool) { return pool.nrOfFreeSets > 0; });
+  if (descriptorPool == _descriptorPools.end()) {
+    descriptorPool = _descriptorPools.insert(_descriptorPools.end(),
+                                             {createLinearDescriptorPool(), nrOfDescriptorSetsPerPool});
+  }
+
+  VkDescriptorSetAllocateInfo vkDescriptorSetAllocateInfo = {};
+  vkDescriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  vkDescriptorSetAllocateInfo.descriptorPool = descriptorPool->vkDescriptorPool;
+  vkDescriptorSetAllocateInfo.pSetLayouts = &mg::vkContext.descriptorSetLayout.dynamic;
+  vkDescriptorSetAllocateInfo.descriptorSetCount = 1;
+  checkResult(
+      vkAllocateDescriptorSets(mg::vkContext.device, &vkDescriptorSetAllocateInfo, &descriptorSet->vkDescriptorSet));
+  descriptorPool->nrOfFreeSets--;
+  descriptorSet->vkDescriptorPool = descriptorPool->vkDescriptorPool;
+}
+
+void LinearHeapAllocator::freeDescriptorSet(const _LinearDescriptorSet &descriptorSet) {
+  checkResult(vkFreeDescriptorSets(mg::vkContext.device, descriptorSet.vkDescriptorPool, 1,
+                                   &descriptorSet.vkDescriptorSet));
+  const auto descriptorPool =
+      std::find_if(_descriptorPools.begin(), _descriptorPools.end(), [&descriptorSet](const auto &pool) {
+        return pool.vkDescriptorPool == descriptorSet.vkDescriptorPool;
+      });
+  mgAssert(descriptorPool != _descriptorPools.end());
+  descriptorPool->nrOfFreeSets++;
 }
 
 void *LinearHeapAllocator::allocateUniform(VkDeviceSize sizeInBytes, VkBuffer *buffer, uint32_t *offset,
@@ -160,10 +335,9 @@ void *LinearHeapAllocator::allocateUniform(VkDeviceSize sizeInBytes, VkBuffer *b
   VkDeviceSize alignedSize = mg::alignUpPowerOfTwo(sizeInBytes, alignment);
 
   VkDeviceSize vkDeviceSizeOffset;
-  auto *data =
-      allocateDynamicBuffer(&_uniformBuffer.buffer, _currentBufferIndex, alignedSize, buffer, &vkDeviceSizeOffset);
+  auto *data = allocateDynamicBuffer(&_uniformBuffer.buffer, alignedSize, MAX_ALLOC, buffer, &vkDeviceSizeOffset);
   *offset = static_cast<uint32_t>(vkDeviceSizeOffset);
-  *vkDescriptorSet = _vkDescriptorSets[_currentBufferIndex];
+  *vkDescriptorSet = getDescriptorSet(*buffer, _lastDescriptorSet.storageBuffer, &_lastDescriptorSet);
 
   return data;
 }
@@ -174,32 +348,62 @@ void *LinearHeapAllocator::allocateStorage(VkDeviceSize sizeInBytes, VkBuffer *b
   VkDeviceSize alignedSize = mg::alignUpPowerOfTwo(sizeInBytes, alignment);
 
   VkDeviceSize vkDeviceSizeOffset;
-  auto *data =
-      allocateDynamicBuffer(&_storageBuffer.buffer, _currentBufferIndex, alignedSize, buffer, &vkDeviceSizeOffset);
+  auto *data = allocateDynamicBuffer(&_storageBuffer.buffer, alignedSize, 0, buffer, &vkDeviceSizeOffset);
   *offset = static_cast<uint32_t>(vkDeviceSizeOffset);
-  *vkDescriptorSet = _vkDescriptorSets[_currentBufferIndex];
+  *vkDescriptorSet = getDescriptorSet(_lastDescriptorSet.uniformBuffer, *buffer, &_lastDescriptorSet);
 
   return data;
 }
 
-void *LinearHeapAllocator::allocateLargeStaging(VkDeviceSize sizeInBytes, VkCommandBuffer *commandBuffer,
-                                                VkBuffer *buffer, VkDeviceSize *offset) {
-  _largeLinearStagingAllocation.push_back({});
-  auto *allocation = &_largeLinearStagingAllocation.back();
+void *LinearHeapAllocator::allocateBuffer(LinearHeapArena *arena, VkDeviceSize sizeInBytes, VkBuffer *buffer,
+                                          VkDeviceSize *offset) {
+  VkDeviceSize alignedSize = mg::alignUpPowerOfTwo(sizeInBytes, 256);
+  return allocateFromArena(arena, &arena->vertex, &_vertexBuffer, alignedSize, 0, buffer, offset);
+}
+
+void *LinearHeapAllocator::allocateUniform(LinearHeapArena *arena, VkDeviceSize sizeInBytes, VkBuffer *buffer,
+                                           uint32_t *offset, VkDescriptorSet *vkDescriptorSet) {
+  const auto alignment = mg::vkContext.physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+  VkDeviceSize alignedSize = mg::alignUpPowerOfTwo(sizeInBytes, alignment);
+
+  VkDeviceSize vkDeviceSizeOffset;
+  auto *data = allocateFromArena(arena, &arena->uniform, &_uniformBuffer.buffer, alignedSize, MAX_ALLOC, buffer,
+                                 &vkDeviceSizeOffset);
+  *offset = static_cast<uint32_t>(vkDeviceSizeOffset);
+  *vkDescriptorSet = getDescriptorSet(*buffer, arena->storage.vkBuffer, &arena->descriptorSet);
+
+  return data;
+}
+
+void *LinearHeapAllocator::allocateStorage(LinearHeapArena *arena, VkDeviceSize sizeInBytes, VkBuffer *buffer,
+                                           uint32_t *offset, VkDescriptorSet *vkDescriptorSet) {
+  const auto alignment = mg::vkContext.physicalDeviceProperties.limits.minStorageBufferOffsetAlignment;
+  VkDeviceSize alignedSize = mg::alignUpPowerOfTwo(sizeInBytes, alignment);
+
+  VkDeviceSize vkDeviceSizeOffset;
+  auto *data = allocateFromArena(arena, &arena->storage, &_storageBuffer.buffer, alignedSize, 0, buffer,
+                                 &vkDeviceSizeOffset);
+  *offset = static_cast<uint32_t>(vkDeviceSizeOffset);
+  *vkDescriptorSet = getDescriptorSet(arena->uniform.vkBuffer, *buffer, &arena->descriptorSet);
+
+  return data;
+}
+
+LinearHeapAllocator::LargeLinearStagingAllocation
+LinearHeapAllocator::createLargeStagingAllocation(VkDeviceSize sizeInBytes) {
+  LargeLinearStagingAllocation allocation = {};
+  allocation.size = sizeInBytes;
 
   VkCommandBufferAllocateInfo vkCommandBufferAllocateInfo = {};
   vkCommandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   vkCommandBufferAllocateInfo.commandPool = mg::vkContext.commandPool;
   vkCommandBufferAllocateInfo.commandBufferCount = 1;
   vkCommandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  checkResult(vkAllocateCommandBuffers(mg::vkContext.device, &vkCommandBufferAllocateInfo, &allocation.commandBuffer));
 
-  // staging buffer
-  checkResult(vkAllocateCommandBuffers(mg::vkContext.device, &vkCommandBufferAllocateInfo, &allocation->commandBuffer));
-  VkCommandBufferBeginInfo vkCommandBufferBeginInfo = {};
-  vkCommandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  vkCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-  vkBeginCommandBuffer(allocation->commandBuffer, &vkCommandBufferBeginInfo);
+  VkFenceCreateInfo vkFenceCreateInfo = {};
+  vkFenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  checkResult(vkCreateFence(mg::vkContext.device, &vkFenceCreateInfo, nullptr, &allocation.vkFence));
 
   VkBufferCreateInfo vkBufferCreateInfo = {};
   vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -207,34 +411,80 @@ void *LinearHeapAllocator::allocateLargeStaging(VkDeviceSize sizeInBytes, VkComm
   vkBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
   vkBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // buffer is exclusive to a single queue family at a time.
 
-  checkResult(vkCreateBuffer(mg::vkContext.device, &vkBufferCreateInfo, nullptr, &allocation->buffer));
+  checkResult(vkCreateBuffer(mg::vkContext.device, &vkBufferCreateInfo, nullptr, &allocation.buffer));
 
   // validation gives a warning if vkGetBufferMemoryRequirements has not been called on all buffers
   VkMemoryRequirements vkMemoryRequirements = {};
-  vkGetBufferMemoryRequirements(mg::vkContext.device, allocation->buffer, &vkMemoryRequirements);
+  vkGetBufferMemoryRequirements(mg::vkContext.device, allocation.buffer, &vkMemoryRequirements);
 
   // VK_MEMORY_PROPERTY_HOST_COHERENT_BIT is not cached and does not need be flushed
   const auto memoryTypeIndex = findMemoryTypeIndex(mg::vkContext.physicalDeviceMemoryProperties,
                                                    vkMemoryRequirements.memoryTypeBits, usageFlags.requiredProperties);
-  const auto alignedSize = vkMemoryRequirements.size;
 
   VkMemoryAllocateInfo vkMemoryAllocateInfo = {};
   vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  vkMemoryAllocateInfo.allocationSize = alignedSize;
+  vkMemoryAllocateInfo.allocationSize = vkMemoryRequirements.size;
   vkMemoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
 
-  checkResult(vkAllocateMemory(mg::vkContext.device, &vkMemoryAllocateInfo, nullptr, &allocation->deviceMemory));
-  checkResult(vkBindBufferMemory(mg::vkContext.device, allocation->buffer, allocation->deviceMemory, 0));
+  checkResult(vkAllocateMemory(mg::vkContext.device, &vkMemoryAllocateInfo, nullptr, &allocation.deviceMemory));
+  checkResult(vkBindBufferMemory(mg::vkContext.device, allocation.buffer, allocation.deviceMemory, 0));
+  checkResult(vkMapMemory(mg::vkContext.device, allocation.deviceMemory, 0, VK_WHOLE_SIZE, 0, &allocation.data));
 
-  void *data = nullptr;
-  checkResult(vkMapMemory(mg::vkContext.device, allocation->deviceMemory, 0, VK_WHOLE_SIZE, 0, &data));
+  return allocation;
+}
 
-  *offset = allocation->offset;
-  *buffer = allocation->buffer;
-  *commandBuffer = allocation->commandBuffer;
-  allocation->size = alignedSize;
+void LinearHeapAllocator::destroyLargeStagingAllocation(const LargeLinearStagingAllocation &allocation) {
+  vkFreeCommandBuffers(mg::vkContext.device, mg::vkContext.commandPool, 1, &allocation.commandBuffer);
+  vkDestroyFence(mg::vkContext.device, allocation.vkFence, nullptr);
+  vkUnmapMemory(mg::vkContext.device, allocation.deviceMemory);
+  vkFreeMemory(mg::vkContext.device, allocation.deviceMemory, nullptr);
+  vkDestroyBuffer(mg::vkContext.device, allocation.buffer, nullptr);
+}
 
-  return data;
+bool LinearHeapAllocator::isLargeStagingAllocationIdle(const LargeLinearStagingAllocation &allocation) const {
+  if (isAsyncUpload())
+    return _uploadQueue->isComplete(allocation.uploadValue);
+  return vkGetFenceStatus(mg::vkContext.device, allocation.vkFence) == VK_SUCCESS;
+}
+
+void *LinearHeapAllocator::allocateLargeStaging(VkDeviceSize sizeInBytes, VkCommandBuffer *commandBuffer,
+                                                VkBuffer *buffer, VkDeviceSize *offset) {
+  VkDeviceSize bucketSize = stagingBufferSizeInBytes;
+  while (bucketSize < sizeInBytes)
+    bucketSize <<= 1;
+
+  // reuse a buffer from the same bucket that the gpu is done with
+  const auto pooledAllocation =
+      std::find_if(_largeStagingPool.begin(), _largeStagingPool.end(), [this, bucketSize](const auto &allocation) {
+        return allocation.size == bucketSize && isLargeStagingAllocationIdle(allocation);
+      });
+  if (pooledAllocation != _largeStagingPool.end()) {
+    if (!isAsyncUpload())
+      checkResult(vkResetFences(mg::vkContext.device, 1, &pooledAllocation->vkFence));
+    _largeLinearStagingAllocation.push_back(*pooledAllocation);
+    _largeStagingPool.erase(pooledAllocation);
+  } else {
+    LOG("allocating large staging size: " << bucketSize);
+    _largeLinearStagingAllocation.push_back(createLargeStagingAllocation(bucketSize));
+  }
+  const auto &allocation = _largeLinearStagingAllocation.back();
+
+  if (isAsyncUpload()) {
+    // the acquire of the copies is submitted together with the graphics staging command buffer
+    getStagingCommandBuffer();
+    *commandBuffer = _uploadQueue->getCommandBuffer();
+  } else {
+    VkCommandBufferBeginInfo vkCommandBufferBeginInfo = {};
+    vkCommandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    vkCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    checkResult(vkBeginCommandBuffer(allocation.commandBuffer, &vkCommandBufferBeginInfo));
+    *commandBuffer = allocation.commandBuffer;
+  }
+  *offset = allocation.offset;
+  *buffer = allocation.buffer;
+  _lastLargeStagingFrameIndex = _frameIndex;
+
+  return allocation.data;
 }
 
 void *LinearHeapAllocator::allocateStaging(VkDeviceSize sizeInBytes, VkDeviceSize alignmentOffset,
@@ -243,21 +493,32 @@ void *LinearHeapAllocator::allocateStaging(VkDeviceSize sizeInBytes, VkDeviceSiz
   auto &dynamicBuffer = stagingBuffer.buffer;
 
   // "Total staging memory size is too small for the current allocation";
-  if (sizeInBytes > dynamicBuffer.alignedSize) {
-    LOG("allocating large staging size: " << sizeInBytes);
+  if (sizeInBytes > dynamicBuffer.pageSize) {
     return allocateLargeStaging(sizeInBytes, commandBuffer, buffer, offset);
   }
 
   // for VkBufferImageCopy, bufferOffset must be a multiple of 4
-  const auto alignOffset =
-      mg::alignUpPowerOfTwo(dynamicBuffer.bufferViews[_currentBufferIndex].offset, alignmentOffset);
-  dynamicBuffer.bufferViews[_currentBufferIndex].offset = alignOffset;
+  auto &bufferView = dynamicBuffer.bufferViews[_currentBufferIndex];
+  const auto alignOffset = mg::alignUpPowerOfTwo(getOffset(bufferView.pageIndexAndOffset), alignmentOffset);
+  bufferView.pageIndexAndOffset = packPageIndexAndOffset(0, alignOffset);
 
-  if ((dynamicBuffer.bufferViews[_currentBufferIndex].offset + sizeInBytes) > dynamicBuffer.alignedSize) {
+  if ((alignOffset + sizeInBytes) > dynamicBuffer.pageSize) {
     submitStagingMemoryToDeviceLocalMemory();
-    dynamicBuffer.bufferViews[_currentBufferIndex].offset = 0;
+    bufferView.pageIndexAndOffset = 0;
   }
 
+  // the staging buffer view is reused when the staging fence is signaled, which also covers the transfer queue copies
+  beginStagingCommandBuffer();
+
+  *commandBuffer =
+      isAsyncUpload() ? _uploadQueue->getCommandBuffer() : stagingBuffer.vkCommandBuffers[_currentBufferIndex];
+  // the staging buffer is submitted when it is full, so it never grows past its first page
+  auto dataBuffer = allocateDynamicBuffer(&dynamicBuffer, sizeInBytes, 0, buffer, offset);
+  return dataBuffer;
+}
+
+void LinearHeapAllocator::beginStagingCommandBuffer() {
+  auto &stagingBuffer = _stagingBuffer;
   if (stagingBuffer.submitted[_currentBufferIndex]) {
     stagingBuffer.submitted[_currentBufferIndex] = false;
     checkResult(
@@ -270,34 +531,47 @@ void *LinearHeapAllocator::allocateStaging(VkDeviceSize sizeInBytes, VkDeviceSiz
 
     vkBeginCommandBuffer(stagingBuffer.vkCommandBuffers[_currentBufferIndex], &vkCommandBufferBeginInfo);
   }
-
-  *commandBuffer = stagingBuffer.vkCommandBuffers[_currentBufferIndex];
-  auto dataBuffer = allocateDynamicBuffer(&dynamicBuffer, _currentBufferIndex, sizeInBytes, buffer, offset);
-  return dataBuffer;
 }
 
-void LinearHeapAllocator::create() {
-  VkDescriptorSetAllocateInfo vkDescriptorSetAllocateInfo = {};
-  vkDescriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  vkDescriptorSetAllocateInfo.descriptorPool = mg::vkContext.descriptorPool;
-  vkDescriptorSetAllocateInfo.descriptorSetCount = NrOfBuffers;
-  vkDescriptorSetAllocateInfo.pSetLayouts = &mg::vkContext.descriptorSetLayout.dynamic;
-  vkDescriptorSetAllocateInfo.descriptorSetCount = 1;
+VkCommandBuffer LinearHeapAllocator::getStagingCommandBuffer() {
+  beginStagingCommandBuffer();
+  _stagingBuffer.hasCommands[_currentBufferIndex] = true;
+  return _stagingBuffer.vkCommandBuffers[_currentBufferIndex];
+}
 
-  for (uint32_t i = 0; i < NrOfBuffers; i++) {
-    vkAllocateDescriptorSets(mg::vkContext.device, &vkDescriptorSetAllocateInfo, &_vkDescriptorSets[i]);
+void LinearHeapAllocator::create(const CreateLinearHeapAllocatorInfo &createInfo) {
+  _nrOfQuietFramesBeforeShrink = createInfo.nrOfQuietFramesBeforeShrink;
+  _uploadQueue = createInfo.uploadQueue;
+  // a buffer view can only be reused when the frame that used it is done
+  _nrOfBuffers = mg::vkContext.commandBuffers.nrOfBuffers;
+  mgAssert(_nrOfBuffers <= MaxNrOfBuffers);
+
+  // arena chunks are handed out back to back, so they have to keep the alignment of the allocations in them
+  const auto &limits = mg::vkContext.physicalDeviceProperties.limits;
+  mgAssert(createInfo.vertexChunkSizeInBytes % 256 == 0);
+  mgAssert(createInfo.uniformChunkSizeInBytes % limits.minUniformBufferOffsetAlignment == 0);
+  mgAssert(createInfo.storageChunkSizeInBytes % limits.minStorageBufferOffsetAlignment == 0);
+
+  // vertex, uniform and storage buffers
+  createLinearBuffer(&_vertexBuffer, createInfo.vertexPageSizeInBytes, createInfo.vertexChunkSizeInBytes,
+                     usageFlags.vertexBufferUsageFlags, _nrOfBuffers);
+  createLinearBuffer(&_uniformBuffer.buffer, createInfo.uniformPageSizeInBytes, createInfo.uniformChunkSizeInBytes,
+                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, _nrOfBuffers);
+  createLinearBuffer(&_storageBuffer.buffer, createInfo.storagePageSizeInBytes, createInfo.storageChunkSizeInBytes,
+                     usageFlags.storageBufferUsageFlags, _nrOfBuffers);
+
+  for (uint32_t i = 0; i < _nrOfBuffers; i++) {
+    _currentBufferIndex = i;
+    _LinearDescriptorSet descriptorSet = {};
+    getDescriptorSet(VK_NULL_HANDLE, VK_NULL_HANDLE, &descriptorSet);
   }
-
-  // vertex and uniform buffers
-  _vertexBuffer =
-      _createLinearBuffer(vertexBufferSizeInBytes, usageFlags.vertexBufferUsageFlags, usageFlags.requiredProperties, 0);
-  _uniformBuffer = createUniformBuffer(uniformBufferSizeInBytes, usageFlags.requiredProperties, 0, _vkDescriptorSets);
-  _storageBuffer = createStorageBuffers(uniformBufferSizeInBytes, usageFlags.requiredProperties, 0, _vkDescriptorSets);
+  _currentBufferIndex = 0;
 
   VkCommandBufferAllocateInfo vkCommandBufferAllocateInfo = {};
   vkCommandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   vkCommandBufferAllocateInfo.commandPool = mg::vkContext.commandPool;
-  vkCommandBufferAllocateInfo.commandBufferCount = 2;
+  // staging command buffers and fences for every possible frame in flight, see setNrOfBuffers
+  vkCommandBufferAllocateInfo.commandBufferCount = MaxNrOfBuffers;
   vkCommandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
   checkResult(
@@ -305,13 +579,13 @@ void LinearHeapAllocator::create() {
 
   // staging buffers
   std::fill(std::begin(_stagingBuffer.submitted), std::end(_stagingBuffer.submitted), true);
-  _stagingBuffer.buffer =
-      _createLinearBuffer(stagingBufferSizeInBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, usageFlags.requiredProperties, 0);
+  createLinearBuffer(&_stagingBuffer.buffer, stagingBufferSizeInBytes, 0, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     _nrOfBuffers);
 
   VkFenceCreateInfo vkFenceCreateInfo = {};
   vkFenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   vkFenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-  for (uint32_t i = 0; i < NrOfBuffers; i++)
+  for (uint32_t i = 0; i < MaxNrOfBuffers; i++)
     checkResult(vkCreateFence(mg::vkContext.device, &vkFenceCreateInfo, nullptr, &_stagingBuffer.vkFences[i]));
 }
 
@@ -320,69 +594,207 @@ void LinearHeapAllocator::destroy() {
   destroyLinearBuffer(&_uniformBuffer.buffer);
   destroyLinearBuffer(&_stagingBuffer.buffer);
   destroyLinearBuffer(&_storageBuffer.buffer);
+  destroyRetiredPages(true);
+  trimLargeStagingPool(true);
 
-  for (uint32_t i = 0; i < NrOfBuffers; i++) {
+  for (uint32_t i = 0; i < MaxNrOfBuffers; i++) {
+    // the sets are freed with their pools
+    _descriptorSets[i].clear();
     vkDestroyFence(mg::vkContext.device, _stagingBuffer.vkFences[i], nullptr);
     _stagingBuffer.vkFences[i] = VK_NULL_HANDLE;
   }
+  for (const auto &descriptorPool : _descriptorPools) {
+    vkDestroyDescriptorPool(mg::vkContext.device, descriptorPool.vkDescriptorPool, nullptr);
+  }
+  _descriptorPools.clear();
   _hasBeenDelete = true;
 }
 
 void LinearHeapAllocator::submitStagingMemoryToDeviceLocalMemory() {
-  if (_stagingBuffer.buffer.bufferViews[_currentBufferIndex].offset > 0 &&
+  // the copies on the transfer queue are submitted first, the graphics queue acquires the copied resources in a batch
+  // that waits on the timeline semaphore, so the cpu never waits for the copies. The staging fence covers both batches
+  VkSubmitInfo vkSubmitInfos[2] = {};
+  uint32_t nrOfSubmitInfos = 0;
+  uint64_t uploadValue = 0;
+  if (isAsyncUpload() && _uploadQueue->hasCopies()) {
+    uploadValue = _uploadQueue->submit(&vkSubmitInfos[nrOfSubmitInfos++]);
+    _stagingBuffer.hasCommands[_currentBufferIndex] = true;
+  }
+
+  if ((getOffset(_stagingBuffer.buffer.bufferViews[_currentBufferIndex].pageIndexAndOffset) > 0 ||
+       _stagingBuffer.hasCommands[_currentBufferIndex]) &&
       _stagingBuffer.submitted[_currentBufferIndex] == false) {
-    VkSubmitInfo vkSubmitInfo = {};
+    auto &vkSubmitInfo = vkSubmitInfos[nrOfSubmitInfos++];
     vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     vkSubmitInfo.commandBufferCount = 1;
     vkSubmitInfo.pCommandBuffers = &_stagingBuffer.vkCommandBuffers[_currentBufferIndex];
 
     checkResult(vkEndCommandBuffer(_stagingBuffer.vkCommandBuffers[_currentBufferIndex]));
-    checkResult(vkQueueSubmit(mg::vkContext.queue, 1, &vkSubmitInfo, _stagingBuffer.vkFences[_currentBufferIndex]));
+    checkResult(vkQueueSubmit(mg::vkContext.queue, nrOfSubmitInfos, vkSubmitInfos,
+                              _stagingBuffer.vkFences[_currentBufferIndex]));
 
     _stagingBuffer.submitted[_currentBufferIndex] = true;
-    _stagingBuffer.buffer.bufferViews[_currentBufferIndex].offset = 0;
+    _stagingBuffer.hasCommands[_currentBufferIndex] = false;
+    _stagingBuffer.buffer.bufferViews[_currentBufferIndex].pageIndexAndOffset = 0;
   }
-  for (const auto &allocation : _largeLinearStagingAllocation) {
-    checkResult(vkEndCommandBuffer(allocation.commandBuffer));
-    VkSubmitInfo vkSubmitInfo = {};
-    vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    vkSubmitInfo.commandBufferCount = 1;
-    vkSubmitInfo.pCommandBuffers = &allocation.commandBuffer;
-    checkResult(vkQueueSubmit(mg::vkContext.queue, 1, &vkSubmitInfo, VK_NULL_HANDLE));
-    checkResult(vkQueueWaitIdle(mg::vkContext.queue));
+  // the large staging buffers are recycled when their fence or upload value is signaled, so there is no need to wait
+  // here
+  for (auto &allocation : _largeLinearStagingAllocation) {
+    if (isAsyncUpload()) {
+      // copied by the upload queue submit above
+      allocation.uploadValue = uploadValue;
+    } else {
+      checkResult(vkEndCommandBuffer(allocation.commandBuffer));
+      VkSubmitInfo vkSubmitInfo = {};
+      vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      vkSubmitInfo.commandBufferCount = 1;
+      vkSubmitInfo.pCommandBuffers = &allocation.commandBuffer;
+      checkResult(vkQueueSubmit(mg::vkContext.queue, 1, &vkSubmitInfo, allocation.vkFence));
+    }
+
+    _largeAllocationHistory.push_back(allocation.size);
+    _largeStagingPool.push_back(allocation);
   }
-  destoryLargeStagingAllocations();
+  _largeLinearStagingAllocation.clear();
 }
 
-void LinearHeapAllocator::destoryLargeStagingAllocations() {
-  for (const auto &allocation : _largeLinearStagingAllocation) {
-    vkFreeCommandBuffers(mg::vkContext.device, mg::vkContext.commandPool, 1, &allocation.commandBuffer);
-    vkUnmapMemory(mg::vkContext.device, allocation.deviceMemory);
-    vkFreeMemory(mg::vkContext.device, allocation.deviceMemory, nullptr);
-    vkDestroyBuffer(mg::vkContext.device, allocation.buffer, nullptr);
+// keeps as many buffers of a bucket as it has been used by the latest large allocations, everything is released
+// when there has not been any large allocation for a while
+void LinearHeapAllocator::trimLargeStagingPool(bool force) {
+  static constexpr uint32_t nrOfRecentAllocations = 16;
+  static constexpr uint32_t nrOfIdleFramesBeforeRelease = 600;
+
+  const bool releaseAll = force || _frameIndex - _lastLargeStagingFrameIndex >= nrOfIdleFramesBeforeRelease;
+  const auto recentAllocationsBegin =
+      _largeAllocationHistory.size() - std::min<size_t>(_largeAllocationHistory.size(), nrOfRecentAllocations);
+  std::vector<VkDeviceSize> recentAllocations(_largeAllocationHistory.begin() + recentAllocationsBegin,
+                                              _largeAllocationHistory.end());
+
+  uint32_t nrOfPooledAllocations = 0;
+  for (const auto &allocation : _largeStagingPool) {
+    const auto recentAllocation = std::find(recentAllocations.begin(), recentAllocations.end(), allocation.size);
+    const bool inUse = !force && !isLargeStagingAllocationIdle(allocation);
+    if (inUse || (!releaseAll && recentAllocation != recentAllocations.end())) {
+      if (recentAllocation != recentAllocations.end())
+        recentAllocations.erase(recentAllocation);
+      _largeStagingPool[nrOfPooledAllocations++] = allocation;
+      continue;
+    }
+    destroyLargeStagingAllocation(allocation);
   }
-  _largeLinearStagingAllocation.clear();
+  _largeStagingPool.resize(nrOfPooledAllocations);
+}
+
+void LinearHeapAllocator::shrinkBuffer(_Buffer *dynamicBuffer, _RetiredLinearPages *retiredPages) {
+  auto &bufferView = dynamicBuffer->bufferViews[_currentBufferIndex];
+  const uint32_t nrOfPagesUsed = getPageIndex(bufferView.pageIndexAndOffset) + 1;
+  if (nrOfPagesUsed >= bufferView.pages.size()) {
+    bufferView.nrOfQuietFrames = 0;
+    bufferView.maxNrOfPagesUsed = 0;
+    return;
+  }
+
+  // every buffer view is only used every _nrOfBuffers frame
+  bufferView.nrOfQuietFrames++;
+  bufferView.maxNrOfPagesUsed = std::max(bufferView.maxNrOfPagesUsed, nrOfPagesUsed);
+  if (bufferView.nrOfQuietFrames * _nrOfBuffers < _nrOfQuietFramesBeforeShrink)
+    return;
+
+  auto &descriptorSets = _descriptorSets[_currentBufferIndex];
+  for (uint32_t i = bufferView.maxNrOfPagesUsed; i < bufferView.pages.size(); i++) {
+    const auto vkBuffer = bufferView.pages[i].vkBuffer;
+    uint32_t nrOfDescriptorSets = 0;
+    for (const auto &descriptorSet : descriptorSets) {
+      if (descriptorSet.uniformBuffer != vkBuffer && descriptorSet.storageBuffer != vkBuffer) {
+        descriptorSets[nrOfDescriptorSets++] = descriptorSet;
+        continue;
+      }
+      retiredPages->descriptorSets.push_back(descriptorSet);
+    }
+    descriptorSets.resize(nrOfDescriptorSets);
+    retiredPages->pages.push_back(bufferView.pages[i]);
+  }
+  bufferView.pages.resize(bufferView.maxNrOfPagesUsed);
+  bufferView.nrOfQuietFrames = 0;
+  bufferView.maxNrOfPagesUsed = 0;
+}
+
+void LinearHeapAllocator::destroyRetiredPages(bool force) {
+  uint32_t nrOfRetiredPages = 0;
+  for (auto &retiredPages : _retiredPages) {
+    if (!force && _frameIndex - retiredPages.frameIndex < _nrOfBuffers) {
+      std::swap(_retiredPages[nrOfRetiredPages++], retiredPages);
+      continue;
+    }
+    for (auto &page : retiredPages.pages) {
+      destroyLinearPage(&page);
+    }
+    for (const auto &descriptorSet : retiredPages.descriptorSets) {
+      freeDescriptorSet(descriptorSet);
+    }
+  }
+  _retiredPages.resize(nrOfRetiredPages);
 }
 
 void LinearHeapAllocator::swapLinearHeapBuffers() {
   {
     // for ui
-    _previousVertexSize = uint32_t(_vertexBuffer.bufferViews[_currentBufferIndex].offset);
-    _previousUniformSize = uint32_t(_uniformBuffer.buffer.bufferViews[_currentBufferIndex].offset);
+    _previousVertexSize = uint32_t(getUsedSize(_vertexBuffer, _currentBufferIndex));
+    _previousVertexTotalSize = uint32_t(getTotalSize(_vertexBuffer, _currentBufferIndex));
+    _previousUniformSize = uint32_t(getUsedSize(_uniformBuffer.buffer, _currentBufferIndex));
+    _previousUniformTotalSize = uint32_t(getTotalSize(_uniformBuffer.buffer, _currentBufferIndex));
     _maxStagingSize =
-        std::max(_maxStagingSize, uint32_t(_stagingBuffer.buffer.bufferViews[_currentBufferIndex].offset));
-    for (const auto &allocation : _largeLinearStagingAllocation) {
-      _largeAllocationHistory.push_back(allocation.size);
-    }
+        std::max(_maxStagingSize, uint32_t(getUsedSize(_stagingBuffer.buffer, _currentBufferIndex)));
   }
   submitStagingMemoryToDeviceLocalMemory();
+  trimLargeStagingPool(false);
+
+  // pages released by this frame are destroyed when the gpu is done with it
+  destroyRetiredPages(false);
+  _RetiredLinearPages retiredPages = {};
+  retiredPages.frameIndex = _frameIndex;
+  shrinkBuffer(&_vertexBuffer, &retiredPages);
+  shrinkBuffer(&_uniformBuffer.buffer, &retiredPages);
+  shrinkBuffer(&_storageBuffer.buffer, &retiredPages);
+  if (retiredPages.pages.size())
+    _retiredPages.push_back(std::move(retiredPages));
+
+  for (auto *dynamicBuffer : {&_vertexBuffer, &_uniformBuffer.buffer, &_stagingBuffer.buffer, &_storageBuffer.buffer}) {
+    dynamicBuffer->bufferViews[_currentBufferIndex].pageIndexAndOffset = 0;
+  }
+  _lastDescriptorSet = {};
 
-  _vertexBuffer.bufferViews[_currentBufferIndex].offset = 0;
-  _uniformBuffer.buffer.bufferViews[_currentBufferIndex].offset = 0;
-  _stagingBuffer.buffer.bufferViews[_currentBufferIndex].offset = 0;
-  _storageBuffer.buffer.bufferViews[_currentBufferIndex].offset = 0;
+  _frameIndex++;
+  _currentBufferIndex = (_currentBufferIndex + 1) % _nrOfBuffers;
+}
+
+void LinearHeapAllocator::setNrOfBuffers(uint32_t nrOfBuffers) {
+  mgAssert(nrOfBuffers > 0 && nrOfBuffers <= MaxNrOfBuffers);
+  destroyRetiredPages(true);
+
+  for (auto *dynamicBuffer : {&_vertexBuffer, &_uniformBuffer.buffer, &_stagingBuffer.buffer, &_storageBuffer.buffer}) {
+    for (uint32_t i = nrOfBuffers; i < _nrOfBuffers; i++) {
+      destroyLinearBufferView(dynamicBuffer, i);
+    }
+    for (uint32_t i = _nrOfBuffers; i < nrOfBuffers; i++) {
+      createLinearBufferView(dynamicBuffer, i);
+    }
+  }
+  for (uint32_t i = nrOfBuffers; i < _nrOfBuffers; i++) {
+    for (const auto &descriptorSet : _descriptorSets[i]) {
+      freeDescriptorSet(descriptorSet);
+    }
+    _descriptorSets[i].clear();
+  }
+  for (uint32_t i = _nrOfBuffers; i < nrOfBuffers; i++) {
+    _currentBufferIndex = i;
+    _LinearDescriptorSet descriptorSet = {};
+    getDescriptorSet(VK_NULL_HANDLE, VK_NULL_HANDLE, &descriptorSet);
+  }
 
-  _currentBufferIndex = (_currentBufferIndex + 1) % NrOfBuffers;
+  _nrOfBuffers = nrOfBuffers;
+  _currentBufferIndex = 0;
+  _lastDescriptorSet = {};
 }
 
 std::vector<GuiAllocation> LinearHeapAllocator::getAllocationForGUI() {
@@ -394,7 +806,7 @@ std::vector<GuiAllocation> LinearHeapAllocator::getAllocationForGUI() {
   {
     vertex.type = "Vertex";
     vertex.showFullSize = true;
-    vertex.totalSize = vertexBufferSizeInBytes;
+    vertex.totalSize = _previousVertexTotalSize;
     vertex.memoryTypeIndex = _vertexBuffer.memoryTypeIndex;
     SubAllocationGui subAllocationGui = {};
     subAllocationGui.free = false;
@@ -405,14 +817,14 @@ std::vector<GuiAllocation> LinearHeapAllocator::getAllocationForGUI() {
     SubAllocationGui subAllocationGuiEmpty = {};
     subAllocationGuiEmpty.offset = subAllocationGui.size;
     subAllocationGuiEmpty.free = true;
-    subAllocationGuiEmpty.size = vertexBufferSizeInBytes - _previousVertexSize;
+    subAllocationGuiEmpty.size = _previousVertexTotalSize - _previousVertexSize;
     if (subAllocationGuiEmpty.size)
       vertex.elements.push_back(subAllocationGuiEmpty);
   }
   {
     dynamic.type = "Uniform";
     dynamic.showFullSize = true;
-    dynamic.totalSize = uniformBufferSizeInBytes;
+    dynamic.totalSize = _previousUniformTotalSize;
     dynamic.memoryTypeIndex = _uniformBuffer.buffer.memoryTypeIndex;
     SubAllocationGui subAllocationGui = {};
     subAllocationGui.free = false;
@@ -423,7 +835,7 @@ std::vector<GuiAllocation> LinearHeapAllocator::getAllocationForGUI() {
     SubAllocationGui subAllocationGuiEmpty = {};
     subAllocationGuiEmpty.offset = subAllocationGui.size;
     subAllocationGuiEmpty.free = true;
-    subAllocationGuiEmpty.size = uniformBufferSizeInBytes - _previousUniformSize;
+    subAllocationGuiEmpty.size = _previousUniformTotalSize - _previousUniformSize;
     if (subAllocationGuiEmpty.size)
       dynamic.elements.push_back(subAllocationGuiEmpty);
   }
@@ -1,22 +1,81 @@
 #pragma once
 #include "vkContext.h"
 #include "mg/mgUtils.h"
+#include "vulkan/uploadQueue.h"
 #include "vulkan/vkUtils.h"
+#include <atomic>
+#include <mutex>
 
 namespace mg {
 
-enum { NrOfBuffers = 2 };
+enum { MaxNrOfBuffers = MAX_NR_OF_FRAMES_IN_FLIGHT };
+// the pages of a buffer view are reserved up front so they never move while other threads allocate from them, new
+// pages grow in size when a chain gets long so it never runs out of reserved pages
+enum { MaxNrOfLinearPages = 64 };
 
-struct _Buffer {
+struct _LinearPage {
   VkDeviceMemory deviceMemory;
-  VkDeviceSize alignedSize;
+  VkBuffer vkBuffer;
+  VkDeviceSize size;
+  char *data;
+};
+
+// each buffer view is a chain of pages, a new page is added when the current one is full and pages that have not
+// been used for a while are released again
+struct _Buffer {
+  VkDeviceSize pageSize;
+  VkDeviceSize chunkSize;
+  VkBufferUsageFlags usage;
   uint32_t memoryTypeIndex;
 
   struct {
-    VkBuffer vkBuffer;
-    VkDeviceSize offset;
-    char *data;
-  } bufferViews[NrOfBuffers];
+    std::vector<_LinearPage> pages;
+    // page index in the upper 16 bits and offset in the lower 48 bits, memory is reserved with one atomic add
+    std::atomic<uint64_t> pageIndexAndOffset;
+    uint32_t nrOfQuietFrames;
+    uint32_t maxNrOfPagesUsed;
+  } bufferViews[MaxNrOfBuffers];
+};
+
+// one descriptor set for every combination of uniform and storage page used in a frame
+struct _LinearDescriptorSet {
+  VkBuffer uniformBuffer;
+  VkBuffer storageBuffer;
+  VkDescriptorSet vkDescriptorSet;
+  VkDescriptorPool vkDescriptorPool;
+};
+
+// the dynamic descriptor sets are allocated from pools owned by the allocator, a pool is added when all are full
+struct _LinearDescriptorPool {
+  VkDescriptorPool vkDescriptorPool;
+  uint32_t nrOfFreeSets;
+};
+
+// pages and descriptor sets can be in use by the gpu when they are released
+struct _RetiredLinearPages {
+  std::vector<_LinearPage> pages;
+  std::vector<_LinearDescriptorSet> descriptorSets;
+  uint32_t frameIndex;
+};
+
+// part of a page reserved by one thread
+struct _LinearChunk {
+  VkBuffer vkBuffer;
+  char *data;
+  VkDeviceSize offset;
+  VkDeviceSize end;
+  VkDeviceSize pageSize;
+};
+
+// per thread allocation state for the linear heaps, chunks are reserved from the current frame buffers with one
+// atomic add and allocated from without synchronization. an arena must only be used by one thread at a time and is
+// reset automatically when it is used in a new frame
+struct LinearHeapArena {
+  _LinearChunk vertex;
+  _LinearChunk uniform;
+  _LinearChunk storage;
+  _LinearDescriptorSet descriptorSet;
+  uint32_t frameIndex = UINT32_MAX;
 };
 
 struct _UniformBuffer {
@@ -29,50 +88,118 @@ struct _StorageBuffer {
 
 struct _StagingBuffer {
   _Buffer buffer;
-  VkCommandBuffer vkCommandBuffers[NrOfBuffers];
-  VkFence vkFences[NrOfBuffers];
-  bool submitted[NrOfBuffers];
+  VkCommandBuffer vkCommandBuffers[MaxNrOfBuffers];
+  VkFence vkFences[MaxNrOfBuffers];
+  bool submitted[MaxNrOfBuffers];
+  bool hasCommands[MaxNrOfBuffers];
+};
+
+struct CreateLinearHeapAllocatorInfo {
+  VkDeviceSize vertexPageSizeInBytes = 1u << 25;  // 32 meg
+  VkDeviceSize uniformPageSizeInBytes = 1u << 16; // 64 kb
+  VkDeviceSize storagePageSizeInBytes = 1u << 25; // 32 meg
+  // number of frames a buffer view must use fewer pages than it has before the unused pages are released
+  uint32_t nrOfQuietFramesBeforeShrink = 120;
+  // size of the chunks reserved by a LinearHeapArena, must be a multiple of the offset alignments
+  VkDeviceSize vertexChunkSizeInBytes = 1u << 18;  // 256 kb
+  VkDeviceSize uniformChunkSizeInBytes = 1u << 13; // 8 kb
+  VkDeviceSize storageChunkSizeInBytes = 1u << 16; // 64 kb
+  // staging copies are recorded on the upload queue when it has a transfer queue, nullptr records them on the graphics
+  // queue
+  UploadQueue *uploadQueue = nullptr;
 };
 
 struct LinearHeapAllocator : mg::nonCopyable {
 public:
-  void create();
+  void create(const CreateLinearHeapAllocatorInfo &createInfo = {});
   void destroy();
 
   void* allocateBuffer(VkDeviceSize sizeInBytes, VkBuffer *buffer, VkDeviceSize *offset);
+  // the returned descriptor set covers both the uniform and the storage binding, when both are allocated for a draw
+  // the set returned by the last allocation must be bound
   void* allocateUniform(VkDeviceSize sizeInBytes, VkBuffer *buffer, uint32_t *offset, VkDescriptorSet *vkDescriptorSet);
   void *allocateStorage(VkDeviceSize sizeInBytes, VkBuffer *buffer, uint32_t *offset, VkDescriptorSet *vkDescriptorSet);
+  // thread safe versions for recording from several threads, must be done before swapLinearHeapBuffers
+  void *allocateBuffer(LinearHeapArena *arena, VkDeviceSize sizeInBytes, VkBuffer *buffer, VkDeviceSize *offset);
+  void *allocateUniform(LinearHeapArena *arena, VkDeviceSize sizeInBytes, VkBuffer *buffer, uint32_t *offset,
+                        VkDescriptorSet *vkDescriptorSet);
+  void *allocateStorage(LinearHeapArena *arena, VkDeviceSize sizeInBytes, VkBuffer *buffer, uint32_t *offset,
+                        VkDescriptorSet *vkDescriptorSet);
+
   void* allocateStaging(VkDeviceSize sizeInBytes, VkDeviceSize alignmentOffset, VkCommandBuffer *commandBuffer, VkBuffer *buffer, VkDeviceSize *offset);
+  // for device to device copies, submitted together with the staging copies
+  VkCommandBuffer getStagingCommandBuffer();
 
   void submitStagingMemoryToDeviceLocalMemory();
   void swapLinearHeapBuffers();
+  // adds or removes buffer views when the number of frames in flight changes, the device must be idle
+  void setNrOfBuffers(uint32_t nrOfBuffers);
   std::vector<GuiAllocation> getAllocationForGUI();
   ~LinearHeapAllocator();
 
 private:
+  void beginStagingCommandBuffer();
   void* allocateLargeStaging(VkDeviceSize sizeInBytes, VkCommandBuffer *commandBuffer, VkBuffer *buffer, VkDeviceSize *offset);
-  void destoryLargeStagingAllocations();
+  void trimLargeStagingPool(bool force);
+  bool isAsyncUpload() const { return _uploadQueue != nullptr && _uploadQueue->isAsync(); }
+  const _LinearPage &reserveDynamicBuffer(_Buffer *dynamicBuffer, VkDeviceSize sizeInBytes, VkDeviceSize rangeInBytes,
+                                          VkDeviceSize *offset);
+  void *allocateDynamicBuffer(_Buffer *dynamicBuffer, VkDeviceSize sizeInBytes, VkDeviceSize rangeInBytes,
+                              VkBuffer *buffer, VkDeviceSize *offset);
+  void *allocateFromArena(LinearHeapArena *arena, _LinearChunk *chunk, _Buffer *dynamicBuffer,
+                          VkDeviceSize sizeInBytes, VkDeviceSize rangeInBytes, VkBuffer *buffer, VkDeviceSize *offset);
+  VkDescriptorSet getDescriptorSet(VkBuffer uniformBuffer, VkBuffer storageBuffer,
+                                   _LinearDescriptorSet *lastDescriptorSet);
+  void allocateDescriptorSet(_LinearDescriptorSet *descriptorSet);
+  void freeDescriptorSet(const _LinearDescriptorSet &descriptorSet);
+  void shrinkBuffer(_Buffer *dynamicBuffer, _RetiredLinearPages *retiredPages);
+  void destroyRetiredPages(bool force);
 
   uint32_t _previousVertexSize, _previousUniformSize, _maxStagingSize;
+  uint32_t _previousVertexTotalSize, _previousUniformTotalSize;
 
   _Buffer _vertexBuffer;
   _UniformBuffer _uniformBuffer;
   _StagingBuffer _stagingBuffer;
   _StorageBuffer _storageBuffer;
+  // one buffer view per frame in flight
+  uint32_t _nrOfBuffers;
   uint32_t _currentBufferIndex = 0;
-  VkDescriptorSet _vkDescriptorSets[NrOfBuffers];
-
-  // allocations larger than the staging buffer
+  uint32_t _frameIndex = 0;
+  uint32_t _nrOfQuietFramesBeforeShrink;
+  std::vector<_LinearDescriptorSet> _descriptorSets[MaxNrOfBuffers];
+  std::vector<_LinearDescriptorPool> _descriptorPools;
+  // descriptor set returned by the last allocateUniform or allocateStorage without an arena
+  _LinearDescriptorSet _lastDescriptorSet;
+  // protects page growth, the descriptor set cache and the descriptor pools
+  std::mutex _mutex;
+  std::vector<_RetiredLinearPages> _retiredPages;
+
+  // allocations larger than the staging buffer, the size is rounded up to a power of two bucket so the buffers can
+  // be reused by later uploads when their fence is signaled
   struct LargeLinearStagingAllocation {
     VkDeviceMemory deviceMemory;
     VkBuffer buffer;
     VkDeviceSize offset;
     VkDeviceSize size;
     VkCommandBuffer commandBuffer;
+    VkFence vkFence;
+    // timeline value of the upload queue submit, used instead of the fence when the copies are on the transfer queue
+    uint64_t uploadValue;
+    void *data;
   };
 
+  LargeLinearStagingAllocation createLargeStagingAllocation(VkDeviceSize sizeInBytes);
+  void destroyLargeStagingAllocation(const LargeLinearStagingAllocation &allocation);
+  bool isLargeStagingAllocationIdle(const LargeLinearStagingAllocation &allocation) const;
+
+  // recorded but not yet submitted
   std::vector<LargeLinearStagingAllocation> _largeLinearStagingAllocation;
+  // submitted or idle
+  std::vector<LargeLinearStagingAllocation> _largeStagingPool;
   std::vector<VkDeviceSize> _largeAllocationHistory;
+  uint32_t _lastLargeStagingFrameIndex = 0;
+  UploadQueue *_uploadQueue = nullptr;
   bool _hasBeenDelete;
 };
 
@@ -0,0 +1,91 @@
+#include "memoryBudget.h"
+#include "mg/mgSystem.h"
+#include "vkUtils.h"
+
+namespace mg {
+
+// memory allocated through the engine allocators, used when the driver can not report the usage
+static VkDeviceSize getEngineUsage(uint32_t memoryHeapIndex) {
+  const auto &memoryProperties = mg::vkContext.physicalDeviceMemoryProperties;
+  VkDeviceSize usage = 0;
+  for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < memoryProperties.memoryTypeCount; memoryTypeIndex++) {
+    if (memoryProperties.memoryTypes[memoryTypeIndex].heapIndex != memoryHeapIndex)
+      continue;
+    usage += mgSystem.meshDeviceMemoryAllocator.getDeviceMemorySize(memoryTypeIndex);
+    usage += mgSystem.textureDeviceMemoryAllocator.getDeviceMemorySize(memoryTypeIndex);
+  }
+  return usage;
+}
+
+void MemoryBudget::create(const CreateMemoryBudgetInfo &createInfo) {
+  mgAssert(createInfo.mediumPressureThreshold <= createInfo.highPressureThreshold);
+  _createInfo = createInfo;
+  update();
+}
+
+void MemoryBudget::update() {
+  const auto &memoryProperties = mg::vkContext.physicalDeviceMemoryProperties;
+
+  if (mg::vkContext.extensions.memoryBudget) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT vkMemoryBudgetProperties = {};
+    vkMemoryBudgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 vkMemoryProperties = {};
+    vkMemoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    vkMemoryProperties.pNext = &vkMemoryBudgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(mg::vkContext.physicalDevice, &vkMemoryProperties);
+
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+      _heapBudgets[i].usage = vkMemoryBudgetProperties.heapUsage[i];
+      _heapBudgets[i].budget = vkMemoryBudgetProperties.heapBudget[i];
+    }
+  } else {
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+      _heapBudgets[i].usage = getEngineUsage(i);
+      _heapBudgets[i].budget =
+          VkDeviceSize(double(memoryProperties.memoryHeaps[i].size) * _createInfo.heapSizeBudgetFactor);
+    }
+  }
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    _heapBudgets[i].pressure = computePressure(_heapBudgets[i].usage, _heapBudgets[i].budget);
+  }
+}
+
+MemoryPressure MemoryBudget::computePressure(VkDeviceSize usage, VkDeviceSize budget) const {
+  const double usedPart = budget > 0 ? double(usage) / double(budget) : 1.0;
+  if (usedPart >= _createInfo.highPressureThreshold)
+    return MemoryPressure::High;
+  if (usedPart >= _createInfo.mediumPressureThreshold)
+    return MemoryPressure::Medium;
+  return MemoryPressure::Low;
+}
+
+MemoryHeapBudget MemoryBudget::getHeapBudget(uint32_t memoryHeapIndex) const {
+  mgAssert(memoryHeapIndex < mg::vkContext.physicalDeviceMemoryProperties.memoryHeapCount);
+  return _heapBudgets[memoryHeapIndex];
+}
+
+MemoryPressure MemoryBudget::getPressure(uint32_t memoryTypeIndex) const {
+  mgAssert(memoryTypeIndex < mg::vkContext.physicalDeviceMemoryProperties.memoryTypeCount);
+  const auto memoryHeapIndex = mg::vkContext.physicalDeviceMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  return _heapBudgets[memoryHeapIndex].pressure;
+}
+
+MemoryPressure MemoryBudget::getDeviceLocalPressure() const {
+  const auto &memoryProperties = mg::vkContext.physicalDeviceMemoryProperties;
+  MemoryPressure pressure = MemoryPressure::Low;
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+      pressure = std::max(pressure, _heapBudgets[i].pressure);
+  }
+  return pressure;
+}
+
+VkDeviceSize MemoryBudget::getSizeAboveMediumPressure(uint32_t memoryTypeIndex) const {
+  mgAssert(memoryTypeIndex < mg::vkContext.physicalDeviceMemoryProperties.memoryTypeCount);
+  const auto memoryHeapIndex = mg::vkContext.physicalDeviceMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  const auto &heapBudget = _heapBudgets[memoryHeapIndex];
+  const auto mediumPressureUsage = VkDeviceSize(double(heapBudget.budget) * _createInfo.mediumPressureThreshold);
+  return heapBudget.usage > mediumPressureUsage ? heapBudget.usage - mediumPressureUsage : 0;
+}
+
+} // namespace mg
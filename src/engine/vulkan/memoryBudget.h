@@ -0,0 +1,45 @@
+#pragma once
+#include "vkContext.h"
+#include "mg/mgUtils.h"
+
+namespace mg {
+
+enum class MemoryPressure { Low, Medium, High };
+
+struct MemoryHeapBudget {
+  VkDeviceSize usage;
+  VkDeviceSize budget;
+  MemoryPressure pressure;
+};
+
+struct CreateMemoryBudgetInfo {
+  // part of the budget that is in use before the pressure is raised
+  float mediumPressureThreshold = 0.75f;
+  float highPressureThreshold = 0.9f;
+  // without VK_EXT_memory_budget the budget is this part of the heap size, and the usage is the memory allocated
+  // by the engine allocators
+  float heapSizeBudgetFactor = 0.8f;
+};
+
+// usage and budget of the memory heaps, updated once per frame. Uses VK_EXT_memory_budget when the device supports
+// it, the usage then includes the memory of other processes
+class MemoryBudget : mg::nonCopyable {
+public:
+  void create(const CreateMemoryBudgetInfo &createInfo = {});
+  void update();
+
+  MemoryHeapBudget getHeapBudget(uint32_t memoryHeapIndex) const;
+  MemoryPressure getPressure(uint32_t memoryTypeIndex) const;
+  // the highest pressure of the device local heaps
+  MemoryPressure getDeviceLocalPressure() const;
+  // bytes that have to be released from the heap of the memory type to get back below the medium pressure threshold
+  VkDeviceSize getSizeAboveMediumPressure(uint32_t memoryTypeIndex) const;
+
+private:
+  MemoryPressure computePressure(VkDeviceSize usage, VkDeviceSize budget) const;
+
+  CreateMemoryBudgetInfo _createInfo;
+  MemoryHeapBudget _heapBudgets[VK_MAX_MEMORY_HEAPS];
+};
+
+} // namespace mg
@@ -1,12 +1,17 @@
 #include "pipelineContainer.h"
 
-#include "../mg/mgSystem.h"
+#include "../mg/jobs.h"
+#include "../mg/logger.h"
 #include "shaderPipelineInput.h"
 #include "shaders.h"
 #include "singleRenderpass.h"
 #include "vkContext.h"
 #include "vkUtils.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <fstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -29,6 +34,15 @@ static uint64_t hashBytes(const unsigned char *first, const unsigned char *last)
 
 namespace mg {
 
+struct _SpecializationDesc {
+  enum { MAX_MAP_ENTRIES = 8 };
+  enum { MAX_DATA_SIZE = 64 };
+  VkSpecializationMapEntry mapEntries[MAX_MAP_ENTRIES];
+  uint32_t mapEntryCount;
+  uint32_t dataSize;
+  char data[MAX_DATA_SIZE];
+};
+
 struct _PipelineDesc {
   _PipelineDesc();
   _PipelineDesc(const _PipelineDesc &other);
@@ -38,6 +52,7 @@ struct _PipelineDesc {
   char shaderName[30];
   mg::shaders::VertexInputState vertexInputState[10];
   uint32_t vertexInputStateCount;
+  _SpecializationDesc specialization;
 };
 
 _PipelineDesc::_PipelineDesc() {
@@ -95,15 +110,69 @@ PipelineStateDesc &PipelineStateDesc::operator=(const PipelineStateDesc &other)
   return *this;
 }
 
-static Pipeline _createPipeline(const _PipelineDesc &pipelineDesc) {
-  VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
-  VkPipelineRasterizationStateCreateInfo rasterizationState = {};
-  std::array<VkPipelineColorBlendAttachmentState, 5> blendAttachmentState = {};
-  VkPipelineColorBlendStateCreateInfo colorBlendState = {};
-  VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
-  VkPipelineViewportStateCreateInfo viewportState = {};
-  VkPipelineMultisampleStateCreateInfo multisampleState = {};
-  VkPipelineDynamicStateCreateInfo dynamicState = {};
+static void setSpecialization(const VkSpecializationInfo *specializationInfo, _SpecializationDesc *specialization) {
+  if (!specializationInfo)
+    return;
+  mgAssert(specializationInfo->mapEntryCount <= _SpecializationDesc::MAX_MAP_ENTRIES);
+  mgAssert(specializationInfo->dataSize <= _SpecializationDesc::MAX_DATA_SIZE);
+  specialization->mapEntryCount = specializationInfo->mapEntryCount;
+  specialization->dataSize = uint32_t(specializationInfo->dataSize);
+  memcpy(specialization->mapEntries, specializationInfo->pMapEntries,
+         specializationInfo->mapEntryCount * sizeof(VkSpecializationMapEntry));
+  memcpy(specialization->data, specializationInfo->pData, specializationInfo->dataSize);
+}
+
+static VkSpecializationInfo getSpecializationInfo(const _SpecializationDesc &specialization) {
+  VkSpecializationInfo specializationInfo = {};
+  specializationInfo.mapEntryCount = specialization.mapEntryCount;
+  specializationInfo.pMapEntries = specialization.mapEntries;
+  specializationInfo.dataSize = specialization.dataSize;
+  specializationInfo.pData = specialization.data;
+  return specializationInfo;
+}
+
+static void setDynamicState(const _PipelineDesc &pipelineDesc, Pipeline *pipeline) {
+  const auto &rasterization = pipelineDesc.state.rasterization;
+  auto &dynamicState = pipeline->dynamicState;
+  dynamicState.isEnabled = mg::vkContext.extensions.extendedDynamicState;
+  dynamicState.topology = rasterization.inputAssemblyState.topology;
+  dynamicState.cullMode = rasterization.rasterization.cullMode;
+  dynamicState.frontFace = rasterization.rasterization.frontFace;
+  dynamicState.depthTestEnable = rasterization.depth.TestEnable;
+  dynamicState.depthWriteEnable = rasterization.depth.writeEnable;
+  dynamicState.depthCompareOp = rasterization.depth.DepthCompareOp;
+}
+
+// the create infos of a graphics pipeline, they point into the struct so it is filled in place
+struct _GraphicsPipelineState {
+  VkVertexInputAttributeDescription vertexInputAttributeDescription[10];
+  VkVertexInputBindingDescription vertexInputBindingDescription[2];
+  VkPipelineVertexInputStateCreateInfo vertexInputState;
+  VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
+  VkPipelineRasterizationStateCreateInfo rasterizationState;
+  std::array<VkPipelineColorBlendAttachmentState, 5> blendAttachmentState;
+  VkPipelineColorBlendStateCreateInfo colorBlendState;
+  VkPipelineDepthStencilStateCreateInfo depthStencilState;
+  VkPipelineViewportStateCreateInfo viewportState;
+  VkPipelineMultisampleStateCreateInfo multisampleState;
+  VkDynamicState dynamicStateEnables[8];
+  VkPipelineDynamicStateCreateInfo dynamicState;
+  VkSpecializationInfo specializationInfo;
+  VkPipelineShaderStageCreateInfo shaderStages[10];
+  uint32_t shaderStageCount;
+};
+
+// only the shader stages in the stage mask are used
+static void fillGraphicsPipelineState(const _PipelineDesc &pipelineDesc, const Shader *shader,
+                                      VkShaderStageFlags stageMask, _GraphicsPipelineState *state) {
+  auto &inputAssemblyState = state->inputAssemblyState;
+  auto &rasterizationState = state->rasterizationState;
+  auto &blendAttachmentState = state->blendAttachmentState;
+  auto &colorBlendState = state->colorBlendState;
+  auto &depthStencilState = state->depthStencilState;
+  auto &viewportState = state->viewportState;
+  auto &multisampleState = state->multisampleState;
+  auto &dynamicState = state->dynamicState;
 
   inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
   inputAssemblyState.topology = pipelineDesc.state.rasterization.inputAssemblyState.topology;
@@ -157,31 +226,30 @@ static Pipeline _createPipeline(const _PipelineDesc &pipelineDesc) {
   multisampleState.rasterizationSamples = pipelineDesc.state.rasterization.multisample.rasterizationSamples;
   multisampleState.minSampleShading = pipelineDesc.state.rasterization.multisample.minSampleShading;
   multisampleState.sampleShadingEnable = pipelineDesc.state.rasterization.multisample.sampleShadingEnable;
-  
 
-  const uint32_t nrOfDynamicStates = 2;
-  VkDynamicState dynamicStateEnables[nrOfDynamicStates] = {
+  const VkDynamicState dynamicStateEnables[] = {
       VK_DYNAMIC_STATE_VIEWPORT,
       VK_DYNAMIC_STATE_SCISSOR,
+      VK_DYNAMIC_STATE_CULL_MODE_EXT,
+      VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+      VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+      VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+      VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+      VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT,
   };
+  static_assert(sizeof(dynamicStateEnables) == sizeof(state->dynamicStateEnables), "");
+  memcpy(state->dynamicStateEnables, dynamicStateEnables, sizeof(dynamicStateEnables));
   dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.pDynamicStates = dynamicStateEnables;
-  dynamicState.dynamicStateCount = nrOfDynamicStates;
+  dynamicState.pDynamicStates = state->dynamicStateEnables;
+  // only the viewport and scissor without VK_EXT_extended_dynamic_state
+  dynamicState.dynamicStateCount = mg::vkContext.extensions.extendedDynamicState ? mg::countof(dynamicStateEnables)
+                                                                                 : 2;
 
-  VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineCreateInfo.layout = pipelineDesc.state.rasterization.vkPipelineLayout;
-  pipelineCreateInfo.renderPass = pipelineDesc.state.rasterization.vkRenderPass;
-  pipelineCreateInfo.subpass = pipelineDesc.state.rasterization.graphics.subpass;
-
-  const auto shader = mg::getShader(pipelineDesc.shaderName);
-
-  VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
+  auto &vertexInputStateCreateInfo = state->vertexInputState;
   vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-  constexpr uint32_t maxNrOfInputVertexAttribute = 10;
-  mgAssert(pipelineDesc.vertexInputStateCount <= maxNrOfInputVertexAttribute);
-  VkVertexInputAttributeDescription vkVertexInputAttributeDescription[maxNrOfInputVertexAttribute] = {};
+  mgAssert(pipelineDesc.vertexInputStateCount <= mg::countof(state->vertexInputAttributeDescription));
+  auto &vkVertexInputAttributeDescription = state->vertexInputAttributeDescription;
 
   uint32_t strideInterleaved = 0;
   uint32_t strideInstancesInterleaved = 0;
@@ -207,58 +275,940 @@ static Pipeline _createPipeline(const _PipelineDesc &pipelineDesc) {
     .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
   }};
   // clang-format on
+  memcpy(state->vertexInputBindingDescription, vkVertexInputBindingDescription,
+         sizeof(vkVertexInputBindingDescription));
 
   uint32_t count = uint32_t(strideInterleaved > 0) + uint32_t(strideInstancesInterleaved > 0);
-  vertexInputStateCreateInfo.pVertexBindingDescriptions = vkVertexInputBindingDescription;
+  vertexInputStateCreateInfo.pVertexBindingDescriptions = state->vertexInputBindingDescription;
   vertexInputStateCreateInfo.vertexBindingDescriptionCount = count;
   vertexInputStateCreateInfo.pVertexAttributeDescriptions = vkVertexInputAttributeDescription;
   vertexInputStateCreateInfo.vertexAttributeDescriptionCount = pipelineDesc.vertexInputStateCount;
 
-  pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-  pipelineCreateInfo.pRasterizationState = &rasterizationState;
-  pipelineCreateInfo.pColorBlendState = &colorBlendState;
-  pipelineCreateInfo.pMultisampleState = &multisampleState;
-  pipelineCreateInfo.pViewportState = &viewportState;
-  pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-  pipelineCreateInfo.pDynamicState = &dynamicState;
+  if (!shader)
+    return;
+  state->specializationInfo = getSpecializationInfo(pipelineDesc.specialization);
+  mgAssert(shader->count <= mg::countof(state->shaderStages));
+  for (uint32_t i = 0; i < shader->count; i++) {
+    if (!(shader->stageCreateInfo[i].stage & stageMask))
+      continue;
+    auto &shaderStage = state->shaderStages[state->shaderStageCount++];
+    shaderStage = shader->stageCreateInfo[i];
+    if (state->specializationInfo.mapEntryCount > 0)
+      shaderStage.pSpecializationInfo = &state->specializationInfo;
+  }
+}
 
-  pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
-  pipelineCreateInfo.stageCount = shader.count;
-  pipelineCreateInfo.pStages = shader.stageCreateInfo;
+static Pipeline _createPipeline(const _PipelineDesc &pipelineDesc, const Shader &shader) {
+  _GraphicsPipelineState state = {};
+  fillGraphicsPipelineState(pipelineDesc, &shader, VK_SHADER_STAGE_ALL, &state);
+
+  VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineCreateInfo.layout = pipelineDesc.state.rasterization.vkPipelineLayout;
+  pipelineCreateInfo.renderPass = pipelineDesc.state.rasterization.vkRenderPass;
+  pipelineCreateInfo.subpass = pipelineDesc.state.rasterization.graphics.subpass;
+
+  pipelineCreateInfo.pInputAssemblyState = &state.inputAssemblyState;
+  pipelineCreateInfo.pRasterizationState = &state.rasterizationState;
+  pipelineCreateInfo.pColorBlendState = &state.colorBlendState;
+  pipelineCreateInfo.pMultisampleState = &state.multisampleState;
+  pipelineCreateInfo.pViewportState = &state.viewportState;
+  pipelineCreateInfo.pDepthStencilState = &state.depthStencilState;
+  pipelineCreateInfo.pDynamicState = &state.dynamicState;
+
+  pipelineCreateInfo.pVertexInputState = &state.vertexInputState;
+  pipelineCreateInfo.stageCount = state.shaderStageCount;
+  pipelineCreateInfo.pStages = state.shaderStages;
 
   Pipeline pipeline = {};
   pipeline.layout = pipelineDesc.state.rasterization.vkPipelineLayout;
+  setDynamicState(pipelineDesc, &pipeline);
+
+  checkResult(vkCreateGraphicsPipelines(mg::vkContext.device, mg::vkContext.pipelineCache, 1, &pipelineCreateInfo,
+                                        nullptr, &pipeline.pipeline));
+  return pipeline;
+}
+
+// the parts of a graphics pipeline with VK_EXT_graphics_pipeline_library, they are created and cached separately and
+// linked into the pipeline
+enum _PipelineLibraryPart { VERTEX_INPUT, PRE_RASTERIZATION, FRAGMENT_SHADER, FRAGMENT_OUTPUT, NR_OF_LIBRARY_PARTS };
+
+// the shader is only used for the pre-rasterization and fragment shader parts
+static VkPipeline _createPipelineLibrary(const _PipelineDesc &pipelineDesc, const Shader *shader,
+                                         _PipelineLibraryPart part) {
+  const VkShaderStageFlags stageMask = part == PRE_RASTERIZATION ? VK_SHADER_STAGE_ALL & ~VK_SHADER_STAGE_FRAGMENT_BIT
+                                                                  : VK_SHADER_STAGE_FRAGMENT_BIT;
+  _GraphicsPipelineState state = {};
+  fillGraphicsPipelineState(pipelineDesc, shader, stageMask, &state);
+
+  VkGraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo = {};
+  libraryCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+
+  VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineCreateInfo.pNext = &libraryCreateInfo;
+  // the libraries are linked again with link time optimization in the background
+  pipelineCreateInfo.flags =
+      VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+  pipelineCreateInfo.pDynamicState = &state.dynamicState;
 
+  switch (part) {
+  case VERTEX_INPUT:
+    libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+    pipelineCreateInfo.pVertexInputState = &state.vertexInputState;
+    pipelineCreateInfo.pInputAssemblyState = &state.inputAssemblyState;
+    break;
+  case PRE_RASTERIZATION:
+    libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+    pipelineCreateInfo.pViewportState = &state.viewportState;
+    pipelineCreateInfo.pRasterizationState = &state.rasterizationState;
+    pipelineCreateInfo.stageCount = state.shaderStageCount;
+    pipelineCreateInfo.pStages = state.shaderStages;
+    break;
+  case FRAGMENT_SHADER:
+    libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+    pipelineCreateInfo.pDepthStencilState = &state.depthStencilState;
+    pipelineCreateInfo.pMultisampleState = &state.multisampleState;
+    pipelineCreateInfo.stageCount = state.shaderStageCount;
+    pipelineCreateInfo.pStages = state.shaderStages;
+    break;
+  case FRAGMENT_OUTPUT:
+    libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+    pipelineCreateInfo.pColorBlendState = &state.colorBlendState;
+    pipelineCreateInfo.pMultisampleState = &state.multisampleState;
+    break;
+  default:
+    mgAssert(false);
+  }
+  if (part == PRE_RASTERIZATION || part == FRAGMENT_SHADER)
+    pipelineCreateInfo.layout = pipelineDesc.state.rasterization.vkPipelineLayout;
+  if (part != VERTEX_INPUT) {
+    pipelineCreateInfo.renderPass = pipelineDesc.state.rasterization.vkRenderPass;
+    pipelineCreateInfo.subpass = pipelineDesc.state.rasterization.graphics.subpass;
+  }
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  checkResult(vkCreateGraphicsPipelines(mg::vkContext.device, mg::vkContext.pipelineCache, 1, &pipelineCreateInfo,
+                                        nullptr, &pipeline));
+  return pipeline;
+}
+
+// fast linking only takes the libraries, link time optimization is slower but gives a faster pipeline
+static Pipeline _linkPipeline(const _PipelineDesc &pipelineDesc, const VkPipeline libraries[NR_OF_LIBRARY_PARTS],
+                              bool isOptimized) {
+  VkPipelineLibraryCreateInfoKHR libraryCreateInfo = {};
+  libraryCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+  libraryCreateInfo.libraryCount = NR_OF_LIBRARY_PARTS;
+  libraryCreateInfo.pLibraries = libraries;
+
+  VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineCreateInfo.pNext = &libraryCreateInfo;
+  pipelineCreateInfo.flags = isOptimized ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+  pipelineCreateInfo.layout = pipelineDesc.state.rasterization.vkPipelineLayout;
+
+  Pipeline pipeline = {};
+  pipeline.layout = pipelineDesc.state.rasterization.vkPipelineLayout;
+  setDynamicState(pipelineDesc, &pipeline);
   checkResult(vkCreateGraphicsPipelines(mg::vkContext.device, mg::vkContext.pipelineCache, 1, &pipelineCreateInfo,
                                         nullptr, &pipeline.pipeline));
   return pipeline;
 }
 
+static Pipeline _createComputePipeline(const _PipelineDesc &pipelineDesc, const Shader &shader) {
+  VkPipelineShaderStageCreateInfo shaderStageCreateInfo = {};
+  shaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  mgAssert(shader.count == 1);
+  shaderStageCreateInfo.module = shader.stageCreateInfo[0].module;
+  shaderStageCreateInfo.pName = "main";
+  const auto specializationInfo = getSpecializationInfo(pipelineDesc.specialization);
+  if (specializationInfo.mapEntryCount > 0)
+    shaderStageCreateInfo.pSpecializationInfo = &specializationInfo;
+
+  VkComputePipelineCreateInfo pipelineCreateInfo = {};
+  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineCreateInfo.stage = shaderStageCreateInfo;
+  pipelineCreateInfo.layout = pipelineDesc.state.compute.pipelineLayout;
+
+  Pipeline pipeline = {};
+  pipeline.layout = pipelineDesc.state.compute.pipelineLayout;
+  checkResult(vkCreateComputePipelines(vkContext.device, vkContext.pipelineCache, 1, &pipelineCreateInfo, nullptr,
+                                       &pipeline.pipeline));
+  return pipeline;
+}
+
+static Pipeline _createRayTracingPipeline(const _PipelineDesc &pipelineDesc, const Shader &shader) {
+  const auto &fToI = shader.fileNameToIndex;
+  const auto &rayTracing = pipelineDesc.state.rayTracing;
+  enum { MAX_SHADER_STAGES = 10 };
+  VkPipelineShaderStageCreateInfo shaderStageCreateInfo[MAX_SHADER_STAGES];
+  mgAssert(MAX_SHADER_STAGES >= rayTracing.shaderCount);
+  for (uint32_t i = 0; i < rayTracing.shaderCount; i++) {
+    const auto shaderIndex = fToI.at(rayTracing.shaders[i]);
+    mgAssert(shaderIndex < shader.count);
+    shaderStageCreateInfo[i] = shader.stageCreateInfo[shaderIndex];
+  }
+
+  VkRayTracingPipelineCreateInfoNV rayPipelineInfo{};
+  rayPipelineInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_NV;
+  rayPipelineInfo.stageCount = rayTracing.shaderCount;
+  rayPipelineInfo.pStages = shaderStageCreateInfo;
+  rayPipelineInfo.pGroups = rayTracing.groups;
+  rayPipelineInfo.groupCount = rayTracing.groupCount;
+  rayPipelineInfo.layout = rayTracing.pipelineLayout;
+  rayPipelineInfo.maxRecursionDepth = 1;
+
+  Pipeline pipeline = {};
+  pipeline.layout = rayTracing.pipelineLayout;
+  checkResult(nv::vkCreateRayTracingPipelinesNV(mg::vkContext.device, mg::vkContext.pipelineCache, 1, &rayPipelineInfo,
+                                                nullptr, &pipeline.pipeline));
+  return pipeline;
+}
+
+enum class _PipelineType { Graphics, Compute, RayTracing };
+
+struct _RegisteredPipeline {
+  _PipelineDesc desc;
+  _PipelineType type;
+};
+
+// the pipeline only fixes the topology class, list and strip topologies of the same class can share it
+static VkPrimitiveTopology getTopologyClass(VkPrimitiveTopology topology) {
+  switch (topology) {
+  case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+    return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+  case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+  case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+  case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+  case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+    return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+  case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+    return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+  default:
+    return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  }
+}
+
+// the description without the state that is set when the pipeline is bound
+static _PipelineDesc getStaticPipelineDesc(const _PipelineDesc &pipelineDesc) {
+  _PipelineDesc staticDesc = pipelineDesc;
+  auto &rasterization = staticDesc.state.rasterization;
+  rasterization.inputAssemblyState.topology = getTopologyClass(rasterization.inputAssemblyState.topology);
+  rasterization.rasterization.cullMode = 0;
+  rasterization.rasterization.frontFace = VkFrontFace(0);
+  rasterization.depth.TestEnable = VK_FALSE;
+  rasterization.depth.writeEnable = VK_FALSE;
+  rasterization.depth.DepthCompareOp = VkCompareOp(0);
+  return staticDesc;
+}
+
+static uint64_t hashPipelineDesc(const _PipelineDesc &pipelineDesc) {
+  auto startAdress = (const unsigned char *)((&pipelineDesc));
+  return hashBytes(startAdress, startAdress + sizeof(pipelineDesc));
+}
+
+// the part of the description a pipeline library depends on, the rest is zero so that pipelines that only differ in
+// the other parts share the library
+static _PipelineDesc getPipelineLibraryDesc(const _PipelineDesc &pipelineDesc, _PipelineLibraryPart part) {
+  const auto desc =
+      mg::vkContext.extensions.extendedDynamicState ? getStaticPipelineDesc(pipelineDesc) : pipelineDesc;
+  const auto &rasterization = desc.state.rasterization;
+  _PipelineDesc libraryDesc = {};
+  auto &libraryRasterization = libraryDesc.state.rasterization;
+  if (part == PRE_RASTERIZATION || part == FRAGMENT_SHADER) {
+    libraryRasterization.vkPipelineLayout = rasterization.vkPipelineLayout;
+    memcpy(libraryDesc.shaderName, desc.shaderName, sizeof(desc.shaderName));
+    libraryDesc.specialization = desc.specialization;
+  }
+  if (part != VERTEX_INPUT) {
+    libraryRasterization.vkRenderPass = rasterization.vkRenderPass;
+    libraryRasterization.graphics.subpass = rasterization.graphics.subpass;
+  }
+  switch (part) {
+  case VERTEX_INPUT:
+    libraryRasterization.inputAssemblyState = rasterization.inputAssemblyState;
+    memcpy(libraryDesc.vertexInputState, desc.vertexInputState, sizeof(desc.vertexInputState));
+    libraryDesc.vertexInputStateCount = desc.vertexInputStateCount;
+    break;
+  case PRE_RASTERIZATION:
+    libraryRasterization.rasterization = rasterization.rasterization;
+    break;
+  case FRAGMENT_SHADER:
+    libraryRasterization.depth = rasterization.depth;
+    libraryRasterization.multisample = rasterization.multisample;
+    break;
+  case FRAGMENT_OUTPUT:
+    libraryRasterization.blend = rasterization.blend;
+    libraryRasterization.multisample = rasterization.multisample;
+    libraryRasterization.graphics.nrOfColorAttachments = rasterization.graphics.nrOfColorAttachments;
+    break;
+  default:
+    mgAssert(false);
+  }
+  return libraryDesc;
+}
+
+static Pipeline _createRegisteredPipeline(const _RegisteredPipeline &registeredPipeline, const Shader &shader) {
+  switch (registeredPipeline.type) {
+  case _PipelineType::Graphics:
+    return _createPipeline(registeredPipeline.desc, shader);
+  case _PipelineType::Compute:
+    return _createComputePipeline(registeredPipeline.desc, shader);
+  case _PipelineType::RayTracing:
+    return _createRayTracingPipeline(registeredPipeline.desc, shader);
+  }
+  mgAssert(false);
+  return {};
+}
+
+// render pass and pipeline layout handles change between runs, the manifest stores the render pass name and the
+// index of the pipeline layout in the vulkan context instead
+struct _ManifestEntry {
+  _RegisteredPipeline pipeline;
+  uint32_t pipelineLayoutIndex;
+  char renderPassName[32];
+};
+
+struct _ManifestFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entrySize;
+  uint32_t entryCount;
+};
+
+struct _PipelineManifest {
+  // loaded entries that have not been pre-warmed yet
+  std::vector<_ManifestEntry> loadedEntries;
+  std::vector<_ManifestEntry> recordedEntries;
+};
+
+// pipelines created by a job, the job only reads the registered descriptions and writes its own slot of the
+// results. The container is updated on the main thread when the batch is done
+struct _PrewarmBatch {
+  std::string renderPassName;
+  std::vector<uint32_t> pipelineIndices;
+  std::vector<const _RegisteredPipeline *> pipelines;
+  std::vector<Pipeline> results;
+  std::atomic<bool> isDone = {false};
+  mg::jobs::Job *job;
+  mg::timer::Time start;
+};
+
+// shaders that changed on disc. The job loads the shader modules and creates the pipelines that use them from
+// copies of the registered descriptions, the main thread swaps them in when the job is done
+struct _ShaderReload {
+  std::vector<std::string> shaderNames;
+  std::vector<Shader> shaders;
+  std::vector<uint32_t> pipelineIndices;
+  std::vector<_RegisteredPipeline> pipelines;
+  std::vector<Pipeline> results;
+  std::atomic<bool> isDone = {false};
+  mg::jobs::Job *job;
+  mg::timer::Time start;
+  mg::timer::Time end;
+};
+
+struct _PipelineLibrary {
+  VkPipeline pipeline;
+  // empty for the parts without shaders
+  std::string shaderName;
+};
+
+// a pipeline fast linked from libraries, it is linked again with link time optimization by a job
+struct _PipelineLink {
+  uint32_t pipelineIndex;
+  _PipelineDesc desc;
+  VkPipeline libraries[NR_OF_LIBRARY_PARTS];
+  VkPipeline fastLinkedPipeline;
+  Pipeline optimizedPipeline;
+};
+
+struct _OptimizedLinkBatch {
+  std::vector<_PipelineLink> links;
+  std::atomic<bool> isDone = {false};
+  mg::jobs::Job *job;
+  mg::timer::Time start;
+  mg::timer::Time end;
+};
+
+// libraries are only created and fast linked on the main thread, pre-warming and shader reloads create full pipelines
+struct _PipelineLibraries {
+  std::unordered_map<uint64_t, _PipelineLibrary> parts[NR_OF_LIBRARY_PARTS];
+  // linked in the next optimized batch
+  std::vector<_PipelineLink> pendingLinks;
+  std::unique_ptr<_OptimizedLinkBatch> optimizedLinks;
+};
+
+// the scenes share the bin directory, every executable has its own manifest
+static std::string getPipelineManifestFileName() {
+  const auto executableName = mg::getExecutableName();
+  return executableName.empty() ? "pipelineManifest.bin" : "pipelineManifest_" + executableName + ".bin";
+}
+
+static const uint32_t pipelineManifestMagic = 0x464d5050; // "PPMF"
+static const uint32_t pipelineManifestVersion = 2;
+
+static VkPipelineLayout *getPipelineLayout(_RegisteredPipeline *pipeline) {
+  switch (pipeline->type) {
+  case _PipelineType::Graphics:
+    return &pipeline->desc.state.rasterization.vkPipelineLayout;
+  case _PipelineType::Compute:
+    return &pipeline->desc.state.compute.pipelineLayout;
+  case _PipelineType::RayTracing:
+    return &pipeline->desc.state.rayTracing.pipelineLayout;
+  }
+  mgAssert(false);
+  return nullptr;
+}
+
+static uint32_t getPipelineLayouts(VkPipelineLayout pipelineLayouts[3]) {
+  pipelineLayouts[0] = mg::vkContext.pipelineLayouts.pipelineLayout;
+  pipelineLayouts[1] = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
+  pipelineLayouts[2] = mg::vkContext.pipelineLayouts.pipelineLayoutRayTracing;
+  return 3;
+}
+
+static bool isSameManifestEntry(const _ManifestEntry &a, const _ManifestEntry &b) {
+  return a.pipeline.type == b.pipeline.type && a.pipelineLayoutIndex == b.pipelineLayoutIndex &&
+         strcmp(a.renderPassName, b.renderPassName) == 0 &&
+         memcmp(&a.pipeline.desc, &b.pipeline.desc, sizeof(_PipelineDesc)) == 0;
+}
+
+PipelineContainer::PipelineContainer() = default;
+
 void PipelineContainer::createPipelineContainer() {
+  _createTime = mg::timer::now();
+  _isFirstFrame = true;
   mg::createShaders();
+  _pipelineLibraries = std::make_unique<_PipelineLibraries>();
+  loadPipelineManifest();
+  // compute and ray tracing pipelines do not depend on a render pass
+  prewarmPipelines("");
 }
 
 PipelineContainer::~PipelineContainer() {
-  mgAssert(_idToPipeline.empty());
+  mgAssert(_pipelines.empty());
+  mgAssert(_prewarmBatches.empty());
+  mgAssert(!_shaderReload);
+  mgAssert(!_pipelineLibraries);
+}
+
+void PipelineContainer::destroyPipelines() {
+  for (auto &pipeline : _pipelines) {
+    if (pipeline.pipeline != VK_NULL_HANDLE)
+      vkDestroyPipeline(mg::vkContext.device, pipeline.pipeline, nullptr);
+    pipeline.pipeline = VK_NULL_HANDLE;
+  }
 }
 
 void PipelineContainer::destroyPipelineContainer() {
+  discardShaderReload();
+  waitForPrewarmedPipelines();
   waitForDeviceIdle();
-  for (auto pipelineIt : _idToPipeline) {
-    vkDestroyPipeline(mg::vkContext.device, pipelineIt.second.pipeline, nullptr);
-  }
-  _idToPipeline.clear();
+  savePipelineManifest();
+  destroyRetiredObjects(true);
+  destroyPipelines();
+  destroyPipelineLibraries();
+  _pipelineLibraries.reset();
+  _pipelines.clear();
+  _registeredPipelines.clear();
+  _idToPipelineIndex.clear();
+  _pipelineOwners.clear();
+  _dynamicIdToPipelineIndex.clear();
+  _renderPassToName.clear();
+  _manifest.reset();
+  // handles from before the destroy are no longer valid
+  _generation++;
   mg::deleteShaders();
 }
 
+// the registered descriptions and handles are kept, the pipelines are recreated with the reloaded shaders the next
+// time they are used
 void PipelineContainer::resetPipelineContainer() {
+  discardShaderReload();
+  waitForPrewarmedPipelines();
   waitForDeviceIdle();
-  destroyPipelineContainer();
-  createPipelineContainer();
+  destroyRetiredObjects(true);
+  destroyPipelines();
+  destroyPipelineLibraries();
+  mg::deleteShaders();
+  mg::createShaders();
 }
 
-Pipeline PipelineContainer::createPipeline(const PipelineStateDesc &pipelineDesc,
-                                           const CreatePipelineInfo &createPipelineInfo) {
+void PipelineContainer::registerRenderPass(VkRenderPass renderPass, const std::string &name) {
+  mgAssert(!name.empty() && name.size() < sizeof(_ManifestEntry::renderPassName));
+  _renderPassToName[renderPass] = name;
+  prewarmPipelines(name);
+}
+
+void PipelineContainer::unregisterRenderPass(VkRenderPass renderPass) {
+  // the workers may be creating pipelines for the render pass
+  waitForPrewarmedPipelines();
+  _renderPassToName.erase(renderPass);
+}
+
+void PipelineContainer::loadPipelineManifest() {
+  _manifest = std::make_unique<_PipelineManifest>();
+
+  const auto fileName = getPipelineManifestFileName();
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file.is_open())
+    return;
+
+  _ManifestFileHeader header = {};
+  if (!file.read((char *)&header, sizeof(header)) || header.magic != pipelineManifestMagic ||
+      header.version != pipelineManifestVersion || header.entrySize != sizeof(_ManifestEntry)) {
+    LOG("pipeline manifest " << fileName << " is from another version, ignoring it");
+    return;
+  }
+
+  VkPipelineLayout pipelineLayouts[3];
+  const auto pipelineLayoutCount = getPipelineLayouts(pipelineLayouts);
+  for (uint32_t i = 0; i < header.entryCount; i++) {
+    _ManifestEntry entry = {};
+    if (!file.read((char *)&entry, sizeof(entry))) {
+      LOG("pipeline manifest " << fileName << " is truncated");
+      break;
+    }
+    entry.renderPassName[sizeof(entry.renderPassName) - 1] = '\0';
+    entry.pipeline.desc.shaderName[sizeof(entry.pipeline.desc.shaderName) - 1] = '\0';
+    // shaders that have been removed since the manifest was written
+    if (entry.pipelineLayoutIndex >= pipelineLayoutCount || !mg::hasShader(entry.pipeline.desc.shaderName))
+      continue;
+    _manifest->loadedEntries.push_back(entry);
+  }
+}
+
+void PipelineContainer::savePipelineManifest() {
+  if (!_manifest || _manifest->recordedEntries.empty())
+    return;
+
+  // entries for render passes that were not used in this run are kept for the next run
+  auto entries = _manifest->recordedEntries;
+  entries.insert(std::end(entries), std::begin(_manifest->loadedEntries), std::end(_manifest->loadedEntries));
+
+  _ManifestFileHeader header = {};
+  header.magic = pipelineManifestMagic;
+  header.version = pipelineManifestVersion;
+  header.entrySize = sizeof(_ManifestEntry);
+  header.entryCount = uint32_t(entries.size());
+
+  std::vector<char> data(sizeof(header) + entries.size() * sizeof(_ManifestEntry));
+  memcpy(data.data(), &header, sizeof(header));
+  memcpy(data.data() + sizeof(header), entries.data(), entries.size() * sizeof(_ManifestEntry));
+  const auto fileName = getPipelineManifestFileName();
+  if (!mg::writeBinaryToDisc(fileName, data))
+    LOG("could not write pipeline manifest " << fileName);
+}
+
+void PipelineContainer::recordPipeline(const _RegisteredPipeline &registeredPipeline) {
+  if (!_manifest)
+    return;
+
+  _ManifestEntry entry = {};
+  entry.pipeline = registeredPipeline;
+
+  VkPipelineLayout pipelineLayouts[3];
+  const auto pipelineLayoutCount = getPipelineLayouts(pipelineLayouts);
+  auto pipelineLayout = getPipelineLayout(&entry.pipeline);
+  entry.pipelineLayoutIndex = uint32_t(std::find(pipelineLayouts, pipelineLayouts + pipelineLayoutCount,
+                                                 *pipelineLayout) - pipelineLayouts);
+  if (entry.pipelineLayoutIndex == pipelineLayoutCount)
+    return;
+  *pipelineLayout = VK_NULL_HANDLE;
+
+  if (registeredPipeline.type == _PipelineType::Graphics) {
+    auto &renderPass = entry.pipeline.desc.state.rasterization.vkRenderPass;
+    const auto it = _renderPassToName.find(renderPass);
+    // pipelines for unnamed render passes can not be created in the next run
+    if (it == std::end(_renderPassToName))
+      return;
+    strncpy(entry.renderPassName, it->second.c_str(), sizeof(entry.renderPassName) - 1);
+    renderPass = VK_NULL_HANDLE;
+  }
+
+  auto &recordedEntries = _manifest->recordedEntries;
+  for (const auto &recordedEntry : recordedEntries) {
+    if (isSameManifestEntry(recordedEntry, entry))
+      return;
+  }
+  recordedEntries.push_back(entry);
+}
+
+void PipelineContainer::prewarmPipelines(const std::string &renderPassName) {
+  if (!_manifest)
+    return;
+
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  for (const auto &renderPassIt : _renderPassToName) {
+    if (renderPassIt.second == renderPassName)
+      renderPass = renderPassIt.first;
+  }
+
+  VkPipelineLayout pipelineLayouts[3];
+  getPipelineLayouts(pipelineLayouts);
+
+  auto batch = std::make_unique<_PrewarmBatch>();
+  batch->renderPassName = renderPassName;
+  auto &loadedEntries = _manifest->loadedEntries;
+  for (auto it = std::begin(loadedEntries); it != std::end(loadedEntries);) {
+    if (renderPassName != it->renderPassName) {
+      ++it;
+      continue;
+    }
+    auto registeredPipeline = it->pipeline;
+    *getPipelineLayout(&registeredPipeline) = pipelineLayouts[it->pipelineLayoutIndex];
+    if (registeredPipeline.type == _PipelineType::Graphics)
+      registeredPipeline.desc.state.rasterization.vkRenderPass = renderPass;
+
+    const auto handle = registerPipelineDesc(registeredPipeline.desc, registeredPipeline.type);
+    const auto owner = _pipelineOwners[handle.index];
+    if (_pipelines[owner].pipeline == VK_NULL_HANDLE &&
+        std::find(std::begin(batch->pipelineIndices), std::end(batch->pipelineIndices), owner) ==
+            std::end(batch->pipelineIndices)) {
+      batch->pipelineIndices.push_back(owner);
+      batch->pipelines.push_back(_registeredPipelines[owner].get());
+    }
+    it = loadedEntries.erase(it);
+  }
+  if (batch->pipelines.empty())
+    return;
+
+  batch->results.resize(batch->pipelines.size());
+  batch->start = mg::timer::now();
+  batch->job = mg::jobs::createJob([batch = batch.get()]() {
+    // vkCreate*Pipelines synchronizes the shared pipeline cache internally
+    mg::jobs::parallelFor(0, uint32_t(batch->pipelines.size()), 1, [batch](uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < end; i++) {
+        const auto &pipeline = *batch->pipelines[i];
+        batch->results[i] = _createRegisteredPipeline(pipeline, mg::getShader(pipeline.desc.shaderName));
+      }
+    });
+    batch->isDone = true;
+  });
+  mg::jobs::run(batch->job);
+  _prewarmBatches.push_back(std::move(batch));
+}
+
+void PipelineContainer::waitForPrewarmedPipelines() {
+  for (auto &batch : _prewarmBatches) {
+    installPrewarmedPipelines(batch.get());
+  }
+  _prewarmBatches.clear();
+}
+
+void PipelineContainer::installPrewarmedPipelines(_PrewarmBatch *batch) {
+  const auto waitStart = mg::timer::now();
+  // a finished job can be reused, it is only waited on while it is running
+  if (!batch->isDone)
+    mg::jobs::wait(batch->job);
+  const auto end = mg::timer::now();
+  for (size_t i = 0; i < batch->pipelines.size(); i++) {
+    auto &pipeline = _pipelines[batch->pipelineIndices[i]];
+    // the manifest may list a pipeline twice
+    if (pipeline.pipeline != VK_NULL_HANDLE)
+      vkDestroyPipeline(mg::vkContext.device, batch->results[i].pipeline, nullptr);
+    else
+      pipeline = batch->results[i];
+  }
+  LOG("pre-warmed " << batch->pipelines.size() << " pipelines"
+                    << (batch->renderPassName.empty() ? "" : " for render pass " + batch->renderPassName) << " on "
+                    << mg::jobs::getNrOfThreads() << " threads in "
+                    << mg::timer::durationInUs(batch->start, end) / 1000.0 << " ms, waited "
+                    << mg::timer::durationInUs(waitStart, end) / 1000.0 << " ms, "
+                    << (mg::vkContext.isPipelineCacheWarm ? "warm" : "cold") << " pipeline cache");
+}
+
+void PipelineContainer::updateShaderHotReload() {
+  _frameIndex++;
+  destroyRetiredObjects(false);
+  if (_shaderReload) {
+    // without worker threads the job only runs when it is waited on
+    if (_shaderReload->isDone || mg::jobs::getNrOfThreads() == 1)
+      swapReloadedShaders();
+    return;
+  }
+
+  const auto shaderNames = mg::getChangedShaders();
+  if (shaderNames.empty())
+    return;
+
+  auto reload = std::make_unique<_ShaderReload>();
+  reload->shaderNames = shaderNames;
+  // pipelines that have not been created yet are created with the new shaders on first use
+  for (uint32_t i = 0; i < _pipelines.size(); i++) {
+    const auto &registeredPipeline = *_registeredPipelines[i];
+    if (_pipelines[i].pipeline == VK_NULL_HANDLE ||
+        std::find(std::begin(shaderNames), std::end(shaderNames), registeredPipeline.desc.shaderName) ==
+            std::end(shaderNames))
+      continue;
+    reload->pipelineIndices.push_back(i);
+    reload->pipelines.push_back(registeredPipeline);
+  }
+  reload->results.resize(reload->pipelines.size());
+  reload->start = mg::timer::now();
+  reload->job = mg::jobs::createJob([reload = reload.get()]() {
+    for (const auto &shaderName : reload->shaderNames) {
+      reload->shaders.push_back(mg::loadShader(shaderName));
+    }
+    mg::jobs::parallelFor(0, uint32_t(reload->pipelines.size()), 1, [reload](uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < end; i++) {
+        const auto &pipeline = reload->pipelines[i];
+        const auto &shader =
+            *std::find_if(std::begin(reload->shaders), std::end(reload->shaders),
+                          [&](const Shader &shader) { return shader.name == pipeline.desc.shaderName; });
+        // the shader files have been removed, the old pipeline is kept
+        if (shader.count > 0)
+          reload->results[i] = _createRegisteredPipeline(pipeline, shader);
+      }
+    });
+    reload->end = mg::timer::now();
+    reload->isDone = true;
+  });
+  mg::jobs::run(reload->job);
+  _shaderReload = std::move(reload);
+}
+
+void PipelineContainer::swapReloadedShaders() {
+  auto &reload = *_shaderReload;
+  if (!reload.isDone)
+    mg::jobs::wait(reload.job);
+  // pre-warmed pipelines are created with the old shader modules, and the optimized links use the old libraries
+  waitForPrewarmedPipelines();
+  waitForOptimizedPipelines();
+
+  std::string shaderNames;
+  std::vector<std::string> reloadedShaderNames;
+  for (const auto &shader : reload.shaders) {
+    if (shader.count == 0)
+      continue;
+    const auto oldShader = mg::replaceShader(shader);
+    for (uint32_t i = 0; i < oldShader.count; i++) {
+      _retiredObjects.push_back({VK_NULL_HANDLE, oldShader.stageCreateInfo[i].module, _frameIndex});
+    }
+    reloadedShaderNames.push_back(shader.name);
+    shaderNames += (shaderNames.empty() ? "" : ", ") + shader.name;
+  }
+
+  // libraries of the reloaded shaders are created again on first use
+  const auto isReloaded = [&reloadedShaderNames](const std::string &shaderName) {
+    return std::find(std::begin(reloadedShaderNames), std::end(reloadedShaderNames), shaderName) !=
+           std::end(reloadedShaderNames);
+  };
+  auto &pendingLinks = _pipelineLibraries->pendingLinks;
+  pendingLinks.erase(std::remove_if(std::begin(pendingLinks), std::end(pendingLinks),
+                                    [&](const _PipelineLink &link) { return isReloaded(link.desc.shaderName); }),
+                     std::end(pendingLinks));
+  for (auto &part : _pipelineLibraries->parts) {
+    for (auto it = std::begin(part); it != std::end(part);) {
+      if (it->second.shaderName.empty() || !isReloaded(it->second.shaderName)) {
+        ++it;
+        continue;
+      }
+      _retiredObjects.push_back({it->second.pipeline, VK_NULL_HANDLE, _frameIndex});
+      it = part.erase(it);
+    }
+  }
+
+  std::vector<bool> isRebuilt(_pipelines.size(), false);
+  uint32_t nrOfRebuiltPipelines = 0;
+  for (size_t i = 0; i < reload.pipelines.size(); i++) {
+    if (reload.results[i].pipeline == VK_NULL_HANDLE)
+      continue;
+    auto &pipeline = _pipelines[reload.pipelineIndices[i]];
+    if (pipeline.pipeline != VK_NULL_HANDLE)
+      _retiredObjects.push_back({pipeline.pipeline, VK_NULL_HANDLE, _frameIndex});
+    pipeline = reload.results[i];
+    isRebuilt[reload.pipelineIndices[i]] = true;
+    nrOfRebuiltPipelines++;
+  }
+  // pipelines created while the worker was running use the old shader modules, they are created again on first use
+  for (uint32_t i = 0; i < _pipelines.size(); i++) {
+    auto &pipeline = _pipelines[i];
+    if (isRebuilt[i] || pipeline.pipeline == VK_NULL_HANDLE ||
+        std::find(std::begin(reloadedShaderNames), std::end(reloadedShaderNames),
+                  _registeredPipelines[i]->desc.shaderName) == std::end(reloadedShaderNames))
+      continue;
+    _retiredObjects.push_back({pipeline.pipeline, VK_NULL_HANDLE, _frameIndex});
+    pipeline.pipeline = VK_NULL_HANDLE;
+  }
+
+  if (!reloadedShaderNames.empty()) {
+    LOG("reloaded shaders " << shaderNames << " and rebuilt " << nrOfRebuiltPipelines << " pipelines in "
+                            << mg::timer::durationInUs(reload.start, reload.end) / 1000.0 << " ms");
+  }
+  _shaderReload.reset();
+}
+
+void PipelineContainer::discardShaderReload() {
+  if (!_shaderReload)
+    return;
+  if (!_shaderReload->isDone)
+    mg::jobs::wait(_shaderReload->job);
+  for (const auto &pipeline : _shaderReload->results) {
+    if (pipeline.pipeline != VK_NULL_HANDLE)
+      vkDestroyPipeline(mg::vkContext.device, pipeline.pipeline, nullptr);
+  }
+  for (const auto &shader : _shaderReload->shaders) {
+    mg::destroyShader(shader);
+  }
+  _shaderReload.reset();
+}
+
+Pipeline PipelineContainer::linkPipeline(uint32_t pipelineIndex) {
+  const auto &pipelineDesc = _registeredPipelines[pipelineIndex]->desc;
+  _PipelineLink link = {};
+  link.pipelineIndex = pipelineIndex;
+  link.desc = pipelineDesc;
+  for (uint32_t i = 0; i < NR_OF_LIBRARY_PARTS; i++) {
+    const auto part = _PipelineLibraryPart(i);
+    const auto libraryDesc = getPipelineLibraryDesc(pipelineDesc, part);
+    auto &library = _pipelineLibraries->parts[part][hashPipelineDesc(libraryDesc)];
+    if (library.pipeline == VK_NULL_HANDLE) {
+      if (part == PRE_RASTERIZATION || part == FRAGMENT_SHADER) {
+        const auto shader = mg::getShader(libraryDesc.shaderName);
+        library.pipeline = _createPipelineLibrary(libraryDesc, &shader, part);
+        library.shaderName = libraryDesc.shaderName;
+      } else {
+        library.pipeline = _createPipelineLibrary(libraryDesc, nullptr, part);
+      }
+    }
+    link.libraries[part] = library.pipeline;
+  }
+  const auto pipeline = _linkPipeline(pipelineDesc, link.libraries, false);
+  link.fastLinkedPipeline = pipeline.pipeline;
+  _pipelineLibraries->pendingLinks.push_back(link);
+  return pipeline;
+}
+
+void PipelineContainer::updateOptimizedPipelines() {
+  auto &libraries = *_pipelineLibraries;
+  if (libraries.optimizedLinks) {
+    // without worker threads the job only runs when it is waited on
+    if (libraries.optimizedLinks->isDone || mg::jobs::getNrOfThreads() == 1)
+      waitForOptimizedPipelines();
+    return;
+  }
+  if (libraries.pendingLinks.empty())
+    return;
+
+  auto batch = std::make_unique<_OptimizedLinkBatch>();
+  batch->links.swap(libraries.pendingLinks);
+  batch->start = mg::timer::now();
+  batch->job = mg::jobs::createJob([batch = batch.get()]() {
+    mg::jobs::parallelFor(0, uint32_t(batch->links.size()), 1, [batch](uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < end; i++) {
+        auto &link = batch->links[i];
+        link.optimizedPipeline = _linkPipeline(link.desc, link.libraries, true);
+      }
+    });
+    batch->end = mg::timer::now();
+    batch->isDone = true;
+  });
+  mg::jobs::run(batch->job);
+  libraries.optimizedLinks = std::move(batch);
+}
+
+void PipelineContainer::waitForOptimizedPipelines() {
+  if (!_pipelineLibraries->optimizedLinks)
+    return;
+  auto &batch = *_pipelineLibraries->optimizedLinks;
+  if (!batch.isDone)
+    mg::jobs::wait(batch.job);
+  for (const auto &link : batch.links) {
+    auto &pipeline = _pipelines[link.pipelineIndex];
+    // the fast linked pipeline is still used by the frames in flight
+    mgAssert(pipeline.pipeline == link.fastLinkedPipeline);
+    _retiredObjects.push_back({pipeline.pipeline, VK_NULL_HANDLE, _frameIndex});
+    pipeline = link.optimizedPipeline;
+  }
+  LOG("linked " << batch.links.size() << " pipelines with link time optimization in "
+                << mg::timer::durationInUs(batch.start, batch.end) / 1000.0 << " ms");
+  _pipelineLibraries->optimizedLinks.reset();
+}
+
+void PipelineContainer::destroyPipelineLibraries() {
+  auto &libraries = *_pipelineLibraries;
+  if (libraries.optimizedLinks) {
+    if (!libraries.optimizedLinks->isDone)
+      mg::jobs::wait(libraries.optimizedLinks->job);
+    for (const auto &link : libraries.optimizedLinks->links) {
+      vkDestroyPipeline(mg::vkContext.device, link.optimizedPipeline.pipeline, nullptr);
+    }
+    libraries.optimizedLinks.reset();
+  }
+  // the fast linked pipelines are destroyed with the other pipelines
+  libraries.pendingLinks.clear();
+  for (auto &part : libraries.parts) {
+    for (const auto &library : part) {
+      vkDestroyPipeline(mg::vkContext.device, library.second.pipeline, nullptr);
+    }
+    part.clear();
+  }
+}
+
+void PipelineContainer::destroyRetiredObjects(bool destroyAll) {
+  // a frame starts by waiting for the frame that used its command buffer, objects retired that many frames ago are
+  // no longer in use
+  const uint64_t nrOfFramesInFlight = mg::vkContext.commandBuffers.nrOfBuffers;
+  auto it = std::remove_if(std::begin(_retiredObjects), std::end(_retiredObjects), [&](const _RetiredObject &object) {
+    if (!destroyAll && _frameIndex - object.frameIndex < nrOfFramesInFlight)
+      return false;
+    if (object.pipeline != VK_NULL_HANDLE)
+      vkDestroyPipeline(mg::vkContext.device, object.pipeline, nullptr);
+    if (object.shaderModule != VK_NULL_HANDLE)
+      vkDestroyShaderModule(mg::vkContext.device, object.shaderModule, nullptr);
+    return true;
+  });
+  _retiredObjects.erase(it, std::end(_retiredObjects));
+}
+
+void PipelineContainer::logPipelineCreationTime() {
+  if (_isFirstFrame) {
+    LOG("first frame recorded " << mg::timer::durationInUs(_createTime, mg::timer::now()) / 1000.0
+                                << " ms after the pipeline container was created, "
+                                << (mg::vkContext.extensions.graphicsPipelineLibrary ? "with" : "without")
+                                << " pipeline libraries");
+    _isFirstFrame = false;
+  }
+  if (_creationTime.nrOfPipelines == 0)
+    return;
+  LOG("created " << _creationTime.nrOfPipelines << " pipelines (" << _creationTime.nrOfLinkedPipelines
+                 << " fast linked) in " << _creationTime.timeInUs / 1000.0 << " ms, "
+                 << (mg::vkContext.isPipelineCacheWarm ? "warm" : "cold") << " pipeline cache");
+  _creationTime = {};
+}
+
+PipelineHandle PipelineContainer::registerPipelineDesc(const _PipelineDesc &pipelineDesc, _PipelineType type) {
+  auto hashValue = hashPipelineDesc(pipelineDesc);
+
+  PipelineHandle handle = {};
+  handle.generation = _generation;
+
+  auto it = _idToPipelineIndex.find(hashValue);
+  if (it != std::end(_idToPipelineIndex)) {
+    handle.index = it->second;
+    return handle;
+  }
+
+  handle.index = uint32_t(_pipelines.size());
+  _pipelines.push_back({});
+  _registeredPipelines.push_back(std::make_unique<_RegisteredPipeline>());
+  _registeredPipelines.back()->desc = pipelineDesc;
+  _registeredPipelines.back()->type = type;
+  _idToPipelineIndex.emplace(hashValue, handle.index);
+  _pipelineOwners.push_back(handle.index);
+  if (type == _PipelineType::Graphics && mg::vkContext.extensions.extendedDynamicState) {
+    const auto staticHashValue = hashPipelineDesc(getStaticPipelineDesc(pipelineDesc));
+    _pipelineOwners.back() = _dynamicIdToPipelineIndex.emplace(staticHashValue, handle.index).first->second;
+  }
+  recordPipeline(*_registeredPipelines.back());
+  return handle;
+}
+
+PipelineHandle PipelineContainer::registerPipeline(const PipelineStateDesc &pipelineDesc,
+                                                   const CreatePipelineInfo &createPipelineInfo) {
   _PipelineDesc _pipelineDesc = {};
   _pipelineDesc.state = pipelineDesc;
   mgAssert(createPipelineInfo.shaderName.size() + 1 < mg::countof(_pipelineDesc.shaderName));
@@ -275,103 +1225,110 @@ Pipeline PipelineContainer::createPipeline(const PipelineStateDesc &pipelineDesc
     _pipelineDesc.vertexInputState[i].offset = vertexInputState[i].offset;
     _pipelineDesc.vertexInputState[i].size = vertexInputState[i].size;
   }
-
-  auto startAdress = (const unsigned char *)((&_pipelineDesc));
-  auto hashValue = hashBytes(startAdress, startAdress + sizeof(_pipelineDesc));
-
-  auto it = _idToPipeline.find(hashValue);
-  if (it != std::end(_idToPipeline)) {
-    return it->second;
-  }
-  auto pipeline = _createPipeline(_pipelineDesc);
-  _idToPipeline.emplace(hashValue, pipeline);
-  return pipeline;
+  setSpecialization(createPipelineInfo.specializationInfo, &_pipelineDesc.specialization);
+  return registerPipelineDesc(_pipelineDesc, _PipelineType::Graphics);
 }
 
-Pipeline PipelineContainer::createComputePipeline(const PipelineStateDesc &pipelineDesc,
-                                                  const CreateComputePipelineInfo &createComputePipelineInfo) {
-
+PipelineHandle PipelineContainer::registerComputePipeline(const PipelineStateDesc &pipelineDesc,
+                                                          const CreateComputePipelineInfo &createComputePipelineInfo) {
   _PipelineDesc _pipelineDesc = {};
   _pipelineDesc.state = pipelineDesc;
   mgAssert(createComputePipelineInfo.shaderName.size() + 1 < mg::countof(_pipelineDesc.shaderName));
   strncpy(_pipelineDesc.shaderName, createComputePipelineInfo.shaderName.c_str(), sizeof(_pipelineDesc.shaderName));
-
-  auto startAdress = (const unsigned char *)((&_pipelineDesc));
-  auto hashValue = hashBytes(startAdress, startAdress + sizeof(_pipelineDesc));
-
-  auto it = _idToPipeline.find(hashValue);
-  if (it != std::end(_idToPipeline)) {
-    return it->second;
-  }
-
-  // create new pipeline
-  const auto shader = mg::getShader(createComputePipelineInfo.shaderName);
-
-  VkPipelineShaderStageCreateInfo shaderStageCreateInfo = {};
-  shaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  shaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-  mgAssert(shader.count == 1);
-  shaderStageCreateInfo.module = shader.stageCreateInfo[0].module;
-  shaderStageCreateInfo.pName = "main";
-
-  VkComputePipelineCreateInfo pipelineCreateInfo = {};
-  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-  pipelineCreateInfo.stage = shaderStageCreateInfo;
-  pipelineCreateInfo.layout = pipelineDesc.compute.pipelineLayout;
-
-  Pipeline pipeline = {};
-  pipeline.layout = pipelineDesc.compute.pipelineLayout;
-  checkResult(
-      vkCreateComputePipelines(vkContext.device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline.pipeline));
-
-  _idToPipeline.emplace(hashValue, pipeline);
-  return pipeline;
-
+  setSpecialization(createComputePipelineInfo.specializationInfo, &_pipelineDesc.specialization);
+  return registerPipelineDesc(_pipelineDesc, _PipelineType::Compute);
 }
 
-Pipeline PipelineContainer::createRayTracingPipeline(const PipelineStateDesc &pipelineDesc,
-                                                     const CreateRayTracingPipelineInfo &createRayTracingPipelineInfo) {
+PipelineHandle
+PipelineContainer::registerRayTracingPipeline(const PipelineStateDesc &pipelineDesc,
+                                              const CreateRayTracingPipelineInfo &createRayTracingPipelineInfo) {
   _PipelineDesc _pipelineDesc = {};
   _pipelineDesc.state = pipelineDesc;
   mgAssert(createRayTracingPipelineInfo.shaderName.size() + 1 < mg::countof(_pipelineDesc.shaderName));
   strncpy(_pipelineDesc.shaderName, createRayTracingPipelineInfo.shaderName.c_str(), sizeof(_pipelineDesc.shaderName));
+  return registerPipelineDesc(_pipelineDesc, _PipelineType::RayTracing);
+}
 
-  auto startAdress = (const unsigned char *)((&_pipelineDesc));
-  auto hashValue = hashBytes(startAdress, startAdress + sizeof(_pipelineDesc));
+bool PipelineContainer::isValid(PipelineHandle handle) const {
+  return handle.generation == _generation && handle.index < _pipelines.size();
+}
 
-  auto it = _idToPipeline.find(hashValue);
-  if (it != std::end(_idToPipeline)) {
-    return it->second;
-  }
+bool PipelineContainer::isValid(PipelineHandle handle, VkRenderPass renderPass, uint32_t subpass) const {
+  if (!isValid(handle))
+    return false;
+  const auto &rasterization = _registeredPipelines[handle.index]->desc.state.rasterization;
+  return rasterization.vkRenderPass == renderPass && rasterization.graphics.subpass == subpass;
+}
 
-  const auto &shader = mg::getShader(createRayTracingPipelineInfo.shaderName);
-  const auto &fToI = shader.fileNameToIndex;
-  const auto &rayTracing = pipelineDesc.rayTracing;
-  enum { MAX_SHADER_STAGES = 10 };
-  VkPipelineShaderStageCreateInfo shaderStageCreateInfo[MAX_SHADER_STAGES];
-  mgAssert(MAX_SHADER_STAGES >= rayTracing.shaderCount);
-  for (uint32_t i = 0; i < rayTracing.shaderCount; i++) {
-    const auto shaderIndex = fToI.at(rayTracing.shaders[i]);
-    mgAssert(shaderIndex < shader.count);
-    shaderStageCreateInfo[i] = shader.stageCreateInfo[shaderIndex];
+Pipeline PipelineContainer::getPipeline(PipelineHandle handle) {
+  mgAssertDesc(isValid(handle), "pipeline handle is not registered in this pipeline container");
+  const auto owner = _pipelineOwners[handle.index];
+  auto &pipeline = _pipelines[owner];
+  // only the batch that creates the pipeline is waited on, the other batches keep running
+  for (auto it = std::begin(_prewarmBatches); pipeline.pipeline == VK_NULL_HANDLE && it != std::end(_prewarmBatches);
+       ++it) {
+    const auto &pipelineIndices = (*it)->pipelineIndices;
+    if (std::find(std::begin(pipelineIndices), std::end(pipelineIndices), owner) == std::end(pipelineIndices))
+      continue;
+    installPrewarmedPipelines(it->get());
+    _prewarmBatches.erase(it);
+    break;
   }
+  if (pipeline.pipeline == VK_NULL_HANDLE) {
+    const auto start = mg::timer::now();
+    const auto &registeredPipeline = *_registeredPipelines[owner];
+    if (registeredPipeline.type == _PipelineType::Graphics && mg::vkContext.extensions.graphicsPipelineLibrary) {
+      pipeline = linkPipeline(owner);
+      _creationTime.nrOfLinkedPipelines++;
+    } else {
+      pipeline = _createRegisteredPipeline(registeredPipeline, mg::getShader(registeredPipeline.desc.shaderName));
+    }
+    _creationTime.timeInUs += mg::timer::durationInUs(start, mg::timer::now());
+    _creationTime.nrOfPipelines++;
+  }
+  if (owner == handle.index)
+    return pipeline;
 
-  VkRayTracingPipelineCreateInfoNV rayPipelineInfo{};
-  rayPipelineInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_NV;
-  rayPipelineInfo.stageCount = pipelineDesc.rayTracing.shaderCount;
-  rayPipelineInfo.pStages = shaderStageCreateInfo;
-  rayPipelineInfo.pGroups = pipelineDesc.rayTracing.groups;
-  rayPipelineInfo.groupCount = pipelineDesc.rayTracing.groupCount;
-  rayPipelineInfo.layout = pipelineDesc.rayTracing.pipelineLayout;
-  rayPipelineInfo.maxRecursionDepth = 1;
+  // shared with the owner, the dynamic state is the one of this handle
+  Pipeline sharedPipeline = pipeline;
+  setDynamicState(_registeredPipelines[handle.index]->desc, &sharedPipeline);
+  return sharedPipeline;
+}
 
-  Pipeline pipeline = {};
-  pipeline.layout = pipelineDesc.rayTracing.pipelineLayout;
-  checkResult(nv::vkCreateRayTracingPipelinesNV(mg::vkContext.device, VK_NULL_HANDLE, 1, &rayPipelineInfo, nullptr,
-                                                &pipeline.pipeline));
+void bindGraphicsPipeline(VkCommandBuffer commandBuffer, const Pipeline &pipeline) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  const auto &dynamicState = pipeline.dynamicState;
+  if (!dynamicState.isEnabled)
+    return;
+  ext::vkCmdSetPrimitiveTopologyEXT(commandBuffer, dynamicState.topology);
+  ext::vkCmdSetCullModeEXT(commandBuffer, dynamicState.cullMode);
+  ext::vkCmdSetFrontFaceEXT(commandBuffer, dynamicState.frontFace);
+  ext::vkCmdSetDepthTestEnableEXT(commandBuffer, dynamicState.depthTestEnable);
+  ext::vkCmdSetDepthWriteEnableEXT(commandBuffer, dynamicState.depthWriteEnable);
+  ext::vkCmdSetDepthCompareOpEXT(commandBuffer, dynamicState.depthCompareOp);
+}
 
-  _idToPipeline.emplace(hashValue, pipeline);
-  return pipeline;
-} // namespace mg
+bool isSamePipeline(const Pipeline &a, const Pipeline &b) {
+  const auto &x = a.dynamicState;
+  const auto &y = b.dynamicState;
+  return a.pipeline == b.pipeline && x.isEnabled == y.isEnabled && x.topology == y.topology &&
+         x.cullMode == y.cullMode && x.frontFace == y.frontFace && x.depthTestEnable == y.depthTestEnable &&
+         x.depthWriteEnable == y.depthWriteEnable && x.depthCompareOp == y.depthCompareOp;
+}
+
+Pipeline PipelineContainer::createPipeline(const PipelineStateDesc &pipelineDesc,
+                                           const CreatePipelineInfo &createPipelineInfo) {
+  return getPipeline(registerPipeline(pipelineDesc, createPipelineInfo));
+}
 
-} // namespace mg
\ No newline at end of file
+Pipeline PipelineContainer::createComputePipeline(const PipelineStateDesc &pipelineDesc,
+                                                  const CreateComputePipelineInfo &createComputePipelineInfo) {
+  return getPipeline(registerComputePipeline(pipelineDesc, createComputePipelineInfo));
+}
+
+Pipeline PipelineContainer::createRayTracingPipeline(const PipelineStateDesc &pipelineDesc,
+                                                     const CreateRayTracingPipelineInfo &createRayTracingPipelineInfo) {
+  return getPipeline(registerRayTracingPipeline(pipelineDesc, createRayTracingPipelineInfo));
+}
+
+} // namespace mg
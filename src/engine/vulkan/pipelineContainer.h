@@ -4,7 +4,9 @@
 #include "vkContext.h"
 
 #include "mg/mgAssert.h"
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace mg {
 
@@ -67,38 +69,155 @@ struct PipelineStateDesc {
 struct Pipeline {
   VkPipeline pipeline;
   VkPipelineLayout layout;
+  // with VK_EXT_extended_dynamic_state these are not part of the graphics pipeline, they are set when it is bound.
+  // Descriptions that only differ in them share the pipeline
+  struct {
+    bool isEnabled;
+    VkPrimitiveTopology topology;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    VkBool32 depthTestEnable;
+    VkBool32 depthWriteEnable;
+    VkCompareOp depthCompareOp;
+  } dynamicState;
 };
 
+// binds the graphics pipeline and sets its dynamic state
+void bindGraphicsPipeline(VkCommandBuffer commandBuffer, const Pipeline &pipeline);
+// same pipeline handle and dynamic state
+bool isSamePipeline(const Pipeline &a, const Pipeline &b);
+
+// specialization constants are copied into the pipeline description and are part of the pipeline key, the same
+// constants are used for all stages of a graphics pipeline
 struct CreatePipelineInfo {
   std::string shaderName;
   mg::shaders::VertexInputState *vertexInputState;
   uint32_t vertexInputStateCount;
+  const VkSpecializationInfo *specializationInfo;
 };
 
 struct CreateComputePipelineInfo {
   std::string shaderName;
+  const VkSpecializationInfo *specializationInfo;
 };
 
 struct CreateRayTracingPipelineInfo {
   std::string shaderName;
 };
 
+// index of a registered pipeline description. Getting the pipeline through a handle does not copy or hash the
+// description, so draw calls that run every frame register once and keep the handle
+struct PipelineHandle {
+  uint32_t index = UINT32_MAX;
+  uint32_t generation = 0;
+};
+
+struct _PipelineDesc;
+struct _RegisteredPipeline;
+struct _PipelineManifest;
+struct _PrewarmBatch;
+struct _ShaderReload;
+struct _PipelineLibraries;
+enum class _PipelineType;
+
 class PipelineContainer : mg::nonCopyable {
 public:
+  PipelineContainer();
   void createPipelineContainer();
   void destroyPipelineContainer();
 
+  // reloads the shaders, registered handles stay valid
   void resetPipelineContainer();
 
+  // hashes the description and returns the pipeline, prefer registering a handle for pipelines used every frame
   Pipeline createPipeline(const PipelineStateDesc &pipelineDesc, const CreatePipelineInfo &createPipelineInfo);
   Pipeline createComputePipeline(const PipelineStateDesc &pipelineDesc,
                                  const CreateComputePipelineInfo &createComputePipelineInfo);
   Pipeline createRayTracingPipeline(const PipelineStateDesc &pipelineDesc,
                                     const CreateRayTracingPipelineInfo &CreateRayTracingPipelineInfo);
+
+  // registering the same description twice returns the same handle, the pipeline is created on first use
+  PipelineHandle registerPipeline(const PipelineStateDesc &pipelineDesc, const CreatePipelineInfo &createPipelineInfo);
+  PipelineHandle registerComputePipeline(const PipelineStateDesc &pipelineDesc,
+                                         const CreateComputePipelineInfo &createComputePipelineInfo);
+  PipelineHandle registerRayTracingPipeline(const PipelineStateDesc &pipelineDesc,
+                                            const CreateRayTracingPipelineInfo &createRayTracingPipelineInfo);
+  // false for default handles and for handles registered before the container was destroyed
+  bool isValid(PipelineHandle handle) const;
+  // also checks that a graphics pipeline handle was registered for the render pass and subpass
+  bool isValid(PipelineHandle handle, VkRenderPass renderPass, uint32_t subpass) const;
+  Pipeline getPipeline(PipelineHandle handle);
+
+  // the pipelines used in a run are recorded in a manifest, and created by the job system when the next run starts.
+  // The name identifies the render pass across runs, pipelines for unnamed render passes are not recorded. The
+  // recorded pipelines of the render pass are pre-warmed when it is registered
+  void registerRenderPass(VkRenderPass renderPass, const std::string &name);
+  void unregisterRenderPass(VkRenderPass renderPass);
+  // installs the pre-warmed pipelines, blocks until the jobs are done
+  void waitForPrewarmedPipelines();
+
+  // the shader build directory is polled for changed spir-v files. The changed shaders are loaded and the pipelines
+  // that use them are rebuilt by a job, then swapped in at the start of a frame. Old pipelines and shader modules are
+  // destroyed when the frames in flight are done with them
+  void updateShaderHotReload();
+
+  // with VK_EXT_graphics_pipeline_library the vertex input, pre-rasterization, fragment shader and fragment output
+  // parts of graphics pipelines are created and cached separately, and pipelines are fast linked from them on first
+  // use. The fast linked pipelines are linked again with link time optimization by a job, and swapped in at the start
+  // of a frame
+  void updateOptimizedPipelines();
+
+  // logs the time spent creating pipelines since the last call, used to compare cold and warm pipeline cache starts
+  void logPipelineCreationTime();
   ~PipelineContainer();
 
 private:
-  std::unordered_map<uint64_t, Pipeline> _idToPipeline;
+  PipelineHandle registerPipelineDesc(const _PipelineDesc &pipelineDesc, _PipelineType type);
+  void destroyPipelines();
+  void loadPipelineManifest();
+  void savePipelineManifest();
+  void recordPipeline(const _RegisteredPipeline &registeredPipeline);
+  void prewarmPipelines(const std::string &renderPassName);
+  void installPrewarmedPipelines(_PrewarmBatch *batch);
+  void swapReloadedShaders();
+  void discardShaderReload();
+  void destroyRetiredObjects(bool destroyAll);
+  Pipeline linkPipeline(uint32_t pipelineIndex);
+  void waitForOptimizedPipelines();
+  void destroyPipelineLibraries();
+
+  // indexed by the handles, a pipeline is VK_NULL_HANDLE until first use and after a reset
+  std::vector<Pipeline> _pipelines;
+  std::vector<std::unique_ptr<_RegisteredPipeline>> _registeredPipelines;
+  std::unordered_map<uint64_t, uint32_t> _idToPipelineIndex;
+  // index of the handle that owns the vulkan pipeline, handles that only differ in dynamic state share the first
+  // one registered. Only owners have a pipeline in _pipelines
+  std::vector<uint32_t> _pipelineOwners;
+  std::unordered_map<uint64_t, uint32_t> _dynamicIdToPipelineIndex;
+  uint32_t _generation = 0;
+
+  std::unordered_map<VkRenderPass, std::string> _renderPassToName;
+  std::unique_ptr<_PipelineManifest> _manifest;
+  // only touched on the main thread, the jobs write to their batch
+  std::vector<std::unique_ptr<_PrewarmBatch>> _prewarmBatches;
+
+  std::unique_ptr<_ShaderReload> _shaderReload;
+  // replaced by a shader reload, still used by the frames in flight
+  struct _RetiredObject {
+    VkPipeline pipeline;
+    VkShaderModule shaderModule;
+    uint64_t frameIndex;
+  };
+  std::vector<_RetiredObject> _retiredObjects;
+  uint64_t _frameIndex = 0;
+  std::unique_ptr<_PipelineLibraries> _pipelineLibraries;
+  struct {
+    uint32_t nrOfPipelines;
+    uint32_t nrOfLinkedPipelines;
+    uint64_t timeInUs;
+  } _creationTime = {};
+  mg::timer::Time _createTime;
+  bool _isFirstFrame = false;
 };
 
 struct Pipelines {
@@ -0,0 +1,92 @@
+#include "secondaryCommandBuffers.h"
+#include "mg/mgSystem.h"
+#include "rendering/rendering.h"
+#include "vkUtils.h"
+
+namespace mg {
+
+void SecondaryCommandBuffers::create() {
+  VkCommandPoolCreateInfo poolCreateInfo = {};
+  poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolCreateInfo.queueFamilyIndex = mg::vkContext.queueFamilyIndex;
+  poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  const auto nrOfCommandPools = jobs::getNrOfThreads();
+  // pools for every possible frame in flight, the number of frames in flight can change at runtime
+  for (uint32_t i = 0; i < MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
+    _commandPools[i].resize(nrOfCommandPools);
+    for (auto &commandPool : _commandPools[i]) {
+      checkResult(vkCreateCommandPool(mg::vkContext.device, &poolCreateInfo, nullptr, &commandPool.commandPool));
+      commandPool.nrOfUsedCommandBuffers = 0;
+    }
+  }
+}
+
+void SecondaryCommandBuffers::destroy() {
+  for (auto &commandPools : _commandPools) {
+    for (auto &commandPool : commandPools) {
+      // frees the command buffers
+      vkDestroyCommandPool(mg::vkContext.device, commandPool.commandPool, nullptr);
+    }
+    commandPools.clear();
+  }
+}
+
+void SecondaryCommandBuffers::beginFrame() {
+  _frameIndex = mg::vkContext.commandBuffers.currentIndex;
+  for (auto &commandPool : _commandPools[_frameIndex]) {
+    checkResult(vkResetCommandPool(mg::vkContext.device, commandPool.commandPool, 0));
+    commandPool.nrOfUsedCommandBuffers = 0;
+  }
+  _lastStats = _stats;
+  _stats = {};
+}
+
+VkCommandBuffer SecondaryCommandBuffers::beginCommandBuffer(uint32_t index, const RenderContext &renderContext) {
+  auto &commandPool = _commandPools[_frameIndex][index];
+  if (commandPool.nrOfUsedCommandBuffers == commandPool.commandBuffers.size()) {
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.commandPool = commandPool.commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    commandBufferAllocateInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    checkResult(vkAllocateCommandBuffers(mg::vkContext.device, &commandBufferAllocateInfo, &commandBuffer));
+    commandPool.commandBuffers.push_back(commandBuffer);
+  }
+  VkCommandBuffer commandBuffer = commandPool.commandBuffers[commandPool.nrOfUsedCommandBuffers++];
+
+  // the framebuffer is not known by the render context, it is optional
+  VkCommandBufferInheritanceInfo inheritanceInfo = {};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = renderContext.renderPass;
+  inheritanceInfo.subpass = renderContext.subpass;
+
+  VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+  commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  commandBufferBeginInfo.flags =
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+  checkResult(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+
+  // dynamic state is not inherited from the frame command buffer
+  setFullscreenViewport(commandBuffer);
+  return commandBuffer;
+}
+
+void SecondaryCommandBuffers::endCommandBuffer(VkCommandBuffer commandBuffer) {
+  checkResult(vkEndCommandBuffer(commandBuffer));
+}
+
+void SecondaryCommandBuffers::executeCommandBuffers(const VkCommandBuffer *commandBuffers, uint32_t count,
+                                                    const timer::Time &start) {
+  vkCmdExecuteCommands(mg::vkContext.commandBuffer, count, commandBuffers);
+  // the state of the frame command buffer is undefined after vkCmdExecuteCommands
+  mg::mgSystem.commandRecorder.invalidate();
+
+  _stats.nrOfCommandBuffers += count;
+  _stats.recordingTimeInUs += timer::durationInUs(start, timer::now());
+}
+
+} // namespace mg
@@ -0,0 +1,75 @@
+#pragma once
+#include "mg/jobs.h"
+#include "mg/mgAssert.h"
+#include "mg/mgUtils.h"
+#include "vkContext.h"
+#include <vector>
+
+namespace mg {
+struct RenderContext;
+
+struct SecondaryCommandBuffersStats {
+  // secondary command buffers executed in the frame
+  uint32_t nrOfCommandBuffers;
+  // cpu time from the start of the recording until the command buffers are executed
+  uint64_t recordingTimeInUs;
+};
+
+// a subpass split into secondary command buffers that are recorded in parallel by the job system and executed in
+// order on the frame command buffer. Every command buffer index has its own command pool per frame in flight, so the
+// jobs never share a pool, the pools of a frame are reset when its fence is signaled
+class SecondaryCommandBuffers : mg::nonCopyable {
+public:
+  void create();
+  void destroy();
+  // resets the command pools of the current frame, called by beginRendering after the fence wait
+  void beginFrame();
+
+  // recordFunction(commandBuffer, index) is called for every index in [0, nrOfCommandBuffers) from the threads of the
+  // job system. The command buffers continue the render pass and subpass of the render context with a fullscreen
+  // viewport and scissor, the subpass must be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. The bound state
+  // and the viewport of the frame command buffer are undefined afterwards, the command recorder is invalidated and the
+  // viewport has to be set again in the next subpass
+  template <typename T>
+  void record(const RenderContext &renderContext, uint32_t nrOfCommandBuffers, const T &recordFunction);
+
+  // one command buffer per thread of the job system
+  uint32_t getMaxNrOfCommandBuffers() const { return uint32_t(_commandPools[0].size()); }
+  // the stats of the last frame
+  SecondaryCommandBuffersStats getStats() const { return _lastStats; }
+
+private:
+  struct _CommandPool {
+    VkCommandPool commandPool;
+    std::vector<VkCommandBuffer> commandBuffers;
+    uint32_t nrOfUsedCommandBuffers;
+  };
+
+  VkCommandBuffer beginCommandBuffer(uint32_t index, const RenderContext &renderContext);
+  void endCommandBuffer(VkCommandBuffer commandBuffer);
+  void executeCommandBuffers(const VkCommandBuffer *commandBuffers, uint32_t count, const timer::Time &start);
+
+  std::vector<_CommandPool> _commandPools[MAX_NR_OF_FRAMES_IN_FLIGHT];
+  uint32_t _frameIndex = 0;
+
+  SecondaryCommandBuffersStats _stats = {};
+  SecondaryCommandBuffersStats _lastStats = {};
+};
+
+template <typename T>
+void SecondaryCommandBuffers::record(const RenderContext &renderContext, uint32_t nrOfCommandBuffers,
+                                     const T &recordFunction) {
+  mgAssert(nrOfCommandBuffers > 0 && nrOfCommandBuffers <= getMaxNrOfCommandBuffers());
+  const auto start = timer::now();
+  VkCommandBuffer commandBuffers[jobs::MaxNrOfWorkerThreads + 1];
+  jobs::parallelFor(0, nrOfCommandBuffers, 1, [&](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+      commandBuffers[i] = beginCommandBuffer(i, renderContext);
+      recordFunction(commandBuffers[i], i);
+      endCommandBuffer(commandBuffers[i]);
+    }
+  });
+  executeCommandBuffers(commandBuffers, nrOfCommandBuffers, start);
+}
+
+} // namespace mg
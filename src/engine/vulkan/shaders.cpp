@@ -1,17 +1,29 @@
 #include "shaders.h"
 
+#include "mg/logger.h"
 #include "mg/mgAssert.h"
 #include "mg/mgUtils.h"
 #include "vkContext.h"
 #include <cassert>
+#include <cstring>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace mg {
 
 static std::unordered_map<std::string, mg::Shader> _shaders;
 
+// last write time of the spir-v files, polled for shader hot reload
+static std::unordered_map<std::string, std::filesystem::file_time_type> _fileTimes;
+// files that changed in the last poll, reported once the write time is the same in two polls so that files the
+// shader compiler is still writing are not loaded
+static std::unordered_map<std::string, std::filesystem::file_time_type> _changedFileTimes;
+static mg::timer::Time _lastPoll = mg::timer::now();
+
 struct ShaderType {
   VkShaderStageFlagBits stage;
   bool isProcedural;
@@ -40,19 +52,34 @@ static ShaderType getShaderType(const std::string &fileName) {
   }
 }
 
-static mg::Shaders getShaderFiles() {
+static std::string getShaderName(const std::string &fileName) {
+  return fileName.substr(0, fileName.find_first_of('.'));
+}
+
+// the build directory also holds the shader archive
+static bool isSpirvFile(const std::filesystem::path &path) {
+  return path.extension() == ".spv";
+}
+
+// lists the files without reading them, the write times are used to find changed files
+static mg::Shaders getShaderFiles(std::unordered_map<std::string, std::filesystem::file_time_type> *fileTimes) {
   mg::Shaders shaders = {};
 
   namespace fs = std::filesystem;
   const auto shaderPath = mg::getShaderPath();
   for (auto &file : fs::directory_iterator(shaderPath)) {
     const auto path = fs::path(file);
+    if (!isSpirvFile(path))
+      continue;
     auto fileName = path.filename().generic_string();
-    auto nameIt = fileName.find_first_of('.');
-    auto name = fileName.substr(0, nameIt);
+    auto name = getShaderName(fileName);
     auto &fileNames = shaders.nameToShaderFiles[name];
     const auto shaderType = getShaderType(fileName);
     fileNames.files.push_back({fileName, shaderType.stage, shaderType.isProcedural});
+    if (fileTimes) {
+      std::error_code errorCode;
+      (*fileTimes)[fileName] = file.last_write_time(errorCode);
+    }
   }
 
   for (auto &files : shaders.nameToShaderFiles) {
@@ -62,8 +89,8 @@ static mg::Shaders getShaderFiles() {
   return shaders;
 }
 
-static VkShaderModule loadShader(const char *fileName, VkDevice device, VkShaderStageFlagBits stageFlag) {
-  auto shaderCode = mg::readBinaryFromDisc(fileName);
+static VkShaderModule loadShader(const char *code, size_t size, VkDevice device) {
+  mgAssert(size % 4 == 0 && uintptr_t(code) % 4 == 0);
   VkShaderModule shaderModule;
   VkShaderModuleCreateInfo moduleCreateInfo;
   VkResult err;
@@ -71,52 +98,267 @@ static VkShaderModule loadShader(const char *fileName, VkDevice device, VkShader
   moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   moduleCreateInfo.pNext = nullptr;
 
-  moduleCreateInfo.codeSize = shaderCode.size();
-  moduleCreateInfo.pCode = (uint32_t *)shaderCode.data();
+  moduleCreateInfo.codeSize = size;
+  moduleCreateInfo.pCode = (const uint32_t *)code;
   moduleCreateInfo.flags = 0;
   err = vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &shaderModule);
   mgAssert(!err);
   return shaderModule;
 }
-static VkPipelineShaderStageCreateInfo createShader(std::string fileName, VkShaderStageFlagBits stage) {
+static VkPipelineShaderStageCreateInfo createShader(const char *code, size_t size, VkShaderStageFlagBits stage) {
   VkPipelineShaderStageCreateInfo shaderStage = {};
   shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStage.stage = stage;
 
-  shaderStage.module = loadShader((fileName).c_str(), mg::vkContext.device, stage);
+  shaderStage.module = loadShader(code, size, mg::vkContext.device);
   shaderStage.pName = "main";
   mgAssert(shaderStage.module != 0);
   return shaderStage;
 }
 
-void createShaders() {
-  const auto shaderFiles = getShaderFiles();
+// all spir-v files packed in one file, so that the shaders are read through a single mapping. The archive is
+// rewritten from the build directory when a shader is newer than its copy in the archive
+struct ShaderArchiveHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t padding;
+};
+
+struct ShaderArchiveEntry {
+  char fileName[64];
+  int64_t lastWriteTime;
+  uint64_t offset;
+  uint64_t size;
+};
+
+static const uint32_t shaderArchiveMagic = 0x4b415053; // "SPAK"
+static const uint32_t shaderArchiveVersion = 1;
+
+static std::string getShaderArchiveFileName() {
+  return mg::getShaderPath() + "shaders.pack";
+}
+
+static int64_t toArchiveTime(std::filesystem::file_time_type fileTime) {
+  return int64_t(fileTime.time_since_epoch().count());
+}
+
+// index of the shaders in the build directory, the shader modules are created on first use. Guarded by the mutex,
+// the pipeline container gets shaders from worker threads
+static std::mutex _mutex;
+static std::unordered_map<std::string, Shaders::ShaderFiles> _nameToShaderFiles;
+static mg::MappedFile _archive;
+static std::unordered_map<std::string, const ShaderArchiveEntry *> _archiveEntries;
+// set when the archive is missing a file or has an old copy of it
+static bool _isArchiveStale = false;
+
+static void openShaderArchive() {
+  _archiveEntries.clear();
+  _isArchiveStale = true;
+  if (!_archive.open(getShaderArchiveFileName()))
+    return;
+
+  ShaderArchiveHeader header = {};
+  if (_archive.size() >= sizeof(header))
+    memcpy(&header, _archive.data(), sizeof(header));
+  if (header.magic != shaderArchiveMagic || header.version != shaderArchiveVersion ||
+      _archive.size() < sizeof(header) + uint64_t(header.entryCount) * sizeof(ShaderArchiveEntry)) {
+    LOG("shader archive " << getShaderArchiveFileName() << " is from another version, ignoring it");
+    _archive.close();
+    return;
+  }
+
+  const auto entries = (const ShaderArchiveEntry *)(_archive.data() + sizeof(header));
+  uint32_t nrOfFiles = 0;
+  for (const auto &files : _nameToShaderFiles) {
+    nrOfFiles += uint32_t(files.second.files.size());
+  }
+  for (uint32_t i = 0; i < header.entryCount; i++) {
+    const auto &entry = entries[i];
+    const std::string fileName(entry.fileName, strnlen(entry.fileName, sizeof(entry.fileName)));
+    const auto fileTime = _fileTimes.find(fileName);
+    if (fileTime == std::end(_fileTimes) || toArchiveTime(fileTime->second) != entry.lastWriteTime ||
+        entry.offset + entry.size > _archive.size())
+      continue;
+    _archiveEntries[fileName] = &entry;
+  }
+  _isArchiveStale = header.entryCount != nrOfFiles || _archiveEntries.size() != nrOfFiles;
+}
+
+// the archive is written to a temporary file that is renamed over the old one, a crash while writing leaves the old
+// archive intact
+static void writeShaderArchive() {
+  const auto shaderFiles = getShaderFiles(nullptr);
+  std::vector<ShaderArchiveEntry> entries;
+  std::vector<std::unique_ptr<mg::MappedFile>> mappedFiles;
+  uint64_t offset = 0;
   for (const auto &files : shaderFiles.nameToShaderFiles) {
-    Shader shader = {};
-    shader.name = files.first;
-    for (uint32_t i = 0; i < files.second.files.size(); i++) {
-      VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfo =
-          createShader(mg::getShaderPath() + files.second.files[i].name, files.second.files[i].stageFlag);
-      shader.isProcedural[shader.count] = files.second.files[i].isProcedural;
-      shader.fileNameToIndex[files.second.files[i].name] = shader.count;
-      shader.stageCreateInfo[shader.count++] = pipelineShaderStageCreateInfo;
+    for (const auto &file : files.second.files) {
+      const auto fileTime = _fileTimes.find(file.name);
+      if (file.name.size() >= sizeof(ShaderArchiveEntry::fileName) || fileTime == std::end(_fileTimes))
+        continue;
+      auto mappedFile = std::make_unique<mg::MappedFile>();
+      if (!mappedFile->open(mg::getShaderPath() + file.name))
+        continue;
+      ShaderArchiveEntry entry = {};
+      strncpy(entry.fileName, file.name.c_str(), sizeof(entry.fileName) - 1);
+      entry.lastWriteTime = toArchiveTime(fileTime->second);
+      entry.offset = offset;
+      entry.size = mappedFile->size();
+      offset += mg::alignUpPowerOfTwo(uint64_t(mappedFile->size()), uint64_t(4));
+      entries.push_back(entry);
+      mappedFiles.push_back(std::move(mappedFile));
+    }
+  }
+
+  ShaderArchiveHeader header = {};
+  header.magic = shaderArchiveMagic;
+  header.version = shaderArchiveVersion;
+  header.entryCount = uint32_t(entries.size());
+  const auto dataOffset = sizeof(header) + entries.size() * sizeof(ShaderArchiveEntry);
+  for (auto &entry : entries) {
+    entry.offset += dataOffset;
+  }
+
+  std::vector<char> data(dataOffset + offset);
+  memcpy(data.data(), &header, sizeof(header));
+  memcpy(data.data() + sizeof(header), entries.data(), entries.size() * sizeof(ShaderArchiveEntry));
+  for (size_t i = 0; i < entries.size(); i++) {
+    memcpy(data.data() + entries[i].offset, mappedFiles[i]->data(), entries[i].size);
+  }
+  // the archive can not be replaced while it is mapped
+  _archive.close();
+  _archiveEntries.clear();
+  if (mg::writeBinaryToDisc(getShaderArchiveFileName(), data))
+    LOG("wrote shader archive " << getShaderArchiveFileName() << " with " << entries.size() << " files");
+  else
+    LOG("could not write shader archive " << getShaderArchiveFileName());
+}
+
+// the code of a file comes from the archive when the archive has the latest copy, otherwise the file is mapped
+static Shader createShaderModules(const std::string &name, const Shaders::ShaderFiles &shaderFiles, bool useArchive) {
+  Shader shader = {};
+  shader.name = name;
+  for (uint32_t i = 0; i < shaderFiles.files.size(); i++) {
+    const auto &file = shaderFiles.files[i];
+    const ShaderArchiveEntry *archiveEntry = nullptr;
+    if (useArchive) {
+      const auto it = _archiveEntries.find(file.name);
+      archiveEntry = it != std::end(_archiveEntries) ? it->second : nullptr;
+    }
+    VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfo = {};
+    if (archiveEntry) {
+      pipelineShaderStageCreateInfo =
+          createShader(_archive.data() + archiveEntry->offset, size_t(archiveEntry->size), file.stageFlag);
+    } else {
+      mg::MappedFile mappedFile;
+      const auto fileName = mg::getShaderPath() + file.name;
+      const bool isOpen = mappedFile.open(fileName);
+      mgAssertDesc(isOpen, "could not open file " + fileName);
+      pipelineShaderStageCreateInfo = createShader(mappedFile.data(), mappedFile.size(), file.stageFlag);
+    }
+    shader.isProcedural[shader.count] = file.isProcedural;
+    shader.fileNameToIndex[file.name] = shader.count;
+    shader.stageCreateInfo[shader.count++] = pipelineShaderStageCreateInfo;
+  }
+  return shader;
+}
+
+void createShaders() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _fileTimes.clear();
+  _changedFileTimes.clear();
+  _nameToShaderFiles = getShaderFiles(&_fileTimes).nameToShaderFiles;
+  openShaderArchive();
+}
+
+Shader loadShader(const std::string &name) {
+  const auto shaderFiles = getShaderFiles(nullptr);
+  const auto it = shaderFiles.nameToShaderFiles.find(name);
+  if (it == std::end(shaderFiles.nameToShaderFiles))
+    return {};
+  return createShaderModules(name, it->second, false);
+}
+
+Shader replaceShader(const Shader &shader) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _isArchiveStale = true;
+  Shader oldShader = {};
+  auto it = _shaders.find(shader.name);
+  if (it != std::end(_shaders)) {
+    oldShader = it->second;
+    it->second = shader;
+  } else {
+    _shaders.insert(make_pair(shader.name, shader));
+  }
+  return oldShader;
+}
+
+void destroyShader(const Shader &shader) {
+  for (uint32_t i = 0; i < shader.count; i++) {
+    vkDestroyShaderModule(mg::vkContext.device, shader.stageCreateInfo[i].module, nullptr);
+  }
+}
+
+std::vector<std::string> getChangedShaders() {
+  constexpr uint64_t pollIntervalInMs = 500;
+  const auto now = mg::timer::now();
+  if (mg::timer::durationInMs(_lastPoll, now) < pollIntervalInMs)
+    return {};
+  _lastPoll = now;
+
+  namespace fs = std::filesystem;
+  std::unordered_set<std::string> changedShaders;
+  std::error_code errorCode;
+  for (auto &file : fs::directory_iterator(mg::getShaderPath(), errorCode)) {
+    if (!isSpirvFile(file.path()))
+      continue;
+    const auto fileName = file.path().filename().generic_string();
+    const auto fileTime = file.last_write_time(errorCode);
+    if (errorCode)
+      continue;
+    const auto it = _fileTimes.find(fileName);
+    if (it != std::end(_fileTimes) && it->second == fileTime)
+      continue;
+
+    const auto changedIt = _changedFileTimes.find(fileName);
+    if (changedIt == std::end(_changedFileTimes) || changedIt->second != fileTime) {
+      _changedFileTimes[fileName] = fileTime;
+      continue;
     }
-    _shaders.insert(make_pair(files.first, shader));
+    _changedFileTimes.erase(changedIt);
+    _fileTimes[fileName] = fileTime;
+    changedShaders.insert(getShaderName(fileName));
   }
+  return std::vector<std::string>(std::begin(changedShaders), std::end(changedShaders));
 }
 
 Shader getShader(const std::string &name) {
+  std::lock_guard<std::mutex> lock(_mutex);
   auto res = _shaders.find(name);
-  mgAssert(res != _shaders.end());
-  return res->second;
+  if (res != _shaders.end())
+    return res->second;
+
+  const auto files = _nameToShaderFiles.find(name);
+  mgAssertDesc(files != std::end(_nameToShaderFiles), "shader " + name + " is not in the shader directory");
+  const auto shader = createShaderModules(name, files->second, true);
+  _shaders.insert(make_pair(name, shader));
+  return shader;
+}
+bool hasShader(const std::string &name) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _nameToShaderFiles.count(name) > 0 || _shaders.count(name) > 0;
 }
 void deleteShaders() {
+  std::lock_guard<std::mutex> lock(_mutex);
   for (auto &_shader : _shaders) {
-    auto shader = _shader.second;
-    for (uint32_t i = 0; i < shader.count; i++) {
-      vkDestroyShaderModule(mg::vkContext.device, shader.stageCreateInfo[i].module, nullptr);
-    }
+    destroyShader(_shader.second);
   }
   _shaders.clear();
+  if (_isArchiveStale)
+    writeShaderArchive();
+  _archive.close();
+  _archiveEntries.clear();
+  _nameToShaderFiles.clear();
 }
 } // namespace mg
@@ -27,6 +27,18 @@ struct Shader {
 };
 void createShaders();
 Shader getShader(const std::string &name);
+bool hasShader(const std::string &name);
+
+// creates the shader modules from the files on disc without touching the loaded shaders, can be called on a worker
+// thread. The count is 0 if there are no files for the name
+Shader loadShader(const std::string &name);
+// the loaded shader with the same name is replaced, the old one is returned so that its modules can be destroyed
+// when the gpu is done with them
+Shader replaceShader(const Shader &shader);
+void destroyShader(const Shader &shader);
+// names of the shaders with spir-v files that changed on disc since the last call, the directory is polled at most
+// twice per second
+std::vector<std::string> getChangedShaders();
 
 void deleteShaders();
 
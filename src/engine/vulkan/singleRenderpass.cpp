@@ -103,6 +103,7 @@ static void createRenderPass(SingleRenderPass *singleRenderPass) {
   createInfo.pDependencies = subpassDependencies;
 
   checkResult(vkCreateRenderPass(mg::vkContext.device, &createInfo, nullptr, &singleRenderPass->vkRenderPass));
+  mg::mgSystem.pipelineContainer.registerRenderPass(singleRenderPass->vkRenderPass, "single");
 }
 
 void initSingleRenderPass(SingleRenderPass *singleRenderPass) {
@@ -125,6 +126,7 @@ void destroySingleRenderPass(SingleRenderPass *singleRenderPass) {
   for (size_t i = 0; i < mg::vkContext.swapChain->numOfImages; i++) {
     vkDestroyFramebuffer(mg::vkContext.device, singleRenderPass->vkFrameBuffers[i], nullptr);
   }
+  mg::mgSystem.pipelineContainer.unregisterRenderPass(singleRenderPass->vkRenderPass);
   vkDestroyRenderPass(mg::vkContext.device, singleRenderPass->vkRenderPass, nullptr);
 }
 
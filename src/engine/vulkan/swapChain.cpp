@@ -139,7 +139,10 @@ void SwapChain::createImages() {
   VkSwapchainCreateInfoKHR createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
   createInfo.surface = mg::vkContext.windowSurface;
-  createInfo.minImageCount = 2;
+  // at least one image per frame in flight, otherwise acquire waits on present and limits the frames in flight
+  createInfo.minImageCount = std::max(surfaceCapabilities.minImageCount, mg::vkContext.commandBuffers.nrOfBuffers);
+  if (surfaceCapabilities.maxImageCount > 0)
+    createInfo.minImageCount = std::min(createInfo.minImageCount, surfaceCapabilities.maxImageCount);
   createInfo.imageFormat = surfaceFormat.format;
   createInfo.imageColorSpace = surfaceFormat.colorSpace;
   createInfo.imageExtent = swapChainExtent;
@@ -0,0 +1,205 @@
+#include "uploadQueue.h"
+#include "mg/mgAssert.h"
+#include "vkUtils.h"
+#include <algorithm>
+
+namespace mg {
+
+void UploadQueue::create() {
+  _isAsync = mg::vkContext.hasTransferQueue;
+  if (!_isAsync)
+    return;
+
+  VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {};
+  semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  semaphoreTypeCreateInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+  semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+  checkResult(vkCreateSemaphore(mg::vkContext.device, &semaphoreCreateInfo, nullptr, &_timelineSemaphore));
+}
+
+void UploadQueue::destroy() {
+  if (!_isAsync)
+    return;
+  mgAssert(_commandBuffer == VK_NULL_HANDLE);
+  for (const auto &commandBuffers : _commandBuffers) {
+    vkFreeCommandBuffers(mg::vkContext.device, mg::vkContext.transferCommandPool, 1,
+                         &commandBuffers.transferCommandBuffer);
+    vkFreeCommandBuffers(mg::vkContext.device, mg::vkContext.commandPool, 1, &commandBuffers.acquireCommandBuffer);
+  }
+  _commandBuffers.clear();
+  vkDestroySemaphore(mg::vkContext.device, _timelineSemaphore, nullptr);
+  _timelineSemaphore = VK_NULL_HANDLE;
+}
+
+bool UploadQueue::isComplete(uint64_t value) const {
+  if (!_isAsync)
+    return true;
+  uint64_t completedValue = 0;
+  checkResult(vkGetSemaphoreCounterValue(mg::vkContext.device, _timelineSemaphore, &completedValue));
+  return completedValue >= value;
+}
+
+static VkCommandBuffer allocateCommandBuffer(VkCommandPool commandPool) {
+  VkCommandBufferAllocateInfo vkCommandBufferAllocateInfo = {};
+  vkCommandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  vkCommandBufferAllocateInfo.commandPool = commandPool;
+  vkCommandBufferAllocateInfo.commandBufferCount = 1;
+  vkCommandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  VkCommandBuffer commandBuffer;
+  checkResult(vkAllocateCommandBuffers(mg::vkContext.device, &vkCommandBufferAllocateInfo, &commandBuffer));
+  return commandBuffer;
+}
+
+static void beginCommandBuffer(VkCommandBuffer commandBuffer) {
+  VkCommandBufferBeginInfo vkCommandBufferBeginInfo = {};
+  vkCommandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  vkCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  checkResult(vkBeginCommandBuffer(commandBuffer, &vkCommandBufferBeginInfo));
+}
+
+VkCommandBuffer UploadQueue::getCommandBuffer() {
+  mgAssert(_isAsync);
+  if (_commandBuffer != VK_NULL_HANDLE)
+    return _commandBuffer;
+
+  const auto commandBuffers =
+      std::find_if(_commandBuffers.begin(), _commandBuffers.end(),
+                   [this](const _UploadCommandBuffers &commandBuffers) { return isComplete(commandBuffers.value); });
+  if (commandBuffers != _commandBuffers.end()) {
+    _commandBuffer = commandBuffers->transferCommandBuffer;
+    _acquireCommandBuffer = commandBuffers->acquireCommandBuffer;
+    _commandBuffers.erase(commandBuffers);
+  } else {
+    _commandBuffer = allocateCommandBuffer(mg::vkContext.transferCommandPool);
+    _acquireCommandBuffer = allocateCommandBuffer(mg::vkContext.commandPool);
+  }
+  beginCommandBuffer(_commandBuffer);
+  return _commandBuffer;
+}
+
+void UploadQueue::releaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkAccessFlags dstAccessMask,
+                                VkPipelineStageFlags dstStageMask) {
+  VkBufferMemoryBarrier bufferMemoryBarrier = {};
+  bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  bufferMemoryBarrier.dstAccessMask = dstAccessMask;
+  bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferMemoryBarrier.buffer = buffer;
+  bufferMemoryBarrier.offset = 0;
+  bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+
+  if (!_isAsync) {
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1,
+                         &bufferMemoryBarrier, 0, nullptr);
+    return;
+  }
+  mgAssert(commandBuffer == _commandBuffer);
+  // the access masks of the release are ignored by the graphics queue and the ones of the acquire by the transfer queue
+  bufferMemoryBarrier.srcQueueFamilyIndex = mg::vkContext.transferQueueFamilyIndex;
+  bufferMemoryBarrier.dstQueueFamilyIndex = mg::vkContext.queueFamilyIndex;
+  bufferMemoryBarrier.dstAccessMask = 0;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                       nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+  // device to device copies of the staging command buffer can read the resource after the acquire
+  bufferMemoryBarrier.srcAccessMask = 0;
+  bufferMemoryBarrier.dstAccessMask = dstAccessMask | VK_ACCESS_TRANSFER_READ_BIT;
+  _bufferBarriers.push_back(bufferMemoryBarrier);
+}
+
+void UploadQueue::releaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout newLayout,
+                               VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask) {
+  VkImageMemoryBarrier imageMemoryBarrier = {};
+  imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  imageMemoryBarrier.dstAccessMask = dstAccessMask;
+  imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  imageMemoryBarrier.newLayout = newLayout;
+  imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageMemoryBarrier.image = image;
+  imageMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+  if (!_isAsync) {
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1,
+                         &imageMemoryBarrier);
+    return;
+  }
+  mgAssert(commandBuffer == _commandBuffer);
+  // the layout transition is part of both the release and the acquire and is only done once
+  imageMemoryBarrier.srcQueueFamilyIndex = mg::vkContext.transferQueueFamilyIndex;
+  imageMemoryBarrier.dstQueueFamilyIndex = mg::vkContext.queueFamilyIndex;
+  imageMemoryBarrier.dstAccessMask = 0;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                       nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+  imageMemoryBarrier.srcAccessMask = 0;
+  imageMemoryBarrier.dstAccessMask = dstAccessMask | VK_ACCESS_TRANSFER_READ_BIT;
+  _imageBarriers.push_back(imageMemoryBarrier);
+}
+
+uint64_t UploadQueue::submit(VkSubmitInfo *acquireSubmitInfo) {
+  mgAssert(hasCopies());
+  checkResult(vkEndCommandBuffer(_commandBuffer));
+
+  _acquireWaitValue = _value + 1;
+  _acquireSignalValue = _value + 2;
+  _value += 2;
+
+  VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {};
+  timelineSemaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineSemaphoreSubmitInfo.signalSemaphoreValueCount = 1;
+  timelineSemaphoreSubmitInfo.pSignalSemaphoreValues = &_acquireWaitValue;
+
+  VkSubmitInfo vkSubmitInfo = {};
+  vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  vkSubmitInfo.pNext = &timelineSemaphoreSubmitInfo;
+  vkSubmitInfo.commandBufferCount = 1;
+  vkSubmitInfo.pCommandBuffers = &_commandBuffer;
+  vkSubmitInfo.signalSemaphoreCount = 1;
+  vkSubmitInfo.pSignalSemaphores = &_timelineSemaphore;
+  checkResult(vkQueueSubmit(mg::vkContext.transferQueue, 1, &vkSubmitInfo, VK_NULL_HANDLE));
+
+  // the acquire is a batch of its own so it is ordered before everything recorded in the staging command buffer,
+  // e.g. defragmentation copies of the uploaded resources. It waits on all stages and blocks all later work on the
+  // graphics queue, which only costs the time of the copies that are not done yet
+  beginCommandBuffer(_acquireCommandBuffer);
+  vkCmdPipelineBarrier(_acquireCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                       0, nullptr, uint32_t(_bufferBarriers.size()), _bufferBarriers.data(),
+                       uint32_t(_imageBarriers.size()), _imageBarriers.data());
+  checkResult(vkEndCommandBuffer(_acquireCommandBuffer));
+  _bufferBarriers.clear();
+  _imageBarriers.clear();
+
+  _acquireTimelineSubmitInfo = {};
+  _acquireTimelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  _acquireTimelineSubmitInfo.waitSemaphoreValueCount = 1;
+  _acquireTimelineSubmitInfo.pWaitSemaphoreValues = &_acquireWaitValue;
+  _acquireTimelineSubmitInfo.signalSemaphoreValueCount = 1;
+  _acquireTimelineSubmitInfo.pSignalSemaphoreValues = &_acquireSignalValue;
+  _acquireWaitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+  _commandBuffers.push_back({_commandBuffer, _acquireCommandBuffer, _value});
+  _submittedAcquireCommandBuffer = _acquireCommandBuffer;
+  *acquireSubmitInfo = {};
+  acquireSubmitInfo->sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  acquireSubmitInfo->pNext = &_acquireTimelineSubmitInfo;
+  acquireSubmitInfo->waitSemaphoreCount = 1;
+  acquireSubmitInfo->pWaitSemaphores = &_timelineSemaphore;
+  acquireSubmitInfo->pWaitDstStageMask = &_acquireWaitStageMask;
+  acquireSubmitInfo->commandBufferCount = 1;
+  acquireSubmitInfo->pCommandBuffers = &_submittedAcquireCommandBuffer;
+  acquireSubmitInfo->signalSemaphoreCount = 1;
+  acquireSubmitInfo->pSignalSemaphores = &_timelineSemaphore;
+
+  _commandBuffer = VK_NULL_HANDLE;
+  _acquireCommandBuffer = VK_NULL_HANDLE;
+  return _value;
+}
+
+} // namespace mg
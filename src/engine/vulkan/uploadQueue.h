@@ -0,0 +1,63 @@
+#pragma once
+#include "mg/mgUtils.h"
+#include "vkContext.h"
+#include <vector>
+
+namespace mg {
+
+// staging copies to device local memory. With a dedicated transfer queue family the copies are recorded and submitted
+// on the transfer queue, the copied buffers and images are released by the transfer queue and acquired by a batch on
+// the graphics queue that waits on a timeline semaphore, so the cpu never waits for the copies. Without one the copies
+// are recorded in the staging command buffers of the graphics queue
+class UploadQueue : mg::nonCopyable {
+public:
+  void create();
+  void destroy();
+
+  bool isAsync() const { return _isAsync; }
+  bool hasCopies() const { return _commandBuffer != VK_NULL_HANDLE; }
+  // transfer queue command buffer for the copies of the next submit, only with a transfer queue
+  VkCommandBuffer getCommandBuffer();
+
+  // makes a buffer or image written by a transfer in commandBuffer visible to the graphics queue, the image is
+  // transitioned from VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL to newLayout
+  void releaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkAccessFlags dstAccessMask,
+                     VkPipelineStageFlags dstStageMask);
+  void releaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout newLayout, VkAccessFlags dstAccessMask,
+                    VkPipelineStageFlags dstStageMask);
+
+  // submits the copies to the transfer queue and returns the graphics queue batch that acquires them, it must be
+  // submitted before any graphics work that uses the copies and stays valid until the next submit. The returned value
+  // is reached when both the copies and the acquire are done
+  uint64_t submit(VkSubmitInfo *acquireSubmitInfo);
+  bool isComplete(uint64_t value) const;
+
+private:
+  struct _UploadCommandBuffers {
+    VkCommandBuffer transferCommandBuffer;
+    VkCommandBuffer acquireCommandBuffer;
+    // reused when the timeline semaphore has reached the value
+    uint64_t value;
+  };
+
+  bool _isAsync = false;
+  VkSemaphore _timelineSemaphore = VK_NULL_HANDLE;
+  // the transfer submit signals an odd value and the acquire batch the even value after it
+  uint64_t _value = 0;
+
+  VkCommandBuffer _commandBuffer = VK_NULL_HANDLE;
+  VkCommandBuffer _acquireCommandBuffer = VK_NULL_HANDLE;
+  std::vector<_UploadCommandBuffers> _commandBuffers;
+
+  // acquire barriers for the graphics queue of the copies not yet submitted
+  std::vector<VkBufferMemoryBarrier> _bufferBarriers;
+  std::vector<VkImageMemoryBarrier> _imageBarriers;
+
+  // referenced by the acquire submit info
+  VkCommandBuffer _submittedAcquireCommandBuffer;
+  VkTimelineSemaphoreSubmitInfo _acquireTimelineSubmitInfo;
+  uint64_t _acquireWaitValue, _acquireSignalValue;
+  VkPipelineStageFlags _acquireWaitStageMask;
+};
+
+} // namespace mg
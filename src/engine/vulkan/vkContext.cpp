@@ -1,9 +1,13 @@
 #include "vkContext.h"
 
 #include <cfloat>
+#include <cstring>
+#include <fstream>
 #include <memory>
+#include <vector>
 
 #include "linearHeapAllocator.h"
+#include "mg/logger.h"
 #include "mg/mgAssert.h"
 #include "mg/textureContainer.h"
 #include "singleRenderpass.h"
@@ -15,16 +19,18 @@ namespace mg {
 VulkanContext vkContext = {};
 
 static void destroySampler();
+static void savePipelineCache();
 void destroyVulkan() {
   mg::vkContext.swapChain->destroy();
   destroySampler();
 
-  for (uint32_t i = 0; i < mg::vkContext.commandBuffers.nrOfBuffers; i++) {
+  for (uint32_t i = 0; i < MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(mg::vkContext.device, mg::vkContext.commandBuffers.imageAquiredSemaphore[i], nullptr);
     vkDestroySemaphore(mg::vkContext.device, mg::vkContext.commandBuffers.renderCompleteSemaphore[i], nullptr);
     vkDestroyFence(mg::vkContext.device, mg::vkContext.commandBuffers.fences[i], nullptr);
   }
 
+  savePipelineCache();
   vkDestroyPipelineCache(mg::vkContext.device, mg::vkContext.pipelineCache, nullptr);
   vkDestroyPipelineLayout(mg::vkContext.device, mg::vkContext.pipelineLayouts.pipelineLayout, nullptr);
   vkDestroyPipelineLayout(mg::vkContext.device, mg::vkContext.pipelineLayouts.pipelineLayoutStorage, nullptr);
@@ -38,6 +44,8 @@ void destroyVulkan() {
   vkDestroyDescriptorSetLayout(mg::vkContext.device, mg::vkContext.descriptorSetLayout.accelerationStructure, nullptr);
 
   vkDestroyCommandPool(mg::vkContext.device, mg::vkContext.commandPool, nullptr);
+  if (mg::vkContext.hasTransferQueue)
+    vkDestroyCommandPool(mg::vkContext.device, mg::vkContext.transferCommandPool, nullptr);
 
   vkDestroyDescriptorPool(mg::vkContext.device, mg::vkContext.descriptorPool, nullptr);
 
@@ -241,12 +249,119 @@ static void createPipelineLayout() {
   }
 }
 
+// the scenes share the bin directory, every executable has its own cache
+static std::string getPipelineCacheFileName() {
+  const auto executableName = mg::getExecutableName();
+  return executableName.empty() ? "pipelineCache.bin" : "pipelineCache_" + executableName + ".bin";
+}
+static const uint32_t pipelineCacheFileMagic = 0x43505047; // "GPPC"
+static const uint32_t pipelineCacheFileVersion = 1;
+
+// written in front of the driver data, the driver version is not part of the vulkan pipeline cache header
+struct PipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+  uint64_t dataSize;
+};
+
+static PipelineCacheFileHeader getPipelineCacheFileHeader(uint64_t dataSize) {
+  const auto &properties = mg::vkContext.physicalDeviceProperties;
+  PipelineCacheFileHeader header = {};
+  header.magic = pipelineCacheFileMagic;
+  header.version = pipelineCacheFileVersion;
+  header.vendorID = properties.vendorID;
+  header.deviceID = properties.deviceID;
+  header.driverVersion = properties.driverVersion;
+  memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  header.dataSize = dataSize;
+  return header;
+}
+
+// the driver data starts with the VK_PIPELINE_CACHE_HEADER_VERSION_ONE header:
+// header length, header version, vendor id, device id and the pipeline cache uuid
+static bool isPipelineCacheDataValid(const std::vector<char> &data) {
+  const auto &properties = mg::vkContext.physicalDeviceProperties;
+  const size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if (data.size() < headerSize)
+    return false;
+
+  uint32_t values[4];
+  memcpy(values, data.data(), sizeof(values));
+  return values[0] >= headerSize && values[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         values[2] == properties.vendorID && values[3] == properties.deviceID &&
+         memcmp(data.data() + sizeof(values), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// returns the driver data of the pipeline cache file, or nothing if the file is missing or was written by another
+// device or driver
+static std::vector<char> loadPipelineCacheData() {
+  std::ifstream file(getPipelineCacheFileName(), std::ios::binary);
+  if (!file.is_open()) {
+    LOG("no pipeline cache found, cold start");
+    return {};
+  }
+
+  PipelineCacheFileHeader header = {};
+  const auto expectedHeader = getPipelineCacheFileHeader(0);
+  if (!file.read((char *)&header, sizeof(header)) || header.magic != expectedHeader.magic ||
+      header.version != expectedHeader.version || header.vendorID != expectedHeader.vendorID ||
+      header.deviceID != expectedHeader.deviceID || header.driverVersion != expectedHeader.driverVersion ||
+      memcmp(header.pipelineCacheUUID, expectedHeader.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    LOG("pipeline cache was written by another device or driver, cold start");
+    return {};
+  }
+
+  // the size in a corrupt header is never allocated when it is larger than the rest of the file
+  const auto dataStart = file.tellg();
+  file.seekg(0, std::ios::end);
+  const auto fileEnd = file.tellg();
+  file.seekg(dataStart);
+  if (dataStart < 0 || fileEnd < dataStart || header.dataSize > uint64_t(fileEnd - dataStart)) {
+    LOG("pipeline cache is corrupt, cold start");
+    return {};
+  }
+
+  std::vector<char> data(header.dataSize);
+  if (!file.read(data.data(), std::streamsize(data.size())) || !isPipelineCacheDataValid(data)) {
+    LOG("pipeline cache is corrupt, cold start");
+    return {};
+  }
+  return data;
+}
+
 static void createPipelineCache() {
+  const auto data = loadPipelineCacheData();
+
   VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
   pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  pipelineCacheCreateInfo.initialDataSize = data.size();
+  pipelineCacheCreateInfo.pInitialData = data.data();
   VkResult err =
       vkCreatePipelineCache(mg::vkContext.device, &pipelineCacheCreateInfo, nullptr, &mg::vkContext.pipelineCache);
   mgAssert(!err);
+
+  mg::vkContext.isPipelineCacheWarm = !data.empty();
+  if (mg::vkContext.isPipelineCacheWarm)
+    LOG("loaded pipeline cache: " << data.size() << " bytes, warm start");
+}
+
+static void savePipelineCache() {
+  size_t dataSize = 0;
+  checkResult(vkGetPipelineCacheData(mg::vkContext.device, mg::vkContext.pipelineCache, &dataSize, nullptr));
+  std::vector<char> data(sizeof(PipelineCacheFileHeader) + dataSize);
+  checkResult(vkGetPipelineCacheData(mg::vkContext.device, mg::vkContext.pipelineCache, &dataSize,
+                                     data.data() + sizeof(PipelineCacheFileHeader)));
+  data.resize(sizeof(PipelineCacheFileHeader) + dataSize);
+
+  const auto header = getPipelineCacheFileHeader(dataSize);
+  memcpy(data.data(), &header, sizeof(header));
+  const auto fileName = getPipelineCacheFileName();
+  if (!mg::writeBinaryToDisc(fileName, data))
+    LOG("could not write pipeline cache " << fileName);
 }
 
 static void createCommandPool() {
@@ -255,6 +370,12 @@ static void createCommandPool() {
   poolCreateInfo.queueFamilyIndex = mg::vkContext.queueFamilyIndex;
   poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
   checkResult(vkCreateCommandPool(mg::vkContext.device, &poolCreateInfo, nullptr, &mg::vkContext.commandPool));
+
+  if (mg::vkContext.hasTransferQueue) {
+    poolCreateInfo.queueFamilyIndex = mg::vkContext.transferQueueFamilyIndex;
+    checkResult(
+        vkCreateCommandPool(mg::vkContext.device, &poolCreateInfo, nullptr, &mg::vkContext.transferCommandPool));
+  }
 }
 
 static void createDescriptorPool() {
@@ -263,11 +384,12 @@ static void createDescriptorPool() {
   descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   descriptorPoolSizes[0].descriptorCount = 1;
 
+  // the texture descriptor sets have one copy per frame in flight
   descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLER;
-  descriptorPoolSizes[1].descriptorCount = 3;
+  descriptorPoolSizes[1].descriptorCount = 3 * MAX_NR_OF_FRAMES_IN_FLIGHT;
 
   descriptorPoolSizes[2].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-  descriptorPoolSizes[2].descriptorCount = MAX_NR_OF_2D_TEXTURES;
+  descriptorPoolSizes[2].descriptorCount = (MAX_NR_OF_2D_TEXTURES + MAX_NR_OF_3D_TEXTURES) * MAX_NR_OF_FRAMES_IN_FLIGHT;
 
   VkDescriptorPoolCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -360,7 +482,37 @@ static void initNvidiaFunctions() {
 }
 } // namespace nv
 
-void initVulkan(GLFWwindow *window) {
+namespace ext {
+PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT;
+PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT;
+PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT;
+PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT;
+PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT;
+PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT;
+
+static void initExtendedDynamicStateFunctions() {
+  if (!mg::vkContext.extensions.extendedDynamicState)
+    return;
+  vkCmdSetCullModeEXT =
+      reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(mg::vkContext.device, "vkCmdSetCullModeEXT"));
+  vkCmdSetFrontFaceEXT =
+      reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(mg::vkContext.device, "vkCmdSetFrontFaceEXT"));
+  vkCmdSetPrimitiveTopologyEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(
+      vkGetDeviceProcAddr(mg::vkContext.device, "vkCmdSetPrimitiveTopologyEXT"));
+  vkCmdSetDepthTestEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(
+      vkGetDeviceProcAddr(mg::vkContext.device, "vkCmdSetDepthTestEnableEXT"));
+  vkCmdSetDepthWriteEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(
+      vkGetDeviceProcAddr(mg::vkContext.device, "vkCmdSetDepthWriteEnableEXT"));
+  vkCmdSetDepthCompareOpEXT = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(
+      vkGetDeviceProcAddr(mg::vkContext.device, "vkCmdSetDepthCompareOpEXT"));
+}
+} // namespace ext
+
+void initVulkan(GLFWwindow *window, uint32_t nrOfFramesInFlight) {
+  mgAssertDesc(nrOfFramesInFlight >= MIN_NR_OF_FRAMES_IN_FLIGHT && nrOfFramesInFlight <= MAX_NR_OF_FRAMES_IN_FLIGHT,
+               "nr of frames in flight must be between " << MIN_NR_OF_FRAMES_IN_FLIGHT << " and "
+                                                         << MAX_NR_OF_FRAMES_IN_FLIGHT);
+  mg::vkContext.commandBuffers.nrOfBuffers = nrOfFramesInFlight;
   createVulkanContext(window);
 
   createCommandPool();
@@ -372,6 +524,7 @@ void initVulkan(GLFWwindow *window) {
   createDescriptorPool();
   createDescriptorLayout();
   nv::initNvidiaFunctions();
+  ext::initExtendedDynamicStateFunctions();
   createPipelineLayout();
 
   initSampler();
@@ -14,6 +14,8 @@ namespace mg {
 
 constexpr uint32_t MAX_NR_OF_2D_TEXTURES = 128;
 constexpr uint32_t MAX_NR_OF_3D_TEXTURES = 5;
+constexpr uint32_t MIN_NR_OF_FRAMES_IN_FLIGHT = 2;
+constexpr uint32_t MAX_NR_OF_FRAMES_IN_FLIGHT = 4;
 
 struct SwapChain;
 
@@ -37,6 +39,11 @@ struct VulkanContext {
 
   VkCommandPool commandPool;
   uint32_t queueFamilyIndex;
+  // a queue family that only supports transfers, staging copies are done on it when the device has one
+  bool hasTransferQueue;
+  VkQueue transferQueue;
+  VkCommandPool transferCommandPool;
+  uint32_t transferQueueFamilyIndex;
   struct {
     VkDescriptorSetLayout dynamic;
     VkDescriptorSetLayout textures;
@@ -48,10 +55,20 @@ struct VulkanContext {
   } descriptorSetLayout;
 
   VkPipelineCache pipelineCache;
+  // true when the pipeline cache was loaded from disc at startup
+  bool isPipelineCacheWarm;
 
   VkPhysicalDeviceProperties physicalDeviceProperties;
   VkPhysicalDeviceFeatures physicalDeviceFeatures;
   VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
+  // optional device extensions, enabled when the device supports them
+  struct {
+    bool memoryBudget;
+    // cull mode, front face, topology and the depth state are set when the pipeline is bound
+    bool extendedDynamicState;
+    // graphics pipelines are fast linked from separately created parts, with fast linking support
+    bool graphicsPipelineLibrary;
+  } extensions;
 
   VkDebugUtilsMessengerEXT callback;
 
@@ -63,13 +80,17 @@ struct VulkanContext {
   } formats;
   VkCommandBuffer commandBuffer;
   struct CommandBuffers {
-    static constexpr uint32_t nrOfBuffers = 2;
+    // number of frames in flight, set by initVulkan and setNrOfFramesInFlight. the command buffers, fences and
+    // semaphores are created for the max number of frames in flight so it can be changed at runtime
+    uint32_t nrOfBuffers = MIN_NR_OF_FRAMES_IN_FLIGHT;
     uint32_t currentIndex = 0;
-    VkCommandBuffer buffers[nrOfBuffers] = {};
-    VkFence fences[nrOfBuffers] = {};
-    bool submitted[nrOfBuffers] = {};
-    VkSemaphore imageAquiredSemaphore[nrOfBuffers] = {};
-    VkSemaphore renderCompleteSemaphore[nrOfBuffers] = {};
+    // cpu time beginRendering waited for the frame that last used the current command buffer
+    uint64_t fenceWaitTimeInUs = 0;
+    VkCommandBuffer buffers[MAX_NR_OF_FRAMES_IN_FLIGHT] = {};
+    VkFence fences[MAX_NR_OF_FRAMES_IN_FLIGHT] = {};
+    bool submitted[MAX_NR_OF_FRAMES_IN_FLIGHT] = {};
+    VkSemaphore imageAquiredSemaphore[MAX_NR_OF_FRAMES_IN_FLIGHT] = {};
+    VkSemaphore renderCompleteSemaphore[MAX_NR_OF_FRAMES_IN_FLIGHT] = {};
   } commandBuffers;
 
   std::unique_ptr<SwapChain> swapChain;
@@ -84,7 +105,7 @@ struct VulkanContext {
 
 extern VulkanContext vkContext;
 
-void initVulkan(GLFWwindow *window);
+void initVulkan(GLFWwindow *window, uint32_t nrOfFramesInFlight = MIN_NR_OF_FRAMES_IN_FLIGHT);
 void destroyVulkan();
 
 namespace nv {
@@ -100,4 +121,13 @@ extern PFN_vkCmdTraceRaysNV vkCmdTraceRaysNV;
 
 } // namespace nv
 
+namespace ext {
+extern PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT;
+extern PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT;
+extern PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT;
+extern PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT;
+extern PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT;
+extern PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT;
+} // namespace ext
+
 } // namespace mg
\ No newline at end of file
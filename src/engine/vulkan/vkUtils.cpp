@@ -50,22 +50,24 @@ void setViewPort(VkCommandBuffer commandBuffer, float x, float y, float width, f
   vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 }
 
-static void setFullscreenScissor() {
+static void setFullscreenScissor(VkCommandBuffer commandBuffer) {
   VkRect2D scissor = {};
   scissor.offset.x = 0;
   scissor.offset.y = 0;
   scissor.extent.width = vkContext.screen.width;
   scissor.extent.height = vkContext.screen.height;
-  vkCmdSetScissor(vkContext.commandBuffer, 0, 1, &scissor);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
 static bool acquireNextSwapChainImage();
 
-void setFullscreenViewport() {
-  setViewPort(vkContext.commandBuffer, 0, 0, float(vkContext.screen.width), float(vkContext.screen.height), 0.0f, 1.0f);
-  setFullscreenScissor();
+void setFullscreenViewport(VkCommandBuffer commandBuffer) {
+  setViewPort(commandBuffer, 0, 0, float(vkContext.screen.width), float(vkContext.screen.height), 0.0f, 1.0f);
+  setFullscreenScissor(commandBuffer);
 }
 
+void setFullscreenViewport() { setFullscreenViewport(vkContext.commandBuffer); }
+
 void waitForDeviceIdle() {
   mg::mgSystem.linearHeapAllocator.submitStagingMemoryToDeviceLocalMemory();
   checkResult(vkDeviceWaitIdle(vkContext.device));
@@ -74,18 +76,38 @@ void waitForDeviceIdle() {
 void beginRendering() {
   vkContext.commandBuffer = vkContext.commandBuffers.buffers[vkContext.commandBuffers.currentIndex];
 
+  // how long the cpu waits here shows if the gpu is the bottleneck for the current number of frames in flight
+  const auto fenceWaitStart = timer::now();
   if (vkContext.commandBuffers.submitted[vkContext.commandBuffers.currentIndex]) {
     checkResult(vkWaitForFences(vkContext.device, 1,
                                 &vkContext.commandBuffers.fences[vkContext.commandBuffers.currentIndex], VK_TRUE,
                                 UINT64_MAX));
   }
+  vkContext.commandBuffers.fenceWaitTimeInUs = timer::durationInUs(fenceWaitStart, timer::now());
   checkResult(
       vkResetFences(vkContext.device, 1, &vkContext.commandBuffers.fences[vkContext.commandBuffers.currentIndex]));
+  mg::mgSystem.secondaryCommandBuffers.beginFrame();
+
+  // the frame that used the current command buffer is done, retired device memory can be released
+  constexpr VkDeviceSize defragmentationBudgetInBytes = 8 * 1024 * 1024;
+  defragmentDeviceMemory(&mg::mgSystem, defragmentationBudgetInBytes);
+  constexpr VkDeviceSize residencyBudgetInBytes = 64 * 1024 * 1024;
+  manageDeviceMemoryBudget(&mg::mgSystem, residencyBudgetInBytes);
+  // meshes and textures of files parsed in the background
+  constexpr VkDeviceSize streamingBudgetInBytes = 32 * 1024 * 1024;
+  mg::mgSystem.assetStreamer.update(streamingBudgetInBytes);
+  // textures moved, evicted or loaded above are written to the descriptor sets of this frame only
+  mg::mgSystem.textureContainer.updateDescriptorSets();
+  // pipelines rebuilt for changed shaders and pipelines linked with link time optimization are swapped in before the
+  // frame is recorded
+  mg::mgSystem.pipelineContainer.updateShaderHotReload();
+  mg::mgSystem.pipelineContainer.updateOptimizedPipelines();
 
   VkCommandBufferBeginInfo vkCommandBufferBeginInfo = {};
   vkCommandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
   vkCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
   checkResult(vkBeginCommandBuffer(vkContext.commandBuffer, &vkCommandBufferBeginInfo));
+  mg::mgSystem.commandRecorder.beginCommandBuffer(vkContext.commandBuffer);
   
   setFullscreenViewport();
   acquireNextSwapChainImage();
@@ -127,10 +149,31 @@ void resizeWindow() {
   waitForDeviceIdle();
 }
 
+// must be called outside of beginRendering and endRendering
+void setNrOfFramesInFlight(uint32_t nrOfFramesInFlight) {
+  mgAssertDesc(nrOfFramesInFlight >= MIN_NR_OF_FRAMES_IN_FLIGHT && nrOfFramesInFlight <= MAX_NR_OF_FRAMES_IN_FLIGHT,
+               "nr of frames in flight must be between " << MIN_NR_OF_FRAMES_IN_FLIGHT << " and "
+                                                         << MAX_NR_OF_FRAMES_IN_FLIGHT);
+  if (nrOfFramesInFlight == vkContext.commandBuffers.nrOfBuffers)
+    return;
+
+  waitForDeviceIdle();
+  mg::mgSystem.linearHeapAllocator.setNrOfBuffers(nrOfFramesInFlight);
+  vkContext.commandBuffers.nrOfBuffers = nrOfFramesInFlight;
+  vkContext.commandBuffers.currentIndex = 0;
+  std::fill(std::begin(vkContext.commandBuffers.submitted), std::end(vkContext.commandBuffers.submitted), false);
+  // the swap chain has at least one image per frame in flight
+  resizeWindow();
+  LOG("Frames in flight: " << nrOfFramesInFlight);
+}
+
 void endRendering() {
   mg::mgSystem.linearHeapAllocator.swapLinearHeapBuffers();
+  mg::mgSystem.pipelineContainer.logPipelineCreationTime();
 
   const auto commandBufferIndex = vkContext.commandBuffers.currentIndex;
+  mg::mgSystem.renderQueue.endFrame();
+  mg::mgSystem.commandRecorder.endCommandBuffer();
   checkResult(vkEndCommandBuffer(vkContext.commandBuffer));
 
   VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
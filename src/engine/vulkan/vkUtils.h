@@ -18,11 +18,13 @@ int32_t findMemoryTypeIndex(const VkPhysicalDeviceMemoryProperties &memoryProper
 void setViewPort(VkCommandBuffer commandBuffer, float x, float y, float width, float height, float minDepth,
                  float maxDepth);
 void setFullscreenViewport();
+void setFullscreenViewport(VkCommandBuffer commandBuffer);
 
 void beginRendering();
 void endRendering();
 void waitForDeviceIdle();
 void resizeWindow();
+void setNrOfFramesInFlight(uint32_t nrOfFramesInFlight);
 
 inline char *errorString(VkResult errorCode) {
   switch (errorCode) {
@@ -79,6 +81,7 @@ struct GuiAllocation {
   std::vector<SubAllocationGui> elements;
   uint32_t totalNrOfAllocation;
   uint32_t allocationNotFreed;
+  float fragmentation;
   bool showFullSize;
   bool largeStagingAllocation;
   bool largeDeviceAllocation;
@@ -9,6 +9,7 @@
 #include <GLFW/glfw3.h>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
@@ -26,7 +27,7 @@ namespace mg {
 static char *DEBUG_LAYER = (char *)"VK_LAYER_KHRONOS_validation";
 
 void createCommandBuffers() {
-  for (int i = 0; i < mg::vkContext.commandBuffers.nrOfBuffers; ++i) {
+  for (uint32_t i = 0; i < mg::MAX_NR_OF_FRAMES_IN_FLIGHT; ++i) {
     VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
     commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     commandBufferAllocateInfo.commandPool = mg::vkContext.commandPool;
@@ -41,12 +42,12 @@ void createCommandBufferFences() {
   VkFenceCreateInfo fenceCreateInfo = {};
   fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 
-  for (int i = 0; i < mg::vkContext.commandBuffers.nrOfBuffers; ++i) {
+  for (uint32_t i = 0; i < mg::MAX_NR_OF_FRAMES_IN_FLIGHT; ++i) {
     checkResult(vkCreateFence(mg::vkContext.device, &fenceCreateInfo, NULL, &mg::vkContext.commandBuffers.fences[i]));
   }
 }
 void createCommandBufferSemaphores() {
-  for (size_t i = 0; i < mg::vkContext.commandBuffers.nrOfBuffers; i++) {
+  for (uint32_t i = 0; i < mg::MAX_NR_OF_FRAMES_IN_FLIGHT; i++) {
     VkSemaphoreCreateInfo semaphoreCreateInfo = {};
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     checkResult(vkCreateSemaphore(mg::vkContext.device, &semaphoreCreateInfo, nullptr,
@@ -235,15 +236,18 @@ static void findPhysicalDevice() {
 }
 
 static void createLogicalDevice() {
-  // use same queue for graphic, present and compute
+  // use same queue for graphic, present and compute, and a second queue for transfers when there is a transfer family
   float queuePriority = 1.0f;
 
-  VkDeviceQueueCreateInfo queueCreateInfo = {};
+  VkDeviceQueueCreateInfo queueCreateInfos[2] = {};
 
-  queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-  queueCreateInfo.queueFamilyIndex = mg::vkContext.queueFamilyIndex;
-  queueCreateInfo.queueCount = 1;
-  queueCreateInfo.pQueuePriorities = &queuePriority;
+  queueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queueCreateInfos[0].queueFamilyIndex = mg::vkContext.queueFamilyIndex;
+  queueCreateInfos[0].queueCount = 1;
+  queueCreateInfos[0].pQueuePriorities = &queuePriority;
+
+  queueCreateInfos[1] = queueCreateInfos[0];
+  queueCreateInfos[1].queueFamilyIndex = mg::vkContext.transferQueueFamilyIndex;
 
   VkPhysicalDeviceVulkan12Features vkPhysicalDeviceVulkan12Features = {};
   vkPhysicalDeviceVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
@@ -253,12 +257,14 @@ static void createLogicalDevice() {
   vkPhysicalDeviceVulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
   vkPhysicalDeviceVulkan12Features.descriptorIndexing = VK_TRUE;
   vkPhysicalDeviceVulkan12Features.bufferDeviceAddress = VK_TRUE;
+  // the graphics queue waits on a timeline semaphore for the copies on the transfer queue
+  vkPhysicalDeviceVulkan12Features.timelineSemaphore = mg::vkContext.hasTransferQueue ? VK_TRUE : VK_FALSE;
   // Create logical device from physical device
   // Note: there are separate instance and device extensions!
   VkDeviceCreateInfo deviceCreateInfo = {};
   deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
-  deviceCreateInfo.queueCreateInfoCount = 1;
+  deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
+  deviceCreateInfo.queueCreateInfoCount = mg::vkContext.hasTransferQueue ? 2 : 1;
   deviceCreateInfo.pNext = &vkPhysicalDeviceVulkan12Features;
 
   // Check for extensions
@@ -280,20 +286,87 @@ static void createLogicalDevice() {
   enabledFeatures.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
   
 
-  const char *deviceExtensions[] = {VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
-                                    VK_KHR_MAINTENANCE3_EXTENSION_NAME,
-                                    VK_KHR_MAINTENANCE1_EXTENSION_NAME,
-                                    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-                                    VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
-                                    VK_NV_RAY_TRACING_EXTENSION_NAME};
+  std::vector<const char *> deviceExtensions = {VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+                                                VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+                                                VK_KHR_MAINTENANCE1_EXTENSION_NAME,
+                                                VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+                                                VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+                                                VK_NV_RAY_TRACING_EXTENSION_NAME};
+
+  // optional extensions
+  const auto isExtensionAvailable = [&availableExtensions](const char *name) {
+    return std::any_of(std::begin(availableExtensions), std::end(availableExtensions),
+                       [name](const VkExtensionProperties &extension) {
+                         return strcmp(extension.extensionName, name) == 0;
+                       });
+  };
+  mg::vkContext.extensions.memoryBudget = isExtensionAvailable(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (mg::vkContext.extensions.memoryBudget)
+    deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  LOG("VK_EXT_memory_budget: " << (mg::vkContext.extensions.memoryBudget ? "yes" : "no"));
+
+  // the features of the optional extensions are queried in one chain, the chain of the enabled extensions is passed
+  // on to the device
+  VkPhysicalDeviceFeatures2 vkPhysicalDeviceFeatures2 = {};
+  vkPhysicalDeviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = {};
+  extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures = {};
+  graphicsPipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+  const bool isExtendedDynamicStateAvailable = isExtensionAvailable(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+  // MG_DISABLE_PIPELINE_LIBRARY is used to compare the time to the first frame with and without pipeline libraries
+  const bool isGraphicsPipelineLibraryAvailable =
+      isExtensionAvailable(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+      isExtensionAvailable(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+      std::getenv("MG_DISABLE_PIPELINE_LIBRARY") == nullptr;
+  if (isExtendedDynamicStateAvailable)
+    vkPhysicalDeviceFeatures2.pNext = &extendedDynamicStateFeatures;
+  if (isGraphicsPipelineLibraryAvailable) {
+    graphicsPipelineLibraryFeatures.pNext = vkPhysicalDeviceFeatures2.pNext;
+    vkPhysicalDeviceFeatures2.pNext = &graphicsPipelineLibraryFeatures;
+  }
+  vkGetPhysicalDeviceFeatures2(mg::vkContext.physicalDevice, &vkPhysicalDeviceFeatures2);
+
+  void **nextFeatures = &vkPhysicalDeviceVulkan12Features.pNext;
+  mg::vkContext.extensions.extendedDynamicState = extendedDynamicStateFeatures.extendedDynamicState == VK_TRUE;
+  if (mg::vkContext.extensions.extendedDynamicState) {
+    deviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    *nextFeatures = &extendedDynamicStateFeatures;
+    nextFeatures = &extendedDynamicStateFeatures.pNext;
+  }
+  LOG("VK_EXT_extended_dynamic_state: " << (mg::vkContext.extensions.extendedDynamicState ? "yes" : "no"));
+
+  // without fast linking, linking the libraries is as slow as creating the pipeline
+  VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT graphicsPipelineLibraryProperties = {};
+  graphicsPipelineLibraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+  if (graphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE) {
+    VkPhysicalDeviceProperties2 vkPhysicalDeviceProperties2 = {};
+    vkPhysicalDeviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    vkPhysicalDeviceProperties2.pNext = &graphicsPipelineLibraryProperties;
+    vkGetPhysicalDeviceProperties2(mg::vkContext.physicalDevice, &vkPhysicalDeviceProperties2);
+  }
+  mg::vkContext.extensions.graphicsPipelineLibrary =
+      graphicsPipelineLibraryProperties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+  if (mg::vkContext.extensions.graphicsPipelineLibrary) {
+    deviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+    deviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+    graphicsPipelineLibraryFeatures.pNext = nullptr;
+    *nextFeatures = &graphicsPipelineLibraryFeatures;
+    nextFeatures = &graphicsPipelineLibraryFeatures.pNext;
+  }
+  LOG("VK_EXT_graphics_pipeline_library: " << (mg::vkContext.extensions.graphicsPipelineLibrary ? "yes" : "no"));
 
-  deviceCreateInfo.enabledExtensionCount = mg::countof(deviceExtensions);
-  deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions;
+  deviceCreateInfo.enabledExtensionCount = uint32_t(deviceExtensions.size());
+  deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
   deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
   checkResult(vkCreateDevice(mg::vkContext.physicalDevice, &deviceCreateInfo, nullptr, &mg::vkContext.device));
 
   vkGetDeviceQueue(mg::vkContext.device, mg::vkContext.queueFamilyIndex, 0, &mg::vkContext.queue);
+  mg::vkContext.transferQueue = mg::vkContext.queue;
+  if (mg::vkContext.hasTransferQueue)
+    vkGetDeviceQueue(mg::vkContext.device, mg::vkContext.transferQueueFamilyIndex, 0, &mg::vkContext.transferQueue);
   vkGetPhysicalDeviceMemoryProperties(mg::vkContext.physicalDevice, &mg::vkContext.physicalDeviceMemoryProperties);
 }
 
@@ -320,6 +393,22 @@ static void findQueueFamilies() {
     }
   }
   mgAssert(i != queueFamilyCount);
+
+  // a family without graphics and compute support is a dedicated dma queue on most gpus. MG_DISABLE_TRANSFER_QUEUE is
+  // used to compare uploads with and without it
+  mg::vkContext.hasTransferQueue = false;
+  if (std::getenv("MG_DISABLE_TRANSFER_QUEUE") == nullptr) {
+    for (uint32_t j = 0; j < queueFamilyCount; j++) {
+      const auto queueFlags = queueFamilies[j].queueFlags;
+      if (queueFamilies[j].queueCount > 0 && queueFlags & VK_QUEUE_TRANSFER_BIT &&
+          !(queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+        mg::vkContext.hasTransferQueue = true;
+        mg::vkContext.transferQueueFamilyIndex = j;
+        break;
+      }
+    }
+  }
+  LOG("Dedicated transfer queue: " << (mg::vkContext.hasTransferQueue ? "yes" : "no"));
 }
 
 static VkFormat getSupportedDepthFormat() {
@@ -32,7 +32,7 @@ static mg::Pipeline createMRTPipeline(const mg::RenderContext &renderContext) {
   return mrtPipeline;
 }
 
-void renderMRT(const mg::RenderContext &renderContext, const mg::ObjMeshes &objMeshes) {
+void renderMRT(const mg::RenderContext &renderContext, const mg::ObjMeshes &objMeshes, uint32_t nrOfCommandBuffers) {
   using namespace mg::shaders::mrt;
 
   const auto mrtPipeline = createMRTPipeline(renderContext);
@@ -51,23 +51,26 @@ void renderMRT(const mg::RenderContext &renderContext, const mg::ObjMeshes &objM
   DescriptorSets descriptorSets = {};
   descriptorSets.ubo = uboSet;
 
-  uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mrtPipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mrtPipeline.pipeline);
+  mg::DrawCommand drawCommand = {};
+  drawCommand.pipeline = mrtPipeline;
+  drawCommand.descriptorSets[0] = descriptorSets.ubo;
+  drawCommand.descriptorSetCount = mg::countof(descriptorSets.values);
+  drawCommand.dynamicOffsets[0] = uniformOffset;
+  drawCommand.dynamicOffsetCount = mg::countof(drawCommand.dynamicOffsets);
 
+  // the meshes have no bounds, so they are only sorted on state
   for (uint32_t i = 0; i < objMeshes.meshes.size(); i++) {
     const auto mesh = mg::getMesh(objMeshes.meshes[i].id);
     mgAssert(objMeshes.meshes[i].materialId < objMeshes.materials.size());
-    const auto material = objMeshes.materials[objMeshes.meshes[i].materialId];
+    const auto &material = objMeshes.materials[objMeshes.meshes[i].materialId];
 
-    VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &mesh.buffer, &offset);
-    vkCmdPushConstants(mg::vkContext.commandBuffer, mrtPipeline.layout, VK_SHADER_STAGE_ALL, 0,
-                       sizeof(material.diffuse), (void *)&material.diffuse);
-    vkCmdDraw(mg::vkContext.commandBuffer, mesh.indexCount, 1, 0, 0);
+    drawCommand.vertexBuffer = mesh.buffer;
+    drawCommand.count = mesh.indexCount;
+    drawCommand.pushConstants = &material.diffuse;
+    drawCommand.pushConstantSize = sizeof(material.diffuse);
+    mg::mgSystem.renderQueue.submit(renderContext, drawCommand);
   }
+  mg::mgSystem.renderQueue.flush(renderContext, nrOfCommandBuffers);
 }
 
 static mg::Pipeline createSSAOPipeline(const mg::RenderContext &renderContext) {
@@ -107,9 +110,8 @@ void renderSSAO(const mg::RenderContext &renderContext, const DeferredRenderPass
   descriptorSets.textures = mg::getTextureDescriptorSet();
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ssaoPipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(ssaoPipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.normalIndex = mg::getTexture2DDescriptorIndex(deferredRenderPass.normal);
@@ -118,7 +120,7 @@ void renderSSAO(const mg::RenderContext &renderContext, const DeferredRenderPass
   vkCmdPushConstants(mg::vkContext.commandBuffer, ssaoPipeline.layout, VK_SHADER_STAGE_ALL, 0, sizeof(TextureIndices),
                      &textureIndices);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ssaoPipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(ssaoPipeline);
   vkCmdDraw(mg::vkContext.commandBuffer, 3, 1, 0, 0);
 }
 
@@ -156,16 +158,15 @@ void renderBlurSSAO(const mg::RenderContext &renderContext, const DeferredRender
   descriptorSets.textures = mg::getTextureDescriptorSet();
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ssaoBlurPipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(ssaoBlurPipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.ssaoIndex = mg::getTexture2DDescriptorIndex(deferredRenderPass.ssao);
   vkCmdPushConstants(mg::vkContext.commandBuffer, ssaoBlurPipeline.layout, VK_SHADER_STAGE_ALL, 0,
                      sizeof(TextureIndices), &textureIndices);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ssaoBlurPipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(ssaoBlurPipeline);
   vkCmdDraw(mg::vkContext.commandBuffer, 3, 1, 0, 0);
 }
 
@@ -226,9 +227,8 @@ void renderFinalDeferred(const mg::RenderContext &renderContext, const DeferredR
   descriptorSets.textures = mg::getTextureDescriptorSet();
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, deferredPipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(deferredPipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.diffuseIndex = mg::getTexture2DDescriptorIndex(deferredRenderPass.albedo);
@@ -239,6 +239,6 @@ void renderFinalDeferred(const mg::RenderContext &renderContext, const DeferredR
   vkCmdPushConstants(mg::vkContext.commandBuffer, deferredPipeline.layout, VK_SHADER_STAGE_ALL, 0,
                      sizeof(TextureIndices), &textureIndices);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, deferredPipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(deferredPipeline);
   vkCmdDraw(mg::vkContext.commandBuffer, 3, 1, 0, 0);
 }
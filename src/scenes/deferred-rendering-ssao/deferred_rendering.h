@@ -9,7 +9,8 @@ struct ObjMeshes;
 
 struct DeferredRenderPass;
 struct Noise;
-void renderMRT(const mg::RenderContext &renderContext, const mg::ObjMeshes &objMeshes);
+// the meshes are recorded into nrOfCommandBuffers secondary command buffers in parallel
+void renderMRT(const mg::RenderContext &renderContext, const mg::ObjMeshes &objMeshes, uint32_t nrOfCommandBuffers);
 void renderSSAO(const mg::RenderContext &renderContext, const DeferredRenderPass &deferredRenderPass, const Noise &noise);
 void renderBlurSSAO(const mg::RenderContext &renderContext, const DeferredRenderPass &deferredRenderPass);
 void renderFinalDeferred(const mg::RenderContext &renderContext, const DeferredRenderPass &deferredRenderPass);
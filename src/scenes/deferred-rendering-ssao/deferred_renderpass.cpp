@@ -200,6 +200,7 @@ static void createRenderPass(DeferredRenderPass *deferredRenderPass) {
   renderPassInfo.pDependencies = dependencies;
 
   mg::checkResult(vkCreateRenderPass(mg::vkContext.device, &renderPassInfo, nullptr, &deferredRenderPass->vkRenderPass));
+  mg::mgSystem.pipelineContainer.registerRenderPass(deferredRenderPass->vkRenderPass, "deferred");
 }
 
 static void createFrameBuffer(DeferredRenderPass *deferredRenderPass) {
@@ -263,10 +264,11 @@ void resizeDeferredRenderPass(DeferredRenderPass *deferredRenderPass) {
 void destroyDeferredRenderPass(DeferredRenderPass *deferredRenderPass) {
   destroyFrameBuffers(deferredRenderPass);
   destroyTextures(deferredRenderPass);
+  mg::mgSystem.pipelineContainer.unregisterRenderPass(deferredRenderPass->vkRenderPass);
   vkDestroyRenderPass(mg::vkContext.device, deferredRenderPass->vkRenderPass, nullptr);
 }
 
-void beginDeferredRenderPass(const DeferredRenderPass &deferredRenderPass) {
+void beginDeferredRenderPass(const DeferredRenderPass &deferredRenderPass, VkSubpassContents contents) {
   VkClearValue clearValues[DEFERRED_ATTACHMENTS::SIZE];
   clearValues[DEFERRED_ATTACHMENTS::NORMAL].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
   clearValues[DEFERRED_ATTACHMENTS::ALBEDO].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
@@ -285,7 +287,7 @@ void beginDeferredRenderPass(const DeferredRenderPass &deferredRenderPass) {
   renderPassBeginInfo.clearValueCount = mg::countof(clearValues);
   renderPassBeginInfo.pClearValues = clearValues;
 
-  vkCmdBeginRenderPass(mg::vkContext.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(mg::vkContext.commandBuffer, &renderPassBeginInfo, contents);
 }
 
 void endDeferredRenderPass() { vkCmdEndRenderPass(mg::vkContext.commandBuffer); }
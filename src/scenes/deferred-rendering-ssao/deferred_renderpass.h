@@ -20,5 +20,6 @@ void initDeferredRenderPass(DeferredRenderPass *deferredRenderPass);
 void resizeDeferredRenderPass(DeferredRenderPass *deferredRenderPass);
 void destroyDeferredRenderPass(DeferredRenderPass *deferredRenderPass);
 
-void beginDeferredRenderPass(const DeferredRenderPass &deferredRenderPass);
+// contents are the subpass contents of the mrt subpass
+void beginDeferredRenderPass(const DeferredRenderPass &deferredRenderPass, VkSubpassContents contents);
 void endDeferredRenderPass();
@@ -3,6 +3,7 @@
 #include "deferred_rendering.h"
 #include "deferred_renderpass.h"
 #include "mg/camera.h"
+#include "mg/jobs.h"
 #include "mg/meshLoader.h"
 #include "mg/mgAssert.h"
 #include "mg/mgSystem.h"
@@ -18,7 +19,28 @@
 static mg::Camera camera;
 static DeferredRenderPass deferredRenderPass;
 static Noise noise;
-static mg::ObjMeshes objMeshes;
+// the obj file is streamed, the scene is drawn with a placeholder mesh until it is loaded
+static mg::StreamId objStreamId;
+// the mrt subpass is recorded into secondary command buffers in parallel, n cycles through 1 to the number of threads of
+// the job system
+static struct {
+  uint32_t nrOfCommandBuffers = 1;
+  bool wasKeyPressed = false;
+  // recording time of the mrt subpass for every number of command buffers, averaged over the frames
+  float recordingTimeInMs[mg::jobs::MaxNrOfWorkerThreads + 1] = {};
+  float frameTimeInMs[mg::jobs::MaxNrOfWorkerThreads + 1] = {};
+  mg::timer::Time frameStart = mg::timer::now();
+} mrtRecording;
+// f cycles the number of frames in flight, the time beginRendering waits for the fence of the frame that last used the
+// command buffer is measured for every number of frames in flight
+static struct {
+  bool wasKeyPressed = false;
+  float fenceWaitTimeInMs[mg::MAX_NR_OF_FRAMES_IN_FLIGHT + 1] = {};
+  float frameTimeInMs[mg::MAX_NR_OF_FRAMES_IN_FLIGHT + 1] = {};
+  mg::timer::Time frameStart = mg::timer::now();
+} framesInFlight;
+// m writes the heap stats of the device memory allocators to the log
+static bool wasAllocationStatsKeyPressed = false;
 
 using namespace std;
 
@@ -31,8 +53,10 @@ void initScene() {
 
   camera = mg::create3DCamera(glm::vec3(0.5, 200, 470), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
   //camera = mg::create3DCamera(glm::vec3(0.5, 1.0, 4), glm::vec3(0, 1.0, 0), glm::vec3(0, 1, 0));
-  objMeshes = mg::loadObjFromFile(mg::getDataPath() + "rungholt_obj/rungholt.obj");
-  //objMeshes = mg::loadObjFromFile(mg::getDataPath() + "CornellBox_obj/CornellBox-Original.obj");
+  objStreamId = mg::mgSystem.assetStreamer.streamObj(mg::getDataPath() + "rungholt_obj/rungholt.obj",
+                                                     mg::StreamingPriority::Near);
+  //objStreamId = mg::mgSystem.assetStreamer.streamObj(mg::getDataPath() + "CornellBox_obj/CornellBox-Original.obj",
+  //                                                   mg::StreamingPriority::Near);
   initDeferredRenderPass(&deferredRenderPass);
   noise = createNoise();
 
@@ -50,6 +74,28 @@ void updateScene(const mg::FrameData &frameData) {
   if (frameData.keys.r) {
     mg::mgSystem.pipelineContainer.resetPipelineContainer();
   }
+  if (frameData.keys.n && !mrtRecording.wasKeyPressed) {
+    const auto index = mrtRecording.nrOfCommandBuffers - 1;
+    LOG("mrt recorded into " << mrtRecording.nrOfCommandBuffers << " command buffers: "
+                             << mrtRecording.recordingTimeInMs[index] << " ms, frame time: "
+                             << mrtRecording.frameTimeInMs[index] << " ms");
+    const auto maxNrOfCommandBuffers = mg::mgSystem.secondaryCommandBuffers.getMaxNrOfCommandBuffers();
+    mrtRecording.nrOfCommandBuffers = mrtRecording.nrOfCommandBuffers % maxNrOfCommandBuffers + 1;
+  }
+  mrtRecording.wasKeyPressed = frameData.keys.n;
+  if (frameData.keys.f && !framesInFlight.wasKeyPressed) {
+    const auto nrOfFramesInFlight = mg::vkContext.commandBuffers.nrOfBuffers;
+    LOG(nrOfFramesInFlight << " frames in flight, fence wait: " << framesInFlight.fenceWaitTimeInMs[nrOfFramesInFlight]
+                           << " ms, frame time: " << framesInFlight.frameTimeInMs[nrOfFramesInFlight] << " ms");
+    mg::setNrOfFramesInFlight(nrOfFramesInFlight == mg::MAX_NR_OF_FRAMES_IN_FLIGHT ? mg::MIN_NR_OF_FRAMES_IN_FLIGHT
+                                                                                    : nrOfFramesInFlight + 1);
+    // the switch waits for the device, it is not part of the frame time
+    framesInFlight.frameStart = mg::timer::now();
+  }
+  framesInFlight.wasKeyPressed = frameData.keys.f;
+  if (frameData.keys.m && !wasAllocationStatsKeyPressed)
+    mg::logAllocationStats();
+  wasAllocationStatsKeyPressed = frameData.keys.m;
   if (frameData.mouse.xy.x >= 0 && frameData.mouse.xy.x < 1.0f && frameData.mouse.xy.y >= 0 && frameData.mouse.xy.y < 1.0f) {
     if (frameData.mouse.left) {
       mg::handleTools(frameData, &camera);
@@ -60,11 +106,35 @@ void updateScene(const mg::FrameData &frameData) {
 
 void renderScene(const mg::FrameData &frameData) {
   mg::Texts texts = {};
-  mg::Text text = {"Rungholt"};
+  mg::Text text = {mg::mgSystem.assetStreamer.isLoaded(objStreamId) ? "Rungholt" : "Rungholt (loading)"};
 
   mg::pushText(&texts, text);
+  {
+    const auto index = mrtRecording.nrOfCommandBuffers - 1;
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "MRT command buffers (n): %u, recording: %.2f ms, frame: %.2f ms",
+             mrtRecording.nrOfCommandBuffers, mrtRecording.recordingTimeInMs[index], mrtRecording.frameTimeInMs[index]);
+    mg::pushText(&texts, {buffer});
+  }
 
   mg::beginRendering();
+  {
+    const auto nrOfFramesInFlight = mg::vkContext.commandBuffers.nrOfBuffers;
+    const auto fenceWaitTimeInMs = float(mg::vkContext.commandBuffers.fenceWaitTimeInUs) / 1000.0f;
+    framesInFlight.fenceWaitTimeInMs[nrOfFramesInFlight] =
+        glm::mix(framesInFlight.fenceWaitTimeInMs[nrOfFramesInFlight], fenceWaitTimeInMs, 0.05f);
+    const auto now = mg::timer::now();
+    const auto frameTimeInMs = float(mg::timer::durationInUs(framesInFlight.frameStart, now)) / 1000.0f;
+    framesInFlight.frameTimeInMs[nrOfFramesInFlight] =
+        glm::mix(framesInFlight.frameTimeInMs[nrOfFramesInFlight], frameTimeInMs, 0.05f);
+    framesInFlight.frameStart = now;
+
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "Frames in flight (f): %u, fence wait: %.2f ms, frame: %.2f ms",
+             nrOfFramesInFlight, framesInFlight.fenceWaitTimeInMs[nrOfFramesInFlight],
+             framesInFlight.frameTimeInMs[nrOfFramesInFlight]);
+    mg::pushText(&texts, {buffer});
+  }
 
   mg::RenderContext renderContext = {};
   renderContext.renderPass = deferredRenderPass.vkRenderPass;
@@ -73,12 +143,22 @@ void renderScene(const mg::FrameData &frameData) {
       glm::perspective(glm::radians(camera.fov), mg::vkContext.screen.width / float(mg::vkContext.screen.height), 0.1f, 1000.f);
   renderContext.view = glm::lookAt(camera.position, camera.aim, camera.up);
 
-  beginDeferredRenderPass(deferredRenderPass);
+  beginDeferredRenderPass(deferredRenderPass, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
   {
     renderContext.subpass = 0;
-    renderMRT(renderContext, objMeshes);
+    const auto start = mg::timer::now();
+    renderMRT(renderContext, mg::mgSystem.assetStreamer.getObjMeshes(objStreamId), mrtRecording.nrOfCommandBuffers);
+    const auto recordingTimeInMs = float(mg::timer::durationInUs(start, mg::timer::now())) / 1000.0f;
+
+    const auto index = mrtRecording.nrOfCommandBuffers - 1;
+    mrtRecording.recordingTimeInMs[index] = glm::mix(mrtRecording.recordingTimeInMs[index], recordingTimeInMs, 0.05f);
+    const auto frameTimeInMs = float(mg::timer::durationInUs(mrtRecording.frameStart, start)) / 1000.0f;
+    mrtRecording.frameTimeInMs[index] = glm::mix(mrtRecording.frameTimeInMs[index], frameTimeInMs, 0.05f);
+    mrtRecording.frameStart = start;
 
     vkCmdNextSubpass(mg::vkContext.commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    // the viewport is undefined after the secondary command buffers
+    mg::setFullscreenViewport();
     renderContext.subpass = 1;
     renderSSAO(renderContext, deferredRenderPass, noise);
 
@@ -3,6 +3,7 @@
 #include "mg/mgSystem.h"
 #include "mg/window.h"
 #include "rendering/rendering.h"
+#include "vulkan/computeAutotuner.h"
 #include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -13,13 +14,23 @@ namespace mg {
 
 static size_t gridSize(size_t N) { return (N + 2) * (N + 2); }
 
-static void diffuse(int32_t N, int32_t b, mg::StorageId x, mg::StorageId x0, float diff, float dt) {
-  using namespace mg::shaders::diffuse;
+// the kernels share the workgroup size, set through specialization constant 0. It is tuned with the diffuse kernel
+// before the first step, the kernels loop over the grid so every workgroup size covers it
+static uint32_t workgroupSize = 0;
+static const VkSpecializationMapEntry workgroupSizeMapEntry = {0, 0, sizeof(uint32_t)};
+static const VkSpecializationInfo workgroupSizeSpecializationInfo = {1, &workgroupSizeMapEntry, sizeof(uint32_t),
+                                                                     &workgroupSize};
 
-  mg::PipelineStateDesc pipelineStateDesc = {};
-  pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
+static uint32_t workgroupCount(int32_t N, uint32_t groupSize) {
+  return uint32_t(gridSize(N) + groupSize - 1) / groupSize;
+}
 
-  const auto pipeline = mg::mgSystem.pipelineContainer.createComputePipeline(pipelineStateDesc, {.shaderName = shader});
+static mg::PipelineHandle diffusePipelineHandle;
+
+// also used to time the workgroup sizes, the pipeline is bound by the caller
+static void recordDiffuse(VkCommandBuffer commandBuffer, const mg::Pipeline &pipeline, uint32_t groupSize, int32_t N,
+                          int32_t b, mg::StorageId x, mg::StorageId x0, float diff, float dt) {
+  using namespace mg::shaders::diffuse;
 
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
@@ -36,14 +47,12 @@ static void diffuse(int32_t N, int32_t b, mg::StorageId x, mg::StorageId x0, flo
   descriptorSets.x = mg::mgSystem.storageContainer.getStorage(x).descriptorSet;
   descriptorSets.x0 = mg::mgSystem.storageContainer.getStorage(x0).descriptorSet;
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
-
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout, 0,
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout, 0,
                           mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
                           dynamicOffsets);
 
-  vkCmdDispatch(mg::vkContext.commandBuffer, uint32_t(gridSize(N)) / 256, 1, 1);
+  vkCmdDispatch(commandBuffer, workgroupCount(N, groupSize), 1, 1);
 
   // setup a memory barrier, device memory has to be finished with writing when reading occurs on
   // the host
@@ -52,17 +61,39 @@ static void diffuse(int32_t N, int32_t b, mg::StorageId x, mg::StorageId x0, flo
   memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
   memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
 
-  vkCmdPipelineBarrier(mg::vkContext.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+static void diffuse(int32_t N, int32_t b, mg::StorageId x, mg::StorageId x0, float diff, float dt) {
+  using namespace mg::shaders::diffuse;
+
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (!pipelineContainer.isValid(diffusePipelineHandle)) {
+    mg::PipelineStateDesc pipelineStateDesc = {};
+    pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
+    diffusePipelineHandle = pipelineContainer.registerComputePipeline(
+        pipelineStateDesc, {.shaderName = shader, .specializationInfo = &workgroupSizeSpecializationInfo});
+  }
+  const auto pipeline = pipelineContainer.getPipeline(diffusePipelineHandle);
+
+  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+  recordDiffuse(mg::vkContext.commandBuffer, pipeline, workgroupSize, N, b, x, x0, diff, dt);
 }
 
+static mg::PipelineHandle advectPipelineHandle;
+
 static void advect(int32_t N, int32_t b, mg::StorageId d, mg::StorageId d0, mg::StorageId u, mg::StorageId v, float dt) {
   using namespace mg::shaders::advec;
 
-  mg::PipelineStateDesc pipelineStateDesc = {};
-  pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
-
-  const auto pipeline = mg::mgSystem.pipelineContainer.createComputePipeline(pipelineStateDesc, {.shaderName = shader});
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (!pipelineContainer.isValid(advectPipelineHandle)) {
+    mg::PipelineStateDesc pipelineStateDesc = {};
+    pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
+    advectPipelineHandle = pipelineContainer.registerComputePipeline(
+        pipelineStateDesc, {.shaderName = shader, .specializationInfo = &workgroupSizeSpecializationInfo});
+  }
+  const auto pipeline = pipelineContainer.getPipeline(advectPipelineHandle);
 
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
@@ -87,7 +118,7 @@ static void advect(int32_t N, int32_t b, mg::StorageId d, mg::StorageId d0, mg::
                           mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
                           dynamicOffsets);
 
-  vkCmdDispatch(vkContext.commandBuffer, uint32_t(gridSize(N)) / 256, 1, 1);
+  vkCmdDispatch(vkContext.commandBuffer, workgroupCount(N, workgroupSize), 1, 1);
 
   VkMemoryBarrier memoryBarrier = {};
   memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
@@ -98,13 +129,19 @@ static void advect(int32_t N, int32_t b, mg::StorageId d, mg::StorageId d0, mg::
                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 }
 
+static mg::PipelineHandle preProjectComputePipelineHandle;
+
 static void preProjectCompute(int32_t N, mg::StorageId u, mg::StorageId v, mg::StorageId p, mg::StorageId div) {
   using namespace mg::shaders::preProject;
 
-  mg::PipelineStateDesc pipelineStateDesc = {};
-  pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
-
-  const auto pipeline = mg::mgSystem.pipelineContainer.createComputePipeline(pipelineStateDesc, {.shaderName = shader});
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (!pipelineContainer.isValid(preProjectComputePipelineHandle)) {
+    mg::PipelineStateDesc pipelineStateDesc = {};
+    pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
+    preProjectComputePipelineHandle = pipelineContainer.registerComputePipeline(
+        pipelineStateDesc, {.shaderName = shader, .specializationInfo = &workgroupSizeSpecializationInfo});
+  }
+  const auto pipeline = pipelineContainer.getPipeline(preProjectComputePipelineHandle);
 
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
@@ -127,7 +164,7 @@ static void preProjectCompute(int32_t N, mg::StorageId u, mg::StorageId v, mg::S
                           mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
                           dynamicOffsets);
 
-  vkCmdDispatch(vkContext.commandBuffer, uint32_t(gridSize(N)) / 256, 1, 1);
+  vkCmdDispatch(vkContext.commandBuffer, workgroupCount(N, workgroupSize), 1, 1);
 
   VkMemoryBarrier memoryBarrier = {};
   memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
@@ -137,13 +174,19 @@ static void preProjectCompute(int32_t N, mg::StorageId u, mg::StorageId v, mg::S
   vkCmdPipelineBarrier(mg::vkContext.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 }
+static mg::PipelineHandle projectComputePipelineHandle;
+
 static void projectCompute(int32_t N, mg::StorageId u, mg::StorageId v, mg::StorageId p, mg::StorageId div) {
   using namespace mg::shaders::project;
 
-  mg::PipelineStateDesc pipelineStateDesc = {};
-  pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
-
-  const auto pipeline = mg::mgSystem.pipelineContainer.createComputePipeline(pipelineStateDesc, {.shaderName = shader});
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (!pipelineContainer.isValid(projectComputePipelineHandle)) {
+    mg::PipelineStateDesc pipelineStateDesc = {};
+    pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
+    projectComputePipelineHandle = pipelineContainer.registerComputePipeline(
+        pipelineStateDesc, {.shaderName = shader, .specializationInfo = &workgroupSizeSpecializationInfo});
+  }
+  const auto pipeline = pipelineContainer.getPipeline(projectComputePipelineHandle);
 
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
@@ -166,7 +209,7 @@ static void projectCompute(int32_t N, mg::StorageId u, mg::StorageId v, mg::Stor
                           mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
                           dynamicOffsets);
 
-  vkCmdDispatch(vkContext.commandBuffer, uint32_t(gridSize(N)) / 256, 1, 1);
+  vkCmdDispatch(vkContext.commandBuffer, workgroupCount(N, workgroupSize), 1, 1);
 
   VkMemoryBarrier memoryBarrier = {};
   memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
@@ -177,13 +220,19 @@ static void projectCompute(int32_t N, mg::StorageId u, mg::StorageId v, mg::Stor
                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 }
 
+static mg::PipelineHandle postProjectComputePipelineHandle;
+
 static void postProjectCompute(int32_t N, mg::StorageId u, mg::StorageId v, mg::StorageId p, mg::StorageId div) {
   using namespace mg::shaders::postProject;
 
-  mg::PipelineStateDesc pipelineStateDesc = {};
-  pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
-
-  const auto pipeline = mg::mgSystem.pipelineContainer.createComputePipeline(pipelineStateDesc, {.shaderName = shader});
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (!pipelineContainer.isValid(postProjectComputePipelineHandle)) {
+    mg::PipelineStateDesc pipelineStateDesc = {};
+    pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
+    postProjectComputePipelineHandle = pipelineContainer.registerComputePipeline(
+        pipelineStateDesc, {.shaderName = shader, .specializationInfo = &workgroupSizeSpecializationInfo});
+  }
+  const auto pipeline = pipelineContainer.getPipeline(postProjectComputePipelineHandle);
 
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
@@ -206,7 +255,7 @@ static void postProjectCompute(int32_t N, mg::StorageId u, mg::StorageId v, mg::
                           mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
                           dynamicOffsets);
 
-  vkCmdDispatch(vkContext.commandBuffer, uint32_t(gridSize(N)) / 256, 1, 1);
+  vkCmdDispatch(vkContext.commandBuffer, workgroupCount(N, workgroupSize), 1, 1);
 
   VkMemoryBarrier memoryBarrier = {};
   memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
@@ -247,6 +296,8 @@ static void step(int32_t N, mg::StorageId u, mg::StorageId v, mg::StorageId u0,
                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 }
 
+static mg::PipelineHandle updateFromGuiPipelineHandle;
+
 static void updateFromGui(int32_t N, mg::StorageId d, mg::StorageId u, mg::StorageId v, const mg::FrameData &frameData) {
   int32_t i = int(frameData.mouse.xy.x * N);
   int32_t j = int((1.0f - frameData.mouse.xy.y) * N);
@@ -254,10 +305,13 @@ static void updateFromGui(int32_t N, mg::StorageId d, mg::StorageId u, mg::Stora
 
   using namespace mg::shaders::addSource;
 
-  mg::PipelineStateDesc pipelineStateDesc = {};
-  pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
-
-  const auto pipeline = mg::mgSystem.pipelineContainer.createComputePipeline(pipelineStateDesc, {.shaderName = shader});
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (!pipelineContainer.isValid(updateFromGuiPipelineHandle)) {
+    mg::PipelineStateDesc pipelineStateDesc = {};
+    pipelineStateDesc.compute.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
+    updateFromGuiPipelineHandle = pipelineContainer.registerComputePipeline(pipelineStateDesc, {.shaderName = shader});
+  }
+  const auto pipeline = pipelineContainer.getPipeline(updateFromGuiPipelineHandle);
 
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
@@ -293,8 +347,33 @@ static void updateFromGui(int32_t N, mg::StorageId d, mg::StorageId u, mg::Stora
                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 }
 
+static constexpr float dt = 0.1f;
+
+void tuneNavierStoke(uint32_t N) {
+  // the kernels are timed on scratch storages, the uploads of new storages are only submitted with the next frame and
+  // may still be owned by the transfer queue. Waiting for the device submits them and completes the ownership transfer
+  auto storages = createStorages(N);
+  mg::waitForDeviceIdle();
+
+  mg::AutotuneWorkgroupSizeInfo autotuneWorkgroupSizeInfo = {};
+  autotuneWorkgroupSizeInfo.shaderName = mg::shaders::diffuse::shader;
+  autotuneWorkgroupSizeInfo.pipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayoutStorage;
+  autotuneWorkgroupSizeInfo.constantId = workgroupSizeMapEntry.constantID;
+  autotuneWorkgroupSizeInfo.recordDispatch = [&](VkCommandBuffer commandBuffer, const mg::Pipeline &pipeline,
+                                                 uint32_t groupSize) {
+    // the velocity diffusion of a step
+    recordDiffuse(commandBuffer, pipeline, groupSize, N, 1, storages.u0, storages.u, 0, dt);
+    recordDiffuse(commandBuffer, pipeline, groupSize, N, 2, storages.v0, storages.v, 0, dt);
+  };
+  workgroupSize = mg::autotuneWorkgroupSize(autotuneWorkgroupSizeInfo);
+
+  // the timing runs have been waited for
+  destroyStorages(&storages);
+}
+
 void simulateNavierStoke(const Storages &storages, const mg::FrameData &frameData, uint32_t N) {
-  const float dt = 0.1f;
+  // the specialization constant is copied when the pipelines are registered
+  mgAssertDesc(workgroupSize != 0, "tuneNavierStoke must be called before the simulation");
   if (frameData.mouse.left)
     updateFromGui(N, storages.d, storages.u, storages.v, frameData);
   step(N, storages.u, storages.v, storages.u0, storages.v0, storages.d, storages.s, 0, dt);
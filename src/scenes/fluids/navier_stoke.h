@@ -12,6 +12,10 @@ struct Storages {
 
 Storages createStorages(size_t N);
 void destroyStorages(Storages *storages);
+// times the grid kernels with the workgroup sizes supported by the device and keeps the fastest, the simulation uses
+// it for all kernels. Submits and waits for the timing runs on scratch storages of the grid size, so it is called
+// once when the scene is created
+void tuneNavierStoke(uint32_t N);
 void simulateNavierStoke(const Storages &storages, const mg::FrameData &frameData, uint32_t N);
 void renderNavierStoke(const mg::RenderContext &renderContext, const Storages &storages);
 } // namespace mg
\ No newline at end of file
@@ -9,10 +9,15 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-void drawGltfMesh(const mg::RenderContext &renderContext, mg::MeshId meshId, const mg::Camera &camera,
-                  const std::unordered_map<std::string, mg::TextureId> &nameToTextureId) {
+static mg::PipelineHandle gltfPipelineHandle;
+
+static mg::Pipeline createGltfPipeline(const mg::RenderContext &renderContext) {
   using namespace mg::shaders::gltf;
 
+  auto &pipelineContainer = mg::mgSystem.pipelineContainer;
+  if (pipelineContainer.isValid(gltfPipelineHandle, renderContext.renderPass, renderContext.subpass))
+    return pipelineContainer.getPipeline(gltfPipelineHandle);
+
   mg::PipelineStateDesc pipelineStateDesc = {};
   pipelineStateDesc.rasterization.vkRenderPass = renderContext.renderPass;
   pipelineStateDesc.rasterization.vkPipelineLayout = mg::vkContext.pipelineLayouts.pipelineLayout;
@@ -22,7 +27,14 @@ void drawGltfMesh(const mg::RenderContext &renderContext, mg::MeshId meshId, con
   createPipelineInfo.vertexInputState = InputAssembler::vertexInputState;
   createPipelineInfo.vertexInputStateCount = mg::countof(InputAssembler::vertexInputState);
 
-  const auto pipeline = mg::mgSystem.pipelineContainer.createPipeline(pipelineStateDesc, createPipelineInfo);
+  gltfPipelineHandle = pipelineContainer.registerPipeline(pipelineStateDesc, createPipelineInfo);
+  return pipelineContainer.getPipeline(gltfPipelineHandle);
+}
+
+void drawGltfMesh(const mg::RenderContext &renderContext, mg::MeshId meshId, const mg::Camera &camera,
+                  const std::unordered_map<std::string, mg::TextureId> &nameToTextureId) {
+  const auto pipeline = createGltfPipeline(renderContext);
+  using namespace mg::shaders::gltf;
 
   VkBuffer uniformBuffer;
   uint32_t uniformOffset;
@@ -46,9 +58,8 @@ void drawGltfMesh(const mg::RenderContext &renderContext, mg::MeshId meshId, con
   descriptorSets.textures = mg::getTextureDescriptorSet();
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(pipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.baseColorIndex = mg::getTexture2DDescriptorIndex(nameToTextureId.at("WaterBottle_baseColor.png"));
@@ -60,10 +71,10 @@ void drawGltfMesh(const mg::RenderContext &renderContext, mg::MeshId meshId, con
   vkCmdPushConstants(mg::vkContext.commandBuffer, pipeline.layout, VK_SHADER_STAGE_ALL, 0, sizeof(TextureIndices),
                      &textureIndices);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(pipeline);
 
   const auto mesh = mg::getMesh(meshId);
   VkDeviceSize offset = 0;
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &mesh.buffer, &offset);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &mesh.buffer, &offset);
   vkCmdDraw(mg::vkContext.commandBuffer, mesh.indexCount, 1, 0, 0);
 }
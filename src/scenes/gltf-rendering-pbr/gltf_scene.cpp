@@ -9,14 +9,13 @@
 #include "rendering/rendering.h"
 #include "vulkan/vkContext.h"
 #include "vulkan/vkUtils.h"
-#include <lodepng.h>
 #include "vulkan/singleRenderpass.h"
 #include <unordered_map>
 
 static mg::Camera camera;
 static mg::SingleRenderPass singleRenderPass;
-static mg::MeshId cubeId;
-static std::unordered_map<std::string, mg::TextureId> nameToTextureId;
+// the mesh and the textures are created by the asset streamer, the mesh is drawn when they are loaded
+static mg::StreamId gltfStreamId;
 
 static void resizeCallback() {
   mg::resizeSingleRenderPass(&singleRenderPass);
@@ -27,32 +26,8 @@ void initScene() {
   mg::initSingleRenderPass(&singleRenderPass);
 
   camera = mg::create3DCamera(glm::vec3{0.0f, 0.0f, 0.5f}, glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
-  auto meshes = mg::parseGltf("box", mg::getDataPath() + "/water_bottle_gltf/", "WaterBottle.gltf");
-
-  const auto mesh = meshes.meshes.front();
-  mg::CreateMeshInfo createMeshInfo = {};
-  createMeshInfo.id = "box";
-  createMeshInfo.vertices = (uint8_t *)mesh.vertices.data();
-  createMeshInfo.verticesSizeInBytes = mg::sizeofContainerInBytes(mesh.vertices);
-  createMeshInfo.nrOfIndices = mesh.count;
-  cubeId = mg::mgSystem.meshContainer.createMesh(createMeshInfo);
-
-  for (const auto &image : meshes.images) {
-    std::vector<unsigned char> imageData;
-    uint32_t width, height;
-    const auto error = lodepng::decode(imageData, width, height, image.path + image.name);
-    mgAssertDesc(error == 0, "decoder error " << error << ": " << lodepng_error_text(error));
-
-    mg::CreateTextureInfo createTextureInfo = {};
-    createTextureInfo.data = imageData.data();
-    createTextureInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-    createTextureInfo.id = image.name;
-    createTextureInfo.size = {width, height, 1};
-    createTextureInfo.sizeInBytes = mg::sizeofContainerInBytes(imageData);
-    createTextureInfo.type = mg::TEXTURE_TYPE::TEXTURE_2D;
-    auto textureId = mg::mgSystem.textureContainer.createTexture(createTextureInfo);
-    nameToTextureId.emplace(image.name, textureId);
-  }
+  gltfStreamId = mg::mgSystem.assetStreamer.streamGltf("box", mg::getDataPath() + "/water_bottle_gltf/",
+                                                       "WaterBottle.gltf", mg::StreamingPriority::Near);
   mg::mgSystem.textureContainer.setupDescriptorSets();
   mg::vkContext.swapChain->resizeCallack = resizeCallback;
 }
@@ -79,7 +54,10 @@ void renderScene(const mg::FrameData &frameData) {
   mg::RenderContext renderContext = {};
   renderContext.renderPass = singleRenderPass.vkRenderPass;
 
-  drawGltfMesh(renderContext, cubeId, camera, nameToTextureId);
+  if (mg::mgSystem.assetStreamer.isLoaded(gltfStreamId)) {
+    const auto &gltf = mg::mgSystem.assetStreamer.getGltf(gltfStreamId);
+    drawGltfMesh(renderContext, gltf.meshId, camera, gltf.nameToTextureId);
+  }
 
   mg::endSingleRenderPass();
 
@@ -137,9 +137,8 @@ void renderParticels(mg::RenderContext &renderContext, const ComputeData &comput
   descriptorSets.textures = mg::getTextureDescriptorSet();
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(pipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.textureIndex = mg::getTexture2DDescriptorIndex(computeData.particleId);
@@ -147,12 +146,12 @@ void renderParticels(mg::RenderContext &renderContext, const ComputeData &comput
   vkCmdPushConstants(mg::vkContext.commandBuffer, pipeline.layout, VK_SHADER_STAGE_ALL, 0, sizeof(TextureIndices),
                      &textureIndices);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(pipeline);
 
   const auto storageData = mg::getStorage(computeData.storageId);
   const auto count = storageData.size / (sizeof(glm::vec4) * 2);
   VkDeviceSize offset = 0;
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &storageData.buffer, &offset);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &storageData.buffer, &offset);
   vkCmdDraw(mg::vkContext.commandBuffer, uint32_t(count), 1, 0, 0);
 }
 
@@ -189,9 +188,8 @@ void renderToneMapping(const mg::RenderContext &renderContext, const NBodyRender
   descriptorSets.textures = mg::getTextureDescriptorSet();
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(pipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.textureIndex = mg::getTexture2DDescriptorIndex(nBodyRenderPass.toneMapping);
@@ -199,6 +197,6 @@ void renderToneMapping(const mg::RenderContext &renderContext, const NBodyRender
   vkCmdPushConstants(mg::vkContext.commandBuffer, pipeline.layout, VK_SHADER_STAGE_ALL, 0, sizeof(TextureIndices),
                      &textureIndices);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(pipeline);
   vkCmdDraw(mg::vkContext.commandBuffer, 3, 1, 0, 0);
 }
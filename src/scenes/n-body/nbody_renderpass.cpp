@@ -99,6 +99,7 @@ static void createRenderPass(NBodyRenderPass *nBodyRenderPass) {
   renderPassInfo.pDependencies = dependencies;
 
   mg::checkResult(vkCreateRenderPass(mg::vkContext.device, &renderPassInfo, nullptr, &nBodyRenderPass->vkRenderPass));
+  mg::mgSystem.pipelineContainer.registerRenderPass(nBodyRenderPass->vkRenderPass, "nBody");
 }
 
 static void createFrameBuffer(NBodyRenderPass *nBodyRenderPass) {
@@ -146,6 +147,7 @@ void resizeNBodyRenderPass(NBodyRenderPass *nBodyRenderPass) {
 void destroyNBodyRenderPass(NBodyRenderPass *nBodyRenderPass) {
   destroyFrameBuffers(nBodyRenderPass);
   destroyTextures(nBodyRenderPass);
+  mg::mgSystem.pipelineContainer.unregisterRenderPass(nBodyRenderPass->vkRenderPass);
   vkDestroyRenderPass(mg::vkContext.device, nBodyRenderPass->vkRenderPass, nullptr);
 }
 
@@ -108,7 +108,8 @@ void traceTriangle(const World &world, const mg::Camera &camera, const mg::Rende
   auto storageAccumulationImage = mg::mgSystem.storageContainer.getStorage(rayInfo.storageAccumulationImageID);
 
   DescriptorSets descriptorSets = {};
-  descriptorSets.ubo = uboSet;
+  // the set from the last allocation covers both the uniform and the storage binding
+  descriptorSets.ubo = storageSet;
   descriptorSets.image = storageImage.descriptorSet;
   descriptorSets.topLevelAS = rayInfo.topLevelASDescriptorSet;
   descriptorSets.textures = mg::getTextureDescriptorSet();
@@ -166,10 +167,9 @@ void drawImageStorage(const mg::RenderContext &renderContext, const RayInfo &ray
   descriptorSets.image = storageImage.descriptorSet;
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(pipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(pipeline);
   vkCmdDraw(mg::vkContext.commandBuffer, 3, 1, 0, 0);
 }
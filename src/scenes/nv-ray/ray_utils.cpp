@@ -34,20 +34,20 @@ struct VkGeometryInstance {
 };
 
 static void createStorageImages(RayInfo *rayInfo) {
-  {
-    mg::CreateImageStorageInfo createImageStorageInfo = {};
-    createImageStorageInfo.format = mg::vkContext.swapChain->format;
-    createImageStorageInfo.id = "storage image";
-    createImageStorageInfo.size = {mg::vkContext.screen.width, mg::vkContext.screen.height, 1};
-    rayInfo->storageImageId = mg::mgSystem.storageContainer.createImageStorage(createImageStorageInfo);
-  }
-  {
-    mg::CreateImageStorageInfo createImageStorageInfo = {};
-    createImageStorageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    createImageStorageInfo.id = "accumulationImage";
-    createImageStorageInfo.size = {mg::vkContext.screen.width, mg::vkContext.screen.height, 1};
-    rayInfo->storageAccumulationImageID = mg::mgSystem.storageContainer.createImageStorage(createImageStorageInfo);
-  }
+  mg::CreateImageStorageInfo createImageStorageInfos[2] = {};
+  createImageStorageInfos[0].format = mg::vkContext.swapChain->format;
+  createImageStorageInfos[0].id = "storage image";
+  createImageStorageInfos[0].size = {mg::vkContext.screen.width, mg::vkContext.screen.height, 1};
+
+  createImageStorageInfos[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  createImageStorageInfos[1].id = "accumulationImage";
+  createImageStorageInfos[1].size = {mg::vkContext.screen.width, mg::vkContext.screen.height, 1};
+
+  mg::StorageId storageIds[2] = {};
+  mg::mgSystem.storageContainer.createImageStorages(createImageStorageInfos, mg::countof(createImageStorageInfos),
+                                                    storageIds);
+  rayInfo->storageImageId = storageIds[0];
+  rayInfo->storageAccumulationImageID = storageIds[1];
 }
 static void destroyStorageImges(RayInfo *rayInfo) {
   mg::mgSystem.storageContainer.removeStorage(rayInfo->storageImageId);
@@ -58,13 +58,12 @@ void drawFrontAndBack(const mg::RenderContext &renderContext, const VolumeInfo &
   descriptorSets.ubo = uboSet;
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, frontAndBackPipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(frontAndBackPipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
-  vkCmdBindVertexBuffers(mg::vkContext.commandBuffer, 0, 1, &buffer, &bufferOffset);
-  vkCmdBindIndexBuffer(mg::vkContext.commandBuffer, indexBuffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, frontAndBackPipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindVertexBuffers(0, 1, &buffer, &bufferOffset);
+  mg::mgSystem.commandRecorder.bindIndexBuffer(indexBuffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(frontAndBackPipeline);
   vkCmdDrawIndexed(mg::vkContext.commandBuffer, mg::countof(cubeMesh.indices), 1, 0, 0, 0);
 }
 
@@ -117,9 +116,8 @@ void drawVolume(const mg::RenderContext &renderContext, const mg::Camera &camera
   descriptorSets.volumeTexture = mg::getTextureDescriptorSet3D();
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, volumePipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(volumePipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.backIndex = mg::getTexture2DDescriptorIndex(volumeRenderPass.back);
@@ -129,7 +127,7 @@ void drawVolume(const mg::RenderContext &renderContext, const mg::Camera &camera
   vkCmdPushConstants(mg::vkContext.commandBuffer, volumePipeline.layout, VK_SHADER_STAGE_ALL, 0, sizeof(TextureIndices),
                      &textureIndices);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, volumePipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(volumePipeline);
   vkCmdDraw(mg::vkContext.commandBuffer, 3, 1, 0, 0);
 }
 
@@ -168,15 +166,14 @@ void drawDenoise(const mg::RenderContext &renderContext, const VolumeRenderPass
   descriptorSets.textures = mg::getTextureDescriptorSet();
 
   uint32_t dynamicOffsets[] = {uniformOffset, 0};
-  vkCmdBindDescriptorSets(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, denoisePipeline.layout, 0,
-                          mg::countof(descriptorSets.values), descriptorSets.values, mg::countof(dynamicOffsets),
-                          dynamicOffsets);
+  mg::mgSystem.commandRecorder.bindDescriptorSets(denoisePipeline.layout, 0, mg::countof(descriptorSets.values),
+                                                  descriptorSets.values, mg::countof(dynamicOffsets), dynamicOffsets);
 
   TextureIndices textureIndices = {};
   textureIndices.textureIndex = mg::getTexture2DDescriptorIndex(volumeRenderPass.color);
   vkCmdPushConstants(mg::vkContext.commandBuffer, denoisePipeline.layout, VK_SHADER_STAGE_ALL, 0,
                      sizeof(TextureIndices), &textureIndices);
 
-  vkCmdBindPipeline(mg::vkContext.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, denoisePipeline.pipeline);
+  mg::mgSystem.commandRecorder.bindGraphicsPipeline(denoisePipeline);
   vkCmdDraw(mg::vkContext.commandBuffer, 3, 1, 0, 0);
 }
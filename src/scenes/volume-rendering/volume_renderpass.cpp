@@ -142,6 +142,7 @@ static void createRenderPass(VolumeRenderPass *volumeRenderPass) {
   renderPassInfo.pDependencies = dependencies;
 
   mg::checkResult(vkCreateRenderPass(mg::vkContext.device, &renderPassInfo, nullptr, &volumeRenderPass->vkRenderPass));
+  mg::mgSystem.pipelineContainer.registerRenderPass(volumeRenderPass->vkRenderPass, "volume");
 }
 
 static void createFrameBuffer(VolumeRenderPass *volumeRenderPass) {
@@ -200,6 +201,7 @@ void resizeVolumeRenderPass(VolumeRenderPass *volumeRenderPass) {
 void destroyVolumeRenderPass(VolumeRenderPass *volumeRenderPass) {
   destroyFrameBuffers(volumeRenderPass);
   destroyTextures(volumeRenderPass);
+  mg::mgSystem.pipelineContainer.unregisterRenderPass(volumeRenderPass->vkRenderPass);
   vkDestroyRenderPass(mg::vkContext.device, volumeRenderPass->vkRenderPass, nullptr);
 }
 
@@ -0,0 +1,303 @@
+#include "mg/jobDeque.h"
+#include "mg/jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// tests of the work stealing deque and the job system, returns nonzero when a check fails
+
+static uint32_t nrOfFailedChecks = 0;
+
+#define CHECK(cond)                                                                                                    \
+  do {                                                                                                                 \
+    if (!(cond)) {                                                                                                     \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                                  \
+      nrOfFailedChecks++;                                                                                              \
+    }                                                                                                                  \
+  } while (0)
+
+static constexpr uint32_t nrOfTestThreads = 4;
+
+// the deque only stores the pointers, the jobs are never run
+static std::unique_ptr<mg::jobs::Job[]> createJobs(uint32_t count) {
+  return std::make_unique<mg::jobs::Job[]>(count);
+}
+
+static void testDequeOrder() {
+  constexpr uint32_t nrOfJobs = 16;
+  auto jobs = createJobs(nrOfJobs);
+  auto deque = std::make_unique<mg::jobs::_JobDeque>();
+
+  CHECK(deque->pop() == nullptr);
+  CHECK(deque->steal() == nullptr);
+  for (uint32_t i = 0; i < nrOfJobs; i++)
+    deque->push(&jobs[i]);
+  // the owner pops the newest job, thieves steal the oldest
+  CHECK(deque->pop() == &jobs[nrOfJobs - 1]);
+  CHECK(deque->steal() == &jobs[0]);
+  CHECK(deque->steal() == &jobs[1]);
+  for (uint32_t i = nrOfJobs - 2; i >= 2; i--)
+    CHECK(deque->pop() == &jobs[i]);
+  CHECK(deque->pop() == nullptr);
+  CHECK(deque->steal() == nullptr);
+
+  // the indices wrap around the capacity
+  for (uint32_t i = 0; i < 3 * mg::jobs::MaxNrOfJobsPerThread; i++) {
+    deque->push(&jobs[i % nrOfJobs]);
+    CHECK(deque->steal() == &jobs[i % nrOfJobs]);
+  }
+  CHECK(deque->pop() == nullptr);
+}
+
+// the owner pushes and pops while the thieves steal, every job must be taken exactly once
+static void testDequeContention() {
+  constexpr uint32_t nrOfJobs = 1u << 18;
+  constexpr uint32_t batchSize = 1024;
+  auto jobs = createJobs(nrOfJobs);
+  auto deque = std::make_unique<mg::jobs::_JobDeque>();
+  auto nrOfTakes = std::make_unique<std::atomic<uint32_t>[]>(nrOfJobs);
+  std::atomic<bool> done = {false};
+  std::atomic<uint32_t> nrOfStolenJobs = {0};
+
+  const auto take = [&](mg::jobs::Job *job) {
+    const auto index = uint32_t(job - jobs.get());
+    if (index < nrOfJobs)
+      nrOfTakes[index].fetch_add(1);
+  };
+
+  std::vector<std::thread> thieves;
+  for (uint32_t i = 0; i < nrOfTestThreads; i++) {
+    thieves.emplace_back([&]() {
+      while (!done.load()) {
+        if (auto *job = deque->steal()) {
+          take(job);
+          nrOfStolenJobs.fetch_add(1);
+        }
+      }
+    });
+  }
+
+  uint32_t nrOfPoppedJobs = 0;
+  for (uint32_t begin = 0; begin < nrOfJobs; begin += batchSize) {
+    for (uint32_t i = begin; i < begin + batchSize; i++)
+      deque->push(&jobs[i]);
+    // pop half of every batch and everything that is left after every second batch, so the deque never holds more
+    // than its capacity
+    const bool drain = (begin / batchSize) % 2 == 1 || begin + batchSize == nrOfJobs;
+    for (uint32_t i = 0; i < batchSize / 2 || drain; i++) {
+      auto *job = deque->pop();
+      if (job == nullptr)
+        break;
+      take(job);
+      nrOfPoppedJobs++;
+    }
+  }
+  done = true;
+  for (auto &thief : thieves)
+    thief.join();
+
+  CHECK(nrOfPoppedJobs + nrOfStolenJobs.load() == nrOfJobs);
+  uint32_t nrOfJobsNotTakenOnce = 0;
+  for (uint32_t i = 0; i < nrOfJobs; i++)
+    nrOfJobsNotTakenOnce += nrOfTakes[i].load() != 1;
+  CHECK(nrOfJobsNotTakenOnce == 0);
+  CHECK(deque->steal() == nullptr);
+}
+
+// the owner pops the only job while a thief steals it, exactly one of them must get it
+static void testDequeLastJobRace() {
+  constexpr uint32_t nrOfRounds = 100000;
+  auto jobs = createJobs(1);
+  auto deque = std::make_unique<mg::jobs::_JobDeque>();
+  std::atomic<bool> done = {false};
+  std::atomic<uint32_t> nrOfStolenJobs = {0};
+
+  std::thread thief([&]() {
+    while (!done.load()) {
+      if (deque->steal() != nullptr)
+        nrOfStolenJobs.fetch_add(1);
+      else
+        std::this_thread::yield();
+    }
+  });
+
+  uint32_t nrOfPoppedJobs = 0;
+  uint32_t nrOfJobsLeft = 0;
+  for (uint32_t i = 0; i < nrOfRounds; i++) {
+    deque->push(&jobs[0]);
+    if (deque->pop() != nullptr) {
+      nrOfPoppedJobs++;
+    } else {
+      // the thief has taken the job and is about to count it
+      while (nrOfPoppedJobs + nrOfStolenJobs.load() != i + 1)
+        std::this_thread::yield();
+    }
+    // the deque must be empty again whoever won
+    nrOfJobsLeft += deque->pop() != nullptr;
+  }
+  done = true;
+  thief.join();
+
+  CHECK(nrOfPoppedJobs + nrOfStolenJobs.load() == nrOfRounds);
+  CHECK(nrOfJobsLeft == 0);
+  printf("  %u popped, %u stolen\n", nrOfPoppedJobs, nrOfStolenJobs.load());
+}
+
+struct _Tree {
+  std::atomic<uint32_t> *nrOfLeaves;
+  uint32_t depth;
+};
+
+static void spawnTree(mg::jobs::Job *job, const void *data) {
+  const auto &tree = *(const _Tree *)data;
+  if (tree.depth == 0) {
+    tree.nrOfLeaves->fetch_add(1);
+    return;
+  }
+  const _Tree child = {tree.nrOfLeaves, tree.depth - 1};
+  for (uint32_t i = 0; i < 4; i++)
+    mg::jobs::run(mg::jobs::createChildJob(job, spawnTree, &child, sizeof(child)));
+}
+
+// every job creates child jobs down to a depth, the root is not finished before all leaves have run
+static void testNestedChildJobs() {
+  mg::jobs::create(nrOfTestThreads - 1);
+
+  for (uint32_t depth = 0; depth <= 5; depth++) {
+    std::atomic<uint32_t> nrOfLeaves = {0};
+    const _Tree tree = {&nrOfLeaves, depth};
+    auto *root = mg::jobs::createJob(spawnTree, &tree, sizeof(tree));
+    mg::jobs::run(root);
+    mg::jobs::wait(root);
+    CHECK(mg::jobs::isFinished(root));
+    CHECK(nrOfLeaves.load() == 1u << (2 * depth));
+  }
+
+  // a child that is blocked keeps its parent and grandparent unfinished
+  std::atomic<bool> isChildRunning = {false};
+  std::atomic<bool> isChildReleased = {false};
+  auto *root = mg::jobs::createJob([]() {});
+  auto *parent = mg::jobs::createChildJob(root, []() {});
+  auto *child = mg::jobs::createChildJob(parent, [&]() {
+    isChildRunning = true;
+    while (!isChildReleased.load())
+      std::this_thread::yield();
+  });
+  mg::jobs::run(child);
+  mg::jobs::run(parent);
+  mg::jobs::run(root);
+  // the workers steal the jobs, the creating thread does not run any until it waits. Only the child is left when the
+  // functions of the parent and the root have returned
+  while (!isChildRunning.load() || parent->nrOfUnfinishedJobs.load() != 1 || root->nrOfUnfinishedJobs.load() != 1)
+    std::this_thread::yield();
+  CHECK(!mg::jobs::isFinished(child));
+  CHECK(!mg::jobs::isFinished(parent));
+  CHECK(!mg::jobs::isFinished(root));
+  isChildReleased = true;
+  mg::jobs::wait(root);
+  CHECK(mg::jobs::isFinished(child));
+  CHECK(mg::jobs::isFinished(parent));
+
+  mg::jobs::destroy();
+}
+
+// every index is covered exactly once by non empty ranges of at most the grain size
+static void testParallelFor(uint32_t nrOfWorkerThreads) {
+  mg::jobs::create(nrOfWorkerThreads);
+
+  const uint32_t ranges[][2] = {{0, 0}, {5, 5}, {7, 3}, {0, 1}, {3, 4}, {0, 7}, {1, 8}, {5, 1000}, {0, 1023},
+                                {17, 4113}};
+  const uint32_t grainSizes[] = {0, 1, 2, 3, 7, 64, 1000, 5000};
+  for (const auto &range : ranges) {
+    for (const auto grainSize : grainSizes) {
+      const auto begin = range[0];
+      const auto end = range[1];
+      const auto size = end > begin ? end - begin : 0;
+      auto nrOfCalls = std::make_unique<std::atomic<uint32_t>[]>(size + 1);
+      std::atomic<uint32_t> nrOfBadRanges = {0};
+      mg::jobs::parallelFor(begin, end, grainSize, [&](uint32_t rangeBegin, uint32_t rangeEnd) {
+        if (rangeBegin < begin || rangeEnd > end || rangeBegin >= rangeEnd ||
+            rangeEnd - rangeBegin > std::max(grainSize, 1u)) {
+          nrOfBadRanges.fetch_add(1);
+          return;
+        }
+        for (uint32_t i = rangeBegin; i < rangeEnd; i++)
+          nrOfCalls[i - begin].fetch_add(1);
+      });
+
+      uint32_t nrOfIndicesNotCoveredOnce = 0;
+      for (uint32_t i = 0; i < size; i++)
+        nrOfIndicesNotCoveredOnce += nrOfCalls[i].load() != 1;
+      CHECK(nrOfBadRanges.load() == 0);
+      CHECK(nrOfIndicesNotCoveredOnce == 0);
+      if (nrOfBadRanges.load() != 0 || nrOfIndicesNotCoveredOnce != 0)
+        printf("  range [%u, %u), grain size %u, %u worker threads\n", begin, end, grainSize, nrOfWorkerThreads);
+    }
+  }
+
+  mg::jobs::destroy();
+}
+
+// joined threads run their own parallelFor and leave their deque to the next thread that joins
+static void testJoinedThreads() {
+  mg::jobs::create(nrOfTestThreads - 1);
+
+  constexpr uint32_t nrOfIndices = 1u << 16;
+  constexpr uint32_t nrOfRounds = 3;
+  for (uint32_t round = 0; round < nrOfRounds; round++) {
+    std::atomic<uint32_t> sums[mg::jobs::MaxNrOfJoinedThreads] = {};
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < mg::jobs::MaxNrOfJoinedThreads; i++) {
+      threads.emplace_back([&sums, i]() {
+        mg::jobs::joinThread();
+        mg::jobs::parallelFor(0, nrOfIndices, 256, [&sums, i](uint32_t begin, uint32_t end) {
+          sums[i].fetch_add(end - begin);
+        });
+        mg::jobs::leaveThread();
+      });
+    }
+    // the thread that created the job system keeps running jobs of its own meanwhile
+    std::atomic<uint32_t> sum = {0};
+    mg::jobs::parallelFor(0, nrOfIndices, 256, [&sum](uint32_t begin, uint32_t end) { sum.fetch_add(end - begin); });
+    for (auto &thread : threads)
+      thread.join();
+
+    CHECK(sum.load() == nrOfIndices);
+    for (const auto &threadSum : sums)
+      CHECK(threadSum.load() == nrOfIndices);
+  }
+
+  // destroy asserts that every joined thread has left
+  mg::jobs::destroy();
+}
+
+int main() {
+  const struct {
+    const char *name;
+    void (*function)();
+  } tests[] = {
+      {"deque order", testDequeOrder},
+      {"deque contention", testDequeContention},
+      {"deque last job race", testDequeLastJobRace},
+      {"nested child jobs", testNestedChildJobs},
+      {"parallel for without workers", []() { testParallelFor(0); }},
+      {"parallel for", []() { testParallelFor(nrOfTestThreads - 1); }},
+      {"joined threads", testJoinedThreads},
+  };
+  for (const auto &test : tests) {
+    const auto nrOfFailedChecksBefore = nrOfFailedChecks;
+    printf("%s\n", test.name);
+    const auto start = std::chrono::steady_clock::now();
+    test.function();
+    const auto durationInMs =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    printf("  %s, %lld ms\n", nrOfFailedChecks == nrOfFailedChecksBefore ? "ok" : "failed", (long long)durationInMs);
+  }
+  printf("%u failed checks\n", nrOfFailedChecks);
+  return nrOfFailedChecks == 0 ? 0 : 1;
+}